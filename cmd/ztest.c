@@ -6253,6 +6253,7 @@ ztest_spa_prop_get_set(ztest_ds_t *zd, uint64_t id)
 	(void) pthread_rwlock_rdlock(&ztest_name_lock);
 
 	(void) ztest_spa_prop_set_uint64(ZPOOL_PROP_AUTOTRIM, ztest_random(2));
+	(void) ztest_spa_prop_set_uint64(ZPOOL_PROP_IOSCHED, ztest_random(2));
 
 	nvlist_t *props = fnvlist_alloc();
 
@@ -0,0 +1,25 @@
+dnl #
+dnl # Check for the io_uring UAPI used by file vdevs in libzpool.  The ring
+dnl # is driven through the raw system calls, so liburing is not required.
+dnl #
+AC_DEFUN([ZFS_AC_CONFIG_USER_IO_URING], [
+	AC_MSG_CHECKING([for io_uring])
+	AC_COMPILE_IFELSE([
+		AC_LANG_PROGRAM([[
+			#include <sys/syscall.h>
+			#include <linux/io_uring.h>
+		]], [[
+			struct io_uring_probe probe;
+			int op = IORING_OP_READ;
+			long nr = __NR_io_uring_setup;
+			(void)probe;
+			(void)op;
+			(void)nr;
+		]])
+	], [
+		AC_MSG_RESULT([yes])
+		AC_DEFINE([HAVE_IO_URING], [1], [io_uring is available])
+	], [
+		AC_MSG_RESULT([no])
+	])
+])
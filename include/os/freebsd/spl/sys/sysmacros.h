@@ -82,6 +82,14 @@ extern "C" {
 #define	kpreempt_enable() critical_exit()
 #define	CPU_SEQID curcpu
 #define	CPU_SEQID_UNSTABLE curcpu
+/* Taskq threads are not bound to memory domains, see taskq_create_proc_node */
+#define	boot_nnodes 1
+#define	CPU_NODEID 0
+#define	max_nnodes 1
+#define	node_is_online(nid) ((nid) == 0)
+#ifndef NUMA_NO_NODE
+#define	NUMA_NO_NODE (-1)
+#endif
 #define	is_system_labeled()		0
 /*
  * Convert a single byte to/from binary-coded decimal (BCD).
@@ -73,6 +73,8 @@ typedef struct zfs_uio {
 #define	zfs_uio_soffset(u)	(u)->uio_soffset
 #define	zfs_uio_fault_disable(u, set)
 #define	zfs_uio_prefaultpages(size, u)	(0)
+#define	zfs_uio_async(u)		(B_FALSE)
+#define	zfs_uio_async_done(u, n, e)	VERIFY(0)
 
 static inline void
 zfs_uio_setoffset(zfs_uio_t *uio, offset_t off)
@@ -29,6 +29,8 @@
 #include <linux/sched.h>
 #include <linux/sched/rt.h>
 #include <linux/cpumask.h>
+#include <linux/nodemask.h>
+#include <linux/topology.h>
 #include <sys/debug.h>
 #include <sys/zone.h>
 #include <sys/signal.h>
@@ -78,6 +80,10 @@
 #define	boot_ncpus			num_online_cpus()
 #define	CPU_SEQID			smp_processor_id()
 #define	CPU_SEQID_UNSTABLE		raw_smp_processor_id()
+#define	boot_nnodes			num_online_nodes()
+#define	CPU_NODEID			numa_node_id()
+#define	max_nnodes			nr_node_ids
+#define	node_is_online(nid)		node_online(nid)
 #define	is_system_labeled()		0
 
 #ifndef RLIM64_INFINITY
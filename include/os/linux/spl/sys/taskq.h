@@ -119,6 +119,8 @@ typedef struct taskq {
 	int			tq_maxthreads;	/* # of threads maximum */
 	/* If PERCPU flag is set, percent of NCPUs to have as threads */
 	int			tq_cpu_pct;
+	int			tq_node;	/* NUMA node or NUMA_NO_NODE */
+	int			tq_node_cpu;	/* last CPU bound on tq_node */
 	int			tq_pri;		/* priority */
 	int			tq_minalloc;	/* min taskq_ent_t pool size */
 	int			tq_maxalloc;	/* max taskq_ent_t pool size */
@@ -192,6 +194,8 @@ extern void taskq_dispatch_ent(taskq_t *, task_func_t, void *, uint_t,
 extern int taskq_empty_ent(taskq_ent_t *);
 extern void taskq_init_ent(taskq_ent_t *);
 extern taskq_t *taskq_create(const char *, int, pri_t, int, int, uint_t);
+extern taskq_t *taskq_create_node(const char *, int, pri_t, int, int, uint_t,
+    int);
 extern taskq_t *taskq_create_synced(const char *, int, pri_t, int, int, uint_t,
     kthread_t ***);
 extern void taskq_destroy(taskq_t *);
@@ -204,6 +208,8 @@ extern taskq_t *taskq_of_curthread(void);
 
 #define	taskq_create_proc(name, nthreads, pri, min, max, proc, flags) \
     taskq_create(name, nthreads, pri, min, max, flags)
+#define	taskq_create_proc_node(name, nthreads, pri, min, max, proc, flags, \
+    node) taskq_create_node(name, nthreads, pri, min, max, flags, node)
 #define	taskq_create_sysdc(name, nthreads, min, max, proc, dc, flags) \
 	((void) sizeof (dc), \
 	    taskq_create(name, nthreads, maxclsyspri, min, max, flags))
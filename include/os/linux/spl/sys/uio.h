@@ -67,6 +67,13 @@ typedef struct {
 	boolean_t	pinned;		/* Whether FOLL_PIN was used */
 } zfs_uio_dio_t;
 
+struct zfs_uio;
+
+/*
+ * Called when an asynchronous Direct I/O request completes.
+ */
+typedef void (zfs_uio_done_func_t)(struct zfs_uio *, ssize_t, int);
+
 typedef struct zfs_uio {
 	union {
 		const struct iovec	*uio_iov;
@@ -83,6 +90,7 @@ typedef struct zfs_uio {
 	ssize_t		uio_resid;	/* Residual unprocessed bytes */
 	size_t		uio_skip;	/* Skipped bytes in current iovec */
 	zfs_uio_dio_t	uio_dio;	/* Direct I/O user pages */
+	zfs_uio_done_func_t *uio_done;	/* Async Direct I/O completion */
 
 	struct request	*rq;
 } zfs_uio_t;
@@ -98,6 +106,8 @@ typedef struct zfs_uio {
 #define	zfs_uio_soffset(u)		(u)->uio_soffset
 #define	zfs_uio_rlimit_fsize(z, u)	(0)
 #define	zfs_uio_fault_move(p, n, rw, u)	zfs_uiomove((p), (n), (rw), (u))
+#define	zfs_uio_async(u)		((u)->uio_done != NULL)
+#define	zfs_uio_async_done(u, n, e)	(u)->uio_done((u), (n), (e))
 
 extern int zfs_uio_prefaultpages(ssize_t, zfs_uio_t *);
 
@@ -139,6 +149,7 @@ zfs_uio_iovec_init(zfs_uio_t *uio, const struct iovec *iov,
 	uio->uio_skip = skip;
 	uio->uio_soffset = uio->uio_loffset;
 	memset(&uio->uio_dio, 0, sizeof (zfs_uio_dio_t));
+	uio->uio_done = NULL;
 }
 
 static inline void
@@ -170,6 +181,7 @@ zfs_uio_bvec_init(zfs_uio_t *uio, struct bio *bio, struct request *rq)
 	uio->rq = rq;
 	uio->uio_soffset = uio->uio_loffset;
 	memset(&uio->uio_dio, 0, sizeof (zfs_uio_dio_t));
+	uio->uio_done = NULL;
 }
 
 static inline void
@@ -187,6 +199,7 @@ zfs_uio_iov_iter_init(zfs_uio_t *uio, struct iov_iter *iter, offset_t offset,
 	uio->uio_skip = 0;
 	uio->uio_soffset = uio->uio_loffset;
 	memset(&uio->uio_dio, 0, sizeof (zfs_uio_dio_t));
+	uio->uio_done = NULL;
 }
 
 #if defined(HAVE_ITER_IOV)
@@ -137,7 +137,6 @@ struct zfsvfs {
 	uint64_t	z_defaultuserobjquota;
 	uint64_t	z_defaultgroupobjquota;
 	uint64_t	z_defaultprojectobjquota;
-	uint64_t	z_replay_eof;	/* New end of file - replay only */
 	sa_attr_type_t	*z_attr_table;	/* SA attr mapping->id */
 	uint64_t	z_hold_size;	/* znode hold array size */
 	avl_tree_t	*z_hold_trees;	/* znode hold trees */
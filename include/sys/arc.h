@@ -257,6 +257,19 @@ typedef struct arc_buf_info {
 	enum zio_compress	abi_l2arc_compress;
 } arc_buf_info_t;
 
+/*
+ * Per-dataset ARC statistics, see arc_tenant_stats().
+ */
+typedef struct arc_tenant_stats {
+	uint64_t	ats_size;
+	uint64_t	ats_quota;
+	uint64_t	ats_reserve;
+	uint64_t	ats_mru_ghost_hits;
+	uint64_t	ats_mfu_ghost_hits;
+	uint64_t	ats_quota_uncached;
+	uint64_t	ats_reserve_skip;
+} arc_tenant_stats_t;
+
 /*
  * Flags returned by arc_cached; describes which part of the arc
  * the block is cached in.
@@ -329,6 +342,11 @@ void arc_remove_prune_callback(arc_prune_t *p);
 void arc_freed(spa_t *spa, const blkptr_t *bp);
 int arc_cached(spa_t *spa, const blkptr_t *bp);
 
+void arc_tenant_set(spa_t *spa, uint64_t objset, uint64_t quota,
+    uint64_t reserve);
+boolean_t arc_tenant_stats(uint64_t load_guid, uint64_t objset,
+    arc_tenant_stats_t *ats);
+
 void arc_flush(spa_t *spa, boolean_t retry);
 void arc_flush_async(spa_t *spa);
 void arc_tempreserve_clear(uint64_t reserve);
@@ -171,6 +171,10 @@ typedef struct l1arc_buf_hdr {
 	uint32_t		b_mfu_hits;
 	uint32_t		b_mfu_ghost_hits;
 	uint8_t			b_byteswap;
+	/* index into arc_tenants[], 0 if not charged to a dataset */
+	uint16_t		b_tenant;
+	/* at_gen of the tenant, tells it apart from later slot users */
+	uint32_t		b_tenant_gen;
 	arc_buf_t		*b_buf;
 
 	/* self protecting */
@@ -378,6 +382,19 @@ typedef struct l2arc_lb_ptr_buf {
 /*
  * L2ARC Internals
  */
+/*
+ * Per-device L2ARC feed statistics, exported as the
+ * "l2arc_feed-<vdev guid>" kstat of the pool.
+ */
+typedef struct l2arc_feed_stats {
+	kstat_named_t	feeds;
+	kstat_named_t	writes_sent;
+	kstat_named_t	write_bytes;
+	kstat_named_t	write_asize;
+	kstat_named_t	feed_time_us;
+	kstat_named_t	write_rate;
+} l2arc_feed_stats_t;
+
 typedef struct l2arc_dev {
 	vdev_t			*l2ad_vdev;	/* can be NULL during remove */
 	spa_t			*l2ad_spa;	/* can be NULL during remove */
@@ -421,6 +438,18 @@ typedef struct l2arc_dev {
 	 */
 	zfs_refcount_t		l2ad_lb_count;
 	boolean_t		l2ad_trim_all; /* TRIM whole device */
+	/*
+	 * Feed state, protected by l2arc_dev_mtx.  Each device is fed by its
+	 * own task, which only scans the ARC sublists whose index is
+	 * congruent to l2ad_feed_slot modulo l2ad_feed_nslots.
+	 */
+	boolean_t		l2ad_feeding;	/* feed task in flight */
+	clock_t			l2ad_feed_next;	/* next feed, in lbolt */
+	clock_t			l2ad_feed_last;	/* last feed, in lbolt */
+	uint_t			l2ad_feed_slot;
+	uint_t			l2ad_feed_nslots;
+	kstat_t			*l2ad_feed_ksp;
+	l2arc_feed_stats_t	l2ad_feed_stats;
 } l2arc_dev_t;
 
 /*
@@ -566,6 +595,11 @@ typedef struct arc_stats {
 	 * not from the spa we're trying to evict from.
 	 */
 	kstat_named_t arcstat_evict_skip;
+	/*
+	 * Number of buffers skipped because the dataset they are charged
+	 * to is within its primarycache_reserve.
+	 */
+	kstat_named_t arcstat_evict_reserve_skip;
 	/*
 	 * Number of times arc_evict_state() was unable to evict enough
 	 * buffers to reach its target amount.
@@ -582,6 +616,11 @@ typedef struct arc_stats {
 	kstat_named_t arcstat_hash_collisions;
 	kstat_named_t arcstat_hash_chains;
 	kstat_named_t arcstat_hash_chain_max;
+	/*
+	 * Number of buf_hash_find() lookups which found an empty bucket
+	 * and returned without taking the hash lock.
+	 */
+	kstat_named_t arcstat_hash_lockless_misses;
 	kstat_named_t arcstat_meta;
 	kstat_named_t arcstat_pd;
 	kstat_named_t arcstat_pm;
@@ -805,6 +844,12 @@ typedef struct arc_stats {
 	kstat_named_t arcstat_l2_evict_l1cached;
 	kstat_named_t arcstat_l2_free_on_write;
 	kstat_named_t arcstat_l2_abort_lowmem;
+	/*
+	 * Number of buffers written to the L2ARC, and number of eligible
+	 * buffers that the L2ARC admission policy refused to write.
+	 */
+	kstat_named_t arcstat_l2_admitted;
+	kstat_named_t arcstat_l2_rejected;
 	kstat_named_t arcstat_l2_cksum_bad;
 	kstat_named_t arcstat_l2_io_error;
 	kstat_named_t arcstat_l2_lsize;
@@ -936,6 +981,7 @@ typedef struct arc_sums {
 	wmsum_t arcstat_mutex_miss;
 	wmsum_t arcstat_access_skip;
 	wmsum_t arcstat_evict_skip;
+	wmsum_t arcstat_evict_reserve_skip;
 	wmsum_t arcstat_evict_not_enough;
 	wmsum_t arcstat_evict_l2_cached;
 	wmsum_t arcstat_evict_l2_eligible;
@@ -946,6 +992,7 @@ typedef struct arc_sums {
 	wmsum_t arcstat_hash_elements;
 	wmsum_t arcstat_hash_collisions;
 	wmsum_t arcstat_hash_chains;
+	wmsum_t arcstat_hash_lockless_misses;
 	aggsum_t arcstat_size;
 	wmsum_t arcstat_compressed_size;
 	wmsum_t arcstat_uncompressed_size;
@@ -976,6 +1023,8 @@ typedef struct arc_sums {
 	wmsum_t arcstat_l2_evict_l1cached;
 	wmsum_t arcstat_l2_free_on_write;
 	wmsum_t arcstat_l2_abort_lowmem;
+	wmsum_t arcstat_l2_admitted;
+	wmsum_t arcstat_l2_rejected;
 	wmsum_t arcstat_l2_cksum_bad;
 	wmsum_t arcstat_l2_io_error;
 	wmsum_t arcstat_l2_lsize;
@@ -1012,6 +1061,29 @@ typedef struct arc_sums {
 	wmsum_t arcstat_abd_chunk_waste_size;
 } arc_sums_t;
 
+/*
+ * A dataset with a primarycache_quota or primarycache_reserve.  Headers
+ * read or written on its behalf are charged to it while they are in the
+ * MRU or MFU state, see arc_tenant_account().
+ */
+#define	ARC_TENANTS_MAX	1024
+
+typedef struct arc_tenant {
+	avl_node_t	at_node;
+	uint64_t	at_spa;		/* spa_load_guid() of the pool */
+	uint64_t	at_objset;
+	uint16_t	at_index;	/* slot in arc_tenants[] */
+	uint32_t	at_gen;		/* unique among slot users */
+	boolean_t	at_registered;	/* in arc_tenant_tree */
+	uint64_t	at_quota;
+	uint64_t	at_reserve;
+	uint64_t	at_size;	/* logical bytes in MRU + MFU */
+	wmsum_t		at_mru_ghost_hits;
+	wmsum_t		at_mfu_ghost_hits;
+	wmsum_t		at_quota_uncached;
+	wmsum_t		at_reserve_skip;
+} arc_tenant_t;
+
 typedef struct arc_evict_waiter {
 	list_node_t aew_node;
 	kcondvar_t aew_cv;
@@ -67,6 +67,14 @@ _Static_assert(BRT_RANGESIZE / SPA_MINBLOCKSIZE <= UINT16_MAX,
 #define	BRT_RANGESIZE_TO_NBLOCKS(size)					\
 	(((size) - 1) / BRT_BLOCKSIZE / sizeof (uint16_t) + 1)
 
+/*
+ * Each vdev also keeps an in-memory bloom filter over the offsets of its BRT
+ * entries, built up in stages that double in size, starting at
+ * BRT_BLOOM_STAGE0_SIZE bytes. See brt_bloom_add().
+ */
+#define	BRT_BLOOM_STAGE0_SIZE	(8 * 1024)
+#define	BRT_BLOOM_MAX_STAGES	(14)
+
 #define	BRT_LITTLE_ENDIAN	0
 #define	BRT_BIG_ENDIAN		1
 #ifdef _ZFS_LITTLE_ENDIAN
@@ -167,6 +175,18 @@ struct brt_vdev {
 	 * Entries to sync.
 	 */
 	avl_tree_t	bv_tree;
+	/*
+	 * Bloom filter over the offsets of all entries, including those
+	 * removed since it was built. Unless it is ready, only bv_entcount[]
+	 * can rule entries out. After import, it is rebuilt a few entries
+	 * per txg from the BRT ZAP, starting at bv_bloom_cursor.
+	 */
+	uint_t		bv_bloom_nstages;
+	uint64_t	bv_bloom_entries;	/* keys in the last stage */
+	uint64_t	*bv_bloom[BRT_BLOOM_MAX_STAGES];
+	boolean_t	bv_bloom_ready;		/* covers all entries */
+	boolean_t	bv_bloom_loading;	/* rebuild under way */
+	uint64_t	bv_bloom_cursor;	/* serialized ZAP cursor */
 };
 
 /* Size of offset / sizeof (uint64_t). */
@@ -170,6 +170,54 @@ NAME(zfs_btree_t *tree, uint8_t *buf, uint32_t nelems,			\
 _Pragma("GCC diagnostic pop")
 /* END CSTYLED */
 
+/*
+ * Variant of ZFS_BTREE_FIND_IN_BUF_FUNC() for element types whose ordering
+ * can be tested without branches, like the fixed-size range segments. Shar's
+ * search only narrows the buffer down to BTREE_FIND_SCAN_ELEMS candidates;
+ * the position within those is then found by counting the candidates that
+ * sort before value. The counting loop has no data-dependent branches and
+ * the compiler can vectorize it where vector registers are usable without
+ * saving FPU state (i.e. in userland); in the kernel it runs as scalar code
+ * that is still free of mispredictions.
+ *
+ * BEFORE - An expression-like macro that evaluates to exactly 1 if its first
+ *          argument compares less than its second one under COMP, else 0.
+ */
+#define	BTREE_FIND_SCAN_ELEMS	16
+
+/* BEGIN CSTYLED */
+#define	ZFS_BTREE_FIND_IN_BUF_SCAN_FUNC(NAME, T, BEFORE, COMP)		\
+_Pragma("GCC diagnostic push")						\
+_Pragma("GCC diagnostic ignored \"-Wunknown-pragmas\"")			\
+static void *								\
+NAME(zfs_btree_t *tree, uint8_t *buf, uint32_t nelems,			\
+    const void *value, zfs_btree_index_t *where)			\
+{									\
+	T *i = (T *)buf;						\
+	uint32_t before = 0;						\
+	(void) tree;							\
+	_Pragma("GCC unroll 5")						\
+	while (nelems > BTREE_FIND_SCAN_ELEMS) {			\
+		uint32_t half = nelems / 2;				\
+		nelems -= half;						\
+		i += BEFORE(&i[half - 1], (const T *)value) * half;	\
+	}								\
+									\
+	for (uint32_t j = 0; j < nelems; j++)				\
+		before += BEFORE(&i[j], (const T *)value);		\
+									\
+	i += before;							\
+	where->bti_offset = i - (T *)buf;				\
+	if (before < nelems && COMP(i, value) == 0) {			\
+		where->bti_before = B_FALSE;				\
+		return (i);						\
+	}								\
+	where->bti_before = B_TRUE;					\
+	return (NULL);							\
+}									\
+_Pragma("GCC diagnostic pop")
+/* END CSTYLED */
+
 /*
  * Allocate and deallocate caches for btree nodes.
  */
@@ -215,6 +263,14 @@ void *zfs_btree_find(zfs_btree_t *, const void *, zfs_btree_index_t *);
  */
 void zfs_btree_add_idx(zfs_btree_t *, const void *, const zfs_btree_index_t *);
 
+/*
+ * Fill an empty tree with nelems elements from the array elems, which must be
+ * sorted by the tree's comparator with no two elements comparing equal. The
+ * tree is built bottom-up with densely packed nodes, which is much cheaper
+ * than adding the elements one at a time.
+ */
+void zfs_btree_bulk_load(zfs_btree_t *, const void *, uint64_t);
+
 /*
  * Return the first or last valued node in the tree. Will return NULL if the
  * tree is empty. The index can be NULL if the location of the first or last
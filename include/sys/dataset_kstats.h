@@ -58,6 +58,15 @@ typedef struct dataset_kstat_values {
 	 * entry is removed from the unlinked set
 	 */
 	kstat_named_t dkv_nunlinked;
+	/*
+	 * ARC usage of the dataset, only tracked when it has a
+	 * primarycache_quota or primarycache_reserve
+	 */
+	kstat_named_t dkv_arc_size;
+	kstat_named_t dkv_arc_mru_ghost_hits;
+	kstat_named_t dkv_arc_mfu_ghost_hits;
+	kstat_named_t dkv_arc_quota_uncached;
+	kstat_named_t dkv_arc_reserve_skip;
 	/*
 	 * Per dataset zil kstats
 	 */
@@ -67,6 +76,8 @@ typedef struct dataset_kstat_values {
 typedef struct dataset_kstats {
 	dataset_sum_stats_t dk_sums;
 	zil_sums_t dk_zil_sums;
+	uint64_t dk_load_guid;
+	uint64_t dk_objset;
 	kstat_t *dk_kstats;
 } dataset_kstats_t;
 
@@ -340,6 +340,7 @@ typedef struct dbuf_hash_table {
 } dbuf_hash_table_t;
 
 typedef void (*dbuf_prefetch_fn)(void *, uint64_t, uint64_t, boolean_t);
+typedef void (dbuf_walk_func_t)(dmu_buf_impl_t *, void *);
 
 extern kmem_cache_t *dbuf_dirty_kmem_cache;
 
@@ -354,6 +355,8 @@ void dbuf_rm_spill(struct dnode *dn, dmu_tx_t *tx);
 dmu_buf_impl_t *dbuf_hold(struct dnode *dn, uint64_t blkid, const void *tag);
 dmu_buf_impl_t *dbuf_hold_level(struct dnode *dn, int level, uint64_t blkid,
     const void *tag);
+int dbuf_hold_array(struct dnode *dn, uint64_t blkid, uint64_t nblks,
+    const void *tag, dmu_buf_t **dbp);
 int dbuf_hold_impl(struct dnode *dn, uint8_t level, uint64_t blkid,
     boolean_t fail_sparse, boolean_t fail_uncached,
     const void *tag, dmu_buf_impl_t **dbp);
@@ -414,6 +417,8 @@ void dbuf_free_range(struct dnode *dn, uint64_t start, uint64_t end,
 
 void dbuf_new_size(dmu_buf_impl_t *db, int size, dmu_tx_t *tx);
 
+void dbuf_hash_walk(dbuf_walk_func_t *func, void *arg);
+
 void dbuf_stats_init(dbuf_hash_table_t *hash);
 void dbuf_stats_destroy(void);
 
@@ -270,6 +270,35 @@ typedef struct {
 	ddt_key_t	ddl_checkpoint;	/* last checkpoint */
 } ddt_log_t;
 
+/*
+ * In-core DDT bloom filter. Each stage is twice the size of the one before it;
+ * new keys are only ever added to the last stage, and a new stage is started
+ * when the last one reaches its planned capacity. A key is "maybe stored" if
+ * any stage claims it.
+ */
+#define	DDT_BLOOM_MAX_STAGES	(12)
+
+typedef struct {
+	uint64_t	*dbs_bits;	/* filter bits */
+	uint64_t	dbs_size;	/* size of filter bits, bytes */
+	uint64_t	dbs_entries;	/* keys added to this stage */
+} ddt_bloom_stage_t;
+
+typedef struct {
+	boolean_t	dbf_valid;	/* filter covers all stored entries */
+	uint_t		dbf_nstages;	/* stages in use */
+	uint64_t	dbf_entries;	/* keys added to all stages */
+	uint64_t	dbf_size;	/* size of all stages, bytes */
+	ddt_bloom_stage_t dbf_stage[DDT_BLOOM_MAX_STAGES];
+
+	/* rebuild after import, walked in syncing context */
+	boolean_t	dbf_loading;	/* rebuild under way */
+	uint64_t	dbf_load_txg;	/* last txg the walk advanced */
+	uint64_t	dbf_load_class;	/* walk position */
+	uint64_t	dbf_load_type;
+	uint64_t	dbf_load_cursor;
+} ddt_bloom_t;
+
 /*
  * In-core DDT object. This covers all entries and stats for a the whole pool
  * for a given checksum type.
@@ -294,6 +323,8 @@ typedef struct {
 
 	uint64_t	ddt_flush_force_txg;	/* flush hard before this txg */
 
+	ddt_bloom_t	ddt_bloom;	/* filter over store objects */
+
 	kstat_t		*ddt_ksp;	/* kstats context */
 
 	enum zio_checksum ddt_checksum;	/* checksum algorithm in use */
@@ -212,6 +212,14 @@ extern void ddt_log_free(ddt_t *ddt);
 extern void ddt_log_init(void);
 extern void ddt_log_fini(void);
 
+/* Dedup bloom filter API */
+extern void ddt_bloom_load(ddt_t *ddt);
+extern void ddt_bloom_free(ddt_t *ddt);
+
+extern void ddt_bloom_add(ddt_t *ddt, const ddt_key_t *ddk);
+extern boolean_t ddt_bloom_contains(const ddt_t *ddt, const ddt_key_t *ddk);
+extern void ddt_bloom_sync(ddt_t *ddt, boolean_t stored, uint64_t txg);
+
 /*
  * These are only exposed so that zdb can access them. Try not to use them
  * outside of the DDT implementation proper, and if you do, consider moving
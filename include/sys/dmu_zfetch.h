@@ -51,21 +51,44 @@ typedef struct zsrange {
 	uint16_t	end;
 } zsrange_t;
 
-#define	ZFETCH_RANGES	9		/* Fits zstream_t into 128 bytes */
+#define	ZFETCH_RANGES	8		/* Future ranges per stream */
+
+/*
+ * Access pattern a stream follows.  Forward streams are the classic case and
+ * track reordered accesses via zs_ranges.  Reverse streams move towards lower
+ * block numbers, zs_blkid being the first block of the last access.  Strided
+ * streams expect accesses of zs_len blocks every zs_stride blocks, zs_blkid
+ * being the start of the next one.  Strides need not be a multiple of the
+ * block size, so they and the positions of strided streams (including the
+ * prefetch range) are kept in 1 / (1 << ZFETCH_STRIDE_SHIFT) of a block,
+ * zs_frac holding the fractional part of the next position.
+ */
+#define	ZFETCH_STRIDE_SHIFT	8
+
+typedef enum zstream_type {
+	ZFETCH_FORWARD = 0,
+	ZFETCH_REVERSE,
+	ZFETCH_STRIDED,
+} zstream_type_t;
 
 typedef struct zstream {
 	list_node_t	zs_node;	/* link for zf_stream */
 	uint64_t	zs_blkid;	/* expect next access at this blkid */
 	uint_t		zs_atime;	/* time last prefetch issued */
 	zsrange_t	zs_ranges[ZFETCH_RANGES]; /* ranges from future */
+	uint32_t	zs_stride;	/* distance between strided accesses */
 	unsigned int	zs_pf_dist;	/* data prefetch distance in bytes */
 	unsigned int	zs_ipf_dist;	/* L1 prefetch distance in bytes */
 	uint64_t	zs_pf_start;	/* first data block to prefetch */
 	uint64_t	zs_pf_end;	/* data block to prefetch up to */
 	uint64_t	zs_ipf_start;	/* first data block to prefetch L1 */
 	uint64_t	zs_ipf_end;	/* data block to prefetch L1 up to */
-	boolean_t	zs_missed;	/* stream saw cache misses */
-	boolean_t	zs_more;	/* need more distant prefetch */
+	uint8_t		zs_missed;	/* stream saw cache misses */
+	uint8_t		zs_type;	/* zstream_type_t */
+	uint8_t		zs_frac;	/* fraction of strided zs_blkid */
+	uint8_t		zs_adapted;	/* distance follows prefetch slack */
+	uint32_t	zs_len;		/* blocks in the last access */
+	uint32_t	zs_slack;	/* biased min prefetch slack, blocks */
 	zfs_refcount_t	zs_callers;	/* number of pending callers */
 	/*
 	 * Number of stream references: dnode, callers and pending blocks.
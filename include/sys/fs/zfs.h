@@ -203,6 +203,8 @@ typedef enum {
 	ZFS_PROP_DEFAULTUSEROBJQUOTA,
 	ZFS_PROP_DEFAULTGROUPOBJQUOTA,
 	ZFS_PROP_DEFAULTPROJECTOBJQUOTA,
+	ZFS_PROP_PRIMARYCACHE_QUOTA,
+	ZFS_PROP_PRIMARYCACHE_RESERVE,
 	ZFS_NUM_PROPS
 } zfs_prop_t;
 
@@ -272,6 +274,7 @@ typedef enum {
 	ZPOOL_PROP_DEDUP_TABLE_QUOTA,
 	ZPOOL_PROP_DEDUPCACHED,
 	ZPOOL_PROP_LAST_SCRUBBED_TXG,
+	ZPOOL_PROP_IOSCHED,
 	ZPOOL_NUM_PROPS
 } zpool_prop_t;
 
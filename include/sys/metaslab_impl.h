@@ -161,6 +161,19 @@ typedef struct metaslab_class_allocator {
 	uint64_t		mca_reserved;
 } ____cacheline_aligned metaslab_class_allocator_t;
 
+/*
+ * Per-CPU cache of space allocated for small blocks in the syncing txg,
+ * handed out without going through the metaslab (see
+ * metaslab_alloc_dva_cached()).
+ */
+typedef struct metaslab_alloc_cache {
+	kmutex_t	mac_lock;
+	uint64_t	mac_txg;	/* txg the space is allocated in */
+	uint64_t	mac_vdev;	/* top-level vdev of the space */
+	uint64_t	mac_offset;	/* start of the unused space */
+	uint64_t	mac_size;	/* unused space, zero if none */
+} ____cacheline_aligned metaslab_alloc_cache_t;
+
 /*
  * A metaslab class encompasses a category of allocatable top-level vdevs.
  * Each top-level vdev is associated with a metaslab group which defines
@@ -211,6 +224,9 @@ struct metaslab_class {
 	 */
 	multilist_t		mc_metaslab_txg_list;
 
+	uint_t			mc_alloc_cache_count;
+	metaslab_alloc_cache_t	*mc_alloc_cache;
+
 	metaslab_class_allocator_t	mc_allocator[];
 };
 
@@ -265,6 +281,19 @@ struct metaslab_group {
 	uint64_t		mg_fragmentation;
 	uint64_t		mg_histogram[ZFS_RANGE_TREE_HISTOGRAM_SIZE];
 
+	/*
+	 * Allocation rate of the group and how long its metaslabs take to
+	 * load, both decaying averages, used to start loading metaslabs
+	 * before the allocators run out of loaded space (see
+	 * metaslab_group_preload_predict()).  mg_txg_alloc and
+	 * mg_rate_time are only used from syncing context.
+	 */
+	uint64_t		mg_alloc_rate;	/* bytes per second */
+	hrtime_t		mg_load_time;	/* ns per metaslab load */
+	uint64_t		mg_txg_alloc;	/* synced since reassess */
+	hrtime_t		mg_rate_time;	/* time of last reassess */
+	uint64_t		mg_predict_txg;	/* last predictive preload */
+
 	int			mg_ms_disabled;
 	boolean_t		mg_disabled_updating;
 	kmutex_t		mg_ms_disabled_lock;
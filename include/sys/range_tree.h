@@ -305,6 +305,7 @@ uint64_t zfs_range_tree_space(zfs_range_tree_t *rt);
 uint64_t zfs_range_tree_numsegs(zfs_range_tree_t *rt);
 boolean_t zfs_range_tree_is_empty(zfs_range_tree_t *rt);
 void zfs_range_tree_swap(zfs_range_tree_t **rtsrc, zfs_range_tree_t **rtdst);
+void zfs_range_tree_copy(zfs_range_tree_t *rtsrc, zfs_range_tree_t *rtdst);
 void zfs_range_tree_stat_verify(zfs_range_tree_t *rt);
 uint64_t zfs_range_tree_min(zfs_range_tree_t *rt);
 uint64_t zfs_range_tree_max(zfs_range_tree_t *rt);
@@ -761,6 +761,16 @@ typedef enum {
 	SPA_AUTOTRIM_ON,
 } spa_autotrim_t;
 
+/*
+ * How the leaf vdev queues pick the next I/O to issue.
+ *	CLASSIC: fixed per-class min/max active limits
+ *	DEADLINE: adapt the limits to meet a per-class latency target
+ */
+typedef enum {
+	SPA_IOSCHED_CLASSIC = 0,	/* default */
+	SPA_IOSCHED_DEADLINE,
+} spa_iosched_t;
+
 /*
  * Reason TRIM command was issued, used internally for accounting purposes.
  */
@@ -940,6 +950,9 @@ typedef struct spa_stats {
 	spa_history_kstat_t	state;		/* pool state */
 	spa_history_kstat_t	guid;		/* pool guid */
 	spa_history_kstat_t	iostats;
+	spa_history_kstat_t	arc_warm;
+	spa_history_kstat_t	iosched;
+	spa_history_kstat_t	zil_slog;
 } spa_stats_t;
 
 typedef enum txg_state {
@@ -988,6 +1001,17 @@ typedef struct spa_iostats {
 	kstat_named_t	direct_write_bytes;
 } spa_iostats_t;
 
+/* ARC warm list kstats */
+typedef struct spa_arc_warm_stats {
+	kstat_named_t	saves;
+	kstat_named_t	saved_entries;
+	kstat_named_t	restore_entries;
+	kstat_named_t	restore_read;
+	kstat_named_t	restore_cached;
+	kstat_named_t	restore_skipped;
+	kstat_named_t	restore_errors;
+} spa_arc_warm_stats_t;
+
 extern void spa_stats_init(spa_t *spa);
 extern void spa_stats_destroy(spa_t *spa);
 extern void spa_read_history_add(spa_t *spa, const zbookmark_phys_t *zb,
@@ -999,6 +1023,11 @@ extern txg_stat_t *spa_txg_history_init_io(spa_t *, uint64_t,
     struct dsl_pool *);
 extern void spa_txg_history_fini_io(spa_t *, txg_stat_t *);
 extern void spa_tx_assign_add_nsecs(spa_t *spa, uint64_t nsecs);
+extern void spa_iosched_stats_issue(spa_t *spa, zio_priority_t p,
+    hrtime_t wait, boolean_t late);
+extern void spa_iosched_stats_throttle(spa_t *spa, zio_priority_t p);
+extern void spa_zil_slog_stats_add(spa_t *spa, uint64_t vdev,
+    uint64_t bytes, hrtime_t latency);
 extern int spa_mmp_history_set_skip(spa_t *spa, uint64_t mmp_kstat_id);
 extern int spa_mmp_history_set(spa_t *spa, uint64_t mmp_kstat_id, int io_error,
     hrtime_t duration);
@@ -1013,6 +1042,9 @@ extern void spa_iostats_read_add(spa_t *spa, uint64_t size, uint64_t iops,
     dmu_flags_t flags);
 extern void spa_iostats_write_add(spa_t *spa, uint64_t size, uint64_t iops,
     dmu_flags_t flags);
+extern void spa_arc_warm_stats_saved(spa_t *spa, uint64_t entries);
+extern void spa_arc_warm_stats_restore_add(spa_t *spa, uint64_t entries,
+    uint64_t read, uint64_t cached, uint64_t skipped, uint64_t errors);
 extern void spa_import_progress_add(spa_t *spa);
 extern void spa_import_progress_remove(uint64_t spa_guid);
 extern int spa_import_progress_set_mmp_check(uint64_t pool_guid,
@@ -1117,6 +1149,7 @@ extern uint64_t spa_deadman_synctime(spa_t *spa);
 extern uint64_t spa_deadman_ziotime(spa_t *spa);
 extern uint64_t spa_dirty_data(spa_t *spa);
 extern spa_autotrim_t spa_get_autotrim(spa_t *spa);
+extern spa_iosched_t spa_get_iosched(spa_t *spa);
 extern int spa_get_allocator(spa_t *spa);
 extern void spa_set_allocator(spa_t *spa, const char *allocator);
 
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+
+#ifndef _SYS_SPA_ARC_WARM_H
+#define	_SYS_SPA_ARC_WARM_H
+
+#include <sys/spa.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * On-disk format of the ARC warm list.  The MOS object referenced by the
+ * DMU_POOL_ARC_WARM directory entry holds a spa_arc_warm_phys_t header
+ * followed by awp_count spa_arc_warm_entry_t records, hottest first.
+ * Both are arrays of uint64_t so the object can be byteswapped as
+ * DMU_OTN_UINT64_METADATA.
+ */
+#define	SPA_ARC_WARM_MAGIC	0x00a5c3a7e0a2c0deULL
+
+typedef struct spa_arc_warm_phys {
+	uint64_t	awp_magic;
+	uint64_t	awp_count;	/* number of entries */
+	uint64_t	awp_txg;	/* txg the list was written in */
+	uint64_t	awp_pad;
+} spa_arc_warm_phys_t;
+
+typedef struct spa_arc_warm_entry {
+	blkptr_t	awe_bp;
+	zbookmark_phys_t awe_zb;
+} spa_arc_warm_entry_t;
+
+extern int spa_arc_warm_load(spa_t *);
+extern void spa_arc_warm_start(spa_t *);
+extern void spa_arc_warm_export(spa_t *);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SYS_SPA_ARC_WARM_H */
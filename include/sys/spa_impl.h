@@ -67,6 +67,18 @@ typedef struct spa_allocs_use {
 	boolean_t	sau_inuse[];
 } spa_allocs_use_t;
 
+/*
+ * Open write batch of one allocator, see zio_issue_async().  Every allocator
+ * has two, for writes issued from the normal and the high priority issue
+ * taskqs.
+ */
+typedef struct spa_zio_batch {
+	kmutex_t	szb_lock;
+	zio_t		*szb_open;	/* leader of the batch being filled */
+	zio_t		*szb_tail;	/* last zio of the open batch */
+	uint_t		szb_count;	/* zios in the open batch */
+} ____cacheline_aligned spa_zio_batch_t;
+
 typedef struct spa_error_entry {
 	zbookmark_phys_t	se_bookmark;
 	char			*se_name;
@@ -191,6 +203,7 @@ typedef enum spa_proc_state {
 
 typedef struct spa_taskqs {
 	uint_t stqs_count;
+	uint_t stqs_nnodes;	/* taskq i is bound to zio_numa_node(i % n) */
 	taskq_t **stqs_taskq;
 } spa_taskqs_t;
 
@@ -250,6 +263,7 @@ struct spa {
 	metaslab_class_t *spa_special_class;	/* special allocation class */
 	metaslab_class_t *spa_special_embedded_log_class; /* log on special */
 	metaslab_class_t *spa_dedup_class;	/* dedup allocation class */
+	uint64_t	spa_ms_load_wait;	/* syncing txg ms load waits */
 	uint64_t	spa_first_txg;		/* first txg after spa_open() */
 	uint64_t	spa_final_txg;		/* txg of export/destroy */
 	uint64_t	spa_freeze_txg;		/* freeze pool at this txg */
@@ -274,6 +288,7 @@ struct spa {
 	spa_allocs_use_t *spa_allocs_use;
 	int		spa_alloc_count;
 	int		spa_active_allocator;	/* selectable allocator */
+	spa_zio_batch_t	*spa_zio_batch;		/* see zio_write_batch() */
 
 	/* per-allocator sync thread taskqs */
 	taskq_t		*spa_sync_tq;
@@ -365,6 +380,13 @@ struct spa {
 	uint64_t	spa_livelists_to_delete; /* set of livelists to free */
 	livelist_condense_entry_t	spa_to_condense; /* next to condense */
 
+	uint64_t	spa_arc_warm_obj;	/* ARC warm list object */
+	uint64_t	spa_arc_warm_count;	/* entries in the warm list */
+	uint64_t	spa_arc_warm_cursor;	/* next entry to restore */
+	boolean_t	spa_arc_warm_restore;	/* restore still pending */
+	hrtime_t	spa_arc_warm_saved;	/* time of the last save */
+	zthr_t		*spa_arc_warm_zthr;	/* saves/restores warm list */
+
 	char		*spa_root;		/* alternate root directory */
 	uint64_t	spa_ena;		/* spa-wide ereport ENA */
 	int		spa_last_open_failed;	/* error if last open failed */
@@ -444,6 +466,7 @@ struct spa {
 	uint64_t	spa_all_vdev_zaps;	/* ZAP of per-vd ZAP obj #s */
 	spa_avz_action_t	spa_avz_action;	/* destroy/rebuild AVZ? */
 	uint64_t	spa_autotrim;		/* automatic background trim? */
+	uint64_t	spa_iosched;		/* leaf vdev queue scheduler */
 	uint64_t	spa_errata;		/* errata issues detected */
 	spa_stats_t	spa_stats;		/* assorted spa statistics */
 	spa_keystore_t	spa_keystore;		/* loaded crypto keys */
@@ -41,6 +41,12 @@ typedef struct vdev_file {
 extern void vdev_file_init(void);
 extern void vdev_file_fini(void);
 
+#ifndef _KERNEL
+extern void vdev_file_uring_init(void);
+extern void vdev_file_uring_fini(void);
+extern boolean_t vdev_file_uring_io_start(zio_t *zio);
+#endif
+
 #ifdef	__cplusplus
 }
 #endif
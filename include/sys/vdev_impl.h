@@ -152,6 +152,12 @@ struct vdev_queue {
 	hrtime_t	vq_io_complete_ts; /* time last i/o completed */
 	hrtime_t	vq_io_delta_ts;
 	zio_t		vq_io_search; /* used as local for stack reduction */
+	/* Deadline scheduler state, see vdev_queue_latency_update(). */
+	hrtime_t	vq_lat_ewma[ZIO_PRIORITY_NUM_QUEUEABLE];
+	uint32_t	vq_dl_max[ZIO_PRIORITY_NUM_QUEUEABLE];
+	uint32_t	vq_dl_late;	/* Classes missing their target. */
+	hrtime_t	vq_dl_backoff_ts; /* Last time limits were lowered. */
+	boolean_t	vq_dl_on;	/* Deadline mode at last check. */
 	kmutex_t	vq_lock;
 };
 
@@ -284,6 +290,12 @@ struct vdev {
 	uint64_t	vdev_top_zap;
 	vdev_alloc_bias_t vdev_alloc_bias; /* metaslab allocation bias	*/
 
+	/* ZIL commits to a log vdev, see spa_zil_slog_stats_add() */
+	uint64_t	vdev_zil_lwbs;	/* lwbs made stable		*/
+	uint64_t	vdev_zil_bytes;	/* log bytes in those lwbs	*/
+	uint64_t	vdev_zil_lat_total; /* issue to stable, in ns	*/
+	uint64_t	vdev_zil_lat_max; /* slowest lwb, in ns		*/
+
 	/* pool checkpoint related */
 	space_map_t	*vdev_checkpoint_sm;	/* contains reserved blocks */
 
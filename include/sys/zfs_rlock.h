@@ -46,15 +46,27 @@ struct zfs_locked_range;
 
 typedef void (zfs_rangelock_cb_t)(struct zfs_locked_range *, void *);
 
+typedef struct zfs_rangelock_shard {
+	kmutex_t rs_lock;
+	avl_tree_t rs_tree;	/* contains locked_range_t */
+	kcondvar_t rs_drain_cv;	/* cv for slow path waiting on a range */
+	boolean_t rs_closed;	/* slow path active, no new ranges */
+} ____cacheline_aligned zfs_rangelock_shard_t;
+
 typedef struct zfs_rangelock {
 	avl_tree_t rl_tree; /* contains locked_range_t */
 	kmutex_t rl_lock;
 	zfs_rangelock_cb_t *rl_cb;
 	void *rl_arg;
+	zfs_rangelock_shard_t *rl_shards; /* fast path shards, or NULL */
+	uint_t rl_nshards;	/* number of shards */
+	uint_t rl_shard_shift;	/* log2 of bytes per shard bucket */
+	uint_t rl_nslow;	/* slow path ranges locked or wanted */
 } zfs_rangelock_t;
 
 typedef struct zfs_locked_range {
 	zfs_rangelock_t *lr_rangelock; /* rangelock that this lock applies to */
+	zfs_rangelock_shard_t *lr_shard; /* shard holding range, or NULL */
 	avl_node_t lr_node;	/* avl node link */
 	uint64_t lr_offset;	/* file range offset */
 	uint64_t lr_length;	/* file range length */
@@ -67,6 +79,9 @@ typedef struct zfs_locked_range {
 	uint8_t lr_read_wanted;	/* reader wants to lock this range */
 } zfs_locked_range_t;
 
+void zfs_rangelock_stat_init(void);
+void zfs_rangelock_stat_fini(void);
+
 void zfs_rangelock_init(zfs_rangelock_t *, zfs_rangelock_cb_t *, void *);
 void zfs_rangelock_fini(zfs_rangelock_t *);
 
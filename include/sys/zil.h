@@ -472,6 +472,20 @@ typedef struct itx {
 	uint8_t		itx_lr_data[];	/* type-specific part of lr_xx_t */
 } itx_t;
 
+/*
+ * Phases of a ZIL commit timed by the zil_hist_* kstats.
+ */
+typedef enum zil_commit_phase {
+	ZIL_PHASE_ASSIGN,	/* commit start to commit itx assigned */
+	ZIL_PHASE_LWB,		/* commit itx assigned to its lwb issued */
+	ZIL_PHASE_WRITE,	/* lwb issued to lwb write done */
+	ZIL_PHASE_FLUSH,	/* lwb write done to lwb stable */
+	ZIL_PHASE_COMMIT,	/* zil_commit() as a whole */
+	ZIL_PHASES
+} zil_commit_phase_t;
+
+#define	ZIL_HIST_BUCKETS	24	/* 1us to 8s */
+
 /*
  * Used for zil kstat.
  */
@@ -544,6 +558,24 @@ typedef struct zil_stats {
 	kstat_named_t zil_itx_metaslab_slog_bytes;
 	kstat_named_t zil_itx_metaslab_slog_write;
 	kstat_named_t zil_itx_metaslab_slog_alloc;
+
+	/*
+	 * Log records replayed, their size (not including the data of
+	 * indirect writes), and how many of them were replayed as barriers
+	 * by parallel replay (see zil_replay_threads).
+	 */
+	kstat_named_t zil_replay_count;
+	kstat_named_t zil_replay_bytes;
+	kstat_named_t zil_replay_barrier_count;
+
+	/*
+	 * Power of two latency histograms of the phases of zil_commit(),
+	 * named zil_hist_<phase>_<N>us, see zil_commit_phase_t.  Bucket N
+	 * counts latencies from N up to 2N microseconds; the last bucket
+	 * also counts everything longer.  Not part of the static kstat
+	 * templates, their names are set by zil_kstat_values_init().
+	 */
+	kstat_named_t zil_hist[ZIL_PHASES][ZIL_HIST_BUCKETS];
 } zil_kstat_values_t;
 
 typedef struct zil_sums {
@@ -568,6 +600,10 @@ typedef struct zil_sums {
 	wmsum_t zil_itx_metaslab_slog_bytes;
 	wmsum_t zil_itx_metaslab_slog_write;
 	wmsum_t zil_itx_metaslab_slog_alloc;
+	wmsum_t zil_replay_count;
+	wmsum_t zil_replay_bytes;
+	wmsum_t zil_replay_barrier_count;
+	wmsum_t zil_hist[ZIL_PHASES][ZIL_HIST_BUCKETS];
 } zil_sums_t;
 
 #define	ZIL_STAT_INCR(zil, stat, val) \
@@ -665,6 +701,7 @@ extern itx_wr_state_t zil_write_state(zilog_t *zilog, uint64_t size,
 
 extern void zil_sums_init(zil_sums_t *zs);
 extern void zil_sums_fini(zil_sums_t *zs);
+extern void zil_kstat_values_init(zil_kstat_values_t *zs);
 extern void zil_kstat_values_update(zil_kstat_values_t *zs,
     zil_sums_t *zil_sums);
 
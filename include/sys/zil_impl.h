@@ -122,6 +122,7 @@ typedef struct lwb {
 	zio_t		*lwb_write_zio;	/* zio for the lwb buffer */
 	zio_t		*lwb_root_zio;	/* root zio for lwb write and flushes */
 	hrtime_t	lwb_issued_timestamp; /* when was the lwb issued? */
+	hrtime_t	lwb_written_timestamp; /* when was its write done? */
 	uint64_t	lwb_issued_txg;	/* the txg when the write is issued */
 	uint64_t	lwb_alloc_txg;	/* the txg when lwb_blk is allocated */
 	uint64_t	lwb_max_txg;	/* highest txg in this lwb */
@@ -156,6 +157,7 @@ typedef struct zil_commit_waiter {
 	lwb_t		*zcw_lwb;	/* back pointer to lwb when linked */
 	boolean_t	zcw_done;	/* B_TRUE when "done", else B_FALSE */
 	int		zcw_error;	/* result to return from zil_commit() */
+	hrtime_t	zcw_assigned;	/* when the commit itx was assigned */
 } zil_commit_waiter_t;
 
 /*
@@ -212,6 +214,7 @@ struct zilog {
 	uint8_t		zl_suspending;	/* log is currently suspending */
 	uint8_t		zl_keep_first;	/* keep first log block in destroy */
 	uint8_t		zl_replay;	/* replaying records while set */
+	uint8_t		zl_replay_async; /* records in replay workers */
 	uint8_t		zl_stop_sync;	/* for debugging */
 	kmutex_t	zl_issuer_lock;	/* single writer, per ZIL, at a time */
 	uint8_t		zl_logbias;	/* latency or throughput */
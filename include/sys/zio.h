@@ -289,6 +289,26 @@ enum zio_wait_type {
 typedef void zio_done_func_t(zio_t *zio);
 
 extern int zio_exclude_metadata;
+extern int zio_taskq_numa;
+
+/*
+ * Per-NUMA-node locality counters.  Dispatches are counted for zio taskqs
+ * that are bound to nodes (zio_taskq_numa), and compare the node of the
+ * chosen taskq with the node of the submitting thread.  ABD pages compare
+ * the node a page was allocated on with the node of the allocating thread.
+ */
+typedef enum zio_numa_stat {
+	ZIO_NUMA_DISPATCH_LOCAL,
+	ZIO_NUMA_DISPATCH_REMOTE,
+	ZIO_NUMA_ABD_LOCAL,
+	ZIO_NUMA_ABD_REMOTE,
+	ZIO_NUMA_NSTATS
+} zio_numa_stat_t;
+
+extern uint_t zio_numa_node_count(void);
+extern int zio_numa_node(uint_t idx);
+extern uint_t zio_numa_node_index(int nid);
+extern void zio_numa_stat_add(int nid, zio_numa_stat_t stat, uint64_t n);
 extern int zio_dva_throttle_enabled;
 extern const char *const zio_type_name[ZIO_TYPES];
 
@@ -554,6 +574,9 @@ struct zio {
 	zio_cksum_report_t *io_cksum_report;
 	uint64_t	io_ena;
 
+	/* Next zio of the same write batch */
+	zio_t		*io_batch_next;
+
 	/* Taskq dispatching state */
 	taskq_ent_t	io_tqent;
 };
@@ -622,8 +645,8 @@ extern zio_t *zio_free_sync(zio_t *pio, spa_t *spa, uint64_t txg,
     const blkptr_t *bp, zio_flag_t flags);
 
 extern int zio_alloc_zil(spa_t *spa, objset_t *os, uint64_t txg,
-    blkptr_t *new_bp, uint64_t min_size, uint64_t max_size, boolean_t *slog,
-    boolean_t allow_larger);
+    blkptr_t *new_bp, uint64_t min_size, uint64_t max_size,
+    const blkptr_t *prev_bp, boolean_t *slog, boolean_t allow_larger);
 extern void zio_flush(zio_t *zio, vdev_t *vd);
 extern void zio_shrink(zio_t *zio, uint64_t size);
 
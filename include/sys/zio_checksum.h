@@ -82,6 +82,14 @@ typedef const struct zio_abd_checksum_func {
 	zio_abd_checksum_iter_t *acf_iter;
 } zio_abd_checksum_func_t;
 
+typedef int zio_abd_checksum_iter2_t(void *, void *, size_t, void *);
+
+typedef const struct zio_abd_checksum_func2 {
+	zio_abd_checksum_init_t *acf_init;
+	zio_abd_checksum_fini_t *acf_fini;
+	zio_abd_checksum_iter2_t *acf_iter;
+} zio_abd_checksum_func2_t;
+
 /*
  * Information about each checksum function.
  */
@@ -133,13 +141,24 @@ extern zio_checksum_tmpl_free_t abd_checksum_blake3_tmpl_free;
 
 /* Fletcher 4 */
 _SYS_ZIO_CHECKSUM_H zio_abd_checksum_func_t fletcher_4_abd_ops;
+_SYS_ZIO_CHECKSUM_H zio_abd_checksum_func2_t fletcher_4_abd_x2_ops;
 extern zio_checksum_t abd_fletcher_4_native;
 extern zio_checksum_t abd_fletcher_4_byteswap;
+extern void abd_fletcher_4_native_multi(struct abd **, uint64_t,
+    zio_cksum_t *, uint_t);
+
+/*
+ * Largest number of blocks checksummed in one multi-buffer pass.  This
+ * bounds the time spent with the FPU state saved (and preemption disabled).
+ */
+#define	ZIO_CHECKSUM_MULTI_MAX	16
 
 extern int zio_checksum_equal(spa_t *, blkptr_t *, enum zio_checksum,
     void *, uint64_t, uint64_t, zio_bad_cksum_t *);
 extern void zio_checksum_compute(zio_t *, enum zio_checksum,
     struct abd *, uint64_t);
+extern void zio_checksum_compute_multi(zio_t **, enum zio_checksum,
+    uint_t);
 extern int zio_checksum_error_impl(spa_t *, const blkptr_t *, enum zio_checksum,
     struct abd *, uint64_t, uint64_t, zio_bad_cksum_t *);
 extern int zio_checksum_error(zio_t *zio, zio_bad_cksum_t *out);
@@ -64,6 +64,8 @@ _ZFS_FLETCHER_H void fletcher_4_byteswap(const void *, uint64_t, const void *,
     zio_cksum_t *);
 _ZFS_FLETCHER_H int fletcher_4_incremental_native(void *, size_t, void *);
 _ZFS_FLETCHER_H int fletcher_4_incremental_byteswap(void *, size_t, void *);
+_ZFS_FLETCHER_H void fletcher_4_native_multi(const void *const *, uint64_t,
+    zio_cksum_t *, uint_t);
 _ZFS_FLETCHER_H int fletcher_4_impl_set(const char *selector);
 _ZFS_FLETCHER_H void fletcher_4_init(void);
 _ZFS_FLETCHER_H void fletcher_4_fini(void);
@@ -118,6 +120,8 @@ typedef void (*fletcher_4_init_f)(fletcher_4_ctx_t *);
 typedef void (*fletcher_4_fini_f)(fletcher_4_ctx_t *, zio_cksum_t *);
 typedef void (*fletcher_4_compute_f)(fletcher_4_ctx_t *,
     const void *, uint64_t);
+typedef void (*fletcher_4_compute_x2_f)(fletcher_4_ctx_t *,
+    fletcher_4_ctx_t *, const void *, const void *, uint64_t);
 
 typedef struct fletcher_4_func {
 	fletcher_4_init_f init_native;
@@ -126,6 +130,7 @@ typedef struct fletcher_4_func {
 	fletcher_4_init_f init_byteswap;
 	fletcher_4_fini_f fini_byteswap;
 	fletcher_4_compute_f compute_byteswap;
+	fletcher_4_compute_x2_f compute_native_x2;	/* optional */
 	boolean_t (*valid)(void);
 	boolean_t uses_fpu;
 	const char *name;
@@ -2791,6 +2791,8 @@ zfs_prop_get(zfs_handle_t *zhp, zfs_prop_t prop, char *propbuf, size_t proplen,
 	case ZFS_PROP_REFQUOTA:
 	case ZFS_PROP_RESERVATION:
 	case ZFS_PROP_REFRESERVATION:
+	case ZFS_PROP_PRIMARYCACHE_QUOTA:
+	case ZFS_PROP_PRIMARYCACHE_RESERVE:
 
 		if (get_numeric_property(zhp, prop, src, &source, &val) != 0)
 			return (-1);
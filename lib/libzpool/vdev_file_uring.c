@@ -0,0 +1,570 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/abd.h>
+#include <sys/vdev_file.h>
+#include <sys/vdev_impl.h>
+#include <sys/zio.h>
+
+/*
+ * io_uring backend for file vdevs in libzpool.
+ *
+ * All file vdevs of the process share a single ring.  Reads and writes are
+ * queued on the submission ring under vfu_lock, and whichever thread finds
+ * no submission in progress enters the kernel for everything queued so
+ * far, so that concurrent issuers are batched into one io_uring_enter()
+ * call.  A single reaper thread waits for completions, drains the
+ * completion ring in batches and hands the zios back to the pipeline.
+ *
+ * Linear ABDs are read and written in place.  Other ABDs need a bounce
+ * buffer anyway; when one of the buffers registered with the ring is free
+ * it is used with IORING_OP_{READ,WRITE}_FIXED, which saves the kernel from
+ * pinning and mapping the pages on every request.
+ *
+ * The ring is only set up when the running kernel supports it; otherwise,
+ * or when the ring is full, vdev_file_io_start() falls back to the
+ * synchronous pread/pwrite path on vdev_file_taskq.
+ */
+
+#if defined(__linux__) && defined(HAVE_IO_URING)
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/* Submission ring size, and so the maximum number of requests in flight. */
+#define	VFU_ENTRIES		256
+
+/* Registered bounce buffers, one bit each in vfu_fixed_free. */
+#define	VFU_FIXED_SLOTS		32
+#define	VFU_FIXED_SIZE		SPA_OLD_MAXBLOCKSIZE
+_Static_assert(VFU_FIXED_SLOTS < 64, "vfu_fixed_free is a uint64_t");
+
+/* Completions copied out of the ring before advancing its head. */
+#define	VFU_REAP_BATCH		32
+
+typedef struct vfu_req {
+	zio_t		*vr_zio;
+	void		*vr_buf;	/* buffer handed to the kernel */
+	int		vr_slot;	/* registered buffer, or -1 */
+} vfu_req_t;
+
+typedef struct vdev_file_uring {
+	int		vfu_fd;
+	kmutex_t	vfu_lock;
+	kcondvar_t	vfu_cv;
+	kthread_t	*vfu_reaper;
+	uint_t		vfu_inflight;	/* requests queued or in the kernel */
+	uint_t		vfu_pending;	/* queued but not yet submitted */
+	boolean_t	vfu_submitting;
+	boolean_t	vfu_exiting;
+
+	/* submission ring */
+	void		*vfu_sq_ring;
+	size_t		vfu_sq_ring_size;
+	uint32_t	*vfu_sq_tail;
+	uint32_t	*vfu_sq_mask;
+	uint32_t	*vfu_sq_array;
+	struct io_uring_sqe *vfu_sqes;
+	size_t		vfu_sqes_size;
+
+	/* completion ring */
+	void		*vfu_cq_ring;
+	size_t		vfu_cq_ring_size;
+	uint32_t	*vfu_cq_head;
+	uint32_t	*vfu_cq_tail;
+	uint32_t	*vfu_cq_mask;
+	struct io_uring_cqe *vfu_cqes;
+
+	/* registered bounce buffers */
+	char		*vfu_fixed;
+	uint64_t	vfu_fixed_free;
+} vdev_file_uring_t;
+
+static vdev_file_uring_t *vdev_file_uring_ring;
+
+static int
+vfu_setup(uint_t entries, struct io_uring_params *p)
+{
+	return (syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int
+vfu_enter(int fd, uint_t to_submit, uint_t min_complete, uint_t flags)
+{
+	return (syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+	    flags, NULL, 0));
+}
+
+static int
+vfu_register(int fd, uint_t opcode, void *arg, uint_t nr_args)
+{
+	return (syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+/*
+ * Check that the kernel knows the opcodes we use; IORING_OP_READ and
+ * IORING_OP_WRITE only appeared in Linux 5.6.
+ */
+static boolean_t
+vfu_probe(int fd)
+{
+	size_t size = sizeof (struct io_uring_probe) +
+	    256 * sizeof (struct io_uring_probe_op);
+	struct io_uring_probe *probe = kmem_zalloc(size, KM_SLEEP);
+	const uint8_t ops[] = { IORING_OP_NOP, IORING_OP_READ,
+	    IORING_OP_WRITE, IORING_OP_READ_FIXED, IORING_OP_WRITE_FIXED };
+	boolean_t ok = B_FALSE;
+
+	if (vfu_register(fd, IORING_REGISTER_PROBE, probe, 256) == 0) {
+		ok = B_TRUE;
+		for (int i = 0; i < ARRAY_SIZE(ops); i++) {
+			if (ops[i] > probe->last_op ||
+			    !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED))
+				ok = B_FALSE;
+		}
+	}
+
+	kmem_free(probe, size);
+	return (ok);
+}
+
+/*
+ * Register the bounce buffer arena.  This counts against RLIMIT_MEMLOCK, so
+ * carry on without it if the kernel refuses.
+ */
+static void
+vfu_register_fixed(vdev_file_uring_t *vfu)
+{
+	struct iovec iov[VFU_FIXED_SLOTS];
+	size_t size = (size_t)VFU_FIXED_SLOTS * VFU_FIXED_SIZE;
+
+	vfu->vfu_fixed = mmap(NULL, size, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (vfu->vfu_fixed == MAP_FAILED) {
+		vfu->vfu_fixed = NULL;
+		return;
+	}
+
+	for (int i = 0; i < VFU_FIXED_SLOTS; i++) {
+		iov[i].iov_base = vfu->vfu_fixed + (size_t)i * VFU_FIXED_SIZE;
+		iov[i].iov_len = VFU_FIXED_SIZE;
+	}
+
+	if (vfu_register(vfu->vfu_fd, IORING_REGISTER_BUFFERS, iov,
+	    VFU_FIXED_SLOTS) != 0) {
+		(void) munmap(vfu->vfu_fixed, size);
+		vfu->vfu_fixed = NULL;
+		return;
+	}
+
+	vfu->vfu_fixed_free = (1ULL << VFU_FIXED_SLOTS) - 1;
+}
+
+static void
+vfu_unmap(vdev_file_uring_t *vfu)
+{
+	if (vfu->vfu_fixed != NULL) {
+		(void) munmap(vfu->vfu_fixed,
+		    (size_t)VFU_FIXED_SLOTS * VFU_FIXED_SIZE);
+	}
+	if (vfu->vfu_sqes != NULL)
+		(void) munmap(vfu->vfu_sqes, vfu->vfu_sqes_size);
+	if (vfu->vfu_cq_ring != NULL && vfu->vfu_cq_ring != vfu->vfu_sq_ring)
+		(void) munmap(vfu->vfu_cq_ring, vfu->vfu_cq_ring_size);
+	if (vfu->vfu_sq_ring != NULL)
+		(void) munmap(vfu->vfu_sq_ring, vfu->vfu_sq_ring_size);
+	(void) close(vfu->vfu_fd);
+}
+
+static vdev_file_uring_t *
+vfu_create(void)
+{
+	struct io_uring_params p = { 0 };
+	vdev_file_uring_t *vfu;
+	void *ring;
+	int fd;
+
+	fd = vfu_setup(VFU_ENTRIES, &p);
+	if (fd < 0)
+		return (NULL);
+
+	vfu = kmem_zalloc(sizeof (*vfu), KM_SLEEP);
+	vfu->vfu_fd = fd;
+
+	if (!vfu_probe(fd))
+		goto fail;
+
+	vfu->vfu_sq_ring_size = p.sq_off.array + p.sq_entries *
+	    sizeof (uint32_t);
+	vfu->vfu_cq_ring_size = p.cq_off.cqes + p.cq_entries *
+	    sizeof (struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		vfu->vfu_sq_ring_size = vfu->vfu_cq_ring_size =
+		    MAX(vfu->vfu_sq_ring_size, vfu->vfu_cq_ring_size);
+	}
+
+	ring = mmap(NULL, vfu->vfu_sq_ring_size, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (ring == MAP_FAILED)
+		goto fail;
+	vfu->vfu_sq_ring = ring;
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		vfu->vfu_cq_ring = ring;
+	} else {
+		ring = mmap(NULL, vfu->vfu_cq_ring_size,
+		    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+		    IORING_OFF_CQ_RING);
+		if (ring == MAP_FAILED)
+			goto fail;
+		vfu->vfu_cq_ring = ring;
+	}
+
+	vfu->vfu_sqes_size = p.sq_entries * sizeof (struct io_uring_sqe);
+	ring = mmap(NULL, vfu->vfu_sqes_size, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (ring == MAP_FAILED)
+		goto fail;
+	vfu->vfu_sqes = ring;
+
+	vfu->vfu_sq_tail = (uint32_t *)((char *)vfu->vfu_sq_ring +
+	    p.sq_off.tail);
+	vfu->vfu_sq_mask = (uint32_t *)((char *)vfu->vfu_sq_ring +
+	    p.sq_off.ring_mask);
+	vfu->vfu_sq_array = (uint32_t *)((char *)vfu->vfu_sq_ring +
+	    p.sq_off.array);
+	vfu->vfu_cq_head = (uint32_t *)((char *)vfu->vfu_cq_ring +
+	    p.cq_off.head);
+	vfu->vfu_cq_tail = (uint32_t *)((char *)vfu->vfu_cq_ring +
+	    p.cq_off.tail);
+	vfu->vfu_cq_mask = (uint32_t *)((char *)vfu->vfu_cq_ring +
+	    p.cq_off.ring_mask);
+	vfu->vfu_cqes = (struct io_uring_cqe *)((char *)vfu->vfu_cq_ring +
+	    p.cq_off.cqes);
+
+	/*
+	 * The completion ring is twice the size of the submission ring, and
+	 * we never have more than sq_entries requests in flight, so it can
+	 * not overflow.
+	 */
+	ASSERT3U(p.sq_entries, ==, VFU_ENTRIES);
+	ASSERT3U(p.cq_entries, >=, p.sq_entries);
+
+	vfu_register_fixed(vfu);
+
+	return (vfu);
+
+fail:
+	vfu_unmap(vfu);
+	kmem_free(vfu, sizeof (*vfu));
+	return (NULL);
+}
+
+/*
+ * Append an SQE to the submission ring.  It is handed to the kernel by the
+ * next vfu_submit().
+ */
+static void
+vfu_queue(vdev_file_uring_t *vfu, uint8_t opcode, int fd, void *buf,
+    uint32_t len, uint64_t off, int slot, void *udata)
+{
+	ASSERT(MUTEX_HELD(&vfu->vfu_lock));
+
+	uint32_t tail = *vfu->vfu_sq_tail;
+	uint32_t idx = tail & *vfu->vfu_sq_mask;
+	struct io_uring_sqe *sqe = &vfu->vfu_sqes[idx];
+
+	memset(sqe, 0, sizeof (*sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t)(uintptr_t)buf;
+	sqe->len = len;
+	sqe->off = off;
+	if (slot >= 0)
+		sqe->buf_index = slot;
+	sqe->user_data = (uint64_t)(uintptr_t)udata;
+
+	vfu->vfu_sq_array[idx] = idx;
+	__atomic_store_n(vfu->vfu_sq_tail, tail + 1, __ATOMIC_RELEASE);
+	vfu->vfu_pending++;
+}
+
+/*
+ * Hand every queued SQE to the kernel.  Only one thread enters the kernel
+ * at a time; SQEs queued meanwhile are picked up by its next iteration, so
+ * other issuers return without a system call of their own.
+ */
+static void
+vfu_submit(vdev_file_uring_t *vfu)
+{
+	ASSERT(MUTEX_HELD(&vfu->vfu_lock));
+
+	if (vfu->vfu_submitting)
+		return;
+
+	vfu->vfu_submitting = B_TRUE;
+	while (vfu->vfu_pending > 0) {
+		uint_t n = vfu->vfu_pending;
+
+		mutex_exit(&vfu->vfu_lock);
+		int rc = vfu_enter(vfu->vfu_fd, n, 0, 0);
+		int error = errno;
+		mutex_enter(&vfu->vfu_lock);
+
+		if (rc < 0) {
+			VERIFY(error == EINTR || error == EAGAIN ||
+			    error == EBUSY);
+			continue;
+		}
+		ASSERT3U(rc, <=, n);
+		vfu->vfu_pending -= rc;
+	}
+	vfu->vfu_submitting = B_FALSE;
+
+	if (vfu->vfu_exiting)
+		cv_broadcast(&vfu->vfu_cv);
+}
+
+static void
+vfu_done(vdev_file_uring_t *vfu, vfu_req_t *vr, int res)
+{
+	zio_t *zio = vr->vr_zio;
+
+	if (res < 0) {
+		/*
+		 * As in zfs_file_pread(), this most likely means an alignment
+		 * issue due to O_DIRECT, so abort() to catch the offender.
+		 */
+		if (res == -EINVAL)
+			abort();
+		zio->io_error = SET_ERROR(-res);
+	} else if (res != zio->io_size) {
+		zio->io_error = SET_ERROR(ENOSPC);
+	}
+
+	if (vr->vr_slot >= 0) {
+		if (zio->io_type == ZIO_TYPE_READ)
+			abd_copy_from_buf(zio->io_abd, vr->vr_buf,
+			    zio->io_size);
+	} else if (zio->io_type == ZIO_TYPE_READ) {
+		abd_return_buf_copy(zio->io_abd, vr->vr_buf, zio->io_size);
+	} else {
+		abd_return_buf(zio->io_abd, vr->vr_buf, zio->io_size);
+	}
+
+	mutex_enter(&vfu->vfu_lock);
+	if (vr->vr_slot >= 0)
+		vfu->vfu_fixed_free |= 1ULL << vr->vr_slot;
+	ASSERT3U(vfu->vfu_inflight, >, 0);
+	if (--vfu->vfu_inflight == 0 && vfu->vfu_exiting)
+		cv_broadcast(&vfu->vfu_cv);
+	mutex_exit(&vfu->vfu_lock);
+
+	kmem_free(vr, sizeof (*vr));
+
+	zio_delay_interrupt(zio);
+}
+
+static __attribute__((noreturn)) void
+vfu_reaper(void *arg)
+{
+	vdev_file_uring_t *vfu = arg;
+	struct {
+		vfu_req_t	*vr;
+		int		res;
+	} batch[VFU_REAP_BATCH];
+	boolean_t exiting = B_FALSE;
+
+	while (!exiting) {
+		uint32_t head = *vfu->vfu_cq_head;
+		uint32_t tail = __atomic_load_n(vfu->vfu_cq_tail,
+		    __ATOMIC_ACQUIRE);
+		int n = 0;
+
+		if (head == tail) {
+			if (vfu_enter(vfu->vfu_fd, 0, 1,
+			    IORING_ENTER_GETEVENTS) < 0) {
+				VERIFY(errno == EINTR || errno == EAGAIN ||
+				    errno == EBUSY);
+			}
+			continue;
+		}
+
+		/*
+		 * Copy a batch of completions out and release their slots
+		 * with a single head update before completing the zios.
+		 */
+		while (head != tail && n < VFU_REAP_BATCH) {
+			struct io_uring_cqe *cqe =
+			    &vfu->vfu_cqes[head & *vfu->vfu_cq_mask];
+
+			batch[n].vr = (vfu_req_t *)(uintptr_t)cqe->user_data;
+			batch[n].res = cqe->res;
+			n++;
+			head++;
+		}
+		__atomic_store_n(vfu->vfu_cq_head, head, __ATOMIC_RELEASE);
+
+		for (int i = 0; i < n; i++) {
+			/* The NOP queued by vdev_file_uring_fini(). */
+			if (batch[i].vr == NULL)
+				exiting = B_TRUE;
+			else
+				vfu_done(vfu, batch[i].vr, batch[i].res);
+		}
+	}
+
+	mutex_enter(&vfu->vfu_lock);
+	vfu->vfu_reaper = NULL;
+	cv_broadcast(&vfu->vfu_cv);
+	mutex_exit(&vfu->vfu_lock);
+
+	thread_exit();
+}
+
+void
+vdev_file_uring_init(void)
+{
+	vdev_file_uring_t *vfu;
+
+	ASSERT0P(vdev_file_uring_ring);
+
+	vfu = vfu_create();
+	if (vfu == NULL)
+		return;
+
+	mutex_init(&vfu->vfu_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&vfu->vfu_cv, NULL, CV_DEFAULT, NULL);
+	vfu->vfu_reaper = thread_create(NULL, 0, vfu_reaper, vfu, 0, &p0,
+	    TS_RUN, minclsyspri);
+
+	vdev_file_uring_ring = vfu;
+}
+
+void
+vdev_file_uring_fini(void)
+{
+	vdev_file_uring_t *vfu = vdev_file_uring_ring;
+
+	if (vfu == NULL)
+		return;
+
+	mutex_enter(&vfu->vfu_lock);
+	vfu->vfu_exiting = B_TRUE;
+	while (vfu->vfu_inflight > 0)
+		cv_wait(&vfu->vfu_cv, &vfu->vfu_lock);
+
+	vfu_queue(vfu, IORING_OP_NOP, -1, NULL, 0, 0, -1, NULL);
+	vfu_submit(vfu);
+	while (vfu->vfu_reaper != NULL || vfu->vfu_submitting)
+		cv_wait(&vfu->vfu_cv, &vfu->vfu_lock);
+	mutex_exit(&vfu->vfu_lock);
+
+	vdev_file_uring_ring = NULL;
+
+	cv_destroy(&vfu->vfu_cv);
+	mutex_destroy(&vfu->vfu_lock);
+	vfu_unmap(vfu);
+	kmem_free(vfu, sizeof (*vfu));
+}
+
+/*
+ * Issue a read or write through the ring.  Returns B_FALSE if the caller
+ * should fall back to the synchronous path.
+ */
+boolean_t
+vdev_file_uring_io_start(zio_t *zio)
+{
+	vdev_file_uring_t *vfu = vdev_file_uring_ring;
+	vdev_file_t *vf = zio->io_vd->vdev_tsd;
+	boolean_t write = (zio->io_type == ZIO_TYPE_WRITE);
+	vfu_req_t *vr;
+	uint8_t opcode;
+
+	ASSERT(zio->io_type == ZIO_TYPE_READ || zio->io_type == ZIO_TYPE_WRITE);
+
+	/* zdb -U dumps what it reads; leave that to zfs_file_pread(). */
+	if (vfu == NULL || vf->vf_file->f_dump_fd != -1)
+		return (B_FALSE);
+
+	vr = kmem_alloc(sizeof (*vr), KM_SLEEP);
+	vr->vr_zio = zio;
+	vr->vr_slot = -1;
+
+	mutex_enter(&vfu->vfu_lock);
+	if (vfu->vfu_exiting || vfu->vfu_inflight == VFU_ENTRIES) {
+		mutex_exit(&vfu->vfu_lock);
+		kmem_free(vr, sizeof (*vr));
+		return (B_FALSE);
+	}
+	vfu->vfu_inflight++;
+	if (!abd_is_linear(zio->io_abd) && zio->io_size <= VFU_FIXED_SIZE &&
+	    vfu->vfu_fixed_free != 0) {
+		vr->vr_slot = lowbit64(vfu->vfu_fixed_free) - 1;
+		vfu->vfu_fixed_free &= ~(1ULL << vr->vr_slot);
+	}
+	mutex_exit(&vfu->vfu_lock);
+
+	if (vr->vr_slot >= 0) {
+		vr->vr_buf = vfu->vfu_fixed + (size_t)vr->vr_slot *
+		    VFU_FIXED_SIZE;
+		if (write)
+			abd_copy_to_buf(vr->vr_buf, zio->io_abd, zio->io_size);
+		opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+	} else {
+		vr->vr_buf = write ?
+		    abd_borrow_buf_copy(zio->io_abd, zio->io_size) :
+		    abd_borrow_buf(zio->io_abd, zio->io_size);
+		opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+	}
+
+	mutex_enter(&vfu->vfu_lock);
+	vfu_queue(vfu, opcode, vf->vf_file->f_fd, vr->vr_buf, zio->io_size,
+	    zio->io_offset, vr->vr_slot, vr);
+	vfu_submit(vfu);
+	mutex_exit(&vfu->vfu_lock);
+
+	return (B_TRUE);
+}
+
+#else	/* !__linux__ || !HAVE_IO_URING */
+
+void
+vdev_file_uring_init(void)
+{
+}
+
+void
+vdev_file_uring_fini(void)
+{
+}
+
+boolean_t
+vdev_file_uring_io_start(zio_t *zio)
+{
+	(void) zio;
+	return (B_FALSE);
+}
+
+#endif
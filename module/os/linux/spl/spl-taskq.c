@@ -1160,7 +1160,22 @@ taskq_thread_create(taskq_t *tq)
 		return (NULL);
 	}
 
-	if (spl_taskq_thread_bind) {
+	if (tq->tq_node != NUMA_NO_NODE) {
+		/*
+		 * Spread the threads of a node-local taskq over the online
+		 * CPUs of that node.
+		 */
+		int cpu = cpumask_next_and(tq->tq_node_cpu,
+		    cpumask_of_node(tq->tq_node), cpu_online_mask);
+		if (cpu >= nr_cpu_ids) {
+			cpu = cpumask_next_and(-1,
+			    cpumask_of_node(tq->tq_node), cpu_online_mask);
+		}
+		if (cpu < nr_cpu_ids) {
+			tq->tq_node_cpu = cpu;
+			kthread_bind(tqt->tqt_thread, cpu);
+		}
+	} else if (spl_taskq_thread_bind) {
 		last_used_cpu = (last_used_cpu + 1) % num_online_cpus();
 		kthread_bind(tqt->tqt_thread, last_used_cpu);
 	}
@@ -1323,6 +1338,19 @@ taskq_kstats_fini(taskq_t *tq)
 taskq_t *
 taskq_create(const char *name, int threads_arg, pri_t pri,
     int minalloc, int maxalloc, uint_t flags)
+{
+	return (taskq_create_node(name, threads_arg, pri, minalloc, maxalloc,
+	    flags, NUMA_NO_NODE));
+}
+EXPORT_SYMBOL(taskq_create);
+
+/*
+ * Create a taskq whose threads only run on the CPUs of the given NUMA
+ * node, or anywhere for NUMA_NO_NODE.
+ */
+taskq_t *
+taskq_create_node(const char *name, int threads_arg, pri_t pri,
+    int minalloc, int maxalloc, uint_t flags, int node)
 {
 	taskq_t *tq;
 	taskq_thread_t *tqt;
@@ -1367,6 +1395,10 @@ taskq_create(const char *name, int threads_arg, pri_t pri,
 	tq->tq_nspawn = 0;
 	tq->tq_maxthreads = nthreads;
 	tq->tq_cpu_pct = threads_arg;
+	if (node != NUMA_NO_NODE && !node_online(node))
+		node = NUMA_NO_NODE;
+	tq->tq_node = node;
+	tq->tq_node_cpu = -1;
 	tq->tq_pri = pri;
 	tq->tq_minalloc = minalloc;
 	tq->tq_maxalloc = maxalloc;
@@ -1430,7 +1462,7 @@ taskq_create(const char *name, int threads_arg, pri_t pri,
 
 	return (tq);
 }
-EXPORT_SYMBOL(taskq_create);
+EXPORT_SYMBOL(taskq_create_node);
 
 void
 taskq_destroy(taskq_t *tq)
@@ -262,6 +262,8 @@ abd_unmark_zfs_page(struct page *page)
  * progressively decreased until it can be satisfied without performing
  * reclaim or compaction.  When necessary this function will degenerate to
  * allocating individual pages and allowing reclaim to satisfy allocations.
+ * With zio_taskq_numa set the first chunk is explicitly requested from the
+ * node of the allocating thread rather than by the task's memory policy.
  */
 void
 abd_alloc_chunks(abd_t *abd, size_t size)
@@ -277,7 +279,8 @@ abd_alloc_chunks(abd_t *abd, size_t size)
 	unsigned int nr_pages = abd_chunkcnt_for_bytes(size);
 	unsigned int chunks = 0, zones = 0;
 	size_t remaining_size;
-	int nid = NUMA_NO_NODE;
+	int local = CPU_NODEID;
+	int nid = zio_taskq_numa ? local : NUMA_NO_NODE;
 	unsigned int alloc_pages = 0;
 
 	INIT_LIST_HEAD(&pages);
@@ -308,6 +311,8 @@ abd_alloc_chunks(abd_t *abd, size_t size)
 			zones++;
 
 		nid = page_to_nid(page);
+		zio_numa_stat_add(local, nid == local ? ZIO_NUMA_ABD_LOCAL :
+		    ZIO_NUMA_ABD_REMOTE, chunk_pages);
 		ABDSTAT_BUMP(abdstat_scatter_orders[order]);
 		chunks++;
 		alloc_pages += chunk_pages;
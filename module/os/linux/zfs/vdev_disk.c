@@ -656,7 +656,7 @@ typedef struct {
 
 	struct block_device *vbio_bdev;	/* blockdev to submit bios to */
 
-	abd_t		*vbio_abd;	/* abd carrying borrowed linear buf */
+	abd_t		*vbio_abd;	/* abd carrying bounce buffers */
 
 	uint_t		vbio_max_segs;	/* max segs per bio */
 
@@ -900,6 +900,120 @@ vdev_disk_check_alignment(abd_t *abd, uint64_t size, struct block_device *bdev)
 	return (B_TRUE);
 }
 
+/*
+ * Aggregated I/Os arrive as gang ABDs referencing the member buffers
+ * directly. When only a few members are misaligned (a small block from a
+ * shared slab, a gang header), copying the whole aggregate just to fix them
+ * up would throw away the benefit of building it without a copy. Instead,
+ * build a new gang that references every member that can be submitted in
+ * place, and bounces only runs of misaligned members through freshly
+ * allocated, correctly aligned buffers.
+ *
+ * The bounce buffers are the only children of the returned gang that own
+ * their data; in-place members are added as offset views. On a read,
+ * vdev_disk_io_done() uses this to copy back just the bounced ranges.
+ *
+ * Returns NULL if the members can't be arranged this way, in which case the
+ * caller falls back to copying the whole ABD.
+ */
+static abd_t *
+vdev_disk_gang_bounce(zio_t *zio, struct block_device *bdev)
+{
+	abd_t *gabd = zio->io_abd;
+	boolean_t meta = !!(gabd->abd_flags & ABD_FLAG_META);
+	vdev_disk_check_alignment_t s = {
+	    .blocksize = bdev_logical_block_size(bdev),
+	};
+	vdev_disk_check_alignment_t t;
+	uint64_t off = 0, run_off = 0, run_size = 0;
+	abd_t *nabd = abd_alloc_gang();
+	abd_t *babd;
+
+	for (abd_t *cabd = abd_gang_next_child(gabd, NULL);
+	    cabd != NULL && off < zio->io_size;
+	    cabd = abd_gang_next_child(gabd, cabd)) {
+		uint64_t csize = MIN(cabd->abd_size, zio->io_size - off);
+		boolean_t inplace = B_FALSE;
+
+		/*
+		 * A pending bounce run always starts on a fresh page, so it
+		 * can only be closed off in front of this member if it also
+		 * ends on a page boundary.
+		 */
+		if (run_size == 0 || IS_P2ALIGNED(run_size, PAGESIZE)) {
+			t = s;
+			if (run_size != 0) {
+				t.seen_first = 1;
+				t.seen_last = 0;
+			}
+			inplace = (abd_iterate_page_func(cabd, 0, csize,
+			    vdev_disk_check_alignment_cb, &t) == 0);
+		}
+
+		if (inplace) {
+			if (run_size != 0) {
+				babd = abd_alloc_for_io(run_size, meta);
+				if (zio->io_type == ZIO_TYPE_WRITE)
+					abd_copy_off(babd, gabd, 0, run_off,
+					    run_size);
+				abd_gang_add(nabd, babd, B_TRUE);
+				run_size = 0;
+			}
+			abd_gang_add(nabd,
+			    abd_get_offset_size(cabd, 0, csize), B_TRUE);
+			s = t;
+		} else {
+			if (run_size == 0)
+				run_off = off;
+			run_size += csize;
+		}
+		off += csize;
+	}
+	ASSERT3U(off, ==, zio->io_size);
+
+	if (run_size != 0) {
+		babd = abd_alloc_for_io(run_size, meta);
+		if (zio->io_type == ZIO_TYPE_WRITE)
+			abd_copy_off(babd, gabd, 0, run_off, run_size);
+		abd_gang_add(nabd, babd, B_TRUE);
+	}
+
+	/*
+	 * The member-by-member walk can't see every way the pieces interact
+	 * (eg, an in-place member ending mid-page ahead of a bounce run), so
+	 * check the result as a whole before committing to it.
+	 */
+	if (!vdev_disk_check_alignment(nabd, zio->io_size, bdev)) {
+		abd_free(nabd);
+		return (NULL);
+	}
+
+	return (nabd);
+}
+
+/*
+ * Return the data of a bounced read to the original ABD. For a partially
+ * bounced gang, only the children that own their data were bounced.
+ */
+static void
+vdev_disk_bounce_return(zio_t *zio, abd_t *abd)
+{
+	if (!abd_is_gang(abd)) {
+		abd_copy(zio->io_abd, abd, zio->io_size);
+		return;
+	}
+
+	uint64_t off = 0;
+	for (abd_t *cabd = abd_gang_next_child(abd, NULL); cabd != NULL;
+	    cabd = abd_gang_next_child(abd, cabd)) {
+		if (cabd->abd_flags & ABD_FLAG_OWNER)
+			abd_copy_off(zio->io_abd, cabd, off, 0,
+			    cabd->abd_size);
+		off += cabd->abd_size;
+	}
+	ASSERT3U(off, ==, zio->io_size);
+}
+
 static int
 vdev_disk_io_rw(zio_t *zio)
 {
@@ -934,10 +1048,13 @@ vdev_disk_io_rw(zio_t *zio)
 	 * larger blocks, this can happen at least when a small number of
 	 * blocks (usually 1) are allocated from a shared slab, or when
 	 * abnormally-small data regions (eg gang headers) are mixed into the
-	 * same ABD as larger allocations (eg aggregations).
+	 * same ABD as larger allocations (eg aggregations). For gang ABDs we
+	 * first try to bounce only the misaligned members.
 	 */
 	abd_t *abd = zio->io_abd;
-	if (!vdev_disk_check_alignment(abd, zio->io_size, bdev)) {
+	if (!vdev_disk_check_alignment(abd, zio->io_size, bdev) &&
+	    (!abd_is_gang(abd) ||
+	    (abd = vdev_disk_gang_bounce(zio, bdev)) == NULL)) {
 		/* Allocate a new memory region with guaranteed alignment */
 		abd = abd_alloc_for_io(zio->io_size,
 		    zio->io_abd->abd_flags & ABD_FLAG_META);
@@ -1224,8 +1341,7 @@ vdev_disk_io_done(zio_t *zio)
 		 */
 		if (vbio->vbio_abd != NULL) {
 			if (zio->io_type == ZIO_TYPE_READ)
-				abd_copy(zio->io_abd, vbio->vbio_abd,
-				    zio->io_size);
+				vdev_disk_bounce_return(zio, vbio->vbio_abd);
 
 			abd_free(vbio->vbio_abd);
 			vbio->vbio_abd = NULL;
@@ -78,7 +78,9 @@ static int zfs_unlink_suspend_progress = 0;
  * This callback is invoked when acquiring a RL_WRITER or RL_APPEND lock on
  * z_rangelock. It will modify the offset and length of the lock to reflect
  * znode-specific information, and convert RL_APPEND to RL_WRITER.  This is
- * called with the rangelock_t's rl_lock held, which avoids races.
+ * called with the rangelock_t's rl_lock held, which avoids races.  It may
+ * also be called under a rangelock shard's lock, in which case any change it
+ * makes sends the lock to the slow path under rl_lock.
  */
 static void
 zfs_rangelock_cb(zfs_locked_range_t *new, void *arg)
@@ -543,6 +545,7 @@ zfs_znode_alloc(zfsvfs_t *zfsvfs, dmu_buf_t *db, int blksz,
 	zp->z_blksz = blksz;
 	zp->z_seq = 0x7A4653;
 	zp->z_sync_cnt = 0;
+	zp->z_replay_eof = 0;
 
 	zfs_znode_sa_init(zfsvfs, zp, db, obj_type, hdl);
 
@@ -207,6 +207,62 @@ zpl_file_accessed(struct file *filp)
 	}
 }
 
+static inline void
+zpl_ki_complete(struct kiocb *kiocb, long ret)
+{
+#if defined(HAVE_KI_COMPLETE_2ARGS)
+	kiocb->ki_complete(kiocb, ret);
+#else
+	kiocb->ki_complete(kiocb, ret, 0);
+#endif
+}
+
+/*
+ * State for a Direct I/O read or write from an asynchronous kiocb, which
+ * zfs_read() or zfs_write() may queue and complete later through
+ * zpl_aio_done().
+ */
+typedef struct zpl_aio {
+	zfs_uio_t	za_uio;
+	struct kiocb	*za_kiocb;
+} zpl_aio_t;
+
+static void
+zpl_aio_done(zfs_uio_t *uio, ssize_t nbytes, int error)
+{
+	zpl_aio_t *za = container_of(uio, zpl_aio_t, za_uio);
+	struct kiocb *kiocb = za->za_kiocb;
+
+	kmem_free(za, sizeof (zpl_aio_t));
+
+	if (error != 0) {
+		zpl_ki_complete(kiocb, -error);
+		return;
+	}
+
+	kiocb->ki_pos += nbytes;
+	zpl_ki_complete(kiocb, nbytes);
+}
+
+/*
+ * Only Direct I/O can be completed asynchronously, so the state is only
+ * allocated for asynchronous O_DIRECT kiocbs.
+ */
+static zpl_aio_t *
+zpl_aio_alloc(struct kiocb *kiocb)
+{
+#if defined(IOCB_DIRECT)
+	if (is_sync_kiocb(kiocb) || !(kiocb->ki_flags & IOCB_DIRECT))
+		return (NULL);
+
+	zpl_aio_t *za = kmem_alloc(sizeof (zpl_aio_t), KM_SLEEP);
+	za->za_kiocb = kiocb;
+	return (za);
+#else
+	return (NULL);
+#endif
+}
+
 static ssize_t
 zpl_iter_read(struct kiocb *kiocb, struct iov_iter *to)
 {
@@ -214,23 +270,39 @@ zpl_iter_read(struct kiocb *kiocb, struct iov_iter *to)
 	fstrans_cookie_t cookie;
 	struct file *filp = kiocb->ki_filp;
 	ssize_t count = iov_iter_count(to);
-	zfs_uio_t uio;
+	zpl_aio_t *za = zpl_aio_alloc(kiocb);
+	zfs_uio_t suio, *uio = (za != NULL) ? &za->za_uio : &suio;
 
-	zfs_uio_iov_iter_init(&uio, to, kiocb->ki_pos, count);
+	zfs_uio_iov_iter_init(uio, to, kiocb->ki_pos, count);
+	if (za != NULL)
+		uio->uio_done = zpl_aio_done;
 
 	crhold(cr);
 	cookie = spl_fstrans_mark();
 
-	ssize_t ret = -zfs_read(ITOZ(filp->f_mapping->host), &uio,
+	ssize_t ret = -zfs_read(ITOZ(filp->f_mapping->host), uio,
 	    filp->f_flags | zfs_io_flags(kiocb), cr);
 
 	spl_fstrans_unmark(cookie);
 	crfree(cr);
 
+	if (ret == -EINPROGRESS) {
+		/*
+		 * The read was queued and za now belongs to zpl_aio_done(),
+		 * which may already have run.  The caller holds its own
+		 * reference on the file meanwhile.
+		 */
+		zpl_file_accessed(filp);
+		return (-EIOCBQUEUED);
+	}
+
+	ssize_t read = count - uio->uio_resid;
+	if (za != NULL)
+		kmem_free(za, sizeof (zpl_aio_t));
+
 	if (ret < 0)
 		return (ret);
 
-	ssize_t read = count - uio.uio_resid;
 	kiocb->ki_pos += read;
 
 	zpl_file_accessed(filp);
@@ -258,7 +330,8 @@ zpl_iter_write(struct kiocb *kiocb, struct iov_iter *from)
 	fstrans_cookie_t cookie;
 	struct file *filp = kiocb->ki_filp;
 	struct inode *ip = filp->f_mapping->host;
-	zfs_uio_t uio;
+	zpl_aio_t *za;
+	zfs_uio_t suio, *uio;
 	size_t count = 0;
 	ssize_t ret;
 
@@ -266,21 +339,33 @@ zpl_iter_write(struct kiocb *kiocb, struct iov_iter *from)
 	if (ret)
 		return (ret);
 
-	zfs_uio_iov_iter_init(&uio, from, kiocb->ki_pos, count);
+	za = zpl_aio_alloc(kiocb);
+	uio = (za != NULL) ? &za->za_uio : &suio;
+
+	zfs_uio_iov_iter_init(uio, from, kiocb->ki_pos, count);
+	if (za != NULL)
+		uio->uio_done = zpl_aio_done;
 
 	crhold(cr);
 	cookie = spl_fstrans_mark();
 
-	ret = -zfs_write(ITOZ(ip), &uio,
+	ret = -zfs_write(ITOZ(ip), uio,
 	    filp->f_flags | zfs_io_flags(kiocb), cr);
 
 	spl_fstrans_unmark(cookie);
 	crfree(cr);
 
+	/* As for reads, za now belongs to zpl_aio_done() */
+	if (ret == -EINPROGRESS)
+		return (-EIOCBQUEUED);
+
+	ssize_t wrote = count - uio->uio_resid;
+	if (za != NULL)
+		kmem_free(za, sizeof (zpl_aio_t));
+
 	if (ret < 0)
 		return (ret);
 
-	ssize_t wrote = count - uio.uio_resid;
 	kiocb->ki_pos += wrote;
 
 	return (wrote);
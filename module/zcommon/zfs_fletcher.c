@@ -492,6 +492,63 @@ fletcher_4_native(const void *buf, uint64_t size,
 	}
 }
 
+/*
+ * Compute the native Fletcher 4 checksums of 'n' equally sized buffers.
+ * The FPU state is saved and restored once for the whole batch rather than
+ * once per buffer, which dominates the cost of checksumming small blocks in
+ * the kernel.  Implementations which provide an interleaved kernel
+ * additionally checksum the buffers two at a time, sharing the loop overhead
+ * between two independent streams.
+ */
+void
+fletcher_4_native_multi(const void *const *bufs, uint64_t size,
+    zio_cksum_t *zcps, uint_t n)
+{
+	const uint64_t p2size = P2ALIGN_TYPED(size, FLETCHER_MIN_SIMD_SIZE,
+	    uint64_t);
+	fletcher_4_ctx_t ctx[2];
+	uint_t i;
+
+	ASSERT(IS_P2ALIGNED(size, sizeof (uint32_t)));
+
+	if (p2size == 0) {
+		for (i = 0; i < n; i++)
+			fletcher_4_native(bufs[i], size, NULL, &zcps[i]);
+		return;
+	}
+
+	const fletcher_4_ops_t *ops = fletcher_4_impl_get();
+
+	if (ops->uses_fpu == B_TRUE) {
+		kfpu_begin();
+	}
+	for (i = 0; i < n; i++) {
+		if (ops->compute_native_x2 != NULL && i + 1 < n) {
+			ops->init_native(&ctx[0]);
+			ops->init_native(&ctx[1]);
+			ops->compute_native_x2(&ctx[0], &ctx[1], bufs[i],
+			    bufs[i + 1], p2size);
+			ops->fini_native(&ctx[0], &zcps[i]);
+			ops->fini_native(&ctx[1], &zcps[i + 1]);
+			i++;
+		} else {
+			ops->init_native(&ctx[0]);
+			ops->compute_native(&ctx[0], bufs[i], p2size);
+			ops->fini_native(&ctx[0], &zcps[i]);
+		}
+	}
+	if (ops->uses_fpu == B_TRUE) {
+		kfpu_end();
+	}
+
+	if (p2size < size) {
+		for (i = 0; i < n; i++) {
+			fletcher_4_scalar_native((fletcher_4_ctx_t *)&zcps[i],
+			    (char *)bufs[i] + p2size, size - p2size);
+		}
+	}
+}
+
 void
 fletcher_4_native_varsize(const void *buf, uint64_t size, zio_cksum_t *zcp)
 {
@@ -728,6 +785,8 @@ fletcher_4_benchmark_impl(boolean_t native, char *data, uint64_t data_size)
 				fastest_stat->native = i;
 				FLETCHER_4_FASTEST_FN_COPY(native,
 				    fletcher_4_supp_impls[i]);
+				fletcher_4_fastest_impl.compute_native_x2 =
+				    fletcher_4_supp_impls[i]->compute_native_x2;
 			} else {
 				fastest_stat->byteswap = i;
 				FLETCHER_4_FASTEST_FN_COPY(byteswap,
@@ -861,17 +920,22 @@ static void
 abd_fletcher_4_simd2scalar(boolean_t native, void *data, size_t size,
     zio_abd_checksum_data_t *cdp)
 {
-	zio_cksum_t *zcp = cdp->acd_zcp;
+	fletcher_4_ctx_t *ctx = cdp->acd_ctx;
 
 	ASSERT3U(size, <, FLETCHER_MIN_SIMD_SIZE);
 
+	/*
+	 * Carry the partial checksum over in the scalar context, the final
+	 * abd_fletcher_4_fini() copies it out of there.
+	 */
 	abd_fletcher_4_fini(cdp);
 	cdp->acd_private = (void *)&fletcher_4_scalar_ops;
+	ctx->scalar = *cdp->acd_zcp;
 
 	if (native)
-		fletcher_4_incremental_native(data, size, zcp);
+		fletcher_4_scalar_native(ctx, data, size);
 	else
-		fletcher_4_incremental_byteswap(data, size, zcp);
+		fletcher_4_scalar_byteswap(ctx, data, size);
 }
 
 static int
@@ -910,6 +974,93 @@ zio_abd_checksum_func_t fletcher_4_abd_ops = {
 	.acf_iter = abd_fletcher_4_iter
 };
 
+/*
+ * ABD adapters for checksumming two buffers in lockstep.  These take an
+ * array of two zio_abd_checksum_data_t, one per buffer, and only support
+ * native byte order since they are used on the write path.
+ */
+static void
+abd_fletcher_4_x2_init(zio_abd_checksum_data_t *cdp)
+{
+	const fletcher_4_ops_t *ops = fletcher_4_impl_get();
+
+	ASSERT3U(cdp[0].acd_byteorder, ==, ZIO_CHECKSUM_NATIVE);
+	ASSERT3U(cdp[1].acd_byteorder, ==, ZIO_CHECKSUM_NATIVE);
+
+	cdp[0].acd_private = (void *) ops;
+	cdp[1].acd_private = (void *) ops;
+
+	if (ops->uses_fpu == B_TRUE) {
+		kfpu_begin();
+	}
+	ops->init_native(cdp[0].acd_ctx);
+	ops->init_native(cdp[1].acd_ctx);
+}
+
+static void
+abd_fletcher_4_x2_fini(zio_abd_checksum_data_t *cdp)
+{
+	fletcher_4_ops_t *ops = (fletcher_4_ops_t *)cdp[0].acd_private;
+
+	ASSERT(ops);
+
+	ops->fini_native(cdp[0].acd_ctx, cdp[0].acd_zcp);
+	ops->fini_native(cdp[1].acd_ctx, cdp[1].acd_zcp);
+
+	if (ops->uses_fpu == B_TRUE) {
+		kfpu_end();
+	}
+}
+
+static int
+abd_fletcher_4_x2_iter(void *data0, void *data1, size_t size, void *private)
+{
+	zio_abd_checksum_data_t *cdp = (zio_abd_checksum_data_t *)private;
+	fletcher_4_ops_t *ops = (fletcher_4_ops_t *)cdp[0].acd_private;
+	uint64_t asize = P2ALIGN_TYPED(size, FLETCHER_MIN_SIMD_SIZE, uint64_t);
+
+	ASSERT(IS_P2ALIGNED(size, sizeof (uint32_t)));
+
+	if (asize > 0) {
+		if (ops->compute_native_x2 != NULL) {
+			ops->compute_native_x2(cdp[0].acd_ctx, cdp[1].acd_ctx,
+			    data0, data1, asize);
+		} else {
+			ops->compute_native(cdp[0].acd_ctx, data0, asize);
+			ops->compute_native(cdp[1].acd_ctx, data1, asize);
+		}
+
+		size -= asize;
+		data0 = (char *)data0 + asize;
+		data1 = (char *)data1 + asize;
+	}
+
+	if (size > 0) {
+		ASSERT3U(size, <, FLETCHER_MIN_SIMD_SIZE);
+		/*
+		 * Fold the SIMD state into the scalar one and carry on with
+		 * the scalar implementation for the rest of both buffers.
+		 */
+		if (ops != &fletcher_4_scalar_ops) {
+			abd_fletcher_4_x2_fini(cdp);
+			cdp[0].acd_ctx->scalar = *cdp[0].acd_zcp;
+			cdp[1].acd_ctx->scalar = *cdp[1].acd_zcp;
+			cdp[0].acd_private = (void *)&fletcher_4_scalar_ops;
+			cdp[1].acd_private = (void *)&fletcher_4_scalar_ops;
+		}
+		fletcher_4_scalar_native(cdp[0].acd_ctx, data0, size);
+		fletcher_4_scalar_native(cdp[1].acd_ctx, data1, size);
+	}
+
+	return (0);
+}
+
+zio_abd_checksum_func2_t fletcher_4_abd_x2_ops = {
+	.acf_init = abd_fletcher_4_x2_init,
+	.acf_fini = abd_fletcher_4_x2_fini,
+	.acf_iter = abd_fletcher_4_x2_iter
+};
+
 #if defined(_KERNEL)
 
 #define	IMPL_FMT(impl, i)	(((impl) == (i)) ? "[%s] " : "%s ")
@@ -1007,6 +1158,7 @@ EXPORT_SYMBOL(fletcher_2_native);
 EXPORT_SYMBOL(fletcher_2_byteswap);
 EXPORT_SYMBOL(fletcher_4_native);
 EXPORT_SYMBOL(fletcher_4_native_varsize);
+EXPORT_SYMBOL(fletcher_4_native_multi);
 EXPORT_SYMBOL(fletcher_4_byteswap);
 EXPORT_SYMBOL(fletcher_4_incremental_native);
 EXPORT_SYMBOL(fletcher_4_incremental_byteswap);
@@ -109,6 +109,42 @@ fletcher_4_avx512f_native(fletcher_4_ctx_t *ctx, const void *buf, uint64_t size)
 }
 STACK_FRAME_NON_STANDARD(fletcher_4_avx512f_native);
 
+static void
+fletcher_4_avx512f_native_x2(fletcher_4_ctx_t *ctx0, fletcher_4_ctx_t *ctx1,
+    const void *buf0, const void *buf1, uint64_t size)
+{
+	const uint32_t *ip0 = buf0;
+	const uint32_t *ip1 = buf1;
+	const uint32_t *ipend = (uint32_t *)((uint8_t *)ip0 + size);
+
+	FLETCHER_4_AVX512_RESTORE_CTX(ctx0);
+	__asm("vmovdqu64 %0, %%zmm6" :: "m" ((ctx1)->avx512[0]));
+	__asm("vmovdqu64 %0, %%zmm7" :: "m" ((ctx1)->avx512[1]));
+	__asm("vmovdqu64 %0, %%zmm8" :: "m" ((ctx1)->avx512[2]));
+	__asm("vmovdqu64 %0, %%zmm9" :: "m" ((ctx1)->avx512[3]));
+
+	do {
+		__asm("vpmovzxdq %0, %%zmm4"::"m" (*ip0));
+		__asm("vpmovzxdq %0, %%zmm5"::"m" (*ip1));
+		__asm("vpaddq %zmm4, %zmm0, %zmm0");
+		__asm("vpaddq %zmm5, %zmm6, %zmm6");
+		__asm("vpaddq %zmm0, %zmm1, %zmm1");
+		__asm("vpaddq %zmm6, %zmm7, %zmm7");
+		__asm("vpaddq %zmm1, %zmm2, %zmm2");
+		__asm("vpaddq %zmm7, %zmm8, %zmm8");
+		__asm("vpaddq %zmm2, %zmm3, %zmm3");
+		__asm("vpaddq %zmm8, %zmm9, %zmm9");
+		ip1 += 8;
+	} while ((ip0 += 8) < ipend);
+
+	FLETCHER_4_AVX512_SAVE_CTX(ctx0);
+	__asm("vmovdqu64 %%zmm6, %0" : "=m" ((ctx1)->avx512[0]));
+	__asm("vmovdqu64 %%zmm7, %0" : "=m" ((ctx1)->avx512[1]));
+	__asm("vmovdqu64 %%zmm8, %0" : "=m" ((ctx1)->avx512[2]));
+	__asm("vmovdqu64 %%zmm9, %0" : "=m" ((ctx1)->avx512[3]));
+}
+STACK_FRAME_NON_STANDARD(fletcher_4_avx512f_native_x2);
+
 static void
 fletcher_4_avx512f_byteswap(fletcher_4_ctx_t *ctx, const void *buf,
     uint64_t size)
@@ -162,6 +198,7 @@ const fletcher_4_ops_t fletcher_4_avx512f_ops = {
 	.init_byteswap = fletcher_4_avx512f_init,
 	.fini_byteswap = fletcher_4_avx512f_fini,
 	.compute_byteswap = fletcher_4_avx512f_byteswap,
+	.compute_native_x2 = fletcher_4_avx512f_native_x2,
 	.valid = fletcher_4_avx512f_valid,
 	.uses_fpu = B_TRUE,
 	.name = "avx512f"
@@ -213,6 +250,7 @@ const fletcher_4_ops_t fletcher_4_avx512bw_ops = {
 	.init_byteswap = fletcher_4_avx512f_init,
 	.fini_byteswap = fletcher_4_avx512f_fini,
 	.compute_byteswap = fletcher_4_avx512bw_byteswap,
+	.compute_native_x2 = fletcher_4_avx512f_native_x2,
 	.valid = fletcher_4_avx512bw_valid,
 	.uses_fpu = B_TRUE,
 	.name = "avx512bw"
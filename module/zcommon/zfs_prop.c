@@ -730,6 +730,14 @@ zfs_prop_init(void)
 	    "defaultprojectobjquota", 0, PROP_DEFAULT,
 	    ZFS_TYPE_FILESYSTEM | ZFS_TYPE_SNAPSHOT, "<size> | none",
 	    "DEFAULTPROJECTOBJQUOTA", B_FALSE, sfeatures);
+	zprop_register_number(ZFS_PROP_PRIMARYCACHE_QUOTA,
+	    "primarycache_quota", 0, PROP_DEFAULT,
+	    ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME, "<size> | none",
+	    "PCQUOTA", B_FALSE, sfeatures);
+	zprop_register_number(ZFS_PROP_PRIMARYCACHE_RESERVE,
+	    "primarycache_reserve", 0, PROP_DEFAULT,
+	    ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME, "<size> | none",
+	    "PCRESERV", B_FALSE, sfeatures);
 
 	/* inherit number properties */
 	zprop_register_number(ZFS_PROP_RECORDSIZE, "recordsize",
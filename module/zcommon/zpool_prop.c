@@ -66,6 +66,12 @@ zpool_prop_init(void)
 		{ NULL }
 	};
 
+	static const zprop_index_t iosched_table[] = {
+		{ "classic",	SPA_IOSCHED_CLASSIC },
+		{ "deadline",	SPA_IOSCHED_DEADLINE },
+		{ NULL }
+	};
+
 	struct zfs_mod_supported_features *sfeatures =
 	    zfs_mod_list_supported(ZFS_SYSFS_POOL_PROPERTIES);
 
@@ -172,6 +178,9 @@ zpool_prop_init(void)
 	zprop_register_index(ZPOOL_PROP_AUTOTRIM, "autotrim",
 	    SPA_AUTOTRIM_OFF, PROP_DEFAULT, ZFS_TYPE_POOL,
 	    "on | off", "AUTOTRIM", boolean_table, sfeatures);
+	zprop_register_index(ZPOOL_PROP_IOSCHED, "iosched",
+	    SPA_IOSCHED_CLASSIC, PROP_DEFAULT, ZFS_TYPE_POOL,
+	    "classic | deadline", "IOSCHED", iosched_table, sfeatures);
 
 	/* hidden properties */
 	zprop_register_hidden(ZPOOL_PROP_NAME, "name", PROP_TYPE_STRING,
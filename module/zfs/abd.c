@@ -482,6 +482,19 @@ abd_gang_add(abd_t *pabd, abd_t *cabd, boolean_t free_on_free)
 	pabd->abd_size += child_abd->abd_size;
 }
 
+/*
+ * Walk the children of a gang ABD, in order. Pass NULL for the first child.
+ */
+abd_t *
+abd_gang_next_child(abd_t *abd, abd_t *cabd)
+{
+	ASSERT(abd_is_gang(abd));
+
+	if (cabd == NULL)
+		return (list_head(&ABD_GANG(abd).abd_gang_chain));
+	return (list_next(&ABD_GANG(abd).abd_gang_chain, cabd));
+}
+
 /*
  * Locate the ABD for the supplied offset in the gang ABD.
  * Return a new offset relative to the returned ABD.
@@ -429,6 +429,7 @@ static uint_t zfs_arc_dnode_reduce_percent = 10;
 static uint_t zfs_arc_grow_retry = 0;
 static uint_t zfs_arc_shrink_shift = 0;
 uint_t zfs_arc_average_blocksize = 8 * 1024; /* 8KB */
+static uint_t zfs_arc_hash_lock_shift = 0;
 
 /*
  * ARC dirty data constraints for arc_tempreserve_space() throttle:
@@ -519,6 +520,7 @@ arc_stats_t arc_stats = {
 	{ "mutex_miss",			KSTAT_DATA_UINT64 },
 	{ "access_skip",		KSTAT_DATA_UINT64 },
 	{ "evict_skip",			KSTAT_DATA_UINT64 },
+	{ "evict_reserve_skip",		KSTAT_DATA_UINT64 },
 	{ "evict_not_enough",		KSTAT_DATA_UINT64 },
 	{ "evict_l2_cached",		KSTAT_DATA_UINT64 },
 	{ "evict_l2_eligible",		KSTAT_DATA_UINT64 },
@@ -531,6 +533,7 @@ arc_stats_t arc_stats = {
 	{ "hash_collisions",		KSTAT_DATA_UINT64 },
 	{ "hash_chains",		KSTAT_DATA_UINT64 },
 	{ "hash_chain_max",		KSTAT_DATA_UINT64 },
+	{ "hash_lockless_misses",	KSTAT_DATA_UINT64 },
 	{ "meta",			KSTAT_DATA_UINT64 },
 	{ "pd",				KSTAT_DATA_UINT64 },
 	{ "pm",				KSTAT_DATA_UINT64 },
@@ -600,6 +603,8 @@ arc_stats_t arc_stats = {
 	{ "l2_evict_l1cached",		KSTAT_DATA_UINT64 },
 	{ "l2_free_on_write",		KSTAT_DATA_UINT64 },
 	{ "l2_abort_lowmem",		KSTAT_DATA_UINT64 },
+	{ "l2_admitted",		KSTAT_DATA_UINT64 },
+	{ "l2_rejected",		KSTAT_DATA_UINT64 },
 	{ "l2_cksum_bad",		KSTAT_DATA_UINT64 },
 	{ "l2_io_error",		KSTAT_DATA_UINT64 },
 	{ "l2_size",			KSTAT_DATA_UINT64 },
@@ -777,17 +782,29 @@ taskq_t *arc_prune_taskq;
  */
 
 #define	BUF_LOCKS 2048
+#define	BUF_LOCKS_PER_CPU 256
+
+/*
+ * Each hash lock is padded out to its own cache line so that CPUs
+ * spinning on neighbouring stripes do not bounce the same line.
+ */
+typedef struct buf_hash_lock {
+	kmutex_t bhl_lock;
+} ____cacheline_aligned buf_hash_lock_t;
+
 typedef struct buf_hash_table {
 	uint64_t ht_mask;
 	arc_buf_hdr_t **ht_table;
-	kmutex_t ht_locks[BUF_LOCKS] ____cacheline_aligned;
+	uint64_t ht_lock_mask;
+	buf_hash_lock_t *ht_locks;
 } buf_hash_table_t;
 
 static buf_hash_table_t buf_hash_table;
 
 #define	BUF_HASH_INDEX(spa, dva, birth) \
 	(buf_hash(spa, dva, birth) & buf_hash_table.ht_mask)
-#define	BUF_HASH_LOCK(idx)	(&buf_hash_table.ht_locks[idx & (BUF_LOCKS-1)])
+#define	BUF_HASH_LOCK(idx)	\
+	(&buf_hash_table.ht_locks[(idx) & buf_hash_table.ht_lock_mask].bhl_lock)
 #define	HDR_LOCK(hdr) \
 	(BUF_HASH_LOCK(BUF_HASH_INDEX(hdr->b_spa, &hdr->b_dva, hdr->b_birth)))
 
@@ -842,6 +859,19 @@ int l2arc_noprefetch = B_TRUE;			/* don't cache prefetch bufs */
 int l2arc_feed_again = B_TRUE;			/* turbo warmup */
 int l2arc_norw = B_FALSE;			/* no reads during writes */
 static uint_t l2arc_meta_percent = 33;	/* limit on headers size */
+static uint_t l2arc_feed_threads = 0;	/* feed tasks in parallel, 0=ncpus */
+
+/*
+ * L2ARC admission policies, see l2arc_admit().
+ */
+typedef enum l2arc_admit_policy {
+	L2ARC_ADMIT_ALL = 0,		/* every eligible buffer */
+	L2ARC_ADMIT_TINYLFU,		/* re-referenced buffers only */
+} l2arc_admit_policy_t;
+
+static uint_t l2arc_admit_policy = L2ARC_ADMIT_ALL;
+static uint_t l2arc_admit_min_refs = 2;	/* TinyLFU admission threshold */
+static uint_t l2arc_admit_sketch_shift = 16;	/* log2 of counters per row */
 
 /*
  * L2ARC Internals
@@ -849,7 +879,7 @@ static uint_t l2arc_meta_percent = 33;	/* limit on headers size */
 static list_t L2ARC_dev_list;			/* device list */
 static list_t *l2arc_dev_list;			/* device list pointer */
 static kmutex_t l2arc_dev_mtx;			/* device list mutex */
-static l2arc_dev_t *l2arc_dev_last;		/* last device used */
+static taskq_t *l2arc_feed_taskq;		/* per-device feed tasks */
 static list_t L2ARC_free_on_write;		/* free after write buf list */
 static list_t *l2arc_free_on_write;		/* free after write list ptr */
 static kmutex_t l2arc_free_on_write_mtx;	/* mutex for list */
@@ -912,6 +942,10 @@ static void arc_hdr_destroy(arc_buf_hdr_t *);
 static void arc_access(arc_buf_hdr_t *, arc_flags_t, boolean_t);
 static void arc_buf_watch(arc_buf_t *);
 static void arc_change_state(arc_state_t *, arc_buf_hdr_t *);
+static void arc_tenant_account(arc_buf_hdr_t *, arc_state_t *, arc_state_t *);
+static boolean_t arc_tenant_assign(arc_buf_hdr_t *, const zbookmark_phys_t *);
+static void arc_tenant_ghost_hit(arc_buf_hdr_t *, boolean_t);
+static boolean_t arc_tenant_reserved(arc_buf_hdr_t *);
 
 static arc_buf_contents_t arc_buf_type(arc_buf_hdr_t *);
 static uint32_t arc_bufc_to_flags(arc_buf_contents_t);
@@ -919,6 +953,7 @@ static inline void arc_hdr_set_flags(arc_buf_hdr_t *hdr, arc_flags_t flags);
 static inline void arc_hdr_clear_flags(arc_buf_hdr_t *hdr, arc_flags_t flags);
 
 static boolean_t l2arc_write_eligible(uint64_t, arc_buf_hdr_t *);
+static void l2arc_admit_record(const arc_buf_hdr_t *);
 static void l2arc_read_done(zio_t *);
 static void l2arc_do_free_on_write(void);
 static void l2arc_hdr_arcstats_update(arc_buf_hdr_t *hdr, boolean_t incr,
@@ -1057,6 +1092,21 @@ buf_hash_find(uint64_t spa, const blkptr_t *bp, kmutex_t **lockp)
 	kmutex_t *hash_lock = BUF_HASH_LOCK(idx);
 	arc_buf_hdr_t *hdr;
 
+	/*
+	 * Most lookups of uncached blocks land on an empty bucket, since
+	 * the table is sized for one header per zfs_arc_average_blocksize
+	 * of memory.  An empty bucket can be detected without the hash
+	 * lock: the head pointer is only ever stored whole, and a racing
+	 * insert is indistinguishable from one that happened just after
+	 * the lookup.  Callers which go on to create a header already
+	 * handle buf_hash_insert() finding an existing entry.
+	 */
+	if (atomic_load_ptr(&buf_hash_table.ht_table[idx]) == NULL) {
+		ARCSTAT_BUMP(arcstat_hash_lockless_misses);
+		*lockp = NULL;
+		return (NULL);
+	}
+
 	mutex_enter(hash_lock);
 	for (hdr = buf_hash_table.ht_table[idx]; hdr != NULL;
 	    hdr = hdr->b_hash_next) {
@@ -1103,7 +1153,7 @@ buf_hash_insert(arc_buf_hdr_t *hdr, kmutex_t **lockp)
 	}
 
 	hdr->b_hash_next = buf_hash_table.ht_table[idx];
-	buf_hash_table.ht_table[idx] = hdr;
+	atomic_store_ptr(&buf_hash_table.ht_table[idx], hdr);
 	arc_hdr_set_flags(hdr, ARC_FLAG_IN_HASH_TABLE);
 
 	/* collect some hash table performance data */
@@ -1132,7 +1182,7 @@ buf_hash_remove(arc_buf_hdr_t *hdr)
 		ASSERT3P(fhdr, !=, NULL);
 		hdrp = &fhdr->b_hash_next;
 	}
-	*hdrp = hdr->b_hash_next;
+	atomic_store_ptr(hdrp, hdr->b_hash_next);
 	hdr->b_hash_next = NULL;
 	arc_hdr_clear_flags(hdr, ARC_FLAG_IN_HASH_TABLE);
 
@@ -1165,8 +1215,10 @@ buf_fini(void)
 	kmem_free(buf_hash_table.ht_table,
 	    (buf_hash_table.ht_mask + 1) * sizeof (void *));
 #endif
-	for (int i = 0; i < BUF_LOCKS; i++)
+	for (uint64_t i = 0; i <= buf_hash_table.ht_lock_mask; i++)
 		mutex_destroy(BUF_HASH_LOCK(i));
+	vmem_free(buf_hash_table.ht_locks,
+	    (buf_hash_table.ht_lock_mask + 1) * sizeof (buf_hash_lock_t));
 	kmem_cache_destroy(hdr_full_cache);
 	kmem_cache_destroy(hdr_l2only_cache);
 	kmem_cache_destroy(buf_cache);
@@ -1262,6 +1314,7 @@ buf_init(void)
 {
 	uint64_t *ct = NULL;
 	uint64_t hsize = 1ULL << 12;
+	uint64_t hlsize;
 	int i, j;
 
 	/*
@@ -1291,6 +1344,24 @@ retry:
 		goto retry;
 	}
 
+	/*
+	 * The hash table buckets are protected by an array of cache line
+	 * sized mutexes.  By default the array scales with the number of
+	 * CPUs so that the chance of two CPUs hashing to the same stripe
+	 * stays constant as the system grows.
+	 */
+	if (zfs_arc_hash_lock_shift == 0) {
+		hlsize = MAX(BUF_LOCKS,
+		    1ULL << highbit64((uint64_t)boot_ncpus * BUF_LOCKS_PER_CPU -
+		    1));
+	} else {
+		hlsize = 1ULL << MIN(zfs_arc_hash_lock_shift, 24);
+	}
+	hlsize = MIN(hlsize, hsize);
+	buf_hash_table.ht_lock_mask = hlsize - 1;
+	buf_hash_table.ht_locks =
+	    vmem_zalloc(hlsize * sizeof (buf_hash_lock_t), KM_SLEEP);
+
 	hdr_full_cache = kmem_cache_create("arc_buf_hdr_t_full", HDR_FULL_SIZE,
 	    0, hdr_full_cons, hdr_full_dest, NULL, NULL, NULL, KMC_RECLAIMABLE);
 	hdr_l2only_cache = kmem_cache_create("arc_buf_hdr_t_l2only",
@@ -1303,8 +1374,8 @@ retry:
 		for (ct = zfs_crc64_table + i, *ct = i, j = 8; j > 0; j--)
 			*ct = (*ct >> 1) ^ (-(*ct & 1) & ZFS_CRC64_POLY);
 
-	for (i = 0; i < BUF_LOCKS; i++)
-		mutex_init(BUF_HASH_LOCK(i), NULL, MUTEX_DEFAULT, NULL);
+	for (uint64_t l = 0; l < hlsize; l++)
+		mutex_init(BUF_HASH_LOCK(l), NULL, MUTEX_DEFAULT, NULL);
 }
 
 #define	ARC_MINTIME	(hz>>4) /* 62 ms */
@@ -2488,6 +2559,9 @@ arc_change_state(arc_state_t *new_state, arc_buf_hdr_t *hdr)
 	if (new_state == arc_anon && HDR_IN_HASH_TABLE(hdr))
 		buf_hash_remove(hdr);
 
+	if (HDR_HAS_L1HDR(hdr))
+		arc_tenant_account(hdr, old_state, new_state);
+
 	/* adjust state sizes (ignore arc_l2c_only) */
 
 	if (update_new && new_state != arc_l2c_only) {
@@ -3309,6 +3383,7 @@ arc_hdr_alloc(uint64_t spa, int32_t psize, int32_t lsize,
 	hdr->b_l1hdr.b_mru_ghost_hits = 0;
 	hdr->b_l1hdr.b_mfu_hits = 0;
 	hdr->b_l1hdr.b_mfu_ghost_hits = 0;
+	hdr->b_l1hdr.b_tenant = 0;
 	hdr->b_l1hdr.b_buf = NULL;
 
 	ASSERT(zfs_refcount_is_zero(&hdr->b_l1hdr.b_refcnt));
@@ -3349,6 +3424,7 @@ arc_hdr_realloc(arc_buf_hdr_t *hdr, kmem_cache_t *old, kmem_cache_t *new)
 		 * l2c_only even though it's about to change.
 		 */
 		nhdr->b_l1hdr.b_state = arc_l2c_only;
+		nhdr->b_l1hdr.b_tenant = 0;
 
 		/* Verify previous threads set to NULL before freeing */
 		ASSERT0P(nhdr->b_l1hdr.b_pabd);
@@ -3961,6 +4037,19 @@ arc_evict_state_impl(multilist_t *ml, int idx, arc_buf_hdr_t *marker,
 		ASSERT(!MUTEX_HELD(hash_lock));
 
 		if (mutex_tryenter(hash_lock)) {
+			/*
+			 * Leave buffers of datasets within their
+			 * primarycache_reserve alone, unless we are
+			 * flushing everything.
+			 */
+			if (bytes != ARC_EVICT_ALL &&
+			    !GHOST_STATE(hdr->b_l1hdr.b_state) &&
+			    arc_tenant_reserved(hdr)) {
+				mutex_exit(hash_lock);
+				ARCSTAT_BUMP(arcstat_evict_reserve_skip);
+				continue;
+			}
+
 			uint64_t revicted;
 			uint64_t evicted = arc_evict_hdr(hdr, &revicted);
 			mutex_exit(hash_lock);
@@ -5331,6 +5420,9 @@ arc_access(arc_buf_hdr_t *hdr, arc_flags_t arc_flags, boolean_t hit)
 	ASSERT(MUTEX_HELD(HDR_LOCK(hdr)));
 	ASSERT(HDR_HAS_L1HDR(hdr));
 
+	if (l2arc_admit_policy == L2ARC_ADMIT_TINYLFU && l2arc_ndev != 0)
+		l2arc_admit_record(hdr);
+
 	/*
 	 * Update buffer prefetch status.
 	 */
@@ -5423,6 +5515,7 @@ arc_access(arc_buf_hdr_t *hdr, arc_flags_t arc_flags, boolean_t hit)
 		 */
 		hdr->b_l1hdr.b_mru_ghost_hits++;
 		ARCSTAT_BUMP(arcstat_mru_ghost_hits);
+		arc_tenant_ghost_hit(hdr, B_FALSE);
 		hdr->b_l1hdr.b_arc_access = now;
 		wmsum_add(&arc_mru_ghost->arcs_hits[arc_buf_type(hdr)],
 		    arc_hdr_size(hdr));
@@ -5452,6 +5545,7 @@ arc_access(arc_buf_hdr_t *hdr, arc_flags_t arc_flags, boolean_t hit)
 		 */
 		hdr->b_l1hdr.b_mfu_ghost_hits++;
 		ARCSTAT_BUMP(arcstat_mfu_ghost_hits);
+		arc_tenant_ghost_hit(hdr, B_TRUE);
 		hdr->b_l1hdr.b_arc_access = now;
 		wmsum_add(&arc_mfu_ghost->arcs_hits[arc_buf_type(hdr)],
 		    arc_hdr_size(hdr));
@@ -5828,6 +5922,330 @@ arc_cached(spa_t *spa, const blkptr_t *bp)
 	return (flags);
 }
 
+/*
+ * Per-dataset ARC accounting.
+ *
+ * The MRU and MFU states are shared by every dataset in every pool, so a
+ * single streaming reader (a backup or "zfs send") on one dataset can push
+ * the working set of every other dataset out of the cache.  To bound this,
+ * datasets with a primarycache_quota or primarycache_reserve property are
+ * registered here as ARC tenants.  Headers read or written on behalf of a
+ * tenant carry its slot index in b_tenant, which lets us:
+ *
+ *   - track the logical size of each tenant's MRU and MFU buffers,
+ *   - attribute ghost list hits to the dataset that caused them,
+ *   - stop admitting new buffers for a tenant over its quota; those are
+ *     read into the uncached state and dropped as soon as they are
+ *     released, and
+ *   - skip a tenant's buffers during eviction while it is within its
+ *     reserve.  Reserves are only honored while their sum is no more
+ *     than half of arc_c, so they can never pin the whole cache.
+ *
+ * Datasets without either property are not registered and cost nothing
+ * beyond a check of arc_tenant_count.  A tenant's slot stays allocated
+ * after its dataset goes away until the last buffer charged to it has
+ * left the MRU and MFU states.  Ghost and uncached headers may still hold
+ * the index after the slot has been reused, so headers also record the
+ * generation of their tenant, and arc_tenant_get() ignores a slot that
+ * has changed hands since.
+ */
+static krwlock_t arc_tenant_lock;
+static avl_tree_t arc_tenant_tree;
+static arc_tenant_t *arc_tenants[ARC_TENANTS_MAX];
+static uint32_t arc_tenant_gen;
+static uint64_t arc_tenant_count;
+static uint64_t arc_tenant_reserve_total;
+
+static int
+arc_tenant_compare(const void *x1, const void *x2)
+{
+	const arc_tenant_t *at1 = x1;
+	const arc_tenant_t *at2 = x2;
+
+	int cmp = TREE_CMP(at1->at_spa, at2->at_spa);
+	if (likely(cmp))
+		return (cmp);
+
+	return (TREE_CMP(at1->at_objset, at2->at_objset));
+}
+
+static arc_tenant_t *
+arc_tenant_find(uint64_t spa, uint64_t objset)
+{
+	arc_tenant_t search;
+
+	ASSERT(RW_LOCK_HELD(&arc_tenant_lock));
+
+	search.at_spa = spa;
+	search.at_objset = objset;
+	return (avl_find(&arc_tenant_tree, &search, NULL));
+}
+
+static void
+arc_tenant_free(arc_tenant_t *at)
+{
+	ASSERT(RW_WRITE_HELD(&arc_tenant_lock));
+	ASSERT(!at->at_registered);
+	ASSERT0(at->at_size);
+
+	arc_tenants[at->at_index] = NULL;
+	wmsum_fini(&at->at_mru_ghost_hits);
+	wmsum_fini(&at->at_mfu_ghost_hits);
+	wmsum_fini(&at->at_quota_uncached);
+	wmsum_fini(&at->at_reserve_skip);
+	kmem_free(at, sizeof (arc_tenant_t));
+}
+
+/*
+ * Return the tenant a header was charged to, or NULL if it is gone.
+ */
+static arc_tenant_t *
+arc_tenant_get(arc_buf_hdr_t *hdr)
+{
+	ASSERT(RW_LOCK_HELD(&arc_tenant_lock));
+
+	arc_tenant_t *at = arc_tenants[hdr->b_l1hdr.b_tenant];
+	if (at == NULL || at->at_gen != hdr->b_l1hdr.b_tenant_gen)
+		return (NULL);
+	return (at);
+}
+
+static inline boolean_t
+arc_tenant_resident(const arc_state_t *state)
+{
+	return (state == arc_mru || state == arc_mfu);
+}
+
+/*
+ * Charge a header that is not currently resident to the tenant owning the
+ * block described by zb, if any.  Returns B_TRUE if that tenant is over
+ * its quota, in which case the caller should not cache the buffer.
+ */
+static boolean_t
+arc_tenant_assign(arc_buf_hdr_t *hdr, const zbookmark_phys_t *zb)
+{
+	boolean_t over = B_FALSE;
+
+	ASSERT(HDR_HAS_L1HDR(hdr));
+	ASSERT(!arc_tenant_resident(hdr->b_l1hdr.b_state));
+
+	hdr->b_l1hdr.b_tenant = 0;
+	if (atomic_load_64(&arc_tenant_count) == 0 || zb == NULL)
+		return (B_FALSE);
+
+	rw_enter(&arc_tenant_lock, RW_READER);
+	arc_tenant_t *at = arc_tenant_find(hdr->b_spa, zb->zb_objset);
+	if (at != NULL) {
+		hdr->b_l1hdr.b_tenant = at->at_index;
+		hdr->b_l1hdr.b_tenant_gen = at->at_gen;
+		if (at->at_quota != 0 &&
+		    atomic_load_64(&at->at_size) >= at->at_quota) {
+			wmsum_add(&at->at_quota_uncached, 1);
+			over = B_TRUE;
+		}
+	}
+	rw_exit(&arc_tenant_lock);
+
+	return (over);
+}
+
+/*
+ * Called from arc_change_state() to keep the tenant's resident size in
+ * step with the header moving into or out of the MRU and MFU states.
+ */
+static void
+arc_tenant_account(arc_buf_hdr_t *hdr, arc_state_t *old_state,
+    arc_state_t *new_state)
+{
+	boolean_t was = arc_tenant_resident(old_state);
+	boolean_t is = arc_tenant_resident(new_state);
+
+	if (was == is || hdr->b_l1hdr.b_tenant == 0)
+		return;
+
+	rw_enter(&arc_tenant_lock, RW_READER);
+	arc_tenant_t *at = arc_tenant_get(hdr);
+	if (at != NULL) {
+		atomic_add_64(&at->at_size, is ? HDR_GET_LSIZE(hdr) :
+		    -HDR_GET_LSIZE(hdr));
+	}
+	rw_exit(&arc_tenant_lock);
+}
+
+static void
+arc_tenant_ghost_hit(arc_buf_hdr_t *hdr, boolean_t mfu)
+{
+	if (hdr->b_l1hdr.b_tenant == 0)
+		return;
+
+	rw_enter(&arc_tenant_lock, RW_READER);
+	arc_tenant_t *at = arc_tenant_get(hdr);
+	if (at != NULL) {
+		wmsum_add(mfu ? &at->at_mfu_ghost_hits :
+		    &at->at_mru_ghost_hits, 1);
+	}
+	rw_exit(&arc_tenant_lock);
+}
+
+/*
+ * Returns B_TRUE if evicting this header would take its tenant below its
+ * primarycache_reserve.
+ */
+static boolean_t
+arc_tenant_reserved(arc_buf_hdr_t *hdr)
+{
+	boolean_t reserved = B_FALSE;
+
+	if (hdr->b_l1hdr.b_tenant == 0 ||
+	    atomic_load_64(&arc_tenant_reserve_total) > arc_c / 2)
+		return (B_FALSE);
+
+	rw_enter(&arc_tenant_lock, RW_READER);
+	arc_tenant_t *at = arc_tenant_get(hdr);
+	if (at != NULL && at->at_reserve != 0 &&
+	    atomic_load_64(&at->at_size) <= at->at_reserve) {
+		wmsum_add(&at->at_reserve_skip, 1);
+		reserved = B_TRUE;
+	}
+	rw_exit(&arc_tenant_lock);
+
+	return (reserved);
+}
+
+/*
+ * Set the primarycache_quota and primarycache_reserve of a dataset.  A
+ * dataset with neither is unregistered; this is also how a dataset is
+ * removed when its objset is evicted.
+ */
+void
+arc_tenant_set(spa_t *spa, uint64_t objset, uint64_t quota,
+    uint64_t reserve)
+{
+	uint64_t guid = spa_load_guid(spa);
+
+	rw_enter(&arc_tenant_lock, RW_WRITER);
+	arc_tenant_t *at = arc_tenant_find(guid, objset);
+
+	if (quota == 0 && reserve == 0) {
+		if (at != NULL) {
+			avl_remove(&arc_tenant_tree, at);
+			at->at_registered = B_FALSE;
+			atomic_add_64(&arc_tenant_reserve_total,
+			    -at->at_reserve);
+			at->at_quota = 0;
+			at->at_reserve = 0;
+			atomic_dec_64(&arc_tenant_count);
+			if (atomic_load_64(&at->at_size) == 0)
+				arc_tenant_free(at);
+		}
+		rw_exit(&arc_tenant_lock);
+		return;
+	}
+
+	if (at == NULL) {
+		uint16_t index = 0;
+
+		/*
+		 * Find a free slot, reclaiming those of unregistered
+		 * tenants whose buffers have all left the cache.
+		 */
+		for (int i = 1; i < ARC_TENANTS_MAX; i++) {
+			arc_tenant_t *old = arc_tenants[i];
+			if (old != NULL && !old->at_registered &&
+			    atomic_load_64(&old->at_size) == 0)
+				arc_tenant_free(old);
+			if (index == 0 && arc_tenants[i] == NULL)
+				index = i;
+		}
+		if (index == 0) {
+			rw_exit(&arc_tenant_lock);
+			zfs_dbgmsg("arc: no tenant slot for objset %llu, "
+			    "primarycache_quota and primarycache_reserve "
+			    "will not be enforced",
+			    (u_longlong_t)objset);
+			return;
+		}
+
+		at = kmem_zalloc(sizeof (arc_tenant_t), KM_SLEEP);
+		at->at_spa = guid;
+		at->at_objset = objset;
+		at->at_index = index;
+		at->at_gen = ++arc_tenant_gen;
+		at->at_registered = B_TRUE;
+		wmsum_init(&at->at_mru_ghost_hits, 0);
+		wmsum_init(&at->at_mfu_ghost_hits, 0);
+		wmsum_init(&at->at_quota_uncached, 0);
+		wmsum_init(&at->at_reserve_skip, 0);
+		avl_add(&arc_tenant_tree, at);
+		arc_tenants[index] = at;
+		atomic_inc_64(&arc_tenant_count);
+	}
+
+	atomic_add_64(&arc_tenant_reserve_total, reserve - at->at_reserve);
+	at->at_quota = quota;
+	at->at_reserve = reserve;
+	rw_exit(&arc_tenant_lock);
+}
+
+/*
+ * Fill in the ARC statistics of a dataset.  Returns B_FALSE if the dataset
+ * has neither a primarycache_quota nor a primarycache_reserve.
+ */
+boolean_t
+arc_tenant_stats(uint64_t load_guid, uint64_t objset,
+    arc_tenant_stats_t *ats)
+{
+	rw_enter(&arc_tenant_lock, RW_READER);
+	arc_tenant_t *at = arc_tenant_find(load_guid, objset);
+	if (at == NULL) {
+		rw_exit(&arc_tenant_lock);
+		memset(ats, 0, sizeof (*ats));
+		return (B_FALSE);
+	}
+
+	ats->ats_size = atomic_load_64(&at->at_size);
+	ats->ats_quota = at->at_quota;
+	ats->ats_reserve = at->at_reserve;
+	ats->ats_mru_ghost_hits = wmsum_value(&at->at_mru_ghost_hits);
+	ats->ats_mfu_ghost_hits = wmsum_value(&at->at_mfu_ghost_hits);
+	ats->ats_quota_uncached = wmsum_value(&at->at_quota_uncached);
+	ats->ats_reserve_skip = wmsum_value(&at->at_reserve_skip);
+	rw_exit(&arc_tenant_lock);
+
+	return (B_TRUE);
+}
+
+static void
+arc_tenant_init(void)
+{
+	rw_init(&arc_tenant_lock, NULL, RW_DEFAULT, NULL);
+	avl_create(&arc_tenant_tree, arc_tenant_compare,
+	    sizeof (arc_tenant_t), offsetof(arc_tenant_t, at_node));
+}
+
+static void
+arc_tenant_fini(void)
+{
+	arc_tenant_t *at;
+	void *cookie = NULL;
+
+	rw_enter(&arc_tenant_lock, RW_WRITER);
+	while ((at = avl_destroy_nodes(&arc_tenant_tree, &cookie)) != NULL)
+		at->at_registered = B_FALSE;
+	for (int i = 1; i < ARC_TENANTS_MAX; i++) {
+		if ((at = arc_tenants[i]) != NULL) {
+			at->at_size = 0;
+			arc_tenant_free(at);
+		}
+	}
+	arc_tenant_count = 0;
+	arc_tenant_reserve_total = 0;
+	rw_exit(&arc_tenant_lock);
+
+	avl_destroy(&arc_tenant_tree);
+	rw_destroy(&arc_tenant_lock);
+}
+
 /*
  * "Read" the block at the specified DVA (in bp) via the
  * cache.  If the block is found in the cache, invoke the provided
@@ -6176,6 +6594,18 @@ top:
 				goto top;
 			}
 		}
+		/*
+		 * Charge the header to its dataset unless it is already
+		 * cached (e.g. we are only after its raw encrypted data).
+		 * New blocks of a dataset over its primarycache_quota are
+		 * not cached.
+		 */
+		if (!embedded_bp &&
+		    !arc_tenant_resident(hdr->b_l1hdr.b_state) &&
+		    arc_tenant_assign(hdr, zb) &&
+		    hdr->b_l1hdr.b_state == arc_anon)
+			*arc_flags |= ARC_FLAG_UNCACHED;
+
 		if (*arc_flags & ARC_FLAG_UNCACHED) {
 			arc_hdr_set_flags(hdr, ARC_FLAG_UNCACHED);
 			if (!encrypted_read)
@@ -7046,6 +7476,8 @@ arc_write(zio_t *pio, spa_t *spa, uint64_t txg,
 	ASSERT(!HDR_IO_IN_PROGRESS(hdr));
 	ASSERT0P(hdr->b_l1hdr.b_acb);
 	ASSERT3P(hdr->b_l1hdr.b_buf, !=, NULL);
+	if (arc_tenant_assign(hdr, zb))
+		uncached = B_TRUE;
 	if (uncached)
 		arc_hdr_set_flags(hdr, ARC_FLAG_UNCACHED);
 	else if (l2arc)
@@ -7288,6 +7720,8 @@ arc_kstat_update(kstat_t *ksp, int rw)
 	    wmsum_value(&arc_sums.arcstat_access_skip);
 	as->arcstat_evict_skip.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_evict_skip);
+	as->arcstat_evict_reserve_skip.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_evict_reserve_skip);
 	as->arcstat_evict_not_enough.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_evict_not_enough);
 	as->arcstat_evict_l2_cached.value.ui64 =
@@ -7309,6 +7743,8 @@ arc_kstat_update(kstat_t *ksp, int rw)
 	    wmsum_value(&arc_sums.arcstat_hash_collisions);
 	as->arcstat_hash_chains.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_hash_chains);
+	as->arcstat_hash_lockless_misses.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_hash_lockless_misses);
 	as->arcstat_size.value.ui64 =
 	    aggsum_value(&arc_sums.arcstat_size);
 	as->arcstat_compressed_size.value.ui64 =
@@ -7413,6 +7849,10 @@ arc_kstat_update(kstat_t *ksp, int rw)
 	    wmsum_value(&arc_sums.arcstat_l2_free_on_write);
 	as->arcstat_l2_abort_lowmem.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_l2_abort_lowmem);
+	as->arcstat_l2_admitted.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_l2_admitted);
+	as->arcstat_l2_rejected.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_l2_rejected);
 	as->arcstat_l2_cksum_bad.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_l2_cksum_bad);
 	as->arcstat_l2_io_error.value.ui64 =
@@ -7722,6 +8162,7 @@ arc_state_init(void)
 	wmsum_init(&arc_sums.arcstat_mutex_miss, 0);
 	wmsum_init(&arc_sums.arcstat_access_skip, 0);
 	wmsum_init(&arc_sums.arcstat_evict_skip, 0);
+	wmsum_init(&arc_sums.arcstat_evict_reserve_skip, 0);
 	wmsum_init(&arc_sums.arcstat_evict_not_enough, 0);
 	wmsum_init(&arc_sums.arcstat_evict_l2_cached, 0);
 	wmsum_init(&arc_sums.arcstat_evict_l2_eligible, 0);
@@ -7732,6 +8173,7 @@ arc_state_init(void)
 	wmsum_init(&arc_sums.arcstat_hash_elements, 0);
 	wmsum_init(&arc_sums.arcstat_hash_collisions, 0);
 	wmsum_init(&arc_sums.arcstat_hash_chains, 0);
+	wmsum_init(&arc_sums.arcstat_hash_lockless_misses, 0);
 	aggsum_init(&arc_sums.arcstat_size, 0);
 	wmsum_init(&arc_sums.arcstat_compressed_size, 0);
 	wmsum_init(&arc_sums.arcstat_uncompressed_size, 0);
@@ -7762,6 +8204,8 @@ arc_state_init(void)
 	wmsum_init(&arc_sums.arcstat_l2_evict_l1cached, 0);
 	wmsum_init(&arc_sums.arcstat_l2_free_on_write, 0);
 	wmsum_init(&arc_sums.arcstat_l2_abort_lowmem, 0);
+	wmsum_init(&arc_sums.arcstat_l2_admitted, 0);
+	wmsum_init(&arc_sums.arcstat_l2_rejected, 0);
 	wmsum_init(&arc_sums.arcstat_l2_cksum_bad, 0);
 	wmsum_init(&arc_sums.arcstat_l2_io_error, 0);
 	wmsum_init(&arc_sums.arcstat_l2_lsize, 0);
@@ -7881,6 +8325,7 @@ arc_state_fini(void)
 	wmsum_fini(&arc_sums.arcstat_mutex_miss);
 	wmsum_fini(&arc_sums.arcstat_access_skip);
 	wmsum_fini(&arc_sums.arcstat_evict_skip);
+	wmsum_fini(&arc_sums.arcstat_evict_reserve_skip);
 	wmsum_fini(&arc_sums.arcstat_evict_not_enough);
 	wmsum_fini(&arc_sums.arcstat_evict_l2_cached);
 	wmsum_fini(&arc_sums.arcstat_evict_l2_eligible);
@@ -7891,6 +8336,7 @@ arc_state_fini(void)
 	wmsum_fini(&arc_sums.arcstat_hash_elements);
 	wmsum_fini(&arc_sums.arcstat_hash_collisions);
 	wmsum_fini(&arc_sums.arcstat_hash_chains);
+	wmsum_fini(&arc_sums.arcstat_hash_lockless_misses);
 	aggsum_fini(&arc_sums.arcstat_size);
 	wmsum_fini(&arc_sums.arcstat_compressed_size);
 	wmsum_fini(&arc_sums.arcstat_uncompressed_size);
@@ -7921,6 +8367,8 @@ arc_state_fini(void)
 	wmsum_fini(&arc_sums.arcstat_l2_evict_l1cached);
 	wmsum_fini(&arc_sums.arcstat_l2_free_on_write);
 	wmsum_fini(&arc_sums.arcstat_l2_abort_lowmem);
+	wmsum_fini(&arc_sums.arcstat_l2_admitted);
+	wmsum_fini(&arc_sums.arcstat_l2_rejected);
 	wmsum_fini(&arc_sums.arcstat_l2_cksum_bad);
 	wmsum_fini(&arc_sums.arcstat_l2_io_error);
 	wmsum_fini(&arc_sums.arcstat_l2_lsize);
@@ -8043,6 +8491,8 @@ arc_init(void)
 
 	buf_init();
 
+	arc_tenant_init();
+
 	list_create(&arc_prune_list, sizeof (arc_prune_t),
 	    offsetof(arc_prune_t, p_node));
 	mutex_init(&arc_prune_mtx, NULL, MUTEX_DEFAULT, NULL);
@@ -8181,6 +8631,7 @@ arc_fini(void)
 	 * trigger the release of kmem magazines, which can callback to
 	 * arc_space_return() which accesses aggsums freed in act_state_fini().
 	 */
+	arc_tenant_fini();
 	buf_fini();
 	arc_state_fini();
 
@@ -8259,7 +8710,10 @@ arc_fini(void)
  * sure we adapt to compression effects (which might significantly reduce
  * the data volume we write to L2ARC). The thread that does this is
  * l2arc_feed_thread(), illustrated below; example sizes are included to
- * provide a better sense of ratio than this diagram:
+ * provide a better sense of ratio than this diagram.  With several cache
+ * devices the thread dispatches one l2arc_feed_dev() task per device to
+ * l2arc_feed_taskq, and each task scans its own subset of the ARC sublists,
+ * so the devices are filled in parallel:
  *
  *	       head -->                        tail
  *	        +---------------------+----------+
@@ -8456,6 +8910,102 @@ l2arc_write_eligible(uint64_t spa_guid, arc_buf_hdr_t *hdr)
 	return (B_TRUE);
 }
 
+/*
+ * TinyLFU-style admission.  Every ARC access is recorded in a count-min
+ * sketch of L2ARC_ADMIT_DEPTH rows of small saturating counters, indexed
+ * by the buffer's identity hash.  The smallest of a buffer's counters is
+ * an upper bound on the number of times it was referenced, and buffers
+ * referenced fewer than l2arc_admit_min_refs times (typically one-shot
+ * streaming data) are not written to the L2ARC.  The counters saturate,
+ * so l2arc_admit_min_refs is capped at L2ARC_ADMIT_CTR_MAX.  All counters
+ * are halved once the number of recorded accesses reaches
+ * L2ARC_ADMIT_AGE_MULT times the row width, so that past popularity fades
+ * over time.
+ *
+ * Updates are not atomic; a lost increment only makes the estimate a
+ * little lower, which is harmless for an admission heuristic.
+ */
+#define	L2ARC_ADMIT_DEPTH	4
+#define	L2ARC_ADMIT_CTR_MAX	15
+#define	L2ARC_ADMIT_AGE_MULT	10
+
+typedef struct l2arc_admit_sketch {
+	uint8_t		*las_ctrs;	/* L2ARC_ADMIT_DEPTH rows */
+	uint64_t	las_width;	/* counters per row */
+	uint64_t	las_adds;	/* accesses since last aging */
+} l2arc_admit_sketch_t;
+
+static l2arc_admit_sketch_t l2arc_admit_sketch;
+
+static inline uint8_t *
+l2arc_admit_ctr(uint64_t hash, int row)
+{
+	l2arc_admit_sketch_t *las = &l2arc_admit_sketch;
+	uint64_t h1 = hash & UINT32_MAX, h2 = hash >> 32;
+
+	return (&las->las_ctrs[row * las->las_width +
+	    ((h1 + row * h2) & (las->las_width - 1))]);
+}
+
+static void
+l2arc_admit_record(const arc_buf_hdr_t *hdr)
+{
+	uint64_t hash = buf_hash(hdr->b_spa, &hdr->b_dva, hdr->b_birth);
+
+	for (int row = 0; row < L2ARC_ADMIT_DEPTH; row++) {
+		uint8_t *ctr = l2arc_admit_ctr(hash, row);
+		if (*ctr < L2ARC_ADMIT_CTR_MAX)
+			(*ctr)++;
+	}
+	atomic_inc_64(&l2arc_admit_sketch.las_adds);
+}
+
+static uint_t
+l2arc_admit_estimate(const arc_buf_hdr_t *hdr)
+{
+	uint64_t hash = buf_hash(hdr->b_spa, &hdr->b_dva, hdr->b_birth);
+	uint_t est = L2ARC_ADMIT_CTR_MAX;
+
+	for (int row = 0; row < L2ARC_ADMIT_DEPTH; row++)
+		est = MIN(est, *l2arc_admit_ctr(hash, row));
+	return (est);
+}
+
+/*
+ * Halve all counters of the sketch once enough accesses were recorded.
+ * Called from the feed thread, so arc_access() never pays for it.
+ */
+static void
+l2arc_admit_age(void)
+{
+	l2arc_admit_sketch_t *las = &l2arc_admit_sketch;
+	uint64_t period = las->las_width * L2ARC_ADMIT_AGE_MULT;
+
+	if (las->las_adds < period)
+		return;
+
+	for (uint64_t i = 0; i < las->las_width * L2ARC_ADMIT_DEPTH; i++)
+		las->las_ctrs[i] >>= 1;
+	atomic_add_64(&las->las_adds, -period);
+}
+
+/*
+ * Decide whether an eligible buffer is admitted to the L2ARC under the
+ * current l2arc_admit_policy.
+ */
+static boolean_t
+l2arc_admit(const arc_buf_hdr_t *hdr)
+{
+	switch (l2arc_admit_policy) {
+	case L2ARC_ADMIT_TINYLFU:
+		return (l2arc_admit_estimate(hdr) >=
+		    MIN(l2arc_admit_min_refs, L2ARC_ADMIT_CTR_MAX));
+	case L2ARC_ADMIT_ALL:
+	default:
+		return (B_TRUE);
+	}
+}
+
 static uint64_t
 l2arc_write_size(l2arc_dev_t *dev)
 {
@@ -8533,68 +9083,6 @@ l2arc_dev_invalid(const l2arc_dev_t *dev)
 	    dev->l2ad_spa == NULL || dev->l2ad_spa->spa_is_exporting);
 }
 
-/*
- * Cycle through L2ARC devices.  This is how L2ARC load balances.
- * If a device is returned, this also returns holding the spa config lock.
- */
-static l2arc_dev_t *
-l2arc_dev_get_next(void)
-{
-	l2arc_dev_t *first, *next = NULL;
-
-	/*
-	 * Lock out the removal of spas (spa_namespace_lock), then removal
-	 * of cache devices (l2arc_dev_mtx).  Once a device has been selected,
-	 * both locks will be dropped and a spa config lock held instead.
-	 */
-	mutex_enter(&spa_namespace_lock);
-	mutex_enter(&l2arc_dev_mtx);
-
-	/* if there are no vdevs, there is nothing to do */
-	if (l2arc_ndev == 0)
-		goto out;
-
-	first = NULL;
-	next = l2arc_dev_last;
-	do {
-		/* loop around the list looking for a non-faulted vdev */
-		if (next == NULL) {
-			next = list_head(l2arc_dev_list);
-		} else {
-			next = list_next(l2arc_dev_list, next);
-			if (next == NULL)
-				next = list_head(l2arc_dev_list);
-		}
-
-		/* if we have come back to the start, bail out */
-		if (first == NULL)
-			first = next;
-		else if (next == first)
-			break;
-
-		ASSERT3P(next, !=, NULL);
-	} while (l2arc_dev_invalid(next));
-
-	/* if we were unable to find any usable vdevs, return NULL */
-	if (l2arc_dev_invalid(next))
-		next = NULL;
-
-	l2arc_dev_last = next;
-
-out:
-	mutex_exit(&l2arc_dev_mtx);
-
-	/*
-	 * Grab the config lock to prevent the 'next' device from being
-	 * removed while we are writing to it.
-	 */
-	if (next != NULL)
-		spa_config_enter(next->l2ad_spa, SCL_L2ARC, next, RW_READER);
-	mutex_exit(&spa_namespace_lock);
-
-	return (next);
-}
-
 /*
  * Free buffers that were tagged for destruction.
  */
@@ -9043,10 +9531,10 @@ l2arc_read_done(zio_t *zio)
  * the lock pointer.
  */
 static multilist_sublist_t *
-l2arc_sublist_lock(int list_num)
+l2arc_sublist_lock(const l2arc_dev_t *dev, int list_num)
 {
 	multilist_t *ml = NULL;
-	unsigned int idx;
+	unsigned int idx, nsub, slot, nslots;
 
 	ASSERT(list_num >= 0 && list_num < L2ARC_FEED_TYPES);
 
@@ -9071,9 +9559,20 @@ l2arc_sublist_lock(int list_num)
 	 * Return a randomly-selected sublist. This is acceptable
 	 * because the caller feeds only a little bit of data for each
 	 * call (8MB). Subsequent calls will result in different
-	 * sublists being selected.
-	 */
-	idx = multilist_get_random_index(ml);
+	 * sublists being selected.  When several devices are fed in
+	 * parallel each one picks from its own residue class of sublist
+	 * indices, so that they do not compete for the same buffers.
+	 */
+	nsub = multilist_get_num_sublists(ml);
+	slot = dev->l2ad_feed_slot;
+	nslots = dev->l2ad_feed_nslots;
+	if (nslots <= 1 || nslots > nsub) {
+		idx = multilist_get_random_index(ml);
+	} else {
+		ASSERT3U(slot, <, nslots);
+		idx = slot + nslots *
+		    random_in_range((nsub - slot + nslots - 1) / nslots);
+	}
 	return (multilist_sublist_lock_idx(ml, idx));
 }
 
@@ -9516,7 +10015,7 @@ l2arc_write_buffers(spa_t *spa, l2arc_dev_t *dev, uint64_t target_sz)
 		 * Until the ARC is warm and starts to evict, read from the
 		 * head of the ARC lists rather than the tail.
 		 */
-		multilist_sublist_t *mls = l2arc_sublist_lock(pass);
+		multilist_sublist_t *mls = l2arc_sublist_lock(dev, pass);
 		ASSERT3P(mls, !=, NULL);
 		if (from_head)
 			hdr = multilist_sublist_head(mls);
@@ -9552,6 +10051,12 @@ skip:
 				goto skip;
 			}
 
+			if (!l2arc_admit(hdr)) {
+				ARCSTAT_BUMP(arcstat_l2_rejected);
+				mutex_exit(hash_lock);
+				goto skip;
+			}
+
 			ASSERT(HDR_HAS_L1HDR(hdr));
 			ASSERT3U(HDR_GET_PSIZE(hdr), >, 0);
 			ASSERT3U(arc_hdr_size(hdr), >, 0);
@@ -9679,6 +10184,7 @@ skip:
 			write_psize += psize;
 			write_asize += asize;
 			dev->l2ad_hand += asize;
+			ARCSTAT_BUMP(arcstat_l2_admitted);
 
 			if (commit) {
 				/* l2ad_hand will be adjusted inside. */
@@ -9725,6 +10231,8 @@ next:
 	ASSERT3U(write_asize, <=, target_sz);
 	ARCSTAT_BUMP(arcstat_l2_writes_sent);
 	ARCSTAT_INCR(arcstat_l2_write_bytes, write_psize);
+	dev->l2ad_feed_stats.writes_sent.value.ui64++;
+	dev->l2ad_feed_stats.write_bytes.value.ui64 += write_psize;
 
 	dev->l2ad_writing = B_TRUE;
 	(void) zio_wait(pio);
@@ -9750,78 +10258,37 @@ l2arc_hdr_limit_reached(void)
 }
 
 /*
- * This thread feeds the L2ARC at regular intervals.  This is the beating
- * heart of the L2ARC.
+ * Feed a single L2ARC device.  Dispatched by l2arc_feed_thread() with the
+ * spa's SCL_L2ARC config lock held as reader on behalf of the device, which
+ * keeps the device from being removed until the lock is dropped here.
  */
-static  __attribute__((noreturn)) void
-l2arc_feed_thread(void *unused)
+static void
+l2arc_feed_dev(void *arg)
 {
-	(void) unused;
-	callb_cpr_t cpr;
-	l2arc_dev_t *dev;
-	spa_t *spa;
+	l2arc_dev_t *dev = arg;
+	spa_t *spa = dev->l2ad_spa;
+	l2arc_feed_stats_t *lfs = &dev->l2ad_feed_stats;
+	clock_t begin = ddi_get_lbolt();
+	clock_t next = begin + hz;
+	hrtime_t start = gethrtime();
 	uint64_t size, wrote;
-	clock_t begin, next = ddi_get_lbolt();
 	fstrans_cookie_t cookie;
 
-	CALLB_CPR_INIT(&cpr, &l2arc_feed_thr_lock, callb_generic_cpr, FTAG);
-
-	mutex_enter(&l2arc_feed_thr_lock);
+	ASSERT3P(spa, !=, NULL);
 
 	cookie = spl_fstrans_mark();
-	while (l2arc_thread_exit == 0) {
-		CALLB_CPR_SAFE_BEGIN(&cpr);
-		(void) cv_timedwait_idle(&l2arc_feed_thr_cv,
-		    &l2arc_feed_thr_lock, next);
-		CALLB_CPR_SAFE_END(&cpr, &l2arc_feed_thr_lock);
-		next = ddi_get_lbolt() + hz;
-
+	if (!spa_writeable(spa)) {
 		/*
-		 * Quick check for L2ARC devices.
+		 * If the pool is read-only then force the feed to sleep a
+		 * little longer.
 		 */
-		mutex_enter(&l2arc_dev_mtx);
-		if (l2arc_ndev == 0) {
-			mutex_exit(&l2arc_dev_mtx);
-			continue;
-		}
-		mutex_exit(&l2arc_dev_mtx);
-		begin = ddi_get_lbolt();
-
-		/*
-		 * This selects the next l2arc device to write to, and in
-		 * doing so the next spa to feed from: dev->l2ad_spa.   This
-		 * will return NULL if there are now no l2arc devices or if
-		 * they are all faulted.
-		 *
-		 * If a device is returned, its spa's config lock is also
-		 * held to prevent device removal.  l2arc_dev_get_next()
-		 * will grab and release l2arc_dev_mtx.
-		 */
-		if ((dev = l2arc_dev_get_next()) == NULL)
-			continue;
-
-		spa = dev->l2ad_spa;
-		ASSERT3P(spa, !=, NULL);
-
-		/*
-		 * If the pool is read-only then force the feed thread to
-		 * sleep a little longer.
-		 */
-		if (!spa_writeable(spa)) {
-			next = ddi_get_lbolt() + 5 * l2arc_feed_secs * hz;
-			spa_config_exit(spa, SCL_L2ARC, dev);
-			continue;
-		}
-
+		next = begin + 5 * l2arc_feed_secs * hz;
+	} else if (l2arc_hdr_limit_reached()) {
 		/*
 		 * Avoid contributing to memory pressure.
 		 */
-		if (l2arc_hdr_limit_reached()) {
-			ARCSTAT_BUMP(arcstat_l2_abort_lowmem);
-			spa_config_exit(spa, SCL_L2ARC, dev);
-			continue;
-		}
-
+		ARCSTAT_BUMP(arcstat_l2_abort_lowmem);
+	} else {
 		ARCSTAT_BUMP(arcstat_l2_feeds);
 
 		size = l2arc_write_size(dev);
@@ -9840,10 +10307,135 @@ l2arc_feed_thread(void *unused)
 		 * Calculate interval between writes.
 		 */
 		next = l2arc_write_interval(begin, size, wrote);
-		spa_config_exit(spa, SCL_L2ARC, dev);
+
+		lfs->feeds.value.ui64++;
+		lfs->write_asize.value.ui64 += wrote;
+		lfs->feed_time_us.value.ui64 += NSEC2USEC(gethrtime() - start);
+		if (dev->l2ad_feed_last != 0 && begin > dev->l2ad_feed_last) {
+			lfs->write_rate.value.ui64 = wrote * hz /
+			    (begin - dev->l2ad_feed_last);
+		}
+		dev->l2ad_feed_last = begin;
 	}
 	spl_fstrans_unmark(cookie);
 
+	mutex_enter(&l2arc_dev_mtx);
+	dev->l2ad_feed_next = next;
+	dev->l2ad_feeding = B_FALSE;
+	mutex_exit(&l2arc_dev_mtx);
+
+	/* The device may be removed as soon as the lock is dropped. */
+	spa_config_exit(spa, SCL_L2ARC, dev);
+
+	mutex_enter(&l2arc_feed_thr_lock);
+	cv_signal(&l2arc_feed_thr_cv);
+	mutex_exit(&l2arc_feed_thr_lock);
+}
+
+/*
+ * Pick the next L2ARC device that is due to be fed and mark it as being
+ * fed.  If a device is returned, this also returns holding the spa config
+ * lock on its behalf.  *nextp is lowered to the earliest time at which an
+ * idle device is due.
+ */
+static l2arc_dev_t *
+l2arc_dev_get_due(clock_t *nextp)
+{
+	l2arc_dev_t *dev, *due = NULL;
+	clock_t now = ddi_get_lbolt();
+	uint_t slot = 0, nslots = 0;
+
+	/*
+	 * Lock out the removal of spas (spa_namespace_lock), then removal
+	 * of cache devices (l2arc_dev_mtx).  Once a device has been selected,
+	 * both locks will be dropped and a spa config lock held instead.
+	 */
+	mutex_enter(&spa_namespace_lock);
+	mutex_enter(&l2arc_dev_mtx);
+	for (dev = list_head(l2arc_dev_list); dev != NULL;
+	    dev = list_next(l2arc_dev_list, dev)) {
+		if (l2arc_dev_invalid(dev))
+			continue;
+
+		if (due == NULL && !dev->l2ad_feeding) {
+			if (dev->l2ad_feed_next <= now) {
+				due = dev;
+				slot = nslots;
+			} else if (dev->l2ad_feed_next < *nextp) {
+				*nextp = dev->l2ad_feed_next;
+			}
+		}
+		nslots++;
+	}
+
+	if (due != NULL) {
+		due->l2ad_feeding = B_TRUE;
+		due->l2ad_feed_slot = slot;
+		due->l2ad_feed_nslots = nslots;
+	}
+	mutex_exit(&l2arc_dev_mtx);
+
+	/*
+	 * Grab the config lock to prevent the device from being removed
+	 * while we are writing to it.
+	 */
+	if (due != NULL)
+		spa_config_enter(due->l2ad_spa, SCL_L2ARC, due, RW_READER);
+	mutex_exit(&spa_namespace_lock);
+
+	return (due);
+}
+
+/*
+ * This thread feeds the L2ARC at regular intervals.  This is the beating
+ * heart of the L2ARC.  Every device that is due is handed to its own
+ * l2arc_feed_dev() task, so that several cache devices are written in
+ * parallel, each on its own schedule.
+ */
+static  __attribute__((noreturn)) void
+l2arc_feed_thread(void *unused)
+{
+	(void) unused;
+	callb_cpr_t cpr;
+	l2arc_dev_t *dev;
+	clock_t next = ddi_get_lbolt();
+
+	CALLB_CPR_INIT(&cpr, &l2arc_feed_thr_lock, callb_generic_cpr, FTAG);
+
+	mutex_enter(&l2arc_feed_thr_lock);
+
+	while (l2arc_thread_exit == 0) {
+		CALLB_CPR_SAFE_BEGIN(&cpr);
+		(void) cv_timedwait_idle(&l2arc_feed_thr_cv,
+		    &l2arc_feed_thr_lock, next);
+		CALLB_CPR_SAFE_END(&cpr, &l2arc_feed_thr_lock);
+		next = ddi_get_lbolt() + hz;
+
+		/*
+		 * Quick check for L2ARC devices.
+		 */
+		if (l2arc_ndev == 0 || l2arc_thread_exit != 0)
+			continue;
+
+		l2arc_admit_age();
+
+		/*
+		 * This selects the next l2arc device to write to, and in
+		 * doing so the next spa to feed from: dev->l2ad_spa.  It
+		 * returns NULL once no idle device is due, or if there
+		 * are no usable l2arc devices.
+		 */
+		while ((dev = l2arc_dev_get_due(&next)) != NULL) {
+			(void) taskq_dispatch(l2arc_feed_taskq,
+			    l2arc_feed_dev, dev, TQ_SLEEP);
+		}
+	}
+
+	/* Wait for the outstanding feeds, which signal us on completion. */
+	mutex_exit(&l2arc_feed_thr_lock);
+	taskq_wait(l2arc_feed_taskq);
+	mutex_enter(&l2arc_feed_thr_lock);
+
 	l2arc_thread_exit = 0;
 	cv_broadcast(&l2arc_feed_thr_cv);
 	CALLB_CPR_EXIT(&cpr);		/* drops l2arc_feed_thr_lock */
@@ -9956,6 +10548,38 @@ l2arc_rebuild_dev(l2arc_dev_t *dev, boolean_t reopen)
 	}
 }
 
+static const l2arc_feed_stats_t l2arc_feed_stats_template = {
+	{ "feeds",		KSTAT_DATA_UINT64 },
+	{ "writes_sent",	KSTAT_DATA_UINT64 },
+	{ "write_bytes",	KSTAT_DATA_UINT64 },
+	{ "write_asize",	KSTAT_DATA_UINT64 },
+	{ "feed_time_us",	KSTAT_DATA_UINT64 },
+	{ "write_rate",		KSTAT_DATA_UINT64 },
+};
+
+static void
+l2arc_feed_kstat_init(l2arc_dev_t *dev)
+{
+	spa_t *spa = dev->l2ad_spa;
+	kstat_t *ksp;
+
+	dev->l2ad_feed_stats = l2arc_feed_stats_template;
+
+	char *module = kmem_asprintf("zfs/%s", spa_name(spa));
+	char *name = kmem_asprintf("l2arc_feed-0x%llx",
+	    (u_longlong_t)dev->l2ad_vdev->vdev_guid);
+	ksp = kstat_create(module, 0, name, "misc", KSTAT_TYPE_NAMED,
+	    sizeof (l2arc_feed_stats_t) / sizeof (kstat_named_t),
+	    KSTAT_FLAG_VIRTUAL);
+	if (ksp != NULL) {
+		ksp->ks_data = &dev->l2ad_feed_stats;
+		kstat_install(ksp);
+	}
+	dev->l2ad_feed_ksp = ksp;
+	kmem_strfree(name);
+	kmem_strfree(module);
+}
+
 /*
  * Add a vdev for use by the L2ARC.  By this point the spa has already
  * validated the vdev and opened it.
@@ -10008,6 +10632,10 @@ l2arc_add_vdev(spa_t *spa, vdev_t *vd)
 	zfs_refcount_create(&adddev->l2ad_lb_asize);
 	zfs_refcount_create(&adddev->l2ad_lb_count);
 
+	adddev->l2ad_feeding = B_FALSE;
+	adddev->l2ad_feed_next = ddi_get_lbolt();
+	l2arc_feed_kstat_init(adddev);
+
 	/*
 	 * Decide if dev is eligible for L2ARC rebuild or whole device
 	 * trimming. This has to happen before the device is added in the
@@ -10135,13 +10763,17 @@ l2arc_remove_vdev(vdev_t *vd)
 	mutex_exit(&l2arc_rebuild_thr_lock);
 	rva->rva_async = asynchronous;
 
+	if (remdev->l2ad_feed_ksp != NULL) {
+		kstat_delete(remdev->l2ad_feed_ksp);
+		remdev->l2ad_feed_ksp = NULL;
+	}
+
 	/*
 	 * Remove device from global list
 	 */
 	ASSERT(spa_config_held(spa, SCL_L2ARC, RW_WRITER) & SCL_L2ARC);
 	mutex_enter(&l2arc_dev_mtx);
 	list_remove(l2arc_dev_list, remdev);
-	l2arc_dev_last = NULL;		/* may have been invalidated */
 	atomic_dec_64(&l2arc_ndev);
 
 	/* During a pool export spa & vdev will no longer be valid */
@@ -10181,6 +10813,12 @@ l2arc_init(void)
 	    offsetof(l2arc_dev_t, l2ad_node));
 	list_create(l2arc_free_on_write, sizeof (l2arc_data_free_t),
 	    offsetof(l2arc_data_free_t, l2df_list_node));
+
+	l2arc_admit_sketch_shift = MIN(MAX(l2arc_admit_sketch_shift, 10), 24);
+	l2arc_admit_sketch.las_width = 1ULL << l2arc_admit_sketch_shift;
+	l2arc_admit_sketch.las_adds = 0;
+	l2arc_admit_sketch.las_ctrs = vmem_zalloc(
+	    l2arc_admit_sketch.las_width * L2ARC_ADMIT_DEPTH, KM_SLEEP);
 }
 
 void
@@ -10195,6 +10833,10 @@ l2arc_fini(void)
 
 	list_destroy(l2arc_dev_list);
 	list_destroy(l2arc_free_on_write);
+
+	vmem_free(l2arc_admit_sketch.las_ctrs,
+	    l2arc_admit_sketch.las_width * L2ARC_ADMIT_DEPTH);
+	l2arc_admit_sketch.las_ctrs = NULL;
 }
 
 void
@@ -10203,6 +10845,10 @@ l2arc_start(void)
 	if (!(spa_mode_global & SPA_MODE_WRITE))
 		return;
 
+	l2arc_feed_taskq = taskq_create("l2arc_feed",
+	    l2arc_feed_threads != 0 ? l2arc_feed_threads : boot_ncpus,
+	    defclsyspri, 1, INT_MAX, TASKQ_DYNAMIC);
+
 	(void) thread_create(NULL, 0, l2arc_feed_thread, NULL, 0, &p0,
 	    TS_RUN, defclsyspri);
 }
@@ -10219,6 +10865,9 @@ l2arc_stop(void)
 	while (l2arc_thread_exit != 0)
 		cv_wait(&l2arc_feed_thr_cv, &l2arc_feed_thr_lock);
 	mutex_exit(&l2arc_feed_thr_lock);
+
+	taskq_destroy(l2arc_feed_taskq);
+	l2arc_feed_taskq = NULL;
 }
 
 /*
@@ -11212,6 +11861,9 @@ ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, pc_percent, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, average_blocksize, UINT, ZMOD_RD,
 	"Target average block size");
 
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, hash_lock_shift, UINT, ZMOD_RD,
+	"Set size of ARC hash lock array (log2), 0 to scale with CPUs");
+
 ZFS_MODULE_PARAM(zfs, zfs_, compressed_arc_enabled, INT, ZMOD_RW,
 	"Disable compressed ARC buffers");
 
@@ -11255,6 +11907,18 @@ ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, norw, INT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, meta_percent, UINT, ZMOD_RW,
 	"Percent of ARC size allowed for L2ARC-only headers");
 
+ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, feed_threads, UINT, ZMOD_RD,
+	"Max number of L2ARC devices fed in parallel, 0 for one per CPU");
+
+ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, admit_policy, UINT, ZMOD_RW,
+	"L2ARC admission policy: 0 all eligible buffers, 1 TinyLFU");
+
+ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, admit_min_refs, UINT, ZMOD_RW,
+	"Min estimated references for TinyLFU L2ARC admission");
+
+ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, admit_sketch_shift, UINT, ZMOD_RD,
+	"Log2 of the counters per row of the L2ARC admission sketch");
+
 ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, rebuild_enabled, INT, ZMOD_RW,
 	"Rebuild the L2ARC when importing a pool");
 
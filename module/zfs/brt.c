@@ -40,6 +40,7 @@
 #include <sys/vdev_impl.h>
 #include <sys/kstat.h>
 #include <sys/wmsum.h>
+#include <cityhash.h>
 
 /*
  * Block Cloning design.
@@ -129,6 +130,19 @@
  * is not yet implemented - for now we will update entire array if there was
  * any change.
  *
+ * A single cloned block makes every free within its 16MB region look like it
+ * may need a BRT lookup, so on a pool mixing cloned and uncloned data most of
+ * those lookups miss. To rule them out without a ZAP read, each VDEV also keeps
+ * an in-memory bloom filter over the offsets of its BRT entries. An offset is
+ * added when its entry is created in brt_vdev_addref(), at the same time as
+ * the entry counters array is updated, so the filter never misses an entry
+ * that the array would have found. Bits are never cleared, so the filter is
+ * only reset when the VDEV's BRT is emptied and destroyed. The filter isn't
+ * stored on disk. After import it is rebuilt from the BRT ZAP in syncing
+ * context, brt_bloom_load_txg_max entries per txg, if there are not too many
+ * entries (brt_bloom_load_max); otherwise it is not used until the BRT
+ * empties. Until the rebuild is done, the filter isn't consulted.
+ *
  * The implementation tries to be economic: if BRT is not used, or no longer
  * used, there will be no entries in the MOS and no additional memory used (eg.
  * the entry counters array is only allocated if needed).
@@ -263,9 +277,30 @@ static int brt_zap_prefetch = 1;
 static int brt_zap_default_bs = 12;
 static int brt_zap_default_ibs = 12;
 
+/*
+ * Enable/disable the per-VDEV bloom filter over BRT entries, the most
+ * entries we will read from the BRT ZAP to rebuild it after import, and how
+ * many of them per txg.
+ */
+static int brt_bloom = 1;
+static uint64_t brt_bloom_load_max = 1024 * 1024;
+static uint_t brt_bloom_load_txg_max = 16384;
+
+/* One 64-byte line per key per stage, and 7 bits from 9-bit hashes in it */
+#define	BRT_BLOOM_LINE_WORDS	(8)
+#define	BRT_BLOOM_HASH_BITS	(9)
+#define	BRT_BLOOM_HASH_MASK	((1ULL << BRT_BLOOM_HASH_BITS) - 1)
+#define	BRT_BLOOM_HASHES	(7)
+#define	BRT_BLOOM_BITS_PER_ENTRY	(10)
+
+#define	BRT_BLOOM_STAGE_SIZE(s)	(BRT_BLOOM_STAGE0_SIZE << (s))
+#define	BRT_BLOOM_STAGE_CAPACITY(s)	\
+	(BRT_BLOOM_STAGE_SIZE(s) * NBBY / BRT_BLOOM_BITS_PER_ENTRY)
+
 static kstat_t	*brt_ksp;
 
 typedef struct brt_stats {
+	kstat_named_t brt_addref_bloom_skip;
 	kstat_named_t brt_addref_entry_not_on_disk;
 	kstat_named_t brt_addref_entry_on_disk;
 	kstat_named_t brt_decref_entry_in_memory;
@@ -276,9 +311,11 @@ typedef struct brt_stats {
 	kstat_named_t brt_decref_free_data_later;
 	kstat_named_t brt_decref_free_data_now;
 	kstat_named_t brt_decref_no_entry;
+	kstat_named_t brt_maybe_exists_bloom_skip;
 } brt_stats_t;
 
 static brt_stats_t brt_stats = {
+	{ "addref_bloom_skip",			KSTAT_DATA_UINT64 },
 	{ "addref_entry_not_on_disk",		KSTAT_DATA_UINT64 },
 	{ "addref_entry_on_disk",		KSTAT_DATA_UINT64 },
 	{ "decref_entry_in_memory",		KSTAT_DATA_UINT64 },
@@ -288,10 +325,12 @@ static brt_stats_t brt_stats = {
 	{ "decref_entry_still_referenced",	KSTAT_DATA_UINT64 },
 	{ "decref_free_data_later",		KSTAT_DATA_UINT64 },
 	{ "decref_free_data_now",		KSTAT_DATA_UINT64 },
-	{ "decref_no_entry",			KSTAT_DATA_UINT64 }
+	{ "decref_no_entry",			KSTAT_DATA_UINT64 },
+	{ "maybe_exists_bloom_skip",		KSTAT_DATA_UINT64 }
 };
 
 struct {
+	wmsum_t brt_addref_bloom_skip;
 	wmsum_t brt_addref_entry_not_on_disk;
 	wmsum_t brt_addref_entry_on_disk;
 	wmsum_t brt_decref_entry_in_memory;
@@ -302,6 +341,7 @@ struct {
 	wmsum_t brt_decref_free_data_later;
 	wmsum_t brt_decref_free_data_now;
 	wmsum_t brt_decref_no_entry;
+	wmsum_t brt_maybe_exists_bloom_skip;
 } brt_sums;
 
 #define	BRTSTAT_BUMP(stat)	wmsum_add(&brt_sums.stat, 1)
@@ -379,6 +419,187 @@ brt_vdev_entcount_dec(brt_vdev_t *brtvd, uint64_t idx)
 	brt_vdev_entcount_set(brtvd, idx, entcnt - 1);
 }
 
+static inline const uint64_t *
+brt_bloom_line(const brt_vdev_t *brtvd, uint_t s, uint64_t hash)
+{
+	uint64_t nlines = BRT_BLOOM_STAGE_SIZE(s) /
+	    (BRT_BLOOM_LINE_WORDS * sizeof (uint64_t));
+
+	return (&brtvd->bv_bloom[s][(hash & (nlines - 1)) *
+	    BRT_BLOOM_LINE_WORDS]);
+}
+
+static boolean_t
+brt_bloom_stages_contain(const brt_vdev_t *brtvd, uint64_t off)
+{
+	uint_t nstages = brtvd->bv_bloom_nstages;
+	uint64_t lhash = cityhash1(off);
+	uint64_t bhash = cityhash2(off, lhash);
+
+	for (uint_t s = 0; s < nstages; s++) {
+		const uint64_t *line = brt_bloom_line(brtvd, s, lhash);
+		uint64_t hash = bhash;
+		int i;
+
+		for (i = 0; i < BRT_BLOOM_HASHES; i++) {
+			uint64_t bit = hash & BRT_BLOOM_HASH_MASK;
+			if (!(line[bit >> 6] & (1ULL << (bit & 63))))
+				break;
+			hash >>= BRT_BLOOM_HASH_BITS;
+		}
+		if (i == BRT_BLOOM_HASHES)
+			return (B_TRUE);
+	}
+
+	return (B_FALSE);
+}
+
+/*
+ * Return FALSE if there is definitely no BRT entry at this offset. Without a
+ * filter, or while it is being rebuilt, there may always be one.
+ */
+static boolean_t
+brt_bloom_contains(const brt_vdev_t *brtvd, uint64_t off)
+{
+	if (!brtvd->bv_bloom_ready)
+		return (B_TRUE);
+
+	membar_consumer();
+	return (brt_bloom_stages_contain(brtvd, off));
+}
+
+/*
+ * Add an entry offset to the filter. Keys go to the last stage; once that
+ * holds BRT_BLOOM_BITS_PER_ENTRY bits per key, a stage twice its size is
+ * started. When all the stages are used the last one keeps filling, which
+ * only raises the false positive rate.
+ */
+static void
+brt_bloom_add(brt_vdev_t *brtvd, uint64_t off)
+{
+	uint_t s = brtvd->bv_bloom_nstages;
+
+	if (s == 0 || brt_bloom_stages_contain(brtvd, off))
+		return;
+
+	s--;
+	if (brtvd->bv_bloom_entries >= BRT_BLOOM_STAGE_CAPACITY(s) &&
+	    s + 1 < BRT_BLOOM_MAX_STAGES) {
+		s++;
+		brtvd->bv_bloom[s] = vmem_zalloc(BRT_BLOOM_STAGE_SIZE(s),
+		    KM_SLEEP);
+		membar_producer();
+		brtvd->bv_bloom_nstages++;
+		brtvd->bv_bloom_entries = 0;
+	}
+
+	uint64_t lhash = cityhash1(off);
+	uint64_t hash = cityhash2(off, lhash);
+	uint64_t *line = (uint64_t *)brt_bloom_line(brtvd, s, lhash);
+
+	for (int i = 0; i < BRT_BLOOM_HASHES; i++) {
+		uint64_t bit = hash & BRT_BLOOM_HASH_MASK;
+		line[bit >> 6] |= 1ULL << (bit & 63);
+		hash >>= BRT_BLOOM_HASH_BITS;
+	}
+	brtvd->bv_bloom_entries++;
+}
+
+static void
+brt_bloom_free(brt_vdev_t *brtvd)
+{
+	brtvd->bv_bloom_ready = B_FALSE;
+	brtvd->bv_bloom_loading = B_FALSE;
+	for (uint_t s = 0; s < brtvd->bv_bloom_nstages; s++) {
+		vmem_free(brtvd->bv_bloom[s], BRT_BLOOM_STAGE_SIZE(s));
+		brtvd->bv_bloom[s] = NULL;
+	}
+	brtvd->bv_bloom_nstages = 0;
+	brtvd->bv_bloom_entries = 0;
+}
+
+static void
+brt_bloom_alloc(brt_vdev_t *brtvd)
+{
+	ASSERT0(brtvd->bv_bloom_nstages);
+
+	if (!brt_bloom)
+		return;
+
+	brtvd->bv_bloom[0] = vmem_zalloc(BRT_BLOOM_STAGE_SIZE(0), KM_SLEEP);
+	brtvd->bv_bloom_entries = 0;
+	brtvd->bv_bloom_nstages = 1;
+	membar_producer();
+	brtvd->bv_bloom_ready = B_TRUE;
+}
+
+/*
+ * Prepare to rebuild the filter from the entries already in the BRT ZAP.
+ * Nothing is read here; see brt_bloom_load_sync(). If there are too many
+ * entries, go without.
+ */
+static void
+brt_bloom_load(brt_vdev_t *brtvd)
+{
+	if (brtvd->bv_bloom_nstages == 0)
+		return;
+
+	if (brtvd->bv_totalcount > brt_bloom_load_max) {
+		brt_bloom_free(brtvd);
+		return;
+	}
+
+	brtvd->bv_bloom_ready = B_FALSE;
+	brtvd->bv_bloom_loading = B_TRUE;
+	brtvd->bv_bloom_cursor = 0;
+}
+
+/*
+ * Read the next brt_bloom_load_txg_max entries of the BRT ZAP into the
+ * filter, resuming from where the last txg stopped. Called in syncing
+ * context before the txg's new entries are applied; entries created behind
+ * the cursor since are added by brt_vdev_addref() as usual. If reading
+ * fails, the filter is left unused until the BRT empties.
+ */
+static void
+brt_bloom_load_sync(spa_t *spa, brt_vdev_t *brtvd)
+{
+	zap_cursor_t zc;
+	zap_attribute_t *za;
+	uint_t walked = 0;
+	int error = 0;
+
+	if (!brtvd->bv_bloom_loading)
+		return;
+
+	ASSERT(brtvd->bv_mos_entries != 0);
+	za = zap_attribute_alloc();
+	zap_cursor_init_serialized(&zc, spa->spa_meta_objset,
+	    brtvd->bv_mos_entries, brtvd->bv_bloom_cursor);
+	while (walked < brt_bloom_load_txg_max &&
+	    (error = zap_cursor_retrieve(&zc, za)) == 0) {
+		brt_bloom_add(brtvd, *(const uint64_t *)za->za_name);
+		zap_cursor_advance(&zc);
+		walked++;
+	}
+	brtvd->bv_bloom_cursor = zap_cursor_serialize(&zc);
+	zap_cursor_fini(&zc);
+	zap_attribute_free(za);
+
+	if (error == 0)
+		return;
+
+	brtvd->bv_bloom_loading = B_FALSE;
+	if (error != ENOENT) {
+		BRT_DEBUG("BRT VDEV %llu: bloom filter not loaded, error=%d",
+		    (u_longlong_t)brtvd->bv_vdevid, error);
+		return;
+	}
+
+	membar_producer();
+	brtvd->bv_bloom_ready = B_TRUE;
+}
+
 #ifdef ZFS_DEBUG
 static void
 brt_vdev_dump(brt_vdev_t *brtvd)
@@ -542,6 +763,7 @@ brt_vdev_realloc(spa_t *spa, brt_vdev_t *brtvd)
 	brtvd->bv_entcount = entcount;
 	brtvd->bv_bitmap = bitmap;
 	if (!brtvd->bv_initiated) {
+		brt_bloom_alloc(brtvd);
 		brtvd->bv_need_byteswap = FALSE;
 		brtvd->bv_initiated = TRUE;
 		BRT_DEBUG("BRT VDEV %llu initiated.",
@@ -599,6 +821,8 @@ brt_vdev_load(spa_t *spa, brt_vdev_t *brtvd)
 
 	dmu_buf_rele(db, FTAG);
 
+	brt_bloom_load(brtvd);
+
 	BRT_DEBUG("BRT VDEV %llu loaded: mos_brtvdev=%llu, mos_entries=%llu",
 	    (u_longlong_t)brtvd->bv_vdevid,
 	    (u_longlong_t)brtvd->bv_mos_brtvdev,
@@ -618,6 +842,7 @@ brt_vdev_dealloc(brt_vdev_t *brtvd)
 	uint64_t nblocks = BRT_RANGESIZE_TO_NBLOCKS(brtvd->bv_size);
 	kmem_free(brtvd->bv_bitmap, BT_SIZEOFMAP(nblocks));
 	brtvd->bv_bitmap = NULL;
+	brt_bloom_free(brtvd);
 
 	brtvd->bv_size = 0;
 
@@ -757,6 +982,7 @@ brt_vdev_addref(spa_t *spa, brt_vdev_t *brtvd, const brt_entry_t *bre,
 
 	brtvd->bv_totalcount++;
 	brt_vdev_entcount_inc(brtvd, idx);
+	brt_bloom_add(brtvd, BRE_OFFSET(bre));
 	brtvd->bv_entcount_dirty = TRUE;
 	idx = idx / BRT_BLOCKSIZE / 8;
 	BT_SET(brtvd->bv_bitmap, idx);
@@ -918,7 +1144,15 @@ brt_maybe_exists(spa_t *spa, const blkptr_t *bp)
 	 * all brt_vdev_addref() have already completed by this point.
 	 */
 	uint64_t off = DVA_GET_OFFSET(&bp->blk_dva[0]);
-	return (brt_vdev_lookup(spa, brtvd, off));
+	if (!brt_vdev_lookup(spa, brtvd, off))
+		return (B_FALSE);
+
+	if (!brt_bloom_contains(brtvd, off)) {
+		BRTSTAT_BUMP(brt_maybe_exists_bloom_skip);
+		return (B_FALSE);
+	}
+
+	return (B_TRUE);
 }
 
 uint64_t
@@ -972,6 +1206,8 @@ brt_kstats_update(kstat_t *ksp, int rw)
 	if (rw == KSTAT_WRITE)
 		return (EACCES);
 
+	bs->brt_addref_bloom_skip.value.ui64 =
+	    wmsum_value(&brt_sums.brt_addref_bloom_skip);
 	bs->brt_addref_entry_not_on_disk.value.ui64 =
 	    wmsum_value(&brt_sums.brt_addref_entry_not_on_disk);
 	bs->brt_addref_entry_on_disk.value.ui64 =
@@ -992,6 +1228,8 @@ brt_kstats_update(kstat_t *ksp, int rw)
 	    wmsum_value(&brt_sums.brt_decref_free_data_now);
 	bs->brt_decref_no_entry.value.ui64 =
 	    wmsum_value(&brt_sums.brt_decref_no_entry);
+	bs->brt_maybe_exists_bloom_skip.value.ui64 =
+	    wmsum_value(&brt_sums.brt_maybe_exists_bloom_skip);
 
 	return (0);
 }
@@ -1000,6 +1238,7 @@ static void
 brt_stat_init(void)
 {
 
+	wmsum_init(&brt_sums.brt_addref_bloom_skip, 0);
 	wmsum_init(&brt_sums.brt_addref_entry_not_on_disk, 0);
 	wmsum_init(&brt_sums.brt_addref_entry_on_disk, 0);
 	wmsum_init(&brt_sums.brt_decref_entry_in_memory, 0);
@@ -1010,6 +1249,7 @@ brt_stat_init(void)
 	wmsum_init(&brt_sums.brt_decref_free_data_later, 0);
 	wmsum_init(&brt_sums.brt_decref_free_data_now, 0);
 	wmsum_init(&brt_sums.brt_decref_no_entry, 0);
+	wmsum_init(&brt_sums.brt_maybe_exists_bloom_skip, 0);
 
 	brt_ksp = kstat_create("zfs", 0, "brtstats", "misc", KSTAT_TYPE_NAMED,
 	    sizeof (brt_stats) / sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
@@ -1028,6 +1268,7 @@ brt_stat_fini(void)
 		brt_ksp = NULL;
 	}
 
+	wmsum_fini(&brt_sums.brt_addref_bloom_skip);
 	wmsum_fini(&brt_sums.brt_addref_entry_not_on_disk);
 	wmsum_fini(&brt_sums.brt_addref_entry_on_disk);
 	wmsum_fini(&brt_sums.brt_decref_entry_in_memory);
@@ -1038,6 +1279,7 @@ brt_stat_fini(void)
 	wmsum_fini(&brt_sums.brt_decref_free_data_later);
 	wmsum_fini(&brt_sums.brt_decref_free_data_now);
 	wmsum_fini(&brt_sums.brt_decref_no_entry);
+	wmsum_fini(&brt_sums.brt_maybe_exists_bloom_skip);
 }
 
 void
@@ -1298,6 +1540,10 @@ brt_pending_apply_vdev(spa_t *spa, brt_vdev_t *brtvd, uint64_t txg)
 		if (brtvd->bv_mos_entries != 0 &&
 		    brt_vdev_lookup(spa, brtvd, off)) {
 			int error;
+			if (!brt_bloom_contains(brtvd, off)) {
+				BRTSTAT_BUMP(brt_addref_bloom_skip);
+				continue;
+			}
 			if (brt_has_endian_fixed(spa)) {
 				error = zap_lookup_uint64_by_dnode(
 				    brtvd->bv_mos_entries_dnode, &off,
@@ -1353,6 +1599,7 @@ brt_pending_apply(spa_t *spa, uint64_t txg)
 		brt_vdev_t *brtvd = spa->spa_brt_vdevs[vdevid];
 		brt_unlock(spa);
 
+		brt_bloom_load_sync(spa, brtvd);
 		brt_pending_apply_vdev(spa, brtvd, txg);
 
 		brt_rlock(spa);
@@ -1525,3 +1772,9 @@ ZFS_MODULE_PARAM(zfs_brt, , brt_zap_default_bs, UINT, ZMOD_RW,
 	"BRT ZAP leaf blockshift");
 ZFS_MODULE_PARAM(zfs_brt, , brt_zap_default_ibs, UINT, ZMOD_RW,
 	"BRT ZAP indirect blockshift");
+ZFS_MODULE_PARAM(zfs_brt, , brt_bloom, INT, ZMOD_RW,
+	"Enable the per-vdev bloom filter over BRT entries");
+ZFS_MODULE_PARAM(zfs_brt, , brt_bloom_load_max, U64, ZMOD_RW,
+	"Max BRT entries to read to rebuild the bloom filter on import");
+ZFS_MODULE_PARAM(zfs_brt, , brt_bloom_load_txg_max, UINT, ZMOD_RW,
+	"Max BRT entries to read per txg while rebuilding the bloom filter");
@@ -1407,6 +1407,110 @@ zfs_btree_add(zfs_btree_t *tree, const void *node)
 	zfs_btree_add_idx(tree, node, &where);
 }
 
+/*
+ * Build the tree bottom-up from an array of sorted, unique elements. Leaves
+ * are filled first, each of them followed by one element that becomes a
+ * separator on the level above; the separators and the nodes they separate
+ * are then grouped into core nodes the same way until a single root is left.
+ * Elements are spread evenly over the minimum number of nodes of each level,
+ * so every node is at least half full and the tree is as dense as the
+ * invariants allow.
+ */
+void
+zfs_btree_bulk_load(zfs_btree_t *tree, const void *elems, uint64_t nelems)
+{
+	size_t size = tree->bt_elem_size;
+	uint64_t lcap = tree->bt_leaf_cap;
+	const uint8_t *in = elems;
+
+	ASSERT0(tree->bt_num_elems);
+	ASSERT0P(tree->bt_root);
+
+	if (nelems == 0)
+		return;
+
+	/*
+	 * Each leaf but the last is followed by a separator, so n elements
+	 * need ceil((n + 1) / (lcap + 1)) leaves.
+	 */
+	uint64_t nleaves = (nelems + 1 + lcap) / (lcap + 1);
+	uint64_t nnodes = nleaves;
+	zfs_btree_hdr_t **nodes = vmem_alloc(nleaves * sizeof (*nodes),
+	    KM_SLEEP);
+	uint8_t *seps = nleaves > 1 ?
+	    vmem_alloc((nleaves - 1) * size, KM_SLEEP) : NULL;
+
+	uint64_t per = (nelems - (nnodes - 1)) / nnodes;
+	uint64_t extra = (nelems - (nnodes - 1)) % nnodes;
+	for (uint64_t i = 0; i < nnodes; i++) {
+		uint32_t count = per + (i < extra);
+		zfs_btree_leaf_t *leaf = zfs_btree_leaf_alloc(tree);
+		zfs_btree_hdr_t *hdr = &leaf->btl_hdr;
+		hdr->bth_parent = NULL;
+		hdr->bth_first = 0;
+		hdr->bth_count = count;
+		bcpy(in, leaf->btl_elems, count * size);
+		zfs_btree_poison_node(tree, hdr);
+		in += count * size;
+		if (i + 1 < nnodes) {
+			bcpy(in, seps + i * size, size);
+			in += size;
+		}
+		nodes[i] = hdr;
+	}
+	ASSERT3P(in, ==, (const uint8_t *)elems + nelems * size);
+	tree->bt_num_nodes = nnodes;
+	tree->bt_height = 0;
+
+	/*
+	 * Group nnodes children and the nnodes - 1 separators between them
+	 * into core nodes of at most BTREE_CORE_ELEMS + 1 children. The
+	 * separators between those core nodes move up a level. Both arrays
+	 * are compacted in place since we never write past what we read.
+	 */
+	while (nnodes > 1) {
+		uint64_t ncore = (nnodes + BTREE_CORE_ELEMS) /
+		    (BTREE_CORE_ELEMS + 1);
+		per = nnodes / ncore;
+		extra = nnodes % ncore;
+		uint64_t child = 0;
+		for (uint64_t i = 0; i < ncore; i++) {
+			uint32_t nchildren = per + (i < extra);
+			zfs_btree_core_t *node = kmem_alloc(
+			    sizeof (zfs_btree_core_t) + BTREE_CORE_ELEMS * size,
+			    KM_SLEEP);
+			zfs_btree_hdr_t *hdr = &node->btc_hdr;
+			hdr->bth_parent = NULL;
+			hdr->bth_first = -1;
+			hdr->bth_count = nchildren - 1;
+			for (uint32_t c = 0; c < nchildren; c++) {
+				node->btc_children[c] = nodes[child + c];
+				nodes[child + c]->bth_parent = node;
+			}
+			bmov(seps + child * size, node->btc_elems,
+			    (nchildren - 1) * size);
+			zfs_btree_poison_node(tree, hdr);
+			child += nchildren;
+			if (i + 1 < ncore) {
+				bmov(seps + (child - 1) * size,
+				    seps + i * size, size);
+			}
+			nodes[i] = hdr;
+		}
+		ASSERT3U(child, ==, nnodes);
+		tree->bt_num_nodes += ncore;
+		tree->bt_height++;
+		nnodes = ncore;
+	}
+
+	tree->bt_root = nodes[0];
+	tree->bt_num_elems = nelems;
+	vmem_free(nodes, nleaves * sizeof (*nodes));
+	if (seps != NULL)
+		vmem_free(seps, (nleaves - 1) * size);
+	zfs_btree_verify(tree);
+}
+
 /* Helper function to free a tree node. */
 static void
 zfs_btree_node_destroy(zfs_btree_t *tree, zfs_btree_hdr_t *node)
@@ -25,6 +25,7 @@
  * Copyright (c) 2018 Datto Inc.
  */
 
+#include <sys/arc.h>
 #include <sys/dataset_kstats.h>
 #include <sys/dmu_objset.h>
 #include <sys/dsl_dataset.h>
@@ -38,6 +39,11 @@ static dataset_kstat_values_t empty_dataset_kstats = {
 	{ "nread",	KSTAT_DATA_UINT64 },
 	{ "nunlinks",	KSTAT_DATA_UINT64 },
 	{ "nunlinked",	KSTAT_DATA_UINT64 },
+	{ "arc_size",	KSTAT_DATA_UINT64 },
+	{ "arc_mru_ghost_hits",	KSTAT_DATA_UINT64 },
+	{ "arc_mfu_ghost_hits",	KSTAT_DATA_UINT64 },
+	{ "arc_quota_uncached",	KSTAT_DATA_UINT64 },
+	{ "arc_reserve_skip",	KSTAT_DATA_UINT64 },
 	{
 	{ "zil_commit_count",			KSTAT_DATA_UINT64 },
 	{ "zil_commit_writer_count",		KSTAT_DATA_UINT64 },
@@ -59,7 +65,10 @@ static dataset_kstat_values_t empty_dataset_kstats = {
 	{ "zil_itx_metaslab_slog_count",	KSTAT_DATA_UINT64 },
 	{ "zil_itx_metaslab_slog_bytes",	KSTAT_DATA_UINT64 },
 	{ "zil_itx_metaslab_slog_write",	KSTAT_DATA_UINT64 },
-	{ "zil_itx_metaslab_slog_alloc",	KSTAT_DATA_UINT64 }
+	{ "zil_itx_metaslab_slog_alloc",	KSTAT_DATA_UINT64 },
+	{ "zil_replay_count",			KSTAT_DATA_UINT64 },
+	{ "zil_replay_bytes",			KSTAT_DATA_UINT64 },
+	{ "zil_replay_barrier_count",		KSTAT_DATA_UINT64 }
 	}
 };
 
@@ -86,6 +95,14 @@ dataset_kstats_update(kstat_t *ksp, int rw)
 	dkv->dkv_nunlinked.value.ui64 =
 	    wmsum_value(&dk->dk_sums.dss_nunlinked);
 
+	arc_tenant_stats_t ats;
+	(void) arc_tenant_stats(dk->dk_load_guid, dk->dk_objset, &ats);
+	dkv->dkv_arc_size.value.ui64 = ats.ats_size;
+	dkv->dkv_arc_mru_ghost_hits.value.ui64 = ats.ats_mru_ghost_hits;
+	dkv->dkv_arc_mfu_ghost_hits.value.ui64 = ats.ats_mfu_ghost_hits;
+	dkv->dkv_arc_quota_uncached.value.ui64 = ats.ats_quota_uncached;
+	dkv->dkv_arc_reserve_skip.value.ui64 = ats.ats_reserve_skip;
+
 	zil_kstat_values_update(&dkv->dkv_zil_stats, &dk->dk_zil_sums);
 
 	return (0);
@@ -156,6 +173,7 @@ dataset_kstats_create(dataset_kstats_t *dk, objset_t *objset)
 	    kmem_alloc(sizeof (empty_dataset_kstats), KM_SLEEP);
 	memcpy(dk_kstats, &empty_dataset_kstats,
 	    sizeof (empty_dataset_kstats));
+	zil_kstat_values_init(&dk_kstats->dkv_zil_stats);
 
 	char *ds_name = kmem_zalloc(ZFS_MAX_DATASET_NAME_LEN, KM_SLEEP);
 	dsl_dataset_name(objset->os_dsl_dataset, ds_name);
@@ -176,6 +194,8 @@ dataset_kstats_create(dataset_kstats_t *dk, objset_t *objset)
 	wmsum_init(&dk->dk_sums.dss_nunlinked, 0);
 	zil_sums_init(&dk->dk_zil_sums);
 
+	dk->dk_load_guid = spa_load_guid(dmu_objset_spa(objset));
+	dk->dk_objset = dmu_objset_id(objset);
 	dk->dk_kstats = kstat;
 	kstat_install(kstat);
 	return (0);
@@ -177,6 +177,8 @@ struct {
 
 static void dbuf_write(dbuf_dirty_record_t *dr, arc_buf_t *data, dmu_tx_t *tx);
 static void dbuf_sync_leaf_verify_bonus_dnode(dbuf_dirty_record_t *dr);
+static void dbuf_hold_locked(dnode_t *dn, dmu_buf_impl_t *db,
+    const void *tag);
 
 /*
  * Global data structures and functions for the dbuf cache.
@@ -368,6 +370,32 @@ dbuf_find(objset_t *os, uint64_t obj, uint8_t level, uint64_t blkid,
 	return (NULL);
 }
 
+/*
+ * Call func for every dbuf in the hash table which is not being evicted.
+ * The hash chain lock and the dbuf's db_mtx are held across the call, so
+ * func must not block.
+ */
+void
+dbuf_hash_walk(dbuf_walk_func_t *func, void *arg)
+{
+	dbuf_hash_table_t *h = &dbuf_hash_table;
+
+	for (uint64_t idx = 0; idx <= h->hash_table_mask; idx++) {
+		if (h->hash_table[idx] == NULL)
+			continue;
+
+		mutex_enter(DBUF_HASH_MUTEX(h, idx));
+		for (dmu_buf_impl_t *db = h->hash_table[idx]; db != NULL;
+		    db = db->db_hash_next) {
+			mutex_enter(&db->db_mtx);
+			if (db->db_state != DB_EVICTING)
+				func(db, arg);
+			mutex_exit(&db->db_mtx);
+		}
+		mutex_exit(DBUF_HASH_MUTEX(h, idx));
+	}
+}
+
 static dmu_buf_impl_t *
 dbuf_find_bonus(objset_t *os, uint64_t object)
 {
@@ -3982,6 +4010,29 @@ dbuf_hold_impl(dnode_t *dn, uint8_t level, uint64_t blkid,
 		return (SET_ERROR(ENOENT));
 	}
 
+	dbuf_hold_locked(dn, db, tag);
+
+	/* NOTE: we can't rele the parent until after we drop the db_mtx */
+	if (parent)
+		dbuf_rele(parent, NULL);
+
+	ASSERT3P(DB_DNODE(db), ==, dn);
+	ASSERT3U(db->db_blkid, ==, blkid);
+	ASSERT3U(db->db_level, ==, level);
+	*dbp = db;
+
+	return (0);
+}
+
+/*
+ * Add a hold on a dbuf returned by dbuf_find() or dbuf_create(), both of
+ * which return with db_mtx held.  Drops db_mtx.
+ */
+static void
+dbuf_hold_locked(dnode_t *dn, dmu_buf_impl_t *db, const void *tag)
+{
+	ASSERT(MUTEX_HELD(&db->db_mtx));
+
 	if (db->db_buf != NULL) {
 		arc_buf_access(db->db_buf);
 		ASSERT(MUTEX_HELD(&db->db_mtx));
@@ -4033,17 +4084,65 @@ dbuf_hold_impl(dnode_t *dn, uint8_t level, uint64_t blkid,
 	(void) zfs_refcount_add(&db->db_holds, tag);
 	DBUF_VERIFY(db);
 	mutex_exit(&db->db_mtx);
+}
+
+/*
+ * Hold the nblks consecutive level-0 dbufs starting at blkid, as if by
+ * calling dbuf_hold() for each of them.  Blocks that are not yet in the
+ * dbuf hash table share the lookup (and the read) of their parent
+ * indirect block, which is only done once per run of siblings rather
+ * than once per block.  On error no holds are returned.
+ */
+int
+dbuf_hold_array(dnode_t *dn, uint64_t blkid, uint64_t nblks,
+    const void *tag, dmu_buf_t **dbp)
+{
+	dmu_buf_impl_t *parent = NULL;
+	int epbs = dn->dn_indblkshift - SPA_BLKPTRSHIFT;
+	uint64_t i;
+	int err = 0;
+
+	ASSERT(RW_LOCK_HELD(&dn->dn_struct_rwlock));
+	ASSERT3U(blkid + nblks, <=, DMU_SPILL_BLKID);
+
+	for (i = 0; i < nblks; i++) {
+		uint64_t hv;
+		dmu_buf_impl_t *db = dbuf_find(dn->dn_objset, dn->dn_object,
+		    0, blkid + i, &hv);
+
+		if (db == NULL) {
+			blkptr_t *bp = NULL;
+
+			if (parent != NULL && parent->db_level == 1 &&
+			    parent->db_blkid == (blkid + i) >> epbs) {
+				bp = (blkptr_t *)parent->db.db_data +
+				    ((blkid + i) & ((1ULL << epbs) - 1));
+			} else {
+				if (parent != NULL)
+					dbuf_rele(parent, NULL);
+				err = dbuf_findbp(dn, 0, blkid + i, FALSE,
+				    &parent, &bp);
+				if (err && err != ENOENT)
+					break;
+				err = 0;
+			}
+			db = dbuf_create(dn, 0, blkid + i, parent, bp, hv);
+		}
+		dbuf_hold_locked(dn, db, tag);
+		dbp[i] = &db->db;
+	}
 
 	/* NOTE: we can't rele the parent until after we drop the db_mtx */
-	if (parent)
+	if (parent != NULL)
 		dbuf_rele(parent, NULL);
 
-	ASSERT3P(DB_DNODE(db), ==, dn);
-	ASSERT3U(db->db_blkid, ==, blkid);
-	ASSERT3U(db->db_level, ==, level);
-	*dbp = db;
-
-	return (0);
+	if (err != 0) {
+		while (i-- > 0) {
+			dbuf_rele((dmu_buf_impl_t *)dbp[i], tag);
+			dbp[i] = NULL;
+		}
+	}
+	return (err);
 }
 
 dmu_buf_impl_t *
@@ -290,6 +290,11 @@ boolean_t zfs_dedup_log_hard_cap = B_FALSE;
  */
 uint_t zfs_dedup_log_flush_flow_rate_txgs = 10;
 
+/*
+ * Number of log entries to prefetch the store leaves for ahead of the flush.
+ */
+uint_t zfs_dedup_log_flush_prefetch = 256;
+
 static const ddt_ops_t *const ddt_ops[DDT_TYPES] = {
 	&ddt_zap_ops,
 };
@@ -331,6 +336,14 @@ typedef struct {
 	kstat_named_t dds_lookup_stored_hit;
 	kstat_named_t dds_lookup_stored_miss;
 
+	/* store searches skipped by the bloom filter, and wasted searches */
+	kstat_named_t dds_lookup_bloom_skip;
+	kstat_named_t dds_lookup_bloom_false_positive;
+
+	/* keys in the bloom filter, and filter size */
+	kstat_named_t dds_bloom_entries;
+	kstat_named_t dds_bloom_size;
+
 	/* number of entries on log trees */
 	kstat_named_t dds_log_active_entries;
 	kstat_named_t dds_log_flushing_entries;
@@ -339,6 +352,14 @@ typedef struct {
 	kstat_named_t dds_log_ingest_rate;
 	kstat_named_t dds_log_flush_rate;
 	kstat_named_t dds_log_flush_time_rate;
+
+	/* flush backlog and pressure, as of the last flush */
+	kstat_named_t dds_log_flush_backlog;
+	kstat_named_t dds_log_flush_pressure;
+
+	/* total entries flushed, and store leaf prefetches for them */
+	kstat_named_t dds_log_flush_entries;
+	kstat_named_t dds_log_flush_prefetch;
 } ddt_kstats_t;
 
 static const ddt_kstats_t ddt_kstats_template = {
@@ -354,11 +375,19 @@ static const ddt_kstats_t ddt_kstats_template = {
 	{ "lookup_log_miss",		KSTAT_DATA_UINT64 },
 	{ "lookup_stored_hit",		KSTAT_DATA_UINT64 },
 	{ "lookup_stored_miss",		KSTAT_DATA_UINT64 },
+	{ "lookup_bloom_skip",		KSTAT_DATA_UINT64 },
+	{ "lookup_bloom_false_positive", KSTAT_DATA_UINT64 },
+	{ "bloom_entries",		KSTAT_DATA_UINT64 },
+	{ "bloom_size",			KSTAT_DATA_UINT64 },
 	{ "log_active_entries",		KSTAT_DATA_UINT64 },
 	{ "log_flushing_entries",	KSTAT_DATA_UINT64 },
 	{ "log_ingest_rate",		KSTAT_DATA_UINT32 },
 	{ "log_flush_rate",		KSTAT_DATA_UINT32 },
 	{ "log_flush_time_rate",	KSTAT_DATA_UINT32 },
+	{ "log_flush_backlog",		KSTAT_DATA_UINT64 },
+	{ "log_flush_pressure",		KSTAT_DATA_UINT32 },
+	{ "log_flush_entries",		KSTAT_DATA_UINT64 },
+	{ "log_flush_prefetch",		KSTAT_DATA_UINT64 },
 };
 
 #ifdef _KERNEL
@@ -518,6 +547,18 @@ ddt_object_exists(ddt_t *ddt, ddt_type_t type, ddt_class_t class)
 	return (!!ddt->ddt_object[type][class]);
 }
 
+static boolean_t
+ddt_has_store_objects(ddt_t *ddt)
+{
+	for (ddt_type_t type = 0; type < DDT_TYPES; type++) {
+		for (ddt_class_t class = 0; class < DDT_CLASSES; class++) {
+			if (ddt_object_exists(ddt, type, class))
+				return (B_TRUE);
+		}
+	}
+	return (B_FALSE);
+}
+
 static int
 ddt_object_lookup(ddt_t *ddt, ddt_type_t type, ddt_class_t class,
     ddt_entry_t *dde)
@@ -568,6 +609,8 @@ ddt_object_update(ddt_t *ddt, ddt_type_t type, ddt_class_t class,
 {
 	ASSERT(ddt_object_exists(ddt, type, class));
 
+	ddt_bloom_add(ddt, &ddlwe->ddlwe_key);
+
 	return (ddt_ops[type]->ddt_op_update(ddt->ddt_os,
 	    ddt->ddt_object[type][class], &ddlwe->ddlwe_key,
 	    &ddlwe->ddlwe_phys, DDT_PHYS_SIZE(ddt), tx));
@@ -1276,6 +1319,19 @@ ddt_lookup(ddt_t *ddt, const blkptr_t *bp, boolean_t verify)
 		DDT_KSTAT_BUMP(ddt, dds_lookup_log_miss);
 	}
 
+	/*
+	 * If the bloom filter says the key was never stored, there's no point
+	 * searching the store objects for it.
+	 */
+	boolean_t bloom = ddt->ddt_bloom.dbf_valid;
+	error = ENOENT;
+	if (!ddt_bloom_contains(ddt, &search)) {
+		DDT_KSTAT_BUMP(ddt, dds_lookup_bloom_skip);
+		type = DDT_TYPES;
+		class = DDT_CLASSES;
+		goto not_stored;
+	}
+
 	/*
 	 * ddt_tree is now stable, so unlock and let everyone else keep moving.
 	 * Anyone landing on this entry will find it without DDE_FLAG_LOADED,
@@ -1284,7 +1340,6 @@ ddt_lookup(ddt_t *ddt, const blkptr_t *bp, boolean_t verify)
 	ddt_exit(ddt);
 
 	/* Search all store objects for the entry. */
-	error = ENOENT;
 	for (type = 0; type < DDT_TYPES; type++) {
 		for (class = 0; class < DDT_CLASSES; class++) {
 			error = ddt_object_lookup(ddt, type, class, dde);
@@ -1299,6 +1354,11 @@ ddt_lookup(ddt_t *ddt, const blkptr_t *bp, boolean_t verify)
 
 	ddt_enter(ddt);
 
+	if (error == ENOENT && bloom)
+		DDT_KSTAT_BUMP(ddt, dds_lookup_bloom_false_positive);
+
+not_stored:
+
 	ASSERT(!(dde->dde_flags & DDE_FLAG_LOADED));
 
 	dde->dde_type = type;	/* will be DDT_TYPES if no entry found */
@@ -1649,6 +1709,7 @@ ddt_table_free(ddt_t *ddt)
 	}
 
 	ddt_log_free(ddt);
+	ddt_bloom_free(ddt);
 	ASSERT0(avl_numnodes(&ddt->ddt_tree));
 	ASSERT0(avl_numnodes(&ddt->ddt_repair_tree));
 	avl_destroy(&ddt->ddt_tree);
@@ -1710,6 +1771,11 @@ ddt_load(spa_t *spa)
 		DDT_KSTAT_SET(ddt, dds_log_flushing_entries,
 		    avl_numnodes(&ddt->ddt_log_flushing->ddl_tree));
 
+		ddt_bloom_load(ddt);
+		DDT_KSTAT_SET(ddt, dds_bloom_entries,
+		    ddt->ddt_bloom.dbf_entries);
+		DDT_KSTAT_SET(ddt, dds_bloom_size, ddt->ddt_bloom.dbf_size);
+
 		/*
 		 * Seed the cached histograms.
 		 */
@@ -2033,6 +2099,45 @@ ddt_sync_flush_entry(ddt_t *ddt, ddt_lightweight_entry_t *ddlwe,
 	}
 }
 
+/*
+ * Prefetch the store leaves for the next entries to be flushed from the log.
+ * The flushing tree is sorted by key, and the first key word is the ZAP hash,
+ * so entries are taken in leaf order and neighbouring entries tend to share a
+ * leaf. Issuing the reads up front lets them proceed in parallel, rather than
+ * each update in the flush loop waiting on its own leaf in turn.
+ */
+static void
+ddt_sync_flush_prefetch(ddt_t *ddt, uint64_t skip, uint64_t count)
+{
+	avl_tree_t *tree = &ddt->ddt_log_flushing->ddl_tree;
+	ddt_log_entry_t *ddle = avl_first(tree);
+	uint64_t n = 0;
+
+	/* Skip the entries already prefetched. */
+	for (; ddle != NULL && skip > 0; skip--)
+		ddle = AVL_NEXT(tree, ddle);
+
+	for (; ddle != NULL && n < count; n++, ddle = AVL_NEXT(tree, ddle)) {
+		ddt_lightweight_entry_t ddlwe;
+		DDT_LOG_ENTRY_TO_LIGHTWEIGHT(ddt, ddle, &ddlwe);
+
+		/* The object it's on now, and the one it will be on. */
+		uint64_t refcnt = ddt_phys_total_refcnt(ddt, &ddlwe.ddlwe_phys);
+		ddt_class_t nclass =
+		    (refcnt > 1) ? DDT_CLASS_DUPLICATE : DDT_CLASS_UNIQUE;
+
+		if (ddlwe.ddlwe_type != DDT_TYPES)
+			ddt_object_prefetch(ddt, ddlwe.ddlwe_type,
+			    ddlwe.ddlwe_class, &ddlwe.ddlwe_key);
+		if (refcnt > 0 && (ddlwe.ddlwe_type != DDT_TYPE_DEFAULT ||
+		    ddlwe.ddlwe_class != nclass))
+			ddt_object_prefetch(ddt, DDT_TYPE_DEFAULT, nclass,
+			    &ddlwe.ddlwe_key);
+	}
+
+	DDT_KSTAT_ADD(ddt, dds_log_flush_prefetch, n);
+}
+
 /* Calculate an exponential weighted moving average, lower limited to zero */
 static inline int32_t
 _ewma(int32_t val, int32_t prev, uint32_t weight)
@@ -2173,8 +2278,25 @@ ddt_sync_flush_log(ddt_t *ddt, dmu_tx_t *tx)
 		target_time = SEC2NSEC(zfs_txg_timeout) / 2;
 	}
 
+	/*
+	 * Keep the leaf prefetch between half and a whole batch ahead of the
+	 * flush, but don't read past where we're going to stop.
+	 */
+	uint64_t batch = zfs_dedup_log_flush_prefetch;
+	uint64_t prefetched = 0;
+
 	ddt_lightweight_entry_t ddlwe;
-	while (ddt_log_take_first(ddt, ddt->ddt_log_flushing, &ddlwe)) {
+	for (;;) {
+		if (batch > 0 && prefetched - count <= batch / 2 &&
+		    prefetched < flush_max) {
+			uint64_t n = MIN(batch, flush_max - prefetched);
+			ddt_sync_flush_prefetch(ddt, prefetched - count, n);
+			prefetched += n;
+		}
+
+		if (!ddt_log_take_first(ddt, ddt->ddt_log_flushing, &ddlwe))
+			break;
+
 		ddt_sync_flush_entry(ddt, &ddlwe,
 		    ddlwe.ddlwe_type, ddlwe.ddlwe_class, tx);
 
@@ -2207,6 +2329,7 @@ ddt_sync_flush_log(ddt_t *ddt, dmu_tx_t *tx)
 		DDT_KSTAT_SUB(ddt, dds_log_flushing_entries, count);
 		ddt_log_checkpoint(ddt, &ddlwe, tx);
 	}
+	DDT_KSTAT_ADD(ddt, dds_log_flush_entries, count);
 
 	ddt_sync_update_stats(ddt, tx);
 
@@ -2228,6 +2351,8 @@ housekeeping:
 	ddt_flush_force_update_txg(ddt, 0);
 
 	ddt->ddt_log_flush_prev_backlog = backlog;
+	DDT_KSTAT_SET(ddt, dds_log_flush_backlog, backlog);
+	DDT_KSTAT_SET(ddt, dds_log_flush_pressure, ddt->ddt_log_flush_pressure);
 
 	/*
 	 * Update flush rate. This is an exponential weighted moving
@@ -2369,6 +2494,8 @@ ddt_sync_table(ddt_t *ddt, dmu_tx_t *tx)
 	if (ddt->ddt_version == DDT_VERSION_FDT && ddt->ddt_dir_object == 0)
 		ddt_create_dir(ddt, tx);
 
+	ddt_bloom_sync(ddt, ddt_has_store_objects(ddt), tx->tx_txg);
+
 	if (ddt->ddt_flags & DDT_FLAG_LOG)
 		ddt_sync_table_log(ddt, tx);
 	else
@@ -2405,6 +2532,9 @@ ddt_sync(spa_t *spa, uint64_t txg)
 		ddt_sync_table(ddt, tx);
 		if (ddt->ddt_flags & DDT_FLAG_LOG)
 			ddt_sync_flush_log(ddt, tx);
+		DDT_KSTAT_SET(ddt, dds_bloom_entries,
+		    ddt->ddt_bloom.dbf_entries);
+		DDT_KSTAT_SET(ddt, dds_bloom_size, ddt->ddt_bloom.dbf_size);
 		ddt_repair_table(ddt, rio);
 	}
 
@@ -2823,3 +2953,6 @@ ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, log_hard_cap, UINT, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, log_flush_flow_rate_txgs, UINT, ZMOD_RW,
 	"Number of txgs to average flow rates across");
+
+ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, log_flush_prefetch, UINT, ZMOD_RW,
+	"Number of log entries to prefetch ahead of the flush");
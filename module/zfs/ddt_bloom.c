@@ -0,0 +1,349 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/spa.h>
+#include <sys/ddt.h>
+#include <sys/ddt_impl.h>
+#include <sys/zio_checksum.h>
+
+/*
+ * DDT bloom filter.
+ *
+ * Most blocks written to a dedup dataset are unique, so most calls to
+ * ddt_lookup() end with a miss on every store object, and each of those
+ * misses costs at least one random read of a ZAP leaf. The filter sits in
+ * front of the store objects: if it says a key is not there, the stores are
+ * not searched at all.
+ *
+ * The filter is a "blocked" bloom filter: each key selects one 64-byte line
+ * from the first checksum word, and DDT_BLOOM_HASHES bits within that line
+ * from the second. Since the key is already a cryptographic hash, no further
+ * hashing is needed, and a probe touches one cache line per stage.
+ *
+ * We don't know how many entries the DDT will grow to, so the filter is made
+ * of stages, each twice the size of the one before. Keys are only added to
+ * the last stage; when it reaches DDT_BLOOM_BITS_PER_ENTRY bits per key, a
+ * new stage is started. Once all stages are in use, the last one simply
+ * fills up, raising the false positive rate but never giving a wrong answer.
+ * Bits are never cleared, so removed entries stay "maybe stored" until the
+ * table has no store objects left and the filter is started over.
+ *
+ * The filter is kept in memory only, like the BRT one. After import it is
+ * rebuilt by walking the store objects from syncing context, at most
+ * zfs_dedup_bloom_load_txg_max entries per txg, so import itself reads
+ * nothing. Keys written while the walk is under way are added as usual, and
+ * until it completes the filter answers "maybe" for every key. Tables holding
+ * more than zfs_dedup_bloom_load_max entries go without a filter until they
+ * are emptied. A table without store objects gets an empty filter on its
+ * next sync, which from then on sees every key written to them.
+ */
+
+/*
+ * Maintain a bloom filter for each DDT, the most entries we will walk to
+ * rebuild it after import, and how many of them per txg. If disabled,
+ * existing filters are dropped on the next txg.
+ */
+static int zfs_dedup_bloom = 1;
+static uint64_t zfs_dedup_bloom_load_max = 1024 * 1024;
+static uint_t zfs_dedup_bloom_load_txg_max = 16384;
+
+/* Size of the first stage */
+#define	DDT_BLOOM_STAGE0_SIZE		(128 * 1024)
+
+/* One line is a 64-byte cache line; one hash selects one bit in a line */
+#define	DDT_BLOOM_LINE_WORDS		(8)
+#define	DDT_BLOOM_LINE_SIZE		(DDT_BLOOM_LINE_WORDS * 8)
+#define	DDT_BLOOM_HASH_BITS		(9)
+#define	DDT_BLOOM_HASHES		(7)
+
+/* Bits per key before starting a new stage; ~1-2% false positives each */
+#define	DDT_BLOOM_BITS_PER_ENTRY	(10)
+
+#define	DDT_BLOOM_STAGE_SIZE(s)		(DDT_BLOOM_STAGE0_SIZE << (s))
+#define	DDT_BLOOM_STAGE_CAPACITY(s)	\
+	(DDT_BLOOM_STAGE_SIZE(s) * NBBY / DDT_BLOOM_BITS_PER_ENTRY)
+
+static void
+ddt_bloom_stage_alloc(ddt_bloom_t *dbf)
+{
+	uint_t s = dbf->dbf_nstages;
+	ASSERT3U(s, <, DDT_BLOOM_MAX_STAGES);
+
+	ddt_bloom_stage_t *dbs = &dbf->dbf_stage[s];
+	dbs->dbs_size = DDT_BLOOM_STAGE_SIZE(s);
+	dbs->dbs_bits = vmem_zalloc(dbs->dbs_size, KM_SLEEP);
+	dbs->dbs_entries = 0;
+
+	dbf->dbf_size += dbs->dbs_size;
+	dbf->dbf_nstages++;
+}
+
+void
+ddt_bloom_free(ddt_t *ddt)
+{
+	ddt_bloom_t *dbf = &ddt->ddt_bloom;
+
+	for (uint_t s = 0; s < dbf->dbf_nstages; s++) {
+		ddt_bloom_stage_t *dbs = &dbf->dbf_stage[s];
+		vmem_free(dbs->dbs_bits, dbs->dbs_size);
+	}
+
+	memset(dbf, 0, sizeof (ddt_bloom_t));
+}
+
+/*
+ * Start a new, empty filter.
+ */
+static void
+ddt_bloom_alloc(ddt_t *ddt)
+{
+	ddt_bloom_t *dbf = &ddt->ddt_bloom;
+
+	ASSERT0(dbf->dbf_nstages);
+
+	ddt_bloom_stage_alloc(dbf);
+	dbf->dbf_valid = B_TRUE;
+}
+
+/*
+ * Returns a pointer to the line for this key in the given stage, and the
+ * hash bits to test or set within it.
+ */
+static inline uint64_t *
+ddt_bloom_line(const ddt_bloom_stage_t *dbs, const ddt_key_t *ddk,
+    uint64_t *hash)
+{
+	uint64_t nlines = dbs->dbs_size / DDT_BLOOM_LINE_SIZE;
+	uint64_t line = ddk->ddk_cksum.zc_word[0] & (nlines - 1);
+
+	*hash = ddk->ddk_cksum.zc_word[1];
+	return (&dbs->dbs_bits[line * DDT_BLOOM_LINE_WORDS]);
+}
+
+static boolean_t
+ddt_bloom_stage_contains(const ddt_bloom_stage_t *dbs, const ddt_key_t *ddk)
+{
+	uint64_t hash;
+	const uint64_t *line = ddt_bloom_line(dbs, ddk, &hash);
+
+	for (int i = 0; i < DDT_BLOOM_HASHES; i++) {
+		uint64_t bit = hash & ((1ULL << DDT_BLOOM_HASH_BITS) - 1);
+		if (!(line[bit >> 6] & (1ULL << (bit & 63))))
+			return (B_FALSE);
+		hash >>= DDT_BLOOM_HASH_BITS;
+	}
+
+	return (B_TRUE);
+}
+
+static boolean_t
+ddt_bloom_stages_contain(const ddt_bloom_t *dbf, const ddt_key_t *ddk)
+{
+	for (uint_t s = 0; s < dbf->dbf_nstages; s++)
+		if (ddt_bloom_stage_contains(&dbf->dbf_stage[s], ddk))
+			return (B_TRUE);
+
+	return (B_FALSE);
+}
+
+/*
+ * Returns B_FALSE if the key is definitely not on any store object, B_TRUE if
+ * it might be. Without a valid filter, including one still being rebuilt,
+ * anything might be.
+ */
+boolean_t
+ddt_bloom_contains(const ddt_t *ddt, const ddt_key_t *ddk)
+{
+	const ddt_bloom_t *dbf = &ddt->ddt_bloom;
+
+	if (!dbf->dbf_valid)
+		return (B_TRUE);
+
+	return (ddt_bloom_stages_contain(dbf, ddk));
+}
+
+/*
+ * Add a key that is being written to a store object. Called in syncing
+ * context only, like all other changes to the store objects. Keys are added
+ * while the filter is being rebuilt too, so that it covers them once done.
+ */
+void
+ddt_bloom_add(ddt_t *ddt, const ddt_key_t *ddk)
+{
+	ddt_bloom_t *dbf = &ddt->ddt_bloom;
+
+	if (dbf->dbf_nstages == 0)
+		return;
+
+	/* Updates to existing entries don't need a new key. */
+	if (ddt_bloom_stages_contain(dbf, ddk))
+		return;
+
+	uint_t s = dbf->dbf_nstages - 1;
+	if (dbf->dbf_stage[s].dbs_entries >= DDT_BLOOM_STAGE_CAPACITY(s) &&
+	    dbf->dbf_nstages < DDT_BLOOM_MAX_STAGES) {
+		ddt_bloom_stage_alloc(dbf);
+		s++;
+	}
+
+	ddt_bloom_stage_t *dbs = &dbf->dbf_stage[s];
+	uint64_t hash;
+	uint64_t *line = ddt_bloom_line(dbs, ddk, &hash);
+
+	for (int i = 0; i < DDT_BLOOM_HASHES; i++) {
+		uint64_t bit = hash & ((1ULL << DDT_BLOOM_HASH_BITS) - 1);
+		line[bit >> 6] |= (1ULL << (bit & 63));
+		hash >>= DDT_BLOOM_HASH_BITS;
+	}
+
+	dbs->dbs_entries++;
+	dbf->dbf_entries++;
+}
+
+/*
+ * Walk the next zfs_dedup_bloom_load_txg_max entries of the store objects
+ * into the filter, picking up where the last txg left off. The ZAP cursor is
+ * resumed by hash, so entries added or moved behind it since are missed by
+ * the walk, but those were added to the filter as they were written. Once
+ * every object has been walked, the filter is valid.
+ */
+static void
+ddt_bloom_load_sync(ddt_t *ddt)
+{
+	ddt_bloom_t *dbf = &ddt->ddt_bloom;
+	ddt_lightweight_entry_t ddlwe;
+	uint_t walked = 0;
+
+	while (dbf->dbf_load_class < DDT_CLASSES) {
+		ddt_type_t type = dbf->dbf_load_type;
+		ddt_class_t class = dbf->dbf_load_class;
+		int error = ENOENT;
+
+		if (ddt->ddt_object[type][class] != 0) {
+			while ((error = ddt_object_walk(ddt, type, class,
+			    &dbf->dbf_load_cursor, &ddlwe)) == 0) {
+				ddt_bloom_add(ddt, &ddlwe.ddlwe_key);
+				if (++walked >= zfs_dedup_bloom_load_txg_max)
+					return;
+			}
+		}
+
+		if (error != ENOENT) {
+			zfs_dbgmsg("ddt_bloom_load: spa=%s ddt=%s "
+			    "not loaded, error=%d", spa_name(ddt->ddt_spa),
+			    zio_checksum_table[ddt->ddt_checksum].ci_name,
+			    error);
+			ddt_bloom_free(ddt);
+			return;
+		}
+
+		dbf->dbf_load_cursor = 0;
+		if (++dbf->dbf_load_type == DDT_TYPES) {
+			dbf->dbf_load_type = 0;
+			dbf->dbf_load_class++;
+		}
+	}
+
+	dbf->dbf_loading = B_FALSE;
+	dbf->dbf_valid = B_TRUE;
+}
+
+/*
+ * Called at the start of each txg sync of a table, before anything is written
+ * to its store objects. With none left, whatever the filter holds is stale,
+ * and an empty one covers everything that will be written from now on.
+ * Otherwise, a rebuild under way takes its next step, once per txg.
+ */
+void
+ddt_bloom_sync(ddt_t *ddt, boolean_t stored, uint64_t txg)
+{
+	ddt_bloom_t *dbf = &ddt->ddt_bloom;
+
+	if (!zfs_dedup_bloom) {
+		if (dbf->dbf_nstages > 0)
+			ddt_bloom_free(ddt);
+		return;
+	}
+
+	if (!stored) {
+		if (!dbf->dbf_valid || dbf->dbf_entries != 0) {
+			ddt_bloom_free(ddt);
+			ddt_bloom_alloc(ddt);
+		}
+		return;
+	}
+
+	if (dbf->dbf_loading && dbf->dbf_load_txg != txg) {
+		dbf->dbf_load_txg = txg;
+		ddt_bloom_load_sync(ddt);
+	}
+}
+
+/*
+ * Start rebuilding the filter from the entries already in the store objects.
+ * Nothing is read here beyond the object sizes; the walk happens in syncing
+ * context, see ddt_bloom_load_sync(). If there are too many entries, or the
+ * pool will never be written to, go without.
+ */
+void
+ddt_bloom_load(ddt_t *ddt)
+{
+	ddt_bloom_t *dbf = &ddt->ddt_bloom;
+	uint64_t total = 0;
+
+	ASSERT0(dbf->dbf_nstages);
+
+	if (!zfs_dedup_bloom || !spa_writeable(ddt->ddt_spa))
+		return;
+
+	for (ddt_type_t type = 0; type < DDT_TYPES; type++) {
+		for (ddt_class_t class = 0; class < DDT_CLASSES; class++) {
+			uint64_t count;
+			if (ddt->ddt_object[type][class] == 0)
+				continue;
+			if (ddt_object_count(ddt, type, class, &count) != 0)
+				return;
+			total += count;
+		}
+	}
+
+	if (total > zfs_dedup_bloom_load_max) {
+		zfs_dbgmsg("ddt_bloom_load: spa=%s ddt=%s not loaded, "
+		    "%llu entries", spa_name(ddt->ddt_spa),
+		    zio_checksum_table[ddt->ddt_checksum].ci_name,
+		    (u_longlong_t)total);
+		return;
+	}
+
+	ddt_bloom_stage_alloc(dbf);
+	dbf->dbf_loading = B_TRUE;
+}
+
+ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, bloom, INT, ZMOD_RW,
+	"Maintain a bloom filter in front of on-disk dedup table lookups");
+
+ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, bloom_load_max, U64, ZMOD_RW,
+	"Max dedup table entries walked to rebuild its bloom filter");
+
+ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, bloom_load_txg_max, UINT, ZMOD_RW,
+	"Max dedup table entries walked per txg to rebuild its bloom filter");
@@ -547,19 +547,23 @@ dmu_buf_hold_array_by_dnode(dnode_t *dn, uint64_t offset, uint64_t length,
 		zs = dmu_zfetch_prepare(&dn->dn_zfetch, blkid, nblks,
 		    read && !(flags & DMU_DIRECTIO), B_TRUE);
 	}
-	for (i = 0; i < nblks; i++) {
-		dmu_buf_impl_t *db = dbuf_hold(dn, blkid + i, tag);
-		if (db == NULL) {
-			if (zs) {
-				dmu_zfetch_run(&dn->dn_zfetch, zs, missed,
-				    B_TRUE, (flags & DMU_UNCACHEDIO));
-			}
-			rw_exit(&dn->dn_struct_rwlock);
-			dmu_buf_rele_array(dbp, nblks, tag);
-			if (read)
-				zio_nowait(zio);
-			return (SET_ERROR(EIO));
+	/*
+	 * Hold all of the dbufs at once, so that siblings which are not yet
+	 * cached share the lookup of their parent indirect block.
+	 */
+	if (dbuf_hold_array(dn, blkid, nblks, tag, dbp) != 0) {
+		if (zs) {
+			dmu_zfetch_run(&dn->dn_zfetch, zs, missed,
+			    B_TRUE, (flags & DMU_UNCACHEDIO));
 		}
+		rw_exit(&dn->dn_struct_rwlock);
+		kmem_free(dbp, sizeof (dmu_buf_t *) * nblks);
+		if (read)
+			zio_nowait(zio);
+		return (SET_ERROR(EIO));
+	}
+	for (i = 0; i < nblks; i++) {
+		dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[i];
 
 		/*
 		 * Initiate async demand data read.
@@ -582,7 +586,6 @@ dmu_buf_hold_array_by_dnode(dnode_t *dn, uint64_t offset, uint64_t length,
 			if (db->db_state != DB_CACHED)
 				missed = B_TRUE;
 		}
-		dbp[i] = &db->db;
 	}
 
 	/*
@@ -245,9 +245,13 @@ dmu_write_abd(dnode_t *dn, uint64_t offset, uint64_t size,
 	return (err);
 }
 
-int
-dmu_read_abd(dnode_t *dn, uint64_t offset, uint64_t size,
-    abd_t *data, dmu_flags_t flags)
+/*
+ * Issue the Direct I/O reads for the given range as children of rio.  Holes
+ * and blocks cached in the dbufs are copied into data directly.
+ */
+static int
+dmu_read_abd_issue(dnode_t *dn, uint64_t offset, uint64_t size,
+    abd_t *data, dmu_flags_t flags, zio_t *rio)
 {
 	objset_t *os = dn->dn_objset;
 	spa_t *spa = os->os_spa;
@@ -261,8 +265,6 @@ dmu_read_abd(dnode_t *dn, uint64_t offset, uint64_t size,
 	if (err)
 		return (err);
 
-	zio_t *rio = zio_root(spa, NULL, NULL, ZIO_FLAG_CANFAIL);
-
 	for (int i = 0; i < numbufs; i++) {
 		dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[i];
 		abd_t *mbuf;
@@ -284,7 +286,7 @@ dmu_read_abd(dnode_t *dn, uint64_t offset, uint64_t size,
 		err = dmu_buf_get_bp_from_dbuf(db, &bp);
 		if (err) {
 			mutex_exit(&db->db_mtx);
-			goto error;
+			break;
 		}
 
 		/*
@@ -341,14 +343,26 @@ dmu_read_abd(dnode_t *dn, uint64_t offset, uint64_t size,
 
 	dmu_buf_rele_array(dbp, numbufs, FTAG);
 
-	return (zio_wait(rio));
-
-error:
-	dmu_buf_rele_array(dbp, numbufs, FTAG);
-	(void) zio_wait(rio);
 	return (err);
 }
 
+int
+dmu_read_abd(dnode_t *dn, uint64_t offset, uint64_t size,
+    abd_t *data, dmu_flags_t flags)
+{
+	zio_t *rio = zio_root(dn->dn_objset->os_spa, NULL, NULL,
+	    ZIO_FLAG_CANFAIL);
+	int err;
+
+	err = dmu_read_abd_issue(dn, offset, size, data, flags, rio);
+	if (err) {
+		(void) zio_wait(rio);
+		return (err);
+	}
+
+	return (zio_wait(rio));
+}
+
 #ifdef _KERNEL
 int
 dmu_read_uio_direct(dnode_t *dn, zfs_uio_t *uio, uint64_t size,
@@ -372,6 +386,120 @@ dmu_read_uio_direct(dnode_t *dn, zfs_uio_t *uio, uint64_t size,
 	return (err);
 }
 
+typedef struct dmu_direct_async {
+	abd_t			*dda_abd;
+	dmu_buf_t		**dda_dbp;
+	int			dda_numbufs;
+	dmu_direct_done_func_t	*dda_done;
+	void			*dda_arg;
+	int			dda_error;
+} dmu_direct_async_t;
+
+static dmu_direct_async_t *
+dmu_direct_async_alloc(zfs_uio_t *uio, uint64_t size,
+    dmu_direct_done_func_t *done, void *arg)
+{
+	offset_t offset = zfs_uio_offset(uio);
+	offset_t page_index = (offset - zfs_uio_soffset(uio)) >> PAGESHIFT;
+	dmu_direct_async_t *dda;
+
+	ASSERT(uio->uio_extflg & UIO_DIRECT);
+	ASSERT3U(page_index, <, uio->uio_dio.npages);
+
+	dda = kmem_zalloc(sizeof (dmu_direct_async_t), KM_SLEEP);
+	dda->dda_abd = abd_alloc_from_pages(&uio->uio_dio.pages[page_index],
+	    offset & (PAGESIZE - 1), size);
+	dda->dda_done = done;
+	dda->dda_arg = arg;
+
+	return (dda);
+}
+
+static void
+dmu_direct_async_done(zio_t *zio)
+{
+	dmu_direct_async_t *dda = zio->io_private;
+	int err = (dda->dda_error != 0) ? dda->dda_error : zio->io_error;
+
+	abd_free(dda->dda_abd);
+	if (dda->dda_dbp != NULL)
+		dmu_buf_rele_array(dda->dda_dbp, dda->dda_numbufs, dda);
+	dda->dda_done(dda->dda_arg, err);
+	kmem_free(dda, sizeof (dmu_direct_async_t));
+}
+
+/*
+ * Asynchronous version of dmu_read_uio_direct().  The reads are issued and
+ * done() is called with the result once they have all completed, from zio
+ * completion context or before returning if no I/O was needed.  The uio
+ * itself is not updated; its Direct I/O pages must remain mapped until
+ * done() is called.
+ */
+void
+dmu_read_uio_direct_async(dmu_buf_t *zdb, zfs_uio_t *uio, uint64_t size,
+    dmu_flags_t flags, dmu_direct_done_func_t *done, void *arg)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)zdb;
+	dmu_direct_async_t *dda;
+
+	ASSERT(flags & DMU_DIRECTIO);
+
+	dda = dmu_direct_async_alloc(uio, size, done, arg);
+
+	zio_t *rio = zio_root(db->db_objset->os_spa, dmu_direct_async_done,
+	    dda, ZIO_FLAG_CANFAIL);
+
+	DB_DNODE_ENTER(db);
+	dda->dda_error = dmu_read_abd_issue(DB_DNODE(db), zfs_uio_offset(uio),
+	    size, dda->dda_abd, flags, rio);
+	DB_DNODE_EXIT(db);
+
+	zio_nowait(rio);
+}
+
+/*
+ * Asynchronous version of dmu_write_uio_direct() for a block aligned range.
+ * The writes are issued in tx, and done() is called with the result once
+ * they have all completed, from zio completion context.  The dbufs stay
+ * held until then, so the caller must not commit tx before done() is
+ * called.  As with reads, the uio is not updated.
+ */
+void
+dmu_write_uio_direct_async(dmu_buf_t *zdb, zfs_uio_t *uio, uint64_t size,
+    dmu_flags_t flags, dmu_tx_t *tx, dmu_direct_done_func_t *done, void *arg)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)zdb;
+	spa_t *spa = db->db_objset->os_spa;
+	offset_t offset = zfs_uio_offset(uio);
+	dmu_direct_async_t *dda;
+
+	ASSERT(flags & DMU_DIRECTIO);
+
+	dda = dmu_direct_async_alloc(uio, size, done, arg);
+
+	zio_t *pio = zio_root(spa, dmu_direct_async_done, dda,
+	    ZIO_FLAG_CANFAIL);
+
+	DB_DNODE_ENTER(db);
+	dnode_t *dn = DB_DNODE(db);
+	ASSERT(zfs_dio_aligned(offset, size, dn->dn_datablksz));
+
+	dda->dda_error = dmu_buf_hold_array_by_dnode(dn, offset, size,
+	    B_FALSE, dda, &dda->dda_numbufs, &dda->dda_dbp, flags);
+	for (int i = 0; i < dda->dda_numbufs; i++) {
+		dmu_buf_impl_t *dbi = (dmu_buf_impl_t *)dda->dda_dbp[i];
+
+		abd_t *abd = abd_get_offset_size(dda->dda_abd,
+		    dbi->db.db_offset - offset, dn->dn_datablksz);
+
+		zfs_racct_write(spa, dbi->db.db_size, 1, flags);
+		VERIFY0(dmu_write_direct(pio, dbi, abd, tx));
+	}
+	DB_DNODE_EXIT(db);
+
+	zio_nowait(pio);
+}
+
 int
 dmu_write_uio_direct(dnode_t *dn, zfs_uio_t *uio, uint64_t size,
     dmu_flags_t flags, dmu_tx_t *tx)
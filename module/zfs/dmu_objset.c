@@ -280,6 +280,26 @@ prefetch_changed_cb(void *arg, uint64_t newval)
 	os->os_prefetch = newval;
 }
 
+static void
+primary_cache_quota_changed_cb(void *arg, uint64_t newval)
+{
+	objset_t *os = arg;
+
+	os->os_primary_cache_quota = newval;
+	arc_tenant_set(os->os_spa, dmu_objset_id(os),
+	    os->os_primary_cache_quota, os->os_primary_cache_reserve);
+}
+
+static void
+primary_cache_reserve_changed_cb(void *arg, uint64_t newval)
+{
+	objset_t *os = arg;
+
+	os->os_primary_cache_reserve = newval;
+	arc_tenant_set(os->os_spa, dmu_objset_id(os),
+	    os->os_primary_cache_quota, os->os_primary_cache_reserve);
+}
+
 static void
 sync_changed_cb(void *arg, uint64_t newval)
 {
@@ -636,8 +656,23 @@ dmu_objset_open_impl(spa_t *spa, dsl_dataset_t *ds, blkptr_t *bp,
 				    zfs_prop_to_name(ZFS_PROP_DIRECT),
 				    direct_changed_cb, os);
 			}
+			if (err == 0) {
+				err = dsl_prop_register(ds,
+				    zfs_prop_to_name(
+				    ZFS_PROP_PRIMARYCACHE_QUOTA),
+				    primary_cache_quota_changed_cb, os);
+			}
+			if (err == 0) {
+				err = dsl_prop_register(ds,
+				    zfs_prop_to_name(
+				    ZFS_PROP_PRIMARYCACHE_RESERVE),
+				    primary_cache_reserve_changed_cb, os);
+			}
 		}
 		if (err != 0) {
+			if (os->os_primary_cache_quota != 0 ||
+			    os->os_primary_cache_reserve != 0)
+				arc_tenant_set(spa, ds->ds_object, 0, 0);
 			arc_buf_destroy(os->os_phys_buf, &os->os_phys_buf);
 			kmem_free(os, sizeof (objset_t));
 			return (err);
@@ -1008,6 +1043,10 @@ dmu_objset_evict(objset_t *os)
 	if (ds)
 		dsl_prop_unregister_all(ds, os);
 
+	if (os->os_primary_cache_quota != 0 ||
+	    os->os_primary_cache_reserve != 0)
+		arc_tenant_set(os->os_spa, dmu_objset_id(os), 0, 0);
+
 	if (os->os_sa)
 		sa_tear_down(os);
 
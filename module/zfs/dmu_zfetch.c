@@ -70,6 +70,10 @@ unsigned int	zfetch_max_idistance = 128 * 1024 * 1024;
 unsigned int	zfetch_max_reorder = 16 * 1024 * 1024;
 /* Max log2 fraction of holes in a stream */
 unsigned int	zfetch_hole_shift = 2;
+/* max distance between strided accesses in a stream (default 1GB) */
+static unsigned int	zfetch_max_stride = 1024 * 1024 * 1024;
+/* size prefetch distance by how early prefetches complete */
+static int		zfetch_adaptive = 1;
 
 typedef struct zfetch_stats {
 	kstat_named_t zfetchstat_hits;
@@ -77,9 +81,13 @@ typedef struct zfetch_stats {
 	kstat_named_t zfetchstat_stride;
 	kstat_named_t zfetchstat_past;
 	kstat_named_t zfetchstat_misses;
+	kstat_named_t zfetchstat_reverse_hits;
+	kstat_named_t zfetchstat_strided_hits;
 	kstat_named_t zfetchstat_max_streams;
 	kstat_named_t zfetchstat_io_issued;
 	kstat_named_t zfetchstat_io_active;
+	kstat_named_t zfetchstat_io_late;
+	kstat_named_t zfetchstat_io_early;
 } zfetch_stats_t;
 
 static zfetch_stats_t zfetch_stats = {
@@ -88,9 +96,13 @@ static zfetch_stats_t zfetch_stats = {
 	{ "stride",			KSTAT_DATA_UINT64 },
 	{ "past",			KSTAT_DATA_UINT64 },
 	{ "misses",			KSTAT_DATA_UINT64 },
+	{ "reverse_hits",		KSTAT_DATA_UINT64 },
+	{ "strided_hits",		KSTAT_DATA_UINT64 },
 	{ "max_streams",		KSTAT_DATA_UINT64 },
 	{ "io_issued",			KSTAT_DATA_UINT64 },
 	{ "io_active",			KSTAT_DATA_UINT64 },
+	{ "io_late",			KSTAT_DATA_UINT64 },
+	{ "io_early",			KSTAT_DATA_UINT64 },
 };
 
 struct {
@@ -99,9 +111,13 @@ struct {
 	wmsum_t zfetchstat_stride;
 	wmsum_t zfetchstat_past;
 	wmsum_t zfetchstat_misses;
+	wmsum_t zfetchstat_reverse_hits;
+	wmsum_t zfetchstat_strided_hits;
 	wmsum_t zfetchstat_max_streams;
 	wmsum_t zfetchstat_io_issued;
 	aggsum_t zfetchstat_io_active;
+	wmsum_t zfetchstat_io_late;
+	wmsum_t zfetchstat_io_early;
 } zfetch_sums;
 
 #define	ZFETCHSTAT_BUMP(stat)					\
@@ -109,6 +125,15 @@ struct {
 #define	ZFETCHSTAT_ADD(stat, val)				\
 	wmsum_add(&zfetch_sums.stat, val)
 
+/*
+ * Each stream records the smallest slack, in data blocks, by which its
+ * prefetches completed ahead of the demand accesses since the last hit.
+ * Negative slack means the demand accesses got to the block first.  It is
+ * updated from I/O completion context without the zfetch lock, so it is
+ * kept biased in an unsigned word that can be compared and swapped.
+ */
+#define	ZFETCH_SLACK_BIAS	(1U << 31)
+#define	ZFETCH_SLACK_NONE	UINT32_MAX
 
 static kstat_t		*zfetch_ksp;
 
@@ -129,12 +154,20 @@ zfetch_kstats_update(kstat_t *ksp, int rw)
 	    wmsum_value(&zfetch_sums.zfetchstat_past);
 	zs->zfetchstat_misses.value.ui64 =
 	    wmsum_value(&zfetch_sums.zfetchstat_misses);
+	zs->zfetchstat_reverse_hits.value.ui64 =
+	    wmsum_value(&zfetch_sums.zfetchstat_reverse_hits);
+	zs->zfetchstat_strided_hits.value.ui64 =
+	    wmsum_value(&zfetch_sums.zfetchstat_strided_hits);
 	zs->zfetchstat_max_streams.value.ui64 =
 	    wmsum_value(&zfetch_sums.zfetchstat_max_streams);
 	zs->zfetchstat_io_issued.value.ui64 =
 	    wmsum_value(&zfetch_sums.zfetchstat_io_issued);
 	zs->zfetchstat_io_active.value.ui64 =
 	    aggsum_value(&zfetch_sums.zfetchstat_io_active);
+	zs->zfetchstat_io_late.value.ui64 =
+	    wmsum_value(&zfetch_sums.zfetchstat_io_late);
+	zs->zfetchstat_io_early.value.ui64 =
+	    wmsum_value(&zfetch_sums.zfetchstat_io_early);
 	return (0);
 }
 
@@ -146,9 +179,13 @@ zfetch_init(void)
 	wmsum_init(&zfetch_sums.zfetchstat_stride, 0);
 	wmsum_init(&zfetch_sums.zfetchstat_past, 0);
 	wmsum_init(&zfetch_sums.zfetchstat_misses, 0);
+	wmsum_init(&zfetch_sums.zfetchstat_reverse_hits, 0);
+	wmsum_init(&zfetch_sums.zfetchstat_strided_hits, 0);
 	wmsum_init(&zfetch_sums.zfetchstat_max_streams, 0);
 	wmsum_init(&zfetch_sums.zfetchstat_io_issued, 0);
 	aggsum_init(&zfetch_sums.zfetchstat_io_active, 0);
+	wmsum_init(&zfetch_sums.zfetchstat_io_late, 0);
+	wmsum_init(&zfetch_sums.zfetchstat_io_early, 0);
 
 	zfetch_ksp = kstat_create("zfs", 0, "zfetchstats", "misc",
 	    KSTAT_TYPE_NAMED, sizeof (zfetch_stats) / sizeof (kstat_named_t),
@@ -174,10 +211,14 @@ zfetch_fini(void)
 	wmsum_fini(&zfetch_sums.zfetchstat_stride);
 	wmsum_fini(&zfetch_sums.zfetchstat_past);
 	wmsum_fini(&zfetch_sums.zfetchstat_misses);
+	wmsum_fini(&zfetch_sums.zfetchstat_reverse_hits);
+	wmsum_fini(&zfetch_sums.zfetchstat_strided_hits);
 	wmsum_fini(&zfetch_sums.zfetchstat_max_streams);
 	wmsum_fini(&zfetch_sums.zfetchstat_io_issued);
 	ASSERT0(aggsum_value(&zfetch_sums.zfetchstat_io_active));
 	aggsum_fini(&zfetch_sums.zfetchstat_io_active);
+	wmsum_fini(&zfetch_sums.zfetchstat_io_late);
+	wmsum_fini(&zfetch_sums.zfetchstat_io_early);
 }
 
 /*
@@ -242,10 +283,11 @@ dmu_zfetch_fini(zfetch_t *zf)
  * If there aren't too many active streams already, create one more.
  * In process delete/reuse all streams without hits for zfetch_max_sec_reap.
  * If needed, reuse oldest stream without hits for zfetch_min_sec_reap or ever.
- * The "blkid" argument is the next block that we expect this stream to access.
+ * The "blkid" argument is the next block that we expect this stream to access,
+ * "nblks" is the size of the access that created it.
  */
 static void
-dmu_zfetch_stream_create(zfetch_t *zf, uint64_t blkid)
+dmu_zfetch_stream_create(zfetch_t *zf, uint64_t blkid, uint64_t nblks)
 {
 	zstream_t *zs, *zs_next, *zs_old = NULL;
 	uint_t now = gethrestime_sec(), t;
@@ -325,7 +367,27 @@ reuse:
 	zs->zs_ipf_start = blkid;
 	zs->zs_ipf_end = blkid;
 	zs->zs_missed = B_FALSE;
-	zs->zs_more = B_FALSE;
+	zs->zs_adapted = B_FALSE;
+	zs->zs_slack = ZFETCH_SLACK_NONE;
+	zs->zs_type = ZFETCH_FORWARD;
+	zs->zs_stride = 0;
+	zs->zs_len = MIN(nblks, UINT32_MAX);
+}
+
+static void
+dmu_zfetch_slack(zstream_t *zs, int64_t slack)
+{
+	uint32_t old, new;
+
+	slack = MIN(MAX(slack, INT32_MIN), INT32_MAX - 1);
+	new = (uint32_t)(slack + ZFETCH_SLACK_BIAS);
+	old = zs->zs_slack;
+	while (new < old) {
+		uint32_t cur = atomic_cas_32(&zs->zs_slack, old, new);
+		if (cur == old)
+			break;
+		old = cur;
+	}
 }
 
 static void
@@ -333,8 +395,25 @@ dmu_zfetch_done(void *arg, uint64_t level, uint64_t blkid, boolean_t io_issued)
 {
 	zstream_t *zs = arg;
 
-	if (io_issued && level == 0 && blkid < zs->zs_blkid)
-		zs->zs_more = B_TRUE;
+	if (io_issued && level == 0) {
+		int64_t slack;
+
+		if (zs->zs_type == ZFETCH_REVERSE) {
+			slack = (int64_t)zs->zs_blkid - (int64_t)blkid - 1;
+		} else {
+			slack = (int64_t)blkid - (int64_t)zs->zs_blkid;
+			/* Count only the data blocks within the gaps. */
+			if (zs->zs_type == ZFETCH_STRIDED) {
+				slack = slack * zs->zs_len / MAX(1,
+				    zs->zs_stride >> ZFETCH_STRIDE_SHIFT);
+			}
+		}
+		if (slack < 0)
+			ZFETCHSTAT_BUMP(zfetchstat_io_late);
+		else
+			ZFETCHSTAT_BUMP(zfetchstat_io_early);
+		dmu_zfetch_slack(zs, slack);
+	}
 	if (zfs_refcount_remove(&zs->zs_refs, NULL) == 0)
 		dmu_zfetch_stream_fini(zs);
 	aggsum_add(&zfetch_sums.zfetchstat_io_active, -1);
@@ -454,6 +533,218 @@ dmu_zfetch_future(zstream_t *zs, uint64_t blkid, uint64_t nblks)
 	return (0);
 }
 
+/*
+ * Turn a forward stream that has not seen any hits yet into a reverse or
+ * strided one, positioned after the access of nblks at blkid.
+ */
+static void
+dmu_zfetch_convert(zstream_t *zs, zstream_type_t type, uint64_t blkid,
+    uint64_t nblks, uint64_t stride)
+{
+	ASSERT3U(zs->zs_type, ==, ZFETCH_FORWARD);
+	ASSERT0(zs->zs_ipf_dist);
+
+	zs->zs_type = type;
+	zs->zs_stride = stride << ZFETCH_STRIDE_SHIFT;
+	zs->zs_frac = 0;
+	zs->zs_len = MIN(nblks, UINT32_MAX);
+	zs->zs_blkid = blkid + stride;
+	memset(zs->zs_ranges, 0, sizeof (zs->zs_ranges));
+	zs->zs_slack = ZFETCH_SLACK_NONE;
+	zs->zs_adapted = B_FALSE;
+	zs->zs_pf_start = zs->zs_pf_end = type == ZFETCH_STRIDED ?
+	    zs->zs_blkid << ZFETCH_STRIDE_SHIFT : zs->zs_blkid;
+	zs->zs_ipf_start = zs->zs_ipf_end = zs->zs_blkid;
+}
+
+/*
+ * Largest stride, in blocks, that strided streams are created with or may
+ * drift to.  It must also fit zs_stride in fixed point.
+ */
+static uint64_t
+dmu_zfetch_max_stride(unsigned int dbs)
+{
+	return (MIN(zfetch_max_stride >> dbs,
+	    UINT32_MAX >> ZFETCH_STRIDE_SHIFT));
+}
+
+/*
+ * Check whether an access that is not part of any stream continues the first
+ * access of a stream that has not seen any hits yet in the given pattern:
+ * either ending where the previous access started (reverse), or having about
+ * the same size and starting beyond the reorder distance (strided).  If so,
+ * convert the stream.  It will start to prefetch once the pattern repeats.
+ */
+static boolean_t
+dmu_zfetch_detect(zfetch_t *zf, zstream_type_t type, uint64_t blkid,
+    uint64_t end_blkid, uint_t max_reorder)
+{
+	unsigned int dbs = zf->zf_dnode->dn_datablkshift;
+	uint64_t nblks = end_blkid - blkid;
+	zstream_t *zs;
+
+	ASSERT(MUTEX_HELD(&zf->zf_lock));
+
+	for (zs = list_head(&zf->zf_stream); zs != NULL;
+	    zs = list_next(&zf->zf_stream, zs)) {
+		if (zs->zs_type != ZFETCH_FORWARD || zs->zs_ipf_dist != 0 ||
+		    zs->zs_len == 0 || zs->zs_len > zs->zs_blkid)
+			continue;
+		uint64_t prev = zs->zs_blkid - zs->zs_len;
+
+		if (type == ZFETCH_REVERSE) {
+			/* Unaligned accesses may share the boundary block. */
+			if (blkid >= prev || end_blkid < prev ||
+			    end_blkid > prev + 1)
+				continue;
+			dmu_zfetch_convert(zs, type, blkid, nblks, 0);
+		} else {
+			if (blkid <= zs->zs_blkid ||
+			    end_blkid <= zs->zs_blkid + max_reorder ||
+			    nblks > zs->zs_len + 1 || nblks + 1 < zs->zs_len ||
+			    blkid - prev > dmu_zfetch_max_stride(dbs))
+				continue;
+			dmu_zfetch_convert(zs, type, blkid, nblks,
+			    blkid - prev);
+		}
+		return (B_TRUE);
+	}
+	return (B_FALSE);
+}
+
+/*
+ * Strides within the reorder distance look like future accesses to a
+ * forward stream, but never fill it enough to start prefetching.  If the
+ * only future range of a stream without hits is one access of about the
+ * size of the one that created it, and this access repeats the same
+ * distance once more, convert the stream to a strided one instead.
+ */
+static boolean_t
+dmu_zfetch_detect_stride(zstream_t *zs, uint64_t blkid, uint64_t nblks,
+    unsigned int dbs)
+{
+	zsrange_t *r = &zs->zs_ranges[0];
+
+	if (zs->zs_ipf_dist != 0 || r->start == 0 ||
+	    zs->zs_ranges[1].start != 0 || zs->zs_len == 0 ||
+	    r->end - r->start > zs->zs_len + 1 ||
+	    r->end - r->start + 1 < zs->zs_len ||
+	    nblks > zs->zs_len + 1 || nblks + 1 < zs->zs_len)
+		return (B_FALSE);
+
+	/* Previous access was at r->start, the one before it at -zs_len. */
+	uint64_t stride = r->start + zs->zs_len;
+	uint64_t expect = zs->zs_blkid + r->start + stride;
+	if (blkid + 1 < expect || blkid > expect + 1 ||
+	    stride > dmu_zfetch_max_stride(dbs))
+		return (B_FALSE);
+
+	dmu_zfetch_convert(zs, ZFETCH_STRIDED, blkid, nblks, stride);
+	return (B_TRUE);
+}
+
+/*
+ * Process access of blkid to end_blkid against a reverse or strided stream.
+ * Return B_TRUE if it continues the stream, which is then advanced past it.
+ */
+static boolean_t
+dmu_zfetch_pattern_hit(zstream_t *zs, uint64_t blkid, uint64_t end_blkid,
+    unsigned int dbs)
+{
+	switch (zs->zs_type) {
+	case ZFETCH_REVERSE:
+		/* Unaligned accesses may share the boundary block. */
+		if (blkid >= zs->zs_blkid || end_blkid < zs->zs_blkid ||
+		    end_blkid > zs->zs_blkid + 1)
+			return (B_FALSE);
+		zs->zs_blkid = blkid;
+		zs->zs_len = MIN(end_blkid - blkid, UINT32_MAX);
+		ZFETCHSTAT_BUMP(zfetchstat_reverse_hits);
+		return (B_TRUE);
+	case ZFETCH_STRIDED: {
+		/*
+		 * Strides that are not a multiple of the block size make
+		 * accesses land up to a block either way of the expected
+		 * position.  Accept those, and nudge the stride towards the
+		 * observed one, so that its average is learned, but no
+		 * further than a stride that could have created the stream.
+		 */
+		const int64_t one = 1 << ZFETCH_STRIDE_SHIFT;
+		const int64_t max = MAX((int64_t)dmu_zfetch_max_stride(dbs) <<
+		    ZFETCH_STRIDE_SHIFT, one);
+		int64_t expect = (zs->zs_blkid << ZFETCH_STRIDE_SHIFT) |
+		    zs->zs_frac;
+		int64_t pos = blkid << ZFETCH_STRIDE_SHIFT;
+		int64_t err = pos - expect;
+		if (err <= -2 * one || err >= 2 * one)
+			return (B_FALSE);
+		zs->zs_stride = MIN(MAX((int64_t)zs->zs_stride + err / 16,
+		    one), max);
+		pos += zs->zs_stride;
+		zs->zs_blkid = pos >> ZFETCH_STRIDE_SHIFT;
+		zs->zs_frac = pos & (one - 1);
+		zs->zs_len = MIN(MAX(zs->zs_len, end_blkid - blkid),
+		    zs->zs_stride >> ZFETCH_STRIDE_SHIFT);
+		ZFETCHSTAT_BUMP(zfetchstat_strided_hits);
+		return (B_TRUE);
+	}
+	default:
+		return (B_FALSE);
+	}
+}
+
+/*
+ * Calculate further data prefetch distance for a stream hit of nbytes.
+ *
+ * Start prefetch from the demand access size (nblks).  Double the
+ * distance every access up to zfetch_min_distance.  After that only
+ * if needed increase the distance by 1/8 up to zfetch_max_distance.
+ *
+ * Don't double the distance beyond single block if we have more
+ * than ~6% of ARC held by active prefetches.  It should help with
+ * getting out of RAM on some badly mispredicted read patterns.
+ *
+ * With zfetch_adaptive, once prefetches are seen completing, the distance
+ * instead follows what was consumed while they were in flight: the current
+ * distance less the smallest slack they arrived with.  That is how far ahead
+ * prefetch needs to be to hide the device latency at the current read rate.
+ * A quarter of it, or at least one access, is added as margin, and the
+ * distance moves 1/4 of the way there on every hit that has completions to
+ * judge by, so it may also shrink below zfetch_min_distance on fast devices.
+ * Late completions still grow it as above.
+ */
+static unsigned int
+dmu_zfetch_distance(zstream_t *zs, unsigned int nbytes, unsigned int dbs)
+{
+	uint32_t bslack = atomic_swap_32(&zs->zs_slack, ZFETCH_SLACK_NONE);
+	boolean_t known = (bslack != ZFETCH_SLACK_NONE);
+	int64_t slack = (int64_t)bslack - ZFETCH_SLACK_BIAS;
+	boolean_t late = (known && slack < 0);
+
+	if (known && zfetch_adaptive)
+		zs->zs_adapted = B_TRUE;
+	if (unlikely(zs->zs_pf_dist < nbytes)) {
+		zs->zs_pf_dist = nbytes;
+	} else if (zs->zs_pf_dist < zfetch_min_distance &&
+	    (!zfetch_adaptive || !zs->zs_adapted || late) &&
+	    (zs->zs_pf_dist < (1 << dbs) ||
+	    aggsum_compare(&zfetch_sums.zfetchstat_io_active,
+	    arc_c_max >> (4 + dbs)) < 0)) {
+		zs->zs_pf_dist *= 2;
+	} else if (late) {
+		zs->zs_pf_dist += zs->zs_pf_dist / 8;
+	} else if (zfetch_adaptive && known) {
+		int64_t dist = zs->zs_pf_dist;
+		int64_t need = dist - slack * ((int64_t)1 << dbs);
+		int64_t want = need + MAX(need / 4, (int64_t)nbytes);
+		want = MIN(MAX(want, (int64_t)nbytes), zfetch_max_distance);
+		zs->zs_pf_dist = dist + (want - dist) / 4;
+	}
+	if (zs->zs_pf_dist > zfetch_max_distance)
+		zs->zs_pf_dist = zfetch_max_distance;
+	return (zs->zs_pf_dist >> dbs);
+}
+
 /*
  * This is the predictive prefetch entry point.  dmu_zfetch_prepare()
  * associates dnode access specified with blkid and nblks arguments with
@@ -474,6 +765,7 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 	spa_t *spa = zf->zf_dnode->dn_objset->os_spa;
 	zfs_prefetch_type_t os_prefetch = zf->zf_dnode->dn_objset->os_prefetch;
 	int64_t ipf_start, ipf_end;
+	unsigned int pf_nblks;
 
 	if (zfs_prefetch_disable || os_prefetch == ZFS_PREFETCH_NONE)
 		return (NULL);
@@ -522,6 +814,11 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 	uint64_t end_blkid = blkid + nblks;
 	for (zs = list_head(&zf->zf_stream); zs != NULL;
 	    zs = list_next(&zf->zf_stream, zs)) {
+		if (zs->zs_type != ZFETCH_FORWARD) {
+			if (dmu_zfetch_pattern_hit(zs, blkid, end_blkid, dbs))
+				goto pattern;
+			continue;
+		}
 		if (blkid == zs->zs_blkid) {
 			goto hit;
 		} else if (blkid + 1 == zs->zs_blkid) {
@@ -540,8 +837,19 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 	 */
 	uint_t max_reorder = MIN((zfetch_max_reorder >> dbs) + 1, UINT16_MAX);
 	uint_t t = gethrestime_sec() - zfetch_max_sec_reap;
+
+	/*
+	 * An access right before the previous one would otherwise be counted
+	 * as behind a new stream; check if it rather starts a reverse one.
+	 */
+	if (dmu_zfetch_detect(zf, ZFETCH_REVERSE, blkid, end_blkid,
+	    max_reorder))
+		goto detected;
+
 	for (zs = list_head(&zf->zf_stream); zs != NULL;
 	    zs = list_next(&zf->zf_stream, zs)) {
+		if (zs->zs_type != ZFETCH_FORWARD)
+			continue;
 		if (blkid > zs->zs_blkid) {
 			if (end_blkid <= zs->zs_blkid + max_reorder) {
 				if (!fetch_data) {
@@ -550,6 +858,10 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 					ZFETCHSTAT_BUMP(zfetchstat_stride);
 					goto future;
 				}
+				if (zfetch_max_stride != 0 &&
+				    dmu_zfetch_detect_stride(zs, blkid, nblks,
+				    dbs))
+					goto detected;
 				nblks = dmu_zfetch_future(zs, blkid, nblks);
 				if (nblks > 0)
 					ZFETCHSTAT_BUMP(zfetchstat_stride);
@@ -571,16 +883,55 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 
 	/*
 	 * This access is not part of any existing stream.  Create a new
-	 * stream for it unless we are at the end of file.
+	 * stream for it unless we are at the end of file, or it repeats the
+	 * previous access of a young stream at a stride.
 	 */
 	ASSERT0P(zs);
-	if (end_blkid < maxblkid)
-		dmu_zfetch_stream_create(zf, end_blkid);
+	if (!dmu_zfetch_detect(zf, ZFETCH_STRIDED, blkid, end_blkid,
+	    max_reorder) && end_blkid < maxblkid)
+		dmu_zfetch_stream_create(zf, end_blkid, nblks);
+detected:
+	zs = NULL;
 	mutex_exit(&zf->zf_lock);
 	ZFETCHSTAT_BUMP(zfetchstat_misses);
 	ipf_start = 0;
 	goto prescient;
 
+pattern:
+	/*
+	 * Reverse and strided streams only prefetch data, growing distance
+	 * the same way as forward ones.  Indirects are left to the prescient
+	 * prefetch for the demand access and to the data prefetch itself.
+	 */
+	zs->zs_atime = gethrestime_sec();
+	if ((zs->zs_type == ZFETCH_REVERSE && zs->zs_blkid == 0) ||
+	    (zs->zs_type == ZFETCH_STRIDED && zs->zs_blkid > maxblkid)) {
+		dmu_zfetch_stream_remove(zf, zs);
+		goto out;
+	}
+	pf_nblks = fetch_data ?
+	    dmu_zfetch_distance(zs, nblks << dbs, dbs) : 0;
+	if (zs->zs_type == ZFETCH_REVERSE) {
+		uint64_t low = zs->zs_blkid - MIN(pf_nblks, zs->zs_blkid);
+		if (zs->zs_pf_end > zs->zs_blkid)
+			zs->zs_pf_end = zs->zs_blkid;
+		if (zs->zs_pf_start > low)
+			zs->zs_pf_start = low;
+	} else if (pf_nblks > 0) {
+		uint64_t steps = MAX(pf_nblks / zs->zs_len, 1);
+		uint64_t pos = (zs->zs_blkid << ZFETCH_STRIDE_SHIFT) |
+		    zs->zs_frac;
+		if (zs->zs_pf_start < pos)
+			zs->zs_pf_start = pos;
+		if (zs->zs_pf_end < pos + steps * zs->zs_stride)
+			zs->zs_pf_end = pos + steps * zs->zs_stride;
+	}
+	ASSERT3U(zs->zs_pf_start, <=, zs->zs_pf_end);
+	/* Shrink the L1 range so that dmu_zfetch_run() issues nothing. */
+	zs->zs_ipf_start = zs->zs_ipf_end;
+	ipf_start = 0;
+	goto issue;
+
 hit:
 	nblks = dmu_zfetch_hit(zs, nblks);
 	ZFETCHSTAT_BUMP(zfetchstat_hits);
@@ -606,34 +957,9 @@ out:
 	/*
 	 * This access was to a block that we issued a prefetch for on
 	 * behalf of this stream.  Calculate further prefetch distances.
-	 *
-	 * Start prefetch from the demand access size (nblks).  Double the
-	 * distance every access up to zfetch_min_distance.  After that only
-	 * if needed increase the distance by 1/8 up to zfetch_max_distance.
-	 *
-	 * Don't double the distance beyond single block if we have more
-	 * than ~6% of ARC held by active prefetches.  It should help with
-	 * getting out of RAM on some badly mispredicted read patterns.
 	 */
 	unsigned int nbytes = nblks << dbs;
-	unsigned int pf_nblks;
-	if (fetch_data) {
-		if (unlikely(zs->zs_pf_dist < nbytes))
-			zs->zs_pf_dist = nbytes;
-		else if (zs->zs_pf_dist < zfetch_min_distance &&
-		    (zs->zs_pf_dist < (1 << dbs) ||
-		    aggsum_compare(&zfetch_sums.zfetchstat_io_active,
-		    arc_c_max >> (4 + dbs)) < 0))
-			zs->zs_pf_dist *= 2;
-		else if (zs->zs_more)
-			zs->zs_pf_dist += zs->zs_pf_dist / 8;
-		zs->zs_more = B_FALSE;
-		if (zs->zs_pf_dist > zfetch_max_distance)
-			zs->zs_pf_dist = zfetch_max_distance;
-		pf_nblks = zs->zs_pf_dist >> dbs;
-	} else {
-		pf_nblks = 0;
-	}
+	pf_nblks = fetch_data ? dmu_zfetch_distance(zs, nbytes, dbs) : 0;
 	if (zs->zs_pf_start < end_blkid)
 		zs->zs_pf_start = end_blkid;
 	if (zs->zs_pf_end < end_blkid + pf_nblks)
@@ -656,6 +982,7 @@ out:
 	if (zs->zs_ipf_end < zs->zs_pf_end + pf_nblks)
 		zs->zs_ipf_end = zs->zs_pf_end + pf_nblks;
 
+issue:
 	zfs_refcount_add(&zs->zs_refs, NULL);
 	/* Count concurrent callers. */
 	zfs_refcount_add(&zs->zs_callers, NULL);
@@ -692,7 +1019,7 @@ void
 dmu_zfetch_run(zfetch_t *zf, zstream_t *zs, boolean_t missed,
     boolean_t have_lock, boolean_t uncached)
 {
-	int64_t pf_start, pf_end, ipf_start, ipf_end;
+	int64_t pf_start, pf_end, ipf_start, ipf_end, stride, len, nwin;
 	int epbs, issued;
 
 	if (missed)
@@ -710,12 +1037,32 @@ dmu_zfetch_run(zfetch_t *zf, zstream_t *zs, boolean_t missed,
 		return;
 	}
 
+	/*
+	 * Strided streams prefetch a window of len blocks at every stride
+	 * position in their range, with one more block if the stride is not a
+	 * multiple of the block size, to cover the jitter.  Others prefetch a
+	 * contiguous range, which reverse streams consume from the top.
+	 */
 	mutex_enter(&zf->zf_lock);
-	if (zs->zs_missed) {
+	if (!zs->zs_missed) {
+		pf_start = pf_end = 0;
+	} else if (zs->zs_type == ZFETCH_REVERSE) {
+		pf_end = zs->zs_pf_end;
+		pf_start = zs->zs_pf_end = zs->zs_pf_start;
+	} else {
 		pf_start = zs->zs_pf_start;
 		pf_end = zs->zs_pf_start = zs->zs_pf_end;
+	}
+	if (zs->zs_type == ZFETCH_STRIDED) {
+		stride = zs->zs_stride;
+		len = MIN(zs->zs_len + !IS_P2ALIGNED(stride,
+		    1 << ZFETCH_STRIDE_SHIFT), P2ROUNDUP(stride,
+		    1 << ZFETCH_STRIDE_SHIFT) >> ZFETCH_STRIDE_SHIFT);
 	} else {
-		pf_start = pf_end = 0;
+		stride = 1 << ZFETCH_STRIDE_SHIFT;
+		len = 1;
+		pf_start <<= ZFETCH_STRIDE_SHIFT;
+		pf_end <<= ZFETCH_STRIDE_SHIFT;
 	}
 	ipf_start = zs->zs_ipf_start;
 	ipf_end = zs->zs_ipf_start = zs->zs_ipf_end;
@@ -727,7 +1074,8 @@ dmu_zfetch_run(zfetch_t *zf, zstream_t *zs, boolean_t missed,
 	ipf_start = P2ROUNDUP(ipf_start, 1 << epbs) >> epbs;
 	ipf_end = P2ROUNDUP(ipf_end, 1 << epbs) >> epbs;
 	ASSERT3S(ipf_start, <=, ipf_end);
-	issued = pf_end - pf_start + ipf_end - ipf_start;
+	nwin = (pf_end - pf_start) / stride;
+	issued = nwin * len + ipf_end - ipf_start;
 	if (issued > 1) {
 		/* More references on top of taken in dmu_zfetch_prepare(). */
 		zfs_refcount_add_few(&zs->zs_refs, issued - 1, NULL);
@@ -743,10 +1091,13 @@ dmu_zfetch_run(zfetch_t *zf, zstream_t *zs, boolean_t missed,
 		rw_enter(&zf->zf_dnode->dn_struct_rwlock, RW_READER);
 
 	issued = 0;
-	for (int64_t blk = pf_start; blk < pf_end; blk++) {
-		issued += dbuf_prefetch_impl(zf->zf_dnode, 0, blk,
-		    ZIO_PRIORITY_ASYNC_READ, uncached ?
-		    ARC_FLAG_UNCACHED : 0, dmu_zfetch_done, zs);
+	for (int64_t w = 0; w < nwin; w++) {
+		int64_t sblk = (pf_start + w * stride) >> ZFETCH_STRIDE_SHIFT;
+		for (int64_t blk = sblk; blk < sblk + len; blk++) {
+			issued += dbuf_prefetch_impl(zf->zf_dnode, 0, blk,
+			    ZIO_PRIORITY_ASYNC_READ, uncached ?
+			    ARC_FLAG_UNCACHED : 0, dmu_zfetch_done, zs);
+		}
 	}
 	for (int64_t iblk = ipf_start; iblk < ipf_end; iblk++) {
 		issued += dbuf_prefetch_impl(zf->zf_dnode, 1, iblk,
@@ -797,3 +1148,9 @@ ZFS_MODULE_PARAM(zfs_prefetch, zfetch_, max_reorder, UINT, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs_prefetch, zfetch_, hole_shift, UINT, ZMOD_RW,
 	"Max log2 fraction of holes in a stream");
+
+ZFS_MODULE_PARAM(zfs_prefetch, zfetch_, max_stride, UINT, ZMOD_RW,
+	"Max distance between strided accesses within a stream");
+
+ZFS_MODULE_PARAM(zfs_prefetch, zfetch_, adaptive, INT, ZMOD_RW,
+	"Size prefetch distance by how early prefetches complete");
@@ -41,6 +41,7 @@
 #include <sys/vdev_indirect_mapping.h>
 #include <sys/zap.h>
 #include <sys/btree.h>
+#include <sys/wmsum.h>
 
 #define	GANG_ALLOCATION(flags) \
 	((flags) & (METASLAB_GANG_CHILD | METASLAB_GANG_HEADER))
@@ -228,6 +229,28 @@ uint_t metaslab_preload_limit = 10;
  */
 static int metaslab_preload_enabled = B_TRUE;
 
+/*
+ * Enable/disable predictive preloading.  Besides the metaslabs picked by
+ * metaslab_group_preload() at the end of each txg, a group keeps enough
+ * metaslabs loaded (or loading) to absorb its recent allocation rate for
+ * metaslab_preload_predict_factor times the time it takes to load one.
+ * The check is made again from the allocation path when the metaslab in
+ * use is about to run out, so a busy txg does not stall on a space map
+ * read.
+ */
+static int metaslab_preload_predict = B_TRUE;
+
+/*
+ * Number of metaslab load times worth of allocations to keep loaded.
+ */
+static uint_t metaslab_preload_predict_factor = 2;
+
+/*
+ * Max number of metaslabs per group a single predictive pass may start
+ * loading.
+ */
+static uint_t metaslab_preload_predict_limit = 4;
+
 /*
  * Enable/disable fragmentation weighting on metaslabs.
  */
@@ -344,6 +367,15 @@ static int zfs_metaslab_try_hard_before_gang = B_FALSE;
  */
 static uint_t zfs_metaslab_find_max_tries = 100;
 
+/*
+ * Blocks of up to metaslab_alloc_cache_max bytes written in syncing context
+ * are allocated from per-CPU batches of metaslab_alloc_cache_batch bytes,
+ * so that most of them need neither the metaslab group's nor the metaslab's
+ * lock.  Setting metaslab_alloc_cache_max to 0 disables the cache.
+ */
+static uint_t metaslab_alloc_cache_max = 16 * 1024;
+static uint_t metaslab_alloc_cache_batch = 1024 * 1024;
+
 static uint64_t metaslab_weight(metaslab_t *, boolean_t);
 static void metaslab_set_fragmentation(metaslab_t *, boolean_t);
 static void metaslab_free_impl(vdev_t *, uint64_t, uint64_t, boolean_t);
@@ -363,6 +395,14 @@ typedef struct metaslab_stats {
 	kstat_named_t metaslabstat_reload_tree;
 	kstat_named_t metaslabstat_too_many_tries;
 	kstat_named_t metaslabstat_try_hard;
+	kstat_named_t metaslabstat_allocs;
+	kstat_named_t metaslabstat_alloc_bytes;
+	kstat_named_t metaslabstat_cache_hits;
+	kstat_named_t metaslabstat_cache_refills;
+	kstat_named_t metaslabstat_cache_returned_bytes;
+	kstat_named_t metaslabstat_load_waits;
+	kstat_named_t metaslabstat_load_wait_ns;
+	kstat_named_t metaslabstat_predictive_preloads;
 } metaslab_stats_t;
 
 static metaslab_stats_t metaslab_stats = {
@@ -370,11 +410,37 @@ static metaslab_stats_t metaslab_stats = {
 	{ "reload_tree",		KSTAT_DATA_UINT64 },
 	{ "too_many_tries",		KSTAT_DATA_UINT64 },
 	{ "try_hard",			KSTAT_DATA_UINT64 },
+	{ "allocs",			KSTAT_DATA_UINT64 },
+	{ "alloc_bytes",		KSTAT_DATA_UINT64 },
+	{ "cache_hits",			KSTAT_DATA_UINT64 },
+	{ "cache_refills",		KSTAT_DATA_UINT64 },
+	{ "cache_returned_bytes",	KSTAT_DATA_UINT64 },
+	{ "load_waits",			KSTAT_DATA_UINT64 },
+	{ "load_wait_ns",		KSTAT_DATA_UINT64 },
+	{ "predictive_preloads",	KSTAT_DATA_UINT64 },
 };
 
 #define	METASLABSTAT_BUMP(stat) \
 	atomic_inc_64(&metaslab_stats.stat.value.ui64);
 
+/*
+ * Counters updated on every allocation are kept as wmsums and only folded
+ * into metaslab_stats when the kstat is read.
+ */
+static struct {
+	wmsum_t metaslabstat_allocs;
+	wmsum_t metaslabstat_alloc_bytes;
+	wmsum_t metaslabstat_cache_hits;
+	wmsum_t metaslabstat_cache_refills;
+	wmsum_t metaslabstat_cache_returned_bytes;
+	wmsum_t metaslabstat_load_waits;
+	wmsum_t metaslabstat_load_wait_ns;
+	wmsum_t metaslabstat_predictive_preloads;
+} metaslab_sums;
+
+#define	METASLABSUM_ADD(stat, val) \
+	wmsum_add(&metaslab_sums.stat, val)
+
 char *
 metaslab_rt_name(metaslab_group_t *mg, metaslab_t *ms, const char *name)
 {
@@ -388,6 +454,33 @@ metaslab_rt_name(metaslab_group_t *mg, metaslab_t *ms, const char *name)
 
 static kstat_t *metaslab_ksp;
 
+static int
+metaslab_kstat_update(kstat_t *ksp, int rw)
+{
+	metaslab_stats_t *ms = ksp->ks_data;
+
+	if (rw == KSTAT_WRITE)
+		return (SET_ERROR(EACCES));
+
+	ms->metaslabstat_allocs.value.ui64 =
+	    wmsum_value(&metaslab_sums.metaslabstat_allocs);
+	ms->metaslabstat_alloc_bytes.value.ui64 =
+	    wmsum_value(&metaslab_sums.metaslabstat_alloc_bytes);
+	ms->metaslabstat_cache_hits.value.ui64 =
+	    wmsum_value(&metaslab_sums.metaslabstat_cache_hits);
+	ms->metaslabstat_cache_refills.value.ui64 =
+	    wmsum_value(&metaslab_sums.metaslabstat_cache_refills);
+	ms->metaslabstat_cache_returned_bytes.value.ui64 =
+	    wmsum_value(&metaslab_sums.metaslabstat_cache_returned_bytes);
+	ms->metaslabstat_load_waits.value.ui64 =
+	    wmsum_value(&metaslab_sums.metaslabstat_load_waits);
+	ms->metaslabstat_load_wait_ns.value.ui64 =
+	    wmsum_value(&metaslab_sums.metaslabstat_load_wait_ns);
+	ms->metaslabstat_predictive_preloads.value.ui64 =
+	    wmsum_value(&metaslab_sums.metaslabstat_predictive_preloads);
+	return (0);
+}
+
 void
 metaslab_stat_init(void)
 {
@@ -395,11 +488,20 @@ metaslab_stat_init(void)
 	metaslab_alloc_trace_cache = kmem_cache_create(
 	    "metaslab_alloc_trace_cache", sizeof (metaslab_alloc_trace_t),
 	    0, NULL, NULL, NULL, NULL, NULL, 0);
+	wmsum_init(&metaslab_sums.metaslabstat_allocs, 0);
+	wmsum_init(&metaslab_sums.metaslabstat_alloc_bytes, 0);
+	wmsum_init(&metaslab_sums.metaslabstat_cache_hits, 0);
+	wmsum_init(&metaslab_sums.metaslabstat_cache_refills, 0);
+	wmsum_init(&metaslab_sums.metaslabstat_cache_returned_bytes, 0);
+	wmsum_init(&metaslab_sums.metaslabstat_load_waits, 0);
+	wmsum_init(&metaslab_sums.metaslabstat_load_wait_ns, 0);
+	wmsum_init(&metaslab_sums.metaslabstat_predictive_preloads, 0);
 	metaslab_ksp = kstat_create("zfs", 0, "metaslab_stats",
 	    "misc", KSTAT_TYPE_NAMED, sizeof (metaslab_stats) /
 	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
 	if (metaslab_ksp != NULL) {
 		metaslab_ksp->ks_data = &metaslab_stats;
+		metaslab_ksp->ks_update = metaslab_kstat_update;
 		kstat_install(metaslab_ksp);
 	}
 }
@@ -412,6 +514,15 @@ metaslab_stat_fini(void)
 		metaslab_ksp = NULL;
 	}
 
+	wmsum_fini(&metaslab_sums.metaslabstat_allocs);
+	wmsum_fini(&metaslab_sums.metaslabstat_alloc_bytes);
+	wmsum_fini(&metaslab_sums.metaslabstat_cache_hits);
+	wmsum_fini(&metaslab_sums.metaslabstat_cache_refills);
+	wmsum_fini(&metaslab_sums.metaslabstat_cache_returned_bytes);
+	wmsum_fini(&metaslab_sums.metaslabstat_load_waits);
+	wmsum_fini(&metaslab_sums.metaslabstat_load_wait_ns);
+	wmsum_fini(&metaslab_sums.metaslabstat_predictive_preloads);
+
 	kmem_cache_destroy(metaslab_alloc_trace_cache);
 	metaslab_alloc_trace_cache = NULL;
 }
@@ -447,6 +558,13 @@ metaslab_class_create(spa_t *spa, const char *name,
 		mca->mca_rotor = NULL;
 		mca->mca_reserved = 0;
 	}
+	mc->mc_alloc_cache_count = boot_ncpus;
+	mc->mc_alloc_cache = kmem_zalloc(mc->mc_alloc_cache_count *
+	    sizeof (metaslab_alloc_cache_t), KM_SLEEP);
+	for (int i = 0; i < mc->mc_alloc_cache_count; i++) {
+		mutex_init(&mc->mc_alloc_cache[i].mac_lock, NULL,
+		    MUTEX_DEFAULT, NULL);
+	}
 
 	return (mc);
 }
@@ -468,6 +586,12 @@ metaslab_class_destroy(metaslab_class_t *mc)
 		ASSERT0P(mca->mca_rotor);
 		ASSERT0(mca->mca_reserved);
 	}
+	for (int i = 0; i < mc->mc_alloc_cache_count; i++) {
+		ASSERT0(mc->mc_alloc_cache[i].mac_size);
+		mutex_destroy(&mc->mc_alloc_cache[i].mac_lock);
+	}
+	kmem_free(mc->mc_alloc_cache, mc->mc_alloc_cache_count *
+	    sizeof (metaslab_alloc_cache_t));
 	mutex_destroy(&mc->mc_lock);
 	multilist_destroy(&mc->mc_metaslab_txg_list);
 	kmem_free(mc, offsetof(metaslab_class_t,
@@ -2654,6 +2778,16 @@ metaslab_load_impl(metaslab_t *msp)
 	ASSERT3U(max_size, <=, msp->ms_max_size);
 	hrtime_t load_end = gethrtime();
 	msp->ms_load_time = load_end;
+
+	/*
+	 * Fold this load into the group's average load time, which sizes
+	 * the predictive preload horizon.  Concurrent loads in the same
+	 * group may race here; the value is only a hint.
+	 */
+	metaslab_group_t *mg = msp->ms_group;
+	hrtime_t load_time = mg->mg_load_time;
+	mg->mg_load_time = (load_time == 0) ? load_end - load_start :
+	    (3 * load_time + (load_end - load_start)) / 4;
 	zfs_dbgmsg("metaslab_load: txg %llu, spa %s, class %s, vdev_id %llu, "
 	    "ms_id %llu, smp_length %llu, "
 	    "unflushed_allocs %llu, unflushed_frees %llu, "
@@ -3790,6 +3924,93 @@ metaslab_group_preload(metaslab_group_t *mg)
 	mutex_exit(&mg->mg_lock);
 }
 
+/*
+ * Bytes the group is expected to allocate during
+ * metaslab_preload_predict_factor metaslab loads.  The rate is in bytes per
+ * second and the load time in ns; the result saturates instead of wrapping.
+ */
+static uint64_t
+metaslab_group_preload_horizon(metaslab_group_t *mg)
+{
+	uint64_t rate = mg->mg_alloc_rate;
+	hrtime_t load_time = mg->mg_load_time;
+	uint64_t factor = metaslab_preload_predict_factor;
+
+	if (rate == 0 || load_time <= 0)
+		return (0);
+
+	uint64_t sec = load_time / NANOSEC;
+	uint64_t nsec = load_time % NANOSEC;
+	if (sec >= UINT64_MAX / rate)
+		return (UINT64_MAX);
+
+	/*
+	 * rate * (sec + 1) fits, and the sub-second part is split so that no
+	 * product below exceeds it.
+	 */
+	uint64_t bytes = rate * sec + rate / NANOSEC * nsec +
+	    rate % NANOSEC * nsec / NANOSEC;
+	if (factor != 0 && bytes > UINT64_MAX / factor)
+		return (UINT64_MAX);
+	return (bytes * factor);
+}
+
+/*
+ * Make sure the group has enough free space in loaded (or loading)
+ * metaslabs to cover its preload horizon, and start loading the next
+ * metaslabs by weight if it does not.  The first "queued" metaslabs of the
+ * tree have just been handed to the taskq and are counted as loading.
+ * Called at the end of each txg and from the allocation path when the
+ * metaslab being allocated from is close to exhaustion; in the latter
+ * case we may not sleep, so a dispatch that would block is simply dropped.
+ */
+static void
+metaslab_group_preload_predict(metaslab_group_t *mg, uint_t queued,
+    int tqflags)
+{
+	spa_t *spa = mg->mg_vd->vdev_spa;
+	avl_tree_t *t = &mg->mg_metaslab_tree;
+	uint64_t horizon = metaslab_group_preload_horizon(mg);
+	uint64_t ready = 0;
+	uint_t started = 0;
+
+	if (spa_shutting_down(spa) || !metaslab_preload_enabled ||
+	    !metaslab_preload_predict || horizon == 0)
+		return;
+
+	mutex_enter(&mg->mg_lock);
+	for (metaslab_t *msp = avl_first(t); msp != NULL &&
+	    ready < horizon && started < metaslab_preload_predict_limit;
+	    msp = AVL_NEXT(t, msp)) {
+		/*
+		 * ms_loaded, ms_loading and ms_allocated_space are read
+		 * without the ms_lock; a stale value only makes us load
+		 * one metaslab more or less.
+		 */
+		uint64_t avail = msp->ms_size - MIN(msp->ms_size,
+		    msp->ms_allocated_space);
+		if (queued > 0 || msp->ms_loaded || msp->ms_loading) {
+			if (queued > 0)
+				queued--;
+			ready += avail;
+			continue;
+		}
+		if (avail == 0 || msp->ms_disabled > 0)
+			continue;
+
+		if (taskq_dispatch(spa->spa_metaslab_taskq, metaslab_preload,
+		    msp, tqflags) == TASKQID_INVALID)
+			break;
+		ready += avail;
+		started++;
+	}
+	mutex_exit(&mg->mg_lock);
+
+	if (started != 0) {
+		METASLABSUM_ADD(metaslabstat_predictive_preloads, started);
+	}
+}
+
 /*
  * Determine if the space map's on-disk footprint is past our tolerance for
  * inefficiency. We would like to use the following criteria to make our
@@ -4647,6 +4868,7 @@ metaslab_sync_done(metaslab_t *msp, uint64_t txg)
 	ASSERT0(zfs_range_tree_space(msp->ms_freed));
 	ASSERT0(zfs_range_tree_space(msp->ms_checkpointing));
 	msp->ms_allocating_total -= msp->ms_allocated_this_txg;
+	msp->ms_group->mg_txg_alloc += msp->ms_allocated_this_txg;
 	msp->ms_allocated_this_txg = 0;
 	mutex_exit(&msp->ms_lock);
 }
@@ -4660,6 +4882,19 @@ metaslab_sync_reassess(metaslab_group_t *mg)
 	mg->mg_fragmentation = metaslab_group_fragmentation(mg);
 	metaslab_group_alloc_update(mg);
 
+	/*
+	 * Fold the bytes allocated from this group since the last reassess
+	 * into its allocation rate.
+	 */
+	hrtime_t now = gethrtime();
+	if (mg->mg_rate_time != 0) {
+		uint64_t delta_ms = MAX(NSEC2MSEC(now - mg->mg_rate_time), 1);
+		uint64_t rate = mg->mg_txg_alloc / delta_ms * MILLISEC;
+		mg->mg_alloc_rate = (3 * mg->mg_alloc_rate + rate) / 4;
+	}
+	mg->mg_txg_alloc = 0;
+	mg->mg_rate_time = now;
+
 	/*
 	 * Preload the next potential metaslabs but only on active
 	 * metaslab groups. We can get into a state where the metaslab
@@ -4669,6 +4904,8 @@ metaslab_sync_reassess(metaslab_group_t *mg)
 	 */
 	if (mg->mg_activation_count > 0) {
 		metaslab_group_preload(mg);
+		metaslab_group_preload_predict(mg, metaslab_preload_limit,
+		    TQ_SLEEP);
 	}
 	spa_config_exit(spa, SCL_ALLOC, FTAG);
 }
@@ -4986,6 +5223,24 @@ metaslab_active_mask_verify(metaslab_t *msp)
 	}
 }
 
+/*
+ * Account for an allocation that had to wait for a metaslab to load.
+ * Waits in syncing context are also charged to the txg being synced
+ * (reported as "mwait" in the txgs kstat).
+ */
+static void
+metaslab_load_wait_account(metaslab_group_t *mg, uint64_t txg,
+    hrtime_t wait_start)
+{
+	spa_t *spa = mg->mg_class->mc_spa;
+	hrtime_t delta = gethrtime() - wait_start;
+
+	METASLABSUM_ADD(metaslabstat_load_waits, 1);
+	METASLABSUM_ADD(metaslabstat_load_wait_ns, delta);
+	if (txg == spa_syncing_txg(spa))
+		atomic_add_64(&spa->spa_ms_load_wait, delta);
+}
+
 static uint64_t
 metaslab_group_alloc(metaslab_group_t *mg, zio_alloc_list_t *zal,
     uint64_t asize, uint64_t max_asize, uint64_t txg,
@@ -5136,9 +5391,12 @@ metaslab_group_alloc(metaslab_group_t *mg, zio_alloc_list_t *zal,
 
 		metaslab_set_selected_txg(msp, txg);
 
+		hrtime_t wait_start = msp->ms_loaded ? 0 : gethrtime();
 		int activation_error =
 		    metaslab_activate(msp, allocator, activation_weight);
 		metaslab_active_mask_verify(msp);
+		if (wait_start != 0)
+			metaslab_load_wait_account(mg, txg, wait_start);
 
 		/*
 		 * If the metaslab was activated by another thread for
@@ -5214,7 +5472,20 @@ metaslab_group_alloc(metaslab_group_t *mg, zio_alloc_list_t *zal,
 			/* Proactively passivate the metaslab, if needed */
 			if (activated)
 				metaslab_segment_may_passivate(msp);
+			boolean_t predict = metaslab_preload_predict &&
+			    zfs_range_tree_space(msp->ms_allocatable) <
+			    metaslab_group_preload_horizon(mg);
 			mutex_exit(&msp->ms_lock);
+
+			/*
+			 * Only one allocation per group and txg gets to look
+			 * for metaslabs to preload.
+			 */
+			uint64_t last = mg->mg_predict_txg;
+			if (predict && last != txg && atomic_cas_64(
+			    &mg->mg_predict_txg, last, txg) == last)
+				metaslab_group_preload_predict(mg, 0,
+				    TQ_NOSLEEP);
 			break;
 		}
 		metaslab_trace_add(zal, mg, msp, asize, d, offset, allocator);
@@ -5390,10 +5661,20 @@ metaslab_alloc_dva_range(spa_t *spa, metaslab_class_t *mc, uint64_t psize,
 	 * If we are doing gang blocks (hintdva is non-NULL), try to keep
 	 * ourselves on the same vdev as our gang block header.  It makes our
 	 * fault domains something tractable.
+	 *
+	 * For METASLAB_ZIL_STRIPE the hint is the previous block of a log
+	 * chain instead, and we start at the group following it, so that
+	 * consecutive blocks of one chain land on consecutive vdevs of the
+	 * class no matter what other chains sharing the rotor are doing.
 	 */
 	if (hintdva && DVA_IS_VALID(&hintdva[d])) {
 		vd = vdev_lookup_top(spa, DVA_GET_VDEV(&hintdva[d]));
-		mg = vdev_get_mg(vd, mc);
+		if (!(flags & METASLAB_ZIL_STRIPE)) {
+			mg = vdev_get_mg(vd, mc);
+		} else if (vd != NULL && (mg = vdev_get_mg(vd, mc)) != NULL) {
+			mg = (mg->mg_class == mc &&
+			    mg->mg_activation_count > 0) ? mg->mg_next : NULL;
+		}
 	}
 	if (mg == NULL && d != 0) {
 		vd = vdev_lookup_top(spa, DVA_GET_VDEV(&dva[d - 1]));
@@ -5762,6 +6043,144 @@ metaslab_unalloc_dva(spa_t *spa, const dva_t *dva, uint64_t txg)
 	mutex_exit(&msp->ms_lock);
 }
 
+/*
+ * ==========================================================================
+ * Per-CPU allocation cache
+ * ==========================================================================
+ *
+ * For small blocks most of the cost of an allocation is taking the
+ * metaslab group and metaslab locks, which all allocators of a busy pool
+ * contend on.  Instead, a small block written in syncing context allocates
+ * a batch of contiguous space through the normal path, takes its own piece
+ * from the front and leaves the rest in the cache of the CPU it runs on.
+ * Following small blocks allocated on that CPU are carved from the cached
+ * space under only its per-CPU lock.
+ *
+ * The whole batch is in the metaslab's ms_allocating tree for the syncing
+ * txg from the start, so to the rest of the metaslab code it is a single
+ * allocation, and pieces freed early go back through metaslab_unalloc_dva()
+ * as usual.  Whatever is left is returned the same way by
+ * metaslab_class_cache_drain(), which spa_sync() calls once all allocations
+ * of a sync pass are done and before the metaslabs are synced.
+ */
+static void
+metaslab_alloc_cache_return(spa_t *spa, metaslab_alloc_cache_t *mac)
+{
+	dva_t dva = {{ 0 }};
+
+	ASSERT(MUTEX_HELD(&mac->mac_lock));
+
+	if (mac->mac_size == 0)
+		return;
+
+	DVA_SET_VDEV(&dva, mac->mac_vdev);
+	DVA_SET_OFFSET(&dva, mac->mac_offset);
+	DVA_SET_ASIZE(&dva, mac->mac_size);
+	metaslab_unalloc_dva(spa, &dva, mac->mac_txg);
+	METASLABSUM_ADD(metaslabstat_cache_returned_bytes, mac->mac_size);
+	mac->mac_size = 0;
+}
+
+static boolean_t
+metaslab_alloc_cache_usable(spa_t *spa, metaslab_class_t *mc,
+    uint64_t psize, uint64_t max_psize, const dva_t *hintdva, uint64_t txg,
+    int flags)
+{
+	return (psize <= metaslab_alloc_cache_max &&
+	    psize < metaslab_alloc_cache_batch && max_psize == psize &&
+	    hintdva == NULL && !GANG_ALLOCATION(flags) &&
+	    !(flags & METASLAB_ZIL) && !mc->mc_is_log &&
+	    txg == spa_syncing_txg(spa));
+}
+
+/*
+ * Allocate the first DVA of a small block from the current CPU's cache,
+ * refilling it through metaslab_alloc_dva_range() when it runs dry.
+ */
+static int
+metaslab_alloc_dva_cached(spa_t *spa, metaslab_class_t *mc, uint64_t psize,
+    dva_t *dva, uint64_t txg, int flags, zio_alloc_list_t *zal,
+    int allocator)
+{
+	metaslab_alloc_cache_t *mac =
+	    &mc->mc_alloc_cache[CPU_SEQID_UNSTABLE % mc->mc_alloc_cache_count];
+	vdev_t *vd;
+	uint64_t asize;
+
+	mutex_enter(&mac->mac_lock);
+	if (mac->mac_size != 0) {
+		ASSERT3U(mac->mac_txg, ==, txg);
+		vd = vdev_lookup_top(spa, mac->mac_vdev);
+		metaslab_group_t *mg = vdev_get_mg(vd, mc);
+		asize = vdev_psize_to_asize_txg(vd, psize, txg);
+
+		/*
+		 * Leave the space to the normal path if the group has been
+		 * passivated or the device can no longer take allocations.
+		 */
+		if (asize <= mac->mac_size && mg->mg_activation_count > 0 &&
+		    vdev_allocatable(vd)) {
+			DVA_SET_VDEV(&dva[0], mac->mac_vdev);
+			DVA_SET_OFFSET(&dva[0], mac->mac_offset);
+			DVA_SET_GANG(&dva[0], 0);
+			DVA_SET_ASIZE(&dva[0], asize);
+			mac->mac_offset += asize;
+			mac->mac_size -= asize;
+			mutex_exit(&mac->mac_lock);
+
+			metaslab_class_rotate(mg, allocator, psize, B_TRUE);
+			METASLABSUM_ADD(metaslabstat_cache_hits, 1);
+			return (0);
+		}
+		metaslab_alloc_cache_return(spa, mac);
+	}
+	mutex_exit(&mac->mac_lock);
+
+	int error = metaslab_alloc_dva_range(spa, mc, psize,
+	    metaslab_alloc_cache_batch, dva, 0, NULL, txg, flags, zal,
+	    allocator, NULL);
+	if (error != 0)
+		return (error);
+
+	vd = vdev_lookup_top(spa, DVA_GET_VDEV(&dva[0]));
+	asize = vdev_psize_to_asize_txg(vd, psize, txg);
+	uint64_t batch = DVA_GET_ASIZE(&dva[0]);
+	ASSERT3U(asize, <=, batch);
+	if (batch > asize) {
+		DVA_SET_ASIZE(&dva[0], asize);
+
+		mutex_enter(&mac->mac_lock);
+		/* Another thread on this CPU may have refilled it already. */
+		metaslab_alloc_cache_return(spa, mac);
+		mac->mac_txg = txg;
+		mac->mac_vdev = DVA_GET_VDEV(&dva[0]);
+		mac->mac_offset = DVA_GET_OFFSET(&dva[0]) + asize;
+		mac->mac_size = batch - asize;
+		mutex_exit(&mac->mac_lock);
+	}
+	METASLABSUM_ADD(metaslabstat_cache_refills, 1);
+	return (0);
+}
+
+/*
+ * Return the space left in the per-CPU caches to the metaslabs.  Called in
+ * every sync pass before the metaslabs are synced.
+ */
+void
+metaslab_class_cache_drain(metaslab_class_t *mc, uint64_t txg)
+{
+	spa_t *spa = mc->mc_spa;
+
+	for (int i = 0; i < mc->mc_alloc_cache_count; i++) {
+		metaslab_alloc_cache_t *mac = &mc->mc_alloc_cache[i];
+
+		mutex_enter(&mac->mac_lock);
+		ASSERT(mac->mac_size == 0 || mac->mac_txg == txg);
+		metaslab_alloc_cache_return(spa, mac);
+		mutex_exit(&mac->mac_lock);
+	}
+}
+
 /*
  * Free the block represented by the given DVA.
  */
@@ -6004,9 +6423,16 @@ metaslab_alloc_range(spa_t *spa, metaslab_class_t *mc, uint64_t psize,
 	uint64_t smallest_psize = UINT64_MAX;
 	for (int d = 0; d < ndvas; d++) {
 		uint64_t cur_psize = 0;
-		error = metaslab_alloc_dva_range(spa, mc, psize,
-		    MIN(smallest_psize, max_psize), dva, d, hintdva, txg,
-		    flags, zal, allocator, actual_psize ? &cur_psize : NULL);
+		if (d == 0 && metaslab_alloc_cache_usable(spa, mc, psize,
+		    max_psize, hintdva, txg, flags)) {
+			error = metaslab_alloc_dva_cached(spa, mc, psize, dva,
+			    txg, flags, zal, allocator);
+		} else {
+			error = metaslab_alloc_dva_range(spa, mc, psize,
+			    MIN(smallest_psize, max_psize), dva, d, hintdva,
+			    txg, flags, zal, allocator,
+			    actual_psize ? &cur_psize : NULL);
+		}
 		if (error != 0) {
 			for (d--; d >= 0; d--) {
 				metaslab_unalloc_dva(spa, &dva[d], txg);
@@ -6025,6 +6451,9 @@ metaslab_alloc_range(spa_t *spa, metaslab_class_t *mc, uint64_t psize,
 			metaslab_group_alloc_increment(spa,
 			    DVA_GET_VDEV(&dva[d]), allocator, flags, psize,
 			    tag);
+			METASLABSUM_ADD(metaslabstat_allocs, 1);
+			METASLABSUM_ADD(metaslabstat_alloc_bytes,
+			    DVA_GET_ASIZE(&dva[d]));
 			if (actual_psize)
 				smallest_psize = MIN(cur_psize, smallest_psize);
 		}
@@ -6362,6 +6791,15 @@ ZFS_MODULE_PARAM(zfs_metaslab, metaslab_, debug_unload, INT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_metaslab, metaslab_, preload_enabled, INT, ZMOD_RW,
 	"Preload potential metaslabs during reassessment");
 
+ZFS_MODULE_PARAM(zfs_metaslab, metaslab_, preload_predict, INT, ZMOD_RW,
+	"Preload metaslabs ahead of the group's allocation rate");
+
+ZFS_MODULE_PARAM(zfs_metaslab, metaslab_, preload_predict_factor, UINT,
+	ZMOD_RW, "Metaslab load times of allocations to keep loaded");
+
+ZFS_MODULE_PARAM(zfs_metaslab, metaslab_, preload_predict_limit, UINT,
+	ZMOD_RW, "Max metaslabs per group to load in one predictive pass");
+
 ZFS_MODULE_PARAM(zfs_metaslab, metaslab_, preload_limit, UINT, ZMOD_RW,
 	"Max number of metaslabs per group to preload");
 
@@ -6426,6 +6864,12 @@ ZFS_MODULE_PARAM(zfs_metaslab, zfs_metaslab_, try_hard_before_gang, INT,
 ZFS_MODULE_PARAM(zfs_metaslab, zfs_metaslab_, find_max_tries, UINT, ZMOD_RW,
 	"Normally only consider this many of the best metaslabs in each vdev");
 
+ZFS_MODULE_PARAM(zfs_metaslab, metaslab_, alloc_cache_max, UINT, ZMOD_RW,
+	"Largest block allocated from per-CPU batches (0 disables)");
+
+ZFS_MODULE_PARAM(zfs_metaslab, metaslab_, alloc_cache_batch, UINT, ZMOD_RW,
+	"Bytes of space allocated at once for each per-CPU batch");
+
 ZFS_MODULE_PARAM_CALL(zfs, zfs_, active_allocator,
 	param_set_active_allocator, param_get_charp, ZMOD_RW,
 	"SPA active allocator");
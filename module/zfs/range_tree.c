@@ -192,11 +192,18 @@ zfs_range_tree_seg_gap_compare(const void *x1, const void *x2)
 	return ((r1->rs_start >= r2->rs_end) - (r1->rs_end <= r2->rs_start));
 }
 
-ZFS_BTREE_FIND_IN_BUF_FUNC(zfs_range_tree_seg32_find_in_buf, zfs_range_seg32_t,
-    zfs_range_tree_seg32_compare)
+/*
+ * Branch-free form of "compare(r1, r2) < 0" for the fixed-size segment
+ * layouts, used to scan the last few candidates of an in-node search.
+ */
+#define	ZFS_RANGE_SEG_BEFORE(r1, r2)	\
+	(((r1)->rs_end <= (r2)->rs_start) & ((r1)->rs_start < (r2)->rs_end))
 
-ZFS_BTREE_FIND_IN_BUF_FUNC(zfs_range_tree_seg64_find_in_buf, zfs_range_seg64_t,
-    zfs_range_tree_seg64_compare)
+ZFS_BTREE_FIND_IN_BUF_SCAN_FUNC(zfs_range_tree_seg32_find_in_buf,
+    zfs_range_seg32_t, ZFS_RANGE_SEG_BEFORE, zfs_range_tree_seg32_compare)
+
+ZFS_BTREE_FIND_IN_BUF_SCAN_FUNC(zfs_range_tree_seg64_find_in_buf,
+    zfs_range_seg64_t, ZFS_RANGE_SEG_BEFORE, zfs_range_tree_seg64_compare)
 
 ZFS_BTREE_FIND_IN_BUF_FUNC(zfs_range_tree_seg_gap_find_in_buf,
     zfs_range_seg_gap_t, zfs_range_tree_seg_gap_compare)
@@ -741,6 +748,52 @@ zfs_range_tree_swap(zfs_range_tree_t **rtsrc, zfs_range_tree_t **rtdst)
 	*rtdst = rt;
 }
 
+/*
+ * Copy all segments of rtsrc into the empty tree rtdst, which must use the
+ * same segment type, start, shift and gap. Equivalent to walking rtsrc with
+ * zfs_range_tree_add(), but the segments are already sorted and disjoint, so
+ * rtdst's btree is bulk loaded instead of being built one insert at a time.
+ */
+void
+zfs_range_tree_copy(zfs_range_tree_t *rtsrc, zfs_range_tree_t *rtdst)
+{
+	zfs_btree_t *bt = &rtsrc->rt_root;
+	uint64_t nsegs = zfs_btree_numnodes(bt);
+	size_t size = bt->bt_elem_size;
+
+	ASSERT0(zfs_range_tree_space(rtdst));
+	ASSERT0(zfs_btree_numnodes(&rtdst->rt_root));
+	VERIFY3U(rtsrc->rt_type, ==, rtdst->rt_type);
+	VERIFY3U(rtsrc->rt_start, ==, rtdst->rt_start);
+	VERIFY3U(rtsrc->rt_shift, ==, rtdst->rt_shift);
+	VERIFY3U(rtsrc->rt_gap, ==, rtdst->rt_gap);
+
+	if (nsegs == 0)
+		return;
+
+	uint8_t *segs = vmem_alloc(nsegs * size, KM_SLEEP);
+	uint8_t *seg = segs;
+	zfs_btree_index_t where;
+	for (zfs_range_seg_t *rs = zfs_btree_first(bt, &where); rs != NULL;
+	    rs = zfs_btree_next(bt, &where, &where)) {
+		memcpy(seg, rs, size);
+		seg += size;
+	}
+	zfs_btree_bulk_load(&rtdst->rt_root, segs, nsegs);
+	vmem_free(segs, nsegs * size);
+
+	rtdst->rt_space = rtsrc->rt_space;
+	memcpy(rtdst->rt_histogram, rtsrc->rt_histogram,
+	    sizeof (rtdst->rt_histogram));
+
+	if (rtdst->rt_ops != NULL && rtdst->rt_ops->rtop_add != NULL) {
+		bt = &rtdst->rt_root;
+		for (zfs_range_seg_t *rs = zfs_btree_first(bt, &where);
+		    rs != NULL; rs = zfs_btree_next(bt, &where, &where))
+			rtdst->rt_ops->rtop_add(rtdst, rs, rtdst->rt_arg);
+	}
+}
+
 void
 zfs_range_tree_vacate(zfs_range_tree_t *rt, zfs_range_tree_func_t *func,
     void *arg)
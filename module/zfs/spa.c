@@ -84,6 +84,7 @@
 #include <sys/dsl_synctask.h>
 #include <sys/fs/zfs.h>
 #include <sys/arc.h>
+#include <sys/spa_arc_warm.h>
 #include <sys/callb.h>
 #include <sys/systeminfo.h>
 #include <sys/zfs_ioctl.h>
@@ -218,6 +219,13 @@ static const boolean_t spa_create_process = B_TRUE; /* no process => no sysdc */
 
 static uint_t	zio_taskq_write_tpq = 16;
 
+/*
+ * Split the scalable zio taskqs across the online NUMA nodes, binding the
+ * threads of each taskq to the CPUs of one node, and dispatch zios to a
+ * taskq on the node of the submitting thread.
+ */
+int	zio_taskq_numa = 0;
+
 /*
  * Report any spa_load_verify errors found, but do not fail spa_load.
  * This is used by zdb to analyze non-idle pools.
@@ -770,6 +778,12 @@ spa_prop_validate(spa_t *spa, nvlist_t *props)
 				error = SET_ERROR(EINVAL);
 			break;
 
+		case ZPOOL_PROP_IOSCHED:
+			error = nvpair_value_uint64(elem, &intval);
+			if (!error && intval > SPA_IOSCHED_DEADLINE)
+				error = SET_ERROR(EINVAL);
+			break;
+
 		case ZPOOL_PROP_MULTIHOST:
 			error = nvpair_value_uint64(elem, &intval);
 			if (!error && intval > 1)
@@ -1171,6 +1185,10 @@ spa_taskqs_init(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 	uint_t count = ztip->zti_count;
 	spa_taskqs_t *tqs = &spa->spa_zio_taskq[t][q];
 	uint_t cpus, flags = TASKQ_DYNAMIC;
+	uint_t nnodes = 1;
+
+	if (zio_taskq_numa && zio_numa_node_count() > 1)
+		nnodes = zio_numa_node_count();
 
 	switch (mode) {
 	case ZTI_MODE_FIXED:
@@ -1198,6 +1216,13 @@ spa_taskqs_init(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 		value = (zio_taskq_batch_pct + count / 2) / count;
 		value = MIN(value, 100);
 		flags |= TASKQ_THREADS_CPU_PCT;
+
+		/*
+		 * The allocator to taskq mapping is kept, so the taskqs can
+		 * only be spread evenly if there are a multiple of nodes.
+		 */
+		if (count % nnodes != 0)
+			nnodes = 1;
 		break;
 
 	case ZTI_MODE_SCALE:
@@ -1234,11 +1259,14 @@ spa_taskqs_init(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 		}
 		/* Limit each taskq within 100% to not trigger assertion. */
 		count = MAX(count, (zio_taskq_batch_pct + 99) / 100);
-		value = (zio_taskq_batch_pct + count / 2) / count;
+		/* Give every node the same number of taskqs. */
+		count = roundup(count, nnodes);
+		value = MAX(1, (zio_taskq_batch_pct + count / 2) / count);
 		break;
 
 	case ZTI_MODE_NULL:
 		tqs->stqs_count = 0;
+		tqs->stqs_nnodes = 1;
 		tqs->stqs_taskq = NULL;
 		return;
 
@@ -1249,8 +1277,13 @@ spa_taskqs_init(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 		break;
 	}
 
+	if (mode == ZTI_MODE_FIXED)
+		nnodes = 1;
+
 	ASSERT3U(count, >, 0);
+	ASSERT0(count % nnodes);
 	tqs->stqs_count = count;
+	tqs->stqs_nnodes = nnodes;
 	tqs->stqs_taskq = kmem_alloc(count * sizeof (taskq_t *), KM_SLEEP);
 
 	for (uint_t i = 0; i < count; i++) {
@@ -1279,8 +1312,10 @@ spa_taskqs_init(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 			const pri_t pri = (t == ZIO_TYPE_WRITE &&
 			    q == ZIO_TASKQ_ISSUE) ?
 			    wtqclsyspri : maxclsyspri;
-			tq = taskq_create_proc(name, value, pri, 50,
-			    INT_MAX, spa->spa_proc, flags);
+			tq = taskq_create_proc_node(name, value, pri, 50,
+			    INT_MAX, spa->spa_proc, flags,
+			    nnodes > 1 ? zio_numa_node(i % nnodes) :
+			    NUMA_NO_NODE);
 #ifdef HAVE_SYSDC
 		}
 #endif
@@ -1587,7 +1622,8 @@ spa_taskq_dispatch(spa_t *spa, zio_type_t t, zio_taskq_type_t q,
     task_func_t *func, zio_t *zio, boolean_t cutinline)
 {
 	spa_taskqs_t *tqs = &spa->spa_zio_taskq[t][q];
-	taskq_t *tq;
+	uint_t i, node = 0;
+	int nid = 0;
 
 	ASSERT3P(tqs->stqs_taskq, !=, NULL);
 	ASSERT3U(tqs->stqs_count, !=, 0);
@@ -1600,17 +1636,35 @@ spa_taskq_dispatch(spa_t *spa, zio_type_t t, zio_taskq_type_t q,
 	ASSERT(zio);
 	ASSERT(taskq_empty_ent(&zio->io_tqent));
 
+	/*
+	 * Taskq i is bound to the node numbered i % stqs_nnodes.  Nodes
+	 * brought online after module load have no taskqs of their own.
+	 */
+	if (tqs->stqs_nnodes > 1) {
+		nid = CPU_NODEID;
+		node = zio_numa_node_index(nid);
+	}
+
 	if (tqs->stqs_count == 1) {
-		tq = tqs->stqs_taskq[0];
+		i = 0;
 	} else if ((t == ZIO_TYPE_WRITE) && (q == ZIO_TASKQ_ISSUE) &&
 	    ZIO_HAS_ALLOCATOR(zio)) {
-		tq = tqs->stqs_taskq[zio->io_allocator % tqs->stqs_count];
+		i = zio->io_allocator % tqs->stqs_count;
+	} else if (tqs->stqs_nnodes > 1 && node < tqs->stqs_nnodes) {
+		/* Pick one of the taskqs bound to the submitter's node. */
+		i = node + tqs->stqs_nnodes * (((uint64_t)gethrtime()) %
+		    (tqs->stqs_count / tqs->stqs_nnodes));
 	} else {
-		tq = tqs->stqs_taskq[((uint64_t)gethrtime()) % tqs->stqs_count];
+		i = ((uint64_t)gethrtime()) % tqs->stqs_count;
 	}
 
-	taskq_dispatch_ent(tq, func, zio, cutinline ? TQ_FRONT : 0,
-	    &zio->io_tqent);
+	if (tqs->stqs_nnodes > 1) {
+		zio_numa_stat_add(nid, i % tqs->stqs_nnodes == node ?
+		    ZIO_NUMA_DISPATCH_LOCAL : ZIO_NUMA_DISPATCH_REMOTE, 1);
+	}
+
+	taskq_dispatch_ent(tqs->stqs_taskq[i], func, zio,
+	    cutinline ? TQ_FRONT : 0, &zio->io_tqent);
 }
 
 static void
@@ -2074,6 +2128,10 @@ spa_destroy_aux_threads(spa_t *spa)
 		zthr_destroy(spa->spa_raidz_expand_zthr);
 		spa->spa_raidz_expand_zthr = NULL;
 	}
+	if (spa->spa_arc_warm_zthr != NULL) {
+		zthr_destroy(spa->spa_arc_warm_zthr);
+		spa->spa_arc_warm_zthr = NULL;
+	}
 }
 
 static void
@@ -3491,6 +3549,8 @@ spa_spawn_aux_threads(spa_t *spa)
 	    zthr_create("z_checkpoint_discard",
 	    spa_checkpoint_discard_thread_check,
 	    spa_checkpoint_discard_thread, spa, minclsyspri);
+
+	spa_arc_warm_start(spa);
 }
 
 /*
@@ -4864,6 +4924,13 @@ spa_ld_get_props(spa_t *spa)
 	/* Load time log */
 	spa_load_txg_log_time(spa);
 
+	/* Load the ARC warm list, it is only a hint so errors are ignored */
+	error = spa_arc_warm_load(spa);
+	if (error != 0) {
+		spa_load_note(spa, "unable to load ARC warm list "
+		    "[error=%d]", error);
+	}
+
 	/*
 	 * Load the persistent error log.  If we have an older pool, this will
 	 * not be present.
@@ -4960,6 +5027,7 @@ spa_ld_get_props(spa_t *spa)
 		    &spa->spa_dedup_table_quota);
 		spa_prop_find(spa, ZPOOL_PROP_MULTIHOST, &spa->spa_multihost);
 		spa_prop_find(spa, ZPOOL_PROP_AUTOTRIM, &spa->spa_autotrim);
+		spa_prop_find(spa, ZPOOL_PROP_IOSCHED, &spa->spa_iosched);
 		spa->spa_autoreplace = (autoreplace != 0);
 	}
 
@@ -6815,6 +6883,7 @@ spa_create(const char *pool, nvlist_t *nvroot, nvlist_t *props,
 	spa->spa_autoexpand = zpool_prop_default_numeric(ZPOOL_PROP_AUTOEXPAND);
 	spa->spa_multihost = zpool_prop_default_numeric(ZPOOL_PROP_MULTIHOST);
 	spa->spa_autotrim = zpool_prop_default_numeric(ZPOOL_PROP_AUTOTRIM);
+	spa->spa_iosched = zpool_prop_default_numeric(ZPOOL_PROP_IOSCHED);
 	spa->spa_dedup_table_quota =
 	    zpool_prop_default_numeric(ZPOOL_PROP_DEDUP_TABLE_QUOTA);
 
@@ -7287,6 +7356,13 @@ spa_export_common(const char *pool, int new_state, nvlist_t **oldconfig,
 			spa_config_exit(spa, SCL_ALL, FTAG);
 		}
 
+		/*
+		 * Record the hottest blocks still cached so that the next
+		 * import can warm the ARC back up.
+		 */
+		if (new_state == POOL_STATE_EXPORTED && !hardforce)
+			spa_arc_warm_export(spa);
+
 		if (spa_should_sync_time_logger_on_unload(spa))
 			spa_unload_sync_time_logger(spa);
 
@@ -9414,6 +9490,10 @@ spa_async_suspend(spa_t *spa)
 	zthr_t *ll_condense_thread = spa->spa_livelist_condense_zthr;
 	if (ll_condense_thread != NULL)
 		zthr_cancel(ll_condense_thread);
+
+	zthr_t *arc_warm_thread = spa->spa_arc_warm_zthr;
+	if (arc_warm_thread != NULL)
+		zthr_cancel(arc_warm_thread);
 }
 
 void
@@ -9444,6 +9524,10 @@ spa_async_resume(spa_t *spa)
 	zthr_t *ll_condense_thread = spa->spa_livelist_condense_zthr;
 	if (ll_condense_thread != NULL)
 		zthr_resume(ll_condense_thread);
+
+	zthr_t *arc_warm_thread = spa->spa_arc_warm_zthr;
+	if (arc_warm_thread != NULL)
+		zthr_resume(arc_warm_thread);
 }
 
 static boolean_t
@@ -9992,6 +10076,9 @@ spa_sync_props(void *arg, dmu_tx_t *tx)
 				case ZPOOL_PROP_MULTIHOST:
 					spa->spa_multihost = intval;
 					break;
+				case ZPOOL_PROP_IOSCHED:
+					spa->spa_iosched = intval;
+					break;
 				case ZPOOL_PROP_DEDUP_TABLE_QUOTA:
 					spa->spa_dedup_table_quota = intval;
 					break;
@@ -10195,6 +10282,15 @@ spa_sync_iterate_to_convergence(spa_t *spa, dmu_tx_t *tx)
 
 		spa_flush_metaslabs(spa, tx);
 
+		/*
+		 * All allocations of this pass are done; give back what is
+		 * left in the per-CPU allocation caches before the metaslabs
+		 * are synced.
+		 */
+		metaslab_class_cache_drain(spa_normal_class(spa), txg);
+		metaslab_class_cache_drain(spa_special_class(spa), txg);
+		metaslab_class_cache_drain(spa_dedup_class(spa), txg);
+
 		vdev_t *vd = NULL;
 		while ((vd = txg_list_remove(&spa->spa_vdev_txg_list, txg))
 		    != NULL)
@@ -11276,3 +11372,6 @@ ZFS_MODULE_VIRTUAL_PARAM_CALL(zfs_zio, zio_, taskq_write,
 
 ZFS_MODULE_PARAM(zfs_zio, zio_, taskq_write_tpq, UINT, ZMOD_RW,
 	"Number of CPUs per write issue taskq");
+
+ZFS_MODULE_PARAM(zfs_zio, zio_, taskq_numa, INT, ZMOD_RW,
+	"Bind zio taskqs to NUMA nodes and dispatch to the local node");
@@ -0,0 +1,464 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+
+#include <sys/arc.h>
+#include <sys/dbuf.h>
+#include <sys/dmu_objset.h>
+#include <sys/dmu_tx.h>
+#include <sys/dsl_pool.h>
+#include <sys/dsl_synctask.h>
+#include <sys/spa.h>
+#include <sys/spa_arc_warm.h>
+#include <sys/spa_impl.h>
+#include <sys/zap.h>
+#include <sys/zfs_context.h>
+#include <sys/zio.h>
+#include <sys/zthr.h>
+
+/*
+ * ARC warm list
+ *
+ * After an import the ARC starts out empty and it can take a long time for
+ * the working set to be read back in by demand misses.  To shorten that,
+ * the pool periodically records the block pointers of its hottest cached
+ * blocks in a MOS object, and on import a zthr reads them back into the
+ * ARC as low-priority prefetches.
+ *
+ * ARC headers only carry the DVA and birth txg of a block, not the full
+ * block pointer needed to read and verify it, so the list is built from
+ * the dbuf cache instead: every clean, cached dbuf of the pool whose ARC
+ * buffer lives in the MFU state is a candidate, and the ones with the
+ * most MFU hits are kept.  The block pointers are read back with
+ * arc_read() and ZIO_FLAG_SPECULATIVE, so an entry whose block has since
+ * been freed or overwritten simply fails its checksum without generating
+ * an ereport; it never produces a wrong cache hit because ARC lookups are
+ * keyed by DVA and birth txg.
+ *
+ * The list is saved every zfs_arc_warm_interval seconds and once more at
+ * export.  Datasets are normally unmounted before the pool is exported,
+ * which takes their dbufs with them, so the export-time save only replaces
+ * the periodic one when it found at least as many entries.
+ *
+ * Progress is reported in the per-pool "arc_warm" kstat.  Demand hits on
+ * restored blocks are counted in the demand_hit_prescient_prefetch arcstat.
+ */
+
+/* Maximum number of entries in the warm list, 0 disables it */
+static uint_t zfs_arc_warm_entries = 16384;
+
+/* Seconds between saves of the warm list, 0 only saves at export */
+static uint_t zfs_arc_warm_interval = 600;
+
+/* Restore the warm list on import */
+static int zfs_arc_warm_restore = 1;
+
+/* Maximum number of warm list reads in flight while restoring */
+static uint_t zfs_arc_warm_inflight = 32;
+
+/* Entries read from the warm list object at a time while restoring */
+#define	SPA_ARC_WARM_CHUNK	256
+
+typedef struct spa_arc_warm_cand {
+	uint64_t		awc_hits;
+	spa_arc_warm_entry_t	awc_ent;
+} spa_arc_warm_cand_t;
+
+typedef struct spa_arc_warm_collect {
+	spa_t			*awl_spa;
+	spa_arc_warm_cand_t	*awl_heap;	/* min-heap on awc_hits */
+	uint64_t		awl_count;
+	uint64_t		awl_max;
+} spa_arc_warm_collect_t;
+
+typedef struct spa_arc_warm_sync_arg {
+	spa_arc_warm_entry_t	*aws_ents;
+	uint64_t		aws_count;
+} spa_arc_warm_sync_arg_t;
+
+typedef struct spa_arc_warm_read {
+	spa_t		*awr_spa;
+	kmutex_t	awr_lock;
+	kcondvar_t	awr_cv;
+	uint64_t	awr_inflight;
+} spa_arc_warm_read_t;
+
+static void
+spa_arc_warm_sift_down(spa_arc_warm_cand_t *heap, uint64_t count, uint64_t i)
+{
+	for (;;) {
+		uint64_t min = i;
+		uint64_t l = 2 * i + 1;
+		uint64_t r = l + 1;
+
+		if (l < count && heap[l].awc_hits < heap[min].awc_hits)
+			min = l;
+		if (r < count && heap[r].awc_hits < heap[min].awc_hits)
+			min = r;
+		if (min == i)
+			return;
+
+		spa_arc_warm_cand_t tmp = heap[i];
+		heap[i] = heap[min];
+		heap[min] = tmp;
+		i = min;
+	}
+}
+
+static void
+spa_arc_warm_collect_cb(dmu_buf_impl_t *db, void *arg)
+{
+	spa_arc_warm_collect_t *awl = arg;
+	spa_arc_warm_cand_t *heap = awl->awl_heap;
+	arc_buf_info_t abi;
+
+	ASSERT(MUTEX_HELD(&db->db_mtx));
+
+	if (db->db_objset->os_spa != awl->awl_spa ||
+	    db->db_state != DB_CACHED || db->db_buf == NULL ||
+	    db->db_blkid == DMU_BONUS_BLKID || db->db_blkptr == NULL ||
+	    !list_is_empty(&db->db_dirty_records))
+		return;
+
+	const blkptr_t *bp = db->db_blkptr;
+	if (BP_IS_HOLE(bp) || BP_IS_EMBEDDED(bp) || BP_IS_REDACTED(bp))
+		return;
+
+	arc_buf_info(db->db_buf, &abi, 0);
+	if (abi.abi_state_type != ARC_STATE_MFU)
+		return;
+
+	uint64_t i;
+	if (awl->awl_count < awl->awl_max) {
+		i = awl->awl_count++;
+		while (i > 0 && heap[(i - 1) / 2].awc_hits > abi.abi_mfu_hits) {
+			heap[i] = heap[(i - 1) / 2];
+			i = (i - 1) / 2;
+		}
+	} else if (abi.abi_mfu_hits > heap[0].awc_hits) {
+		i = 0;
+	} else {
+		return;
+	}
+
+	spa_arc_warm_cand_t *awc = &heap[i];
+	awc->awc_hits = abi.abi_mfu_hits;
+	awc->awc_ent.awe_bp = *bp;
+	SET_BOOKMARK(&awc->awc_ent.awe_zb, dmu_objset_id(db->db_objset),
+	    db->db.db_object, db->db_level, db->db_blkid);
+
+	if (i == 0 && awl->awl_count == awl->awl_max)
+		spa_arc_warm_sift_down(heap, awl->awl_count, 0);
+}
+
+static void
+spa_arc_warm_sync(void *arg, dmu_tx_t *tx)
+{
+	spa_arc_warm_sync_arg_t *aws = arg;
+	spa_t *spa = dmu_tx_pool(tx)->dp_spa;
+	objset_t *mos = spa->spa_meta_objset;
+	spa_arc_warm_phys_t awp = {
+		.awp_magic = SPA_ARC_WARM_MAGIC,
+		.awp_count = aws->aws_count,
+		.awp_txg = dmu_tx_get_txg(tx),
+	};
+
+	if (spa->spa_arc_warm_obj == 0) {
+		spa->spa_arc_warm_obj = dmu_object_alloc(mos,
+		    DMU_OTN_UINT64_METADATA, SPA_OLD_MAXBLOCKSIZE,
+		    DMU_OT_NONE, 0, tx);
+		VERIFY0(zap_add(mos, DMU_POOL_DIRECTORY_OBJECT,
+		    DMU_POOL_ARC_WARM, sizeof (uint64_t), 1,
+		    &spa->spa_arc_warm_obj, tx));
+	}
+
+	uint64_t len = aws->aws_count * sizeof (spa_arc_warm_entry_t);
+	dmu_write(mos, spa->spa_arc_warm_obj, 0, sizeof (awp), &awp, tx);
+	if (len != 0) {
+		dmu_write(mos, spa->spa_arc_warm_obj, sizeof (awp), len,
+		    aws->aws_ents, tx);
+	}
+	VERIFY0(dmu_free_range(mos, spa->spa_arc_warm_obj,
+	    sizeof (awp) + len, DMU_OBJECT_END, tx));
+
+	spa->spa_arc_warm_count = aws->aws_count;
+}
+
+/*
+ * Collect the pool's hottest MFU blocks and write them out as the new warm
+ * list.  At export only replace the list if it would not shrink.
+ */
+static void
+spa_arc_warm_save(spa_t *spa, boolean_t exporting)
+{
+	dsl_pool_t *dp = spa_get_dsl(spa);
+	spa_arc_warm_collect_t awl = {
+		.awl_spa = spa,
+		.awl_max = zfs_arc_warm_entries,
+	};
+
+	spa->spa_arc_warm_saved = gethrtime();
+	if (awl.awl_max == 0 || !spa_writeable(spa) || spa_suspended(spa))
+		return;
+
+	size_t size = awl.awl_max * sizeof (spa_arc_warm_cand_t);
+	awl.awl_heap = vmem_alloc(size, KM_SLEEP);
+	dbuf_hash_walk(spa_arc_warm_collect_cb, &awl);
+
+	if (awl.awl_count == 0 ||
+	    (exporting && awl.awl_count < spa->spa_arc_warm_count)) {
+		vmem_free(awl.awl_heap, size);
+		return;
+	}
+
+	/*
+	 * Heapsort the candidates so that the hottest come first, then pack
+	 * the entries in place for the on-disk list.
+	 */
+	for (uint64_t n = awl.awl_count - 1; n > 0; n--) {
+		spa_arc_warm_cand_t tmp = awl.awl_heap[0];
+		awl.awl_heap[0] = awl.awl_heap[n];
+		awl.awl_heap[n] = tmp;
+		spa_arc_warm_sift_down(awl.awl_heap, n, 0);
+	}
+	spa_arc_warm_entry_t *ents = (spa_arc_warm_entry_t *)awl.awl_heap;
+	for (uint64_t i = 0; i < awl.awl_count; i++)
+		memmove(&ents[i], &awl.awl_heap[i].awc_ent, sizeof (ents[i]));
+
+	spa_arc_warm_sync_arg_t aws = {
+		.aws_ents = ents,
+		.aws_count = awl.awl_count,
+	};
+	dmu_tx_t *tx = dmu_tx_create_dd(dp->dp_mos_dir);
+	VERIFY0(dmu_tx_assign(tx, DMU_TX_WAIT));
+	uint64_t txg = dmu_tx_get_txg(tx);
+	dsl_sync_task_nowait(dp, spa_arc_warm_sync, &aws, tx);
+	dmu_tx_commit(tx);
+	txg_wait_synced(dp, txg);
+
+	spa_arc_warm_stats_saved(spa, awl.awl_count);
+	vmem_free(awl.awl_heap, size);
+}
+
+static void
+spa_arc_warm_read_done(zio_t *zio, const zbookmark_phys_t *zb,
+    const blkptr_t *bp, arc_buf_t *abuf, void *private)
+{
+	(void) zb, (void) bp;
+	spa_arc_warm_read_t *awr = private;
+
+	if (abuf != NULL)
+		arc_buf_destroy(abuf, private);
+
+	/*
+	 * Cache hits and early failures call back without a zio and are
+	 * accounted for by the issuer.
+	 */
+	if (zio != NULL) {
+		spa_arc_warm_stats_restore_add(awr->awr_spa, 0,
+		    zio->io_error == 0, 0, 0, zio->io_error != 0);
+	}
+
+	mutex_enter(&awr->awr_lock);
+	ASSERT3U(awr->awr_inflight, >, 0);
+	awr->awr_inflight--;
+	cv_broadcast(&awr->awr_cv);
+	mutex_exit(&awr->awr_lock);
+}
+
+static void
+spa_arc_warm_read(spa_t *spa, spa_arc_warm_read_t *awr,
+    const spa_arc_warm_entry_t *awe)
+{
+	const blkptr_t *bp = &awe->awe_bp;
+
+	if (BP_IS_HOLE(bp) || BP_IS_EMBEDDED(bp) || BP_IS_REDACTED(bp) ||
+	    BP_GET_BIRTH(bp) > spa_last_synced_txg(spa) ||
+	    zfs_blkptr_verify(spa, bp, BLK_CONFIG_NEEDED, BLK_VERIFY_ONLY)) {
+		spa_arc_warm_stats_restore_add(spa, 0, 0, 0, 1, 0);
+		return;
+	}
+
+	mutex_enter(&awr->awr_lock);
+	while (awr->awr_inflight >= MAX(zfs_arc_warm_inflight, 1))
+		cv_wait(&awr->awr_cv, &awr->awr_lock);
+	awr->awr_inflight++;
+	mutex_exit(&awr->awr_lock);
+
+	int zio_flags = ZIO_FLAG_CANFAIL | ZIO_FLAG_SPECULATIVE;
+	arc_flags_t aflags = ARC_FLAG_NOWAIT | ARC_FLAG_PREFETCH |
+	    ARC_FLAG_PRESCIENT_PREFETCH | ARC_FLAG_NO_BUF;
+
+	/* dnodes are always read as raw and then converted later */
+	if (BP_GET_TYPE(bp) == DMU_OT_DNODE && BP_IS_PROTECTED(bp) &&
+	    BP_GET_LEVEL(bp) == 0)
+		zio_flags |= ZIO_FLAG_RAW;
+
+	int error = arc_read(NULL, spa, bp, spa_arc_warm_read_done, awr,
+	    ZIO_PRIORITY_ASYNC_READ, zio_flags, &aflags, &awe->awe_zb);
+	if (error != 0)
+		spa_arc_warm_stats_restore_add(spa, 0, 0, 0, 0, 1);
+	else if (aflags & ARC_FLAG_CACHED)
+		spa_arc_warm_stats_restore_add(spa, 0, 0, 1, 0, 0);
+}
+
+/*
+ * Read the warm list back into the ARC.  If the zthr is cancelled the
+ * restore picks up at spa_arc_warm_cursor once it is resumed.
+ */
+static void
+spa_arc_warm_restore_list(spa_t *spa, zthr_t *zthr)
+{
+	objset_t *mos = spa->spa_meta_objset;
+	spa_arc_warm_phys_t awp;
+	spa_arc_warm_read_t awr = { .awr_spa = spa };
+
+	if (dmu_read(mos, spa->spa_arc_warm_obj, 0, sizeof (awp), &awp,
+	    DMU_READ_PREFETCH) != 0 || awp.awp_magic != SPA_ARC_WARM_MAGIC) {
+		spa->spa_arc_warm_restore = B_FALSE;
+		return;
+	}
+	if (spa->spa_arc_warm_cursor == 0)
+		spa_arc_warm_stats_restore_add(spa, awp.awp_count, 0, 0, 0, 0);
+
+	mutex_init(&awr.awr_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&awr.awr_cv, NULL, CV_DEFAULT, NULL);
+
+	size_t size = SPA_ARC_WARM_CHUNK * sizeof (spa_arc_warm_entry_t);
+	spa_arc_warm_entry_t *ents = vmem_alloc(size, KM_SLEEP);
+	while (spa->spa_arc_warm_cursor < awp.awp_count &&
+	    !zthr_iscancelled(zthr)) {
+		uint64_t n = MIN(SPA_ARC_WARM_CHUNK,
+		    awp.awp_count - spa->spa_arc_warm_cursor);
+		if (dmu_read(mos, spa->spa_arc_warm_obj, sizeof (awp) +
+		    spa->spa_arc_warm_cursor * sizeof (spa_arc_warm_entry_t),
+		    n * sizeof (spa_arc_warm_entry_t), ents,
+		    DMU_READ_PREFETCH) != 0) {
+			spa_arc_warm_stats_restore_add(spa, 0, 0, 0, 0,
+			    awp.awp_count - spa->spa_arc_warm_cursor);
+			spa->spa_arc_warm_cursor = awp.awp_count;
+			break;
+		}
+
+		for (uint64_t i = 0; i < n && !zthr_iscancelled(zthr); i++) {
+			spa_arc_warm_read(spa, &awr, &ents[i]);
+			spa->spa_arc_warm_cursor++;
+		}
+	}
+	vmem_free(ents, size);
+
+	mutex_enter(&awr.awr_lock);
+	while (awr.awr_inflight > 0)
+		cv_wait(&awr.awr_cv, &awr.awr_lock);
+	mutex_exit(&awr.awr_lock);
+
+	mutex_destroy(&awr.awr_lock);
+	cv_destroy(&awr.awr_cv);
+
+	if (spa->spa_arc_warm_cursor >= awp.awp_count)
+		spa->spa_arc_warm_restore = B_FALSE;
+}
+
+static boolean_t
+spa_arc_warm_thread_check(void *arg, zthr_t *zthr)
+{
+	(void) zthr;
+	spa_t *spa = arg;
+
+	if (spa->spa_arc_warm_restore)
+		return (B_TRUE);
+
+	return (zfs_arc_warm_entries != 0 && zfs_arc_warm_interval != 0 &&
+	    gethrtime() - spa->spa_arc_warm_saved >=
+	    SEC2NSEC(zfs_arc_warm_interval));
+}
+
+static void
+spa_arc_warm_thread(void *arg, zthr_t *zthr)
+{
+	spa_t *spa = arg;
+
+	if (spa->spa_arc_warm_restore)
+		spa_arc_warm_restore_list(spa, zthr);
+	else
+		spa_arc_warm_save(spa, B_FALSE);
+}
+
+/*
+ * Look up the warm list object during pool load.
+ */
+int
+spa_arc_warm_load(spa_t *spa)
+{
+	spa_arc_warm_phys_t awp;
+	int error;
+
+	spa->spa_arc_warm_count = 0;
+	error = zap_lookup(spa->spa_meta_objset, DMU_POOL_DIRECTORY_OBJECT,
+	    DMU_POOL_ARC_WARM, sizeof (uint64_t), 1, &spa->spa_arc_warm_obj);
+	if (error != 0) {
+		spa->spa_arc_warm_obj = 0;
+		return (error == ENOENT ? 0 : error);
+	}
+
+	error = dmu_read(spa->spa_meta_objset, spa->spa_arc_warm_obj, 0,
+	    sizeof (awp), &awp, DMU_READ_PREFETCH);
+	if (error == 0 && awp.awp_magic == SPA_ARC_WARM_MAGIC)
+		spa->spa_arc_warm_count = awp.awp_count;
+
+	return (error);
+}
+
+void
+spa_arc_warm_start(spa_t *spa)
+{
+	ASSERT0P(spa->spa_arc_warm_zthr);
+
+	spa->spa_arc_warm_cursor = 0;
+	spa->spa_arc_warm_restore = zfs_arc_warm_restore &&
+	    spa->spa_arc_warm_count != 0;
+	spa->spa_arc_warm_saved = gethrtime();
+	spa->spa_arc_warm_zthr = zthr_create_timer("z_arc_warm",
+	    spa_arc_warm_thread_check, spa_arc_warm_thread, spa,
+	    SEC2NSEC(10), minclsyspri);
+}
+
+/*
+ * Called from spa_export_common() once the zthr has been cancelled.
+ */
+void
+spa_arc_warm_export(spa_t *spa)
+{
+	spa_arc_warm_save(spa, B_TRUE);
+}
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_warm_, entries, UINT, ZMOD_RW,
+	"Max number of blocks recorded in the ARC warm list");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_warm_, interval, UINT, ZMOD_RW,
+	"Seconds between ARC warm list saves");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_warm_, restore, INT, ZMOD_RW,
+	"Restore the ARC warm list on pool import");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_warm_, inflight, UINT, ZMOD_RW,
+	"Max ARC warm list reads in flight during restore");
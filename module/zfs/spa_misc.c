@@ -766,6 +766,12 @@ spa_add(const char *name, nvlist_t *config, const char *altroot)
 		mutex_init(&spa->spa_allocs_use->sau_lock, NULL, MUTEX_DEFAULT,
 		    NULL);
 	}
+	spa->spa_zio_batch = kmem_zalloc(2 * spa->spa_alloc_count *
+	    sizeof (spa_zio_batch_t), KM_SLEEP);
+	for (int i = 0; i < 2 * spa->spa_alloc_count; i++) {
+		mutex_init(&spa->spa_zio_batch[i].szb_lock, NULL,
+		    MUTEX_DEFAULT, NULL);
+	}
 
 	avl_create(&spa->spa_metaslabs_by_flushed, metaslab_sort_by_flushed,
 	    sizeof (metaslab_t), offsetof(metaslab_t, ms_spa_txg_node));
@@ -859,6 +865,12 @@ spa_remove(spa_t *spa)
 		kmem_free(spa->spa_allocs_use, offsetof(spa_allocs_use_t,
 		    sau_inuse[spa->spa_alloc_count]));
 	}
+	for (int i = 0; i < 2 * spa->spa_alloc_count; i++) {
+		ASSERT0P(spa->spa_zio_batch[i].szb_open);
+		mutex_destroy(&spa->spa_zio_batch[i].szb_lock);
+	}
+	kmem_free(spa->spa_zio_batch, 2 * spa->spa_alloc_count *
+	    sizeof (spa_zio_batch_t));
 
 	avl_destroy(&spa->spa_metaslabs_by_flushed);
 	avl_destroy(&spa->spa_sm_logs_by_txg);
@@ -2155,6 +2167,12 @@ spa_get_autotrim(spa_t *spa)
 	return (spa->spa_autotrim);
 }
 
+spa_iosched_t
+spa_get_iosched(spa_t *spa)
+{
+	return (spa->spa_iosched);
+}
+
 uint64_t
 spa_deadman_ziotime(spa_t *spa)
 {
@@ -200,6 +200,7 @@ typedef struct spa_txg_history {
 	uint64_t	writes;		/* number of write operations */
 	uint64_t	ndirty;		/* number of dirty bytes */
 	hrtime_t	times[TXG_STATE_COMMITTED]; /* completion times */
+	hrtime_t	mwait;		/* time waited on metaslab loads */
 	procfs_list_node_t	sth_node;
 } spa_txg_history_t;
 
@@ -207,9 +208,9 @@ static int
 spa_txg_history_show_header(struct seq_file *f)
 {
 	seq_printf(f, "%-8s %-16s %-5s %-12s %-12s %-12s "
-	    "%-8s %-8s %-12s %-12s %-12s %-12s\n", "txg", "birth", "state",
-	    "ndirty", "nread", "nwritten", "reads", "writes",
-	    "otime", "qtime", "wtime", "stime");
+	    "%-8s %-8s %-12s %-12s %-12s %-12s %-12s\n", "txg", "birth",
+	    "state", "ndirty", "nread", "nwritten", "reads", "writes",
+	    "otime", "qtime", "wtime", "stime", "mwait");
 	return (0);
 }
 
@@ -247,13 +248,14 @@ spa_txg_history_show(struct seq_file *f, void *data)
 		    sth->times[TXG_STATE_WAIT_FOR_SYNC];
 
 	seq_printf(f, "%-8llu %-16llu %-5c %-12llu "
-	    "%-12llu %-12llu %-8llu %-8llu %-12llu %-12llu %-12llu %-12llu\n",
+	    "%-12llu %-12llu %-8llu %-8llu %-12llu %-12llu %-12llu %-12llu "
+	    "%-12llu\n",
 	    (longlong_t)sth->txg, sth->times[TXG_STATE_BIRTH], state,
 	    (u_longlong_t)sth->ndirty,
 	    (u_longlong_t)sth->nread, (u_longlong_t)sth->nwritten,
 	    (u_longlong_t)sth->reads, (u_longlong_t)sth->writes,
 	    (u_longlong_t)open, (u_longlong_t)quiesce, (u_longlong_t)wait,
-	    (u_longlong_t)sync);
+	    (u_longlong_t)sync, (u_longlong_t)sth->mwait);
 
 	return (0);
 }
@@ -370,7 +372,8 @@ spa_txg_history_set(spa_t *spa, uint64_t txg, txg_state_t completed_state,
  */
 static int
 spa_txg_history_set_io(spa_t *spa, uint64_t txg, uint64_t nread,
-    uint64_t nwritten, uint64_t reads, uint64_t writes, uint64_t ndirty)
+    uint64_t nwritten, uint64_t reads, uint64_t writes, uint64_t ndirty,
+    hrtime_t mwait)
 {
 	spa_history_list_t *shl = &spa->spa_stats.txg_history;
 	spa_txg_history_t *sth;
@@ -388,6 +391,7 @@ spa_txg_history_set_io(spa_t *spa, uint64_t txg, uint64_t nread,
 			sth->reads = reads;
 			sth->writes = writes;
 			sth->ndirty = ndirty;
+			sth->mwait = mwait;
 			error = 0;
 			break;
 		}
@@ -402,6 +406,8 @@ spa_txg_history_init_io(spa_t *spa, uint64_t txg, dsl_pool_t *dp)
 {
 	txg_stat_t *ts;
 
+	spa->spa_ms_load_wait = 0;
+
 	if (zfs_txg_history == 0)
 		return (NULL);
 
@@ -440,7 +446,7 @@ spa_txg_history_fini_io(spa_t *spa, txg_stat_t *ts)
 	    ts->vs2.vs_bytes[ZIO_TYPE_WRITE] - ts->vs1.vs_bytes[ZIO_TYPE_WRITE],
 	    ts->vs2.vs_ops[ZIO_TYPE_READ] - ts->vs1.vs_ops[ZIO_TYPE_READ],
 	    ts->vs2.vs_ops[ZIO_TYPE_WRITE] - ts->vs1.vs_ops[ZIO_TYPE_WRITE],
-	    ts->ndirty);
+	    ts->ndirty, spa->spa_ms_load_wait);
 
 	kmem_free(ts, sizeof (txg_stat_t));
 }
@@ -549,6 +555,377 @@ spa_tx_assign_add_nsecs(spa_t *spa, uint64_t nsecs)
 	atomic_inc_64(&((kstat_named_t *)shk->priv)[idx].value.ui64);
 }
 
+/*
+ * ==========================================================================
+ * SPA I/O Scheduler Routines
+ * ==========================================================================
+ */
+
+/*
+ * Leaf vdev queue statistics, summed over all leaf vdevs of the pool and
+ * exported in /proc/spl/kstat/zfs/<pool>/iosched.  They are only recorded
+ * while the pool's iosched property is "deadline".  For each I/O class: the
+ * number of I/Os issued, how many of them had waited in the queue longer
+ * than their deadline target, how often the deadline scheduler lowered the
+ * class's active limit, and a power of two histogram of the queue wait.
+ * Writing to the kstat zeroes it.
+ */
+#define	SPA_IOSCHED_HISTO_BUCKETS	25	/* 1us to 16s */
+
+typedef struct spa_iosched_stats {
+	zio_priority_t	sis_class;
+	uint64_t	sis_issued;
+	uint64_t	sis_late;
+	uint64_t	sis_throttled;
+	uint64_t	sis_wait_histo[SPA_IOSCHED_HISTO_BUCKETS];
+} spa_iosched_stats_t;
+
+static const char *const spa_iosched_class_names[] = {
+	"sync_read",
+	"sync_write",
+	"async_read",
+	"async_write",
+	"scrub",
+	"removal",
+	"initializing",
+	"trim",
+	"rebuild",
+};
+
+_Static_assert(ARRAY_SIZE(spa_iosched_class_names) ==
+    ZIO_PRIORITY_NUM_QUEUEABLE, "one name per queueable I/O class");
+
+static int
+spa_iosched_headers(char *buf, size_t size)
+{
+	ssize_t off = 0;
+
+	off += snprintf(buf + off, size - off, "%-14s %-12s %-12s %-12s",
+	    "class", "issued", "late", "throttled");
+	for (int i = 0; i < SPA_IOSCHED_HISTO_BUCKETS; i++) {
+		uint64_t us = 1ULL << i;
+
+		if (us < 1000) {
+			off += snprintf(buf + off, size - off, " %6lluus",
+			    (u_longlong_t)us);
+		} else if (us < 1000000) {
+			off += snprintf(buf + off, size - off, " %6llums",
+			    (u_longlong_t)us / 1000);
+		} else {
+			off += snprintf(buf + off, size - off, " %7llus",
+			    (u_longlong_t)us / 1000000);
+		}
+	}
+	(void) snprintf(buf + off, size - off, "\n");
+
+	return (0);
+}
+
+static int
+spa_iosched_data(char *buf, size_t size, void *data)
+{
+	spa_iosched_stats_t *sis = (spa_iosched_stats_t *)data;
+	ssize_t off = 0;
+
+	off += snprintf(buf + off, size - off, "%-14s %-12llu %-12llu %-12llu",
+	    spa_iosched_class_names[sis->sis_class],
+	    (u_longlong_t)sis->sis_issued, (u_longlong_t)sis->sis_late,
+	    (u_longlong_t)sis->sis_throttled);
+	for (int i = 0; i < SPA_IOSCHED_HISTO_BUCKETS; i++) {
+		off += snprintf(buf + off, size - off, " %8llu",
+		    (u_longlong_t)sis->sis_wait_histo[i]);
+	}
+	(void) snprintf(buf + off, size - off, "\n");
+
+	return (0);
+}
+
+static void *
+spa_iosched_addr(kstat_t *ksp, loff_t n)
+{
+	spa_t *spa = ksp->ks_private;
+	spa_iosched_stats_t *sis = spa->spa_stats.iosched.priv;
+
+	if (n < ZIO_PRIORITY_NUM_QUEUEABLE)
+		return (&sis[n]);
+	return (NULL);
+}
+
+static int
+spa_iosched_update(kstat_t *ksp, int rw)
+{
+	spa_t *spa = ksp->ks_private;
+	spa_iosched_stats_t *sis = spa->spa_stats.iosched.priv;
+
+	if (rw == KSTAT_WRITE) {
+		for (zio_priority_t p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE;
+		    p++) {
+			memset(&sis[p], 0, sizeof (spa_iosched_stats_t));
+			sis[p].sis_class = p;
+		}
+	}
+
+	return (0);
+}
+
+static void
+spa_iosched_init(spa_t *spa)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.iosched;
+	spa_iosched_stats_t *sis;
+	char *name;
+	kstat_t *ksp;
+
+	mutex_init(&shk->lock, NULL, MUTEX_DEFAULT, NULL);
+
+	shk->count = ZIO_PRIORITY_NUM_QUEUEABLE;
+	shk->size = shk->count * sizeof (spa_iosched_stats_t);
+	shk->priv = sis = kmem_zalloc(shk->size, KM_SLEEP);
+	for (zio_priority_t p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++)
+		sis[p].sis_class = p;
+
+	name = kmem_asprintf("zfs/%s", spa_name(spa));
+	ksp = kstat_create(name, 0, "iosched", "misc",
+	    KSTAT_TYPE_RAW, 0, KSTAT_FLAG_VIRTUAL);
+
+	shk->kstat = ksp;
+	if (ksp) {
+		ksp->ks_lock = &shk->lock;
+		ksp->ks_data = NULL;
+		ksp->ks_ndata = ZIO_PRIORITY_NUM_QUEUEABLE;
+		ksp->ks_private = spa;
+		ksp->ks_update = spa_iosched_update;
+		kstat_set_raw_ops(ksp, spa_iosched_headers, spa_iosched_data,
+		    spa_iosched_addr);
+		kstat_install(ksp);
+	}
+
+	kmem_strfree(name);
+}
+
+static void
+spa_iosched_destroy(spa_t *spa)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.iosched;
+	kstat_t *ksp = shk->kstat;
+	if (ksp)
+		kstat_delete(ksp);
+
+	kmem_free(shk->priv, shk->size);
+	mutex_destroy(&shk->lock);
+}
+
+/*
+ * Called by the leaf vdev queues when an I/O is issued; wait is the time
+ * it spent queued.
+ */
+void
+spa_iosched_stats_issue(spa_t *spa, zio_priority_t p, hrtime_t wait,
+    boolean_t late)
+{
+	spa_iosched_stats_t *sis = spa->spa_stats.iosched.priv;
+	uint_t idx = MIN(highbit64(MAX(wait, 0) / 1000),
+	    SPA_IOSCHED_HISTO_BUCKETS - 1);
+
+	ASSERT3U(p, <, ZIO_PRIORITY_NUM_QUEUEABLE);
+	atomic_inc_64(&sis[p].sis_issued);
+	atomic_inc_64(&sis[p].sis_wait_histo[idx]);
+	if (late)
+		atomic_inc_64(&sis[p].sis_late);
+}
+
+void
+spa_iosched_stats_throttle(spa_t *spa, zio_priority_t p)
+{
+	spa_iosched_stats_t *sis = spa->spa_stats.iosched.priv;
+
+	ASSERT3U(p, <, ZIO_PRIORITY_NUM_QUEUEABLE);
+	atomic_inc_64(&sis[p].sis_throttled);
+}
+
+/*
+ * ==========================================================================
+ * SPA ZIL SLOG Routines
+ * ==========================================================================
+ */
+
+/*
+ * ZIL commit statistics of every top-level log vdev of the pool, exported in
+ * /proc/spl/kstat/zfs/<pool>/zil_slog.  For each log vdev: the number of
+ * lwbs written to it that became stable, the log bytes they carried, and
+ * the total, average and maximum time from lwb issue until the lwb and
+ * everything before it in the chain was stable.  The counters live in the
+ * vdev itself and are snapshot on every read; writing to the kstat zeroes
+ * them.
+ */
+typedef struct spa_zil_slog_stats {
+	uint64_t	szs_guid;
+	uint64_t	szs_lwbs;
+	uint64_t	szs_bytes;
+	uint64_t	szs_lat_total;
+	uint64_t	szs_lat_max;
+} spa_zil_slog_stats_t;
+
+static int
+spa_zil_slog_headers(char *buf, size_t size)
+{
+	(void) snprintf(buf, size, "%-20s %-12s %-14s %-14s %-10s %-10s\n",
+	    "vdev_guid", "lwbs", "bytes", "latency_us", "avg_us", "max_us");
+
+	return (0);
+}
+
+static int
+spa_zil_slog_data(char *buf, size_t size, void *data)
+{
+	spa_zil_slog_stats_t *szs = (spa_zil_slog_stats_t *)data;
+	uint64_t total_us = NSEC2USEC(szs->szs_lat_total);
+
+	(void) snprintf(buf, size,
+	    "0x%-18llx %-12llu %-14llu %-14llu %-10llu %-10llu\n",
+	    (u_longlong_t)szs->szs_guid, (u_longlong_t)szs->szs_lwbs,
+	    (u_longlong_t)szs->szs_bytes, (u_longlong_t)total_us,
+	    (u_longlong_t)(szs->szs_lwbs ? total_us / szs->szs_lwbs : 0),
+	    (u_longlong_t)NSEC2USEC(szs->szs_lat_max));
+
+	return (0);
+}
+
+static void *
+spa_zil_slog_addr(kstat_t *ksp, loff_t n)
+{
+	spa_t *spa = ksp->ks_private;
+	spa_history_kstat_t *shk = &spa->spa_stats.zil_slog;
+	spa_zil_slog_stats_t *szs = shk->priv;
+
+	if (n < shk->count)
+		return (&szs[n]);
+	return (NULL);
+}
+
+static int
+spa_zil_slog_update(kstat_t *ksp, int rw)
+{
+	spa_t *spa = ksp->ks_private;
+	spa_history_kstat_t *shk = &spa->spa_stats.zil_slog;
+	spa_zil_slog_stats_t *szs;
+	vdev_t *rvd;
+	uint64_t count = 0;
+
+	if (shk->priv != NULL)
+		kmem_free(shk->priv, shk->size);
+	shk->priv = NULL;
+	shk->size = 0;
+	shk->count = 0;
+	ksp->ks_ndata = 0;
+
+	spa_config_enter(spa, SCL_VDEV, FTAG, RW_READER);
+	if ((rvd = spa->spa_root_vdev) == NULL) {
+		spa_config_exit(spa, SCL_VDEV, FTAG);
+		return (0);
+	}
+	for (uint64_t c = 0; c < rvd->vdev_children; c++) {
+		if (rvd->vdev_child[c]->vdev_islog)
+			count++;
+	}
+	if (count == 0) {
+		spa_config_exit(spa, SCL_VDEV, FTAG);
+		return (0);
+	}
+
+	shk->size = count * sizeof (spa_zil_slog_stats_t);
+	shk->priv = szs = kmem_zalloc(shk->size, KM_SLEEP);
+	for (uint64_t c = 0; c < rvd->vdev_children; c++) {
+		vdev_t *vd = rvd->vdev_child[c];
+
+		if (!vd->vdev_islog)
+			continue;
+		if (rw == KSTAT_WRITE) {
+			atomic_store_64(&vd->vdev_zil_lwbs, 0);
+			atomic_store_64(&vd->vdev_zil_bytes, 0);
+			atomic_store_64(&vd->vdev_zil_lat_total, 0);
+			atomic_store_64(&vd->vdev_zil_lat_max, 0);
+		}
+		szs->szs_guid = vd->vdev_guid;
+		szs->szs_lwbs = atomic_load_64(&vd->vdev_zil_lwbs);
+		szs->szs_bytes = atomic_load_64(&vd->vdev_zil_bytes);
+		szs->szs_lat_total = atomic_load_64(&vd->vdev_zil_lat_total);
+		szs->szs_lat_max = atomic_load_64(&vd->vdev_zil_lat_max);
+		szs++;
+	}
+	spa_config_exit(spa, SCL_VDEV, FTAG);
+
+	shk->count = count;
+	ksp->ks_ndata = count;
+
+	return (0);
+}
+
+static void
+spa_zil_slog_init(spa_t *spa)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.zil_slog;
+	char *name;
+	kstat_t *ksp;
+
+	mutex_init(&shk->lock, NULL, MUTEX_DEFAULT, NULL);
+
+	name = kmem_asprintf("zfs/%s", spa_name(spa));
+	ksp = kstat_create(name, 0, "zil_slog", "misc",
+	    KSTAT_TYPE_RAW, 0, KSTAT_FLAG_VIRTUAL);
+
+	shk->kstat = ksp;
+	if (ksp) {
+		ksp->ks_lock = &shk->lock;
+		ksp->ks_data = NULL;
+		ksp->ks_private = spa;
+		ksp->ks_update = spa_zil_slog_update;
+		kstat_set_raw_ops(ksp, spa_zil_slog_headers, spa_zil_slog_data,
+		    spa_zil_slog_addr);
+		kstat_install(ksp);
+	}
+
+	kmem_strfree(name);
+}
+
+static void
+spa_zil_slog_destroy(spa_t *spa)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.zil_slog;
+	kstat_t *ksp = shk->kstat;
+	if (ksp)
+		kstat_delete(ksp);
+
+	if (shk->priv != NULL)
+		kmem_free(shk->priv, shk->size);
+	mutex_destroy(&shk->lock);
+}
+
+/*
+ * Called by the ZIL when an lwb written to the top-level log vdev "vdev"
+ * becomes stable, latency being the time since the lwb was issued.  The
+ * caller holds SCL_STATE.
+ */
+void
+spa_zil_slog_stats_add(spa_t *spa, uint64_t vdev, uint64_t bytes,
+    hrtime_t latency)
+{
+	vdev_t *vd = vdev_lookup_top(spa, vdev);
+	uint64_t lat = MAX(latency, 0);
+	uint64_t max;
+
+	if (vd == NULL || !vd->vdev_islog)
+		return;
+
+	atomic_inc_64(&vd->vdev_zil_lwbs);
+	atomic_add_64(&vd->vdev_zil_bytes, bytes);
+	atomic_add_64(&vd->vdev_zil_lat_total, lat);
+	while ((max = atomic_load_64(&vd->vdev_zil_lat_max)) < lat) {
+		if (atomic_cas_64(&vd->vdev_zil_lat_max, max, lat) == max)
+			break;
+	}
+}
+
 /*
  * ==========================================================================
  * SPA MMP History Routines
@@ -987,6 +1364,51 @@ spa_iostats_write_add(spa_t *spa, uint64_t size, uint64_t iops,
 	}
 }
 
+static const spa_arc_warm_stats_t spa_arc_warm_stats_template = {
+	{ "saves",				KSTAT_DATA_UINT64 },
+	{ "saved_entries",			KSTAT_DATA_UINT64 },
+	{ "restore_entries",			KSTAT_DATA_UINT64 },
+	{ "restore_read",			KSTAT_DATA_UINT64 },
+	{ "restore_cached",			KSTAT_DATA_UINT64 },
+	{ "restore_skipped",			KSTAT_DATA_UINT64 },
+	{ "restore_errors",			KSTAT_DATA_UINT64 },
+};
+
+#define	SPA_ARC_WARM_STATS_ADD(stat, val) \
+    atomic_add_64(&awstats->stat.value.ui64, (val));
+
+void
+spa_arc_warm_stats_saved(spa_t *spa, uint64_t entries)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.arc_warm;
+	kstat_t *ksp = shk->kstat;
+
+	if (ksp == NULL)
+		return;
+
+	spa_arc_warm_stats_t *awstats = ksp->ks_data;
+	SPA_ARC_WARM_STATS_ADD(saves, 1);
+	awstats->saved_entries.value.ui64 = entries;
+}
+
+void
+spa_arc_warm_stats_restore_add(spa_t *spa, uint64_t entries, uint64_t read,
+    uint64_t cached, uint64_t skipped, uint64_t errors)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.arc_warm;
+	kstat_t *ksp = shk->kstat;
+
+	if (ksp == NULL)
+		return;
+
+	spa_arc_warm_stats_t *awstats = ksp->ks_data;
+	SPA_ARC_WARM_STATS_ADD(restore_entries, entries);
+	SPA_ARC_WARM_STATS_ADD(restore_read, read);
+	SPA_ARC_WARM_STATS_ADD(restore_cached, cached);
+	SPA_ARC_WARM_STATS_ADD(restore_skipped, skipped);
+	SPA_ARC_WARM_STATS_ADD(restore_errors, errors);
+}
+
 static int
 spa_iostats_update(kstat_t *ksp, int rw)
 {
@@ -1037,6 +1459,45 @@ spa_iostats_destroy(spa_t *spa)
 	mutex_destroy(&shk->lock);
 }
 
+static void
+spa_arc_warm_stats_init(spa_t *spa)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.arc_warm;
+
+	mutex_init(&shk->lock, NULL, MUTEX_DEFAULT, NULL);
+
+	char *name = kmem_asprintf("zfs/%s", spa_name(spa));
+	kstat_t *ksp = kstat_create(name, 0, "arc_warm", "misc",
+	    KSTAT_TYPE_NAMED,
+	    sizeof (spa_arc_warm_stats_t) / sizeof (kstat_named_t),
+	    KSTAT_FLAG_VIRTUAL);
+
+	shk->kstat = ksp;
+	if (ksp) {
+		int size = sizeof (spa_arc_warm_stats_t);
+		ksp->ks_lock = &shk->lock;
+		ksp->ks_private = spa;
+		ksp->ks_data = kmem_alloc(size, KM_SLEEP);
+		memcpy(ksp->ks_data, &spa_arc_warm_stats_template, size);
+		kstat_install(ksp);
+	}
+
+	kmem_strfree(name);
+}
+
+static void
+spa_arc_warm_stats_destroy(spa_t *spa)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.arc_warm;
+	kstat_t *ksp = shk->kstat;
+	if (ksp) {
+		kmem_free(ksp->ks_data, sizeof (spa_arc_warm_stats_t));
+		kstat_delete(ksp);
+	}
+
+	mutex_destroy(&shk->lock);
+}
+
 void
 spa_stats_init(spa_t *spa)
 {
@@ -1047,11 +1508,17 @@ spa_stats_init(spa_t *spa)
 	spa_state_init(spa);
 	spa_guid_init(spa);
 	spa_iostats_init(spa);
+	spa_arc_warm_stats_init(spa);
+	spa_iosched_init(spa);
+	spa_zil_slog_init(spa);
 }
 
 void
 spa_stats_destroy(spa_t *spa)
 {
+	spa_zil_slog_destroy(spa);
+	spa_iosched_destroy(spa);
+	spa_arc_warm_stats_destroy(spa);
 	spa_iostats_destroy(spa);
 	spa_health_destroy(spa);
 	spa_tx_assign_destroy(spa);
@@ -3484,9 +3484,14 @@ vdev_dtl_load(vdev_t *vd)
 		    ZFS_RT_F_DYN_NAME, vdev_rt_name(vd, "vdev_dtl_load:rt"));
 		error = space_map_load(vd->vdev_dtl_sm, rt, SM_ALLOC);
 		if (error == 0) {
+			zfs_range_tree_t *missing = vd->vdev_dtl[DTL_MISSING];
 			mutex_enter(&vd->vdev_dtl_lock);
-			zfs_range_tree_walk(rt, zfs_range_tree_add,
-			    vd->vdev_dtl[DTL_MISSING]);
+			if (zfs_range_tree_is_empty(missing)) {
+				zfs_range_tree_copy(rt, missing);
+			} else {
+				zfs_range_tree_walk(rt, zfs_range_tree_add,
+				    missing);
+			}
 			mutex_exit(&vd->vdev_dtl_lock);
 		}
 
@@ -3633,7 +3638,7 @@ vdev_dtl_sync(vdev_t *vd, uint64_t txg)
 	    ZFS_RT_F_DYN_NAME, vdev_rt_name(vd, "rtsync"));
 
 	mutex_enter(&vd->vdev_dtl_lock);
-	zfs_range_tree_walk(rt, zfs_range_tree_add, rtsync);
+	zfs_range_tree_copy(rt, rtsync);
 	mutex_exit(&vd->vdev_dtl_lock);
 
 	space_map_truncate(vd->vdev_dtl_sm, zfs_vdev_dtl_sm_blksz, tx);
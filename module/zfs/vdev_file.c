@@ -52,6 +52,15 @@ static taskq_t *vdev_file_taskq;
 static uint_t vdev_file_logical_ashift = SPA_MINBLOCKSHIFT;
 static uint_t vdev_file_physical_ashift = SPA_MINBLOCKSHIFT;
 
+#ifndef _KERNEL
+/*
+ * Issue reads and writes of file vdevs in libzpool through io_uring when
+ * the running kernel supports it, instead of a synchronous pread/pwrite
+ * per request on vdev_file_taskq.
+ */
+static int vdev_file_uring = 1;
+#endif
+
 void
 vdev_file_init(void)
 {
@@ -59,11 +68,17 @@ vdev_file_init(void)
 	    minclsyspri, boot_ncpus, INT_MAX, TASKQ_DYNAMIC);
 
 	VERIFY(vdev_file_taskq);
+#ifndef _KERNEL
+	vdev_file_uring_init();
+#endif
 }
 
 void
 vdev_file_fini(void)
 {
+#ifndef _KERNEL
+	vdev_file_uring_fini();
+#endif
 	taskq_destroy(vdev_file_taskq);
 }
 
@@ -298,6 +313,11 @@ vdev_file_io_start(zio_t *zio)
 	ASSERT(zio->io_type == ZIO_TYPE_READ || zio->io_type == ZIO_TYPE_WRITE);
 	zio->io_target_timestamp = zio_handle_io_delay(zio);
 
+#ifndef _KERNEL
+	if (vdev_file_uring && vdev_file_uring_io_start(zio))
+		return;
+#endif
+
 	VERIFY3U(taskq_dispatch(vdev_file_taskq, vdev_file_io_strategy, zio,
 	    TQ_SLEEP), !=, TASKQID_INVALID);
 }
@@ -370,3 +390,8 @@ ZFS_MODULE_PARAM(zfs_vdev_file, vdev_file_, logical_ashift, UINT, ZMOD_RW,
 	"Logical ashift for file-based devices");
 ZFS_MODULE_PARAM(zfs_vdev_file, vdev_file_, physical_ashift, UINT, ZMOD_RW,
 	"Physical ashift for file-based devices");
+
+#ifndef _KERNEL
+ZFS_MODULE_PARAM(zfs_vdev_file, vdev_file_, uring, INT, ZMOD_RW,
+	"Use io_uring for file-based devices in userspace");
+#endif
@@ -116,6 +116,18 @@
  * maximum percentage, this indicates that the rate of incoming data is
  * greater than the rate that the backend storage can handle. In this case, we
  * must further throttle incoming writes (see dmu_tx_delay() for details).
+ *
+ * Deadline Mode
+ *
+ * With the pool's iosched property set to "deadline", each I/O class also
+ * has a target latency (zfs_vdev_*_target_us), measured from the time an
+ * I/O is queued until it completes.  Every vdev keeps an exponentially
+ * weighted moving average of that latency per class.  When a class runs
+ * over its target, the max_active of every class with a looser target is
+ * halved, down to its min_active; while no tighter class is late, each
+ * completion of a throttled class raises its limit by one again.  Queued
+ * I/Os which have waited longer than their target are issued ahead of LBA
+ * order.  See vdev_queue_latency_update().
  */
 
 /*
@@ -161,6 +173,25 @@ static uint_t zfs_vdev_trim_max_active = 2;
 static uint_t zfs_vdev_rebuild_min_active = 1;
 static uint_t zfs_vdev_rebuild_max_active = 3;
 
+/*
+ * Per-queue latency targets of the deadline scheduler, in microseconds.
+ */
+static uint_t zfs_vdev_sync_read_target_us = 10000;
+static uint_t zfs_vdev_sync_write_target_us = 10000;
+static uint_t zfs_vdev_async_read_target_us = 50000;
+static uint_t zfs_vdev_async_write_target_us = 200000;
+static uint_t zfs_vdev_scrub_target_us = 500000;
+static uint_t zfs_vdev_removal_target_us = 500000;
+static uint_t zfs_vdev_initializing_target_us = 1000000;
+static uint_t zfs_vdev_trim_target_us = 1000000;
+static uint_t zfs_vdev_rebuild_target_us = 500000;
+
+/*
+ * Weight of a new sample in the per-queue latency averages, as a power of
+ * two: each completion moves the average 1/8th of the way to its latency.
+ */
+#define	VDQ_EWMA_SHIFT	3
+
 /*
  * When the pool has less than zfs_vdev_async_write_active_min_dirty_percent
  * dirty data, use zfs_vdev_async_write_min_active.  When it has more than
@@ -197,9 +228,17 @@ static uint_t zfs_vdev_nia_credit = 5;
  * To reduce IOPs, we aggregate small adjacent I/Os into one large I/O.
  * For read I/Os, we also aggregate across small adjacency gaps; for writes
  * we include spans of optional I/Os to aid aggregation at the disk even when
- * they aren't able to help us aggregate at this level.
+ * they aren't able to help us aggregate at this level.  Aggregates are gang
+ * ABDs referencing the member buffers directly (write gaps share the zero
+ * page).  Only the Linux vdev_disk submits such a gang without linearizing
+ * it first (see vdev_disk_gang_bounce()), so only there does a large limit
+ * cost no extra copying; elsewhere the aggregate is copied into one buffer.
  */
+#if defined(__linux__) && defined(_KERNEL)
+static uint_t zfs_vdev_aggregation_limit = SPA_MAXBLOCKSIZE;
+#else
 static uint_t zfs_vdev_aggregation_limit = 1 << 20;
+#endif
 static uint_t zfs_vdev_aggregation_limit_non_rotating = SPA_OLD_MAXBLOCKSIZE;
 static uint_t zfs_vdev_read_gap_limit = 32 << 10;
 static uint_t zfs_vdev_write_gap_limit = 4 << 10;
@@ -401,6 +440,57 @@ vdev_queue_class_max_active(vdev_queue_t *vq, zio_priority_t p)
 	}
 }
 
+static hrtime_t
+vdev_queue_class_target(zio_priority_t p)
+{
+	switch (p) {
+	case ZIO_PRIORITY_SYNC_READ:
+		return (USEC2NSEC(zfs_vdev_sync_read_target_us));
+	case ZIO_PRIORITY_SYNC_WRITE:
+		return (USEC2NSEC(zfs_vdev_sync_write_target_us));
+	case ZIO_PRIORITY_ASYNC_READ:
+		return (USEC2NSEC(zfs_vdev_async_read_target_us));
+	case ZIO_PRIORITY_ASYNC_WRITE:
+		return (USEC2NSEC(zfs_vdev_async_write_target_us));
+	case ZIO_PRIORITY_SCRUB:
+		return (USEC2NSEC(zfs_vdev_scrub_target_us));
+	case ZIO_PRIORITY_REMOVAL:
+		return (USEC2NSEC(zfs_vdev_removal_target_us));
+	case ZIO_PRIORITY_INITIALIZING:
+		return (USEC2NSEC(zfs_vdev_initializing_target_us));
+	case ZIO_PRIORITY_TRIM:
+		return (USEC2NSEC(zfs_vdev_trim_target_us));
+	case ZIO_PRIORITY_REBUILD:
+		return (USEC2NSEC(zfs_vdev_rebuild_target_us));
+	default:
+		panic("invalid priority %u", p);
+		return (0);
+	}
+}
+
+/*
+ * Is the pool in deadline mode?  On a switch into it, drop whatever limits
+ * were left over from the last time, so that a class throttled back then
+ * does not start out throttled now.
+ */
+static boolean_t
+vdev_queue_deadline(vdev_queue_t *vq)
+{
+	boolean_t deadline = (spa_get_iosched(vq->vq_vdev->vdev_spa) ==
+	    SPA_IOSCHED_DEADLINE);
+
+	ASSERT(MUTEX_HELD(&vq->vq_lock));
+	if (deadline && !vq->vq_dl_on) {
+		for (zio_priority_t p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++)
+			vq->vq_dl_max[p] = UINT32_MAX;
+		vq->vq_dl_late = 0;
+		vq->vq_dl_backoff_ts = 0;
+	}
+	vq->vq_dl_on = deadline;
+
+	return (deadline);
+}
+
 /*
  * Return the i/o class to issue from, or ZIO_PRIORITY_NUM_QUEUEABLE if
  * there is no eligible class.
@@ -409,6 +499,7 @@ static zio_priority_t
 vdev_queue_class_to_issue(vdev_queue_t *vq)
 {
 	uint32_t cq = vq->vq_cqueued;
+	boolean_t deadline = vdev_queue_deadline(vq);
 	zio_priority_t p, p1;
 
 	if (cq == 0 || vq->vq_active >= zfs_vdev_max_active)
@@ -435,11 +526,12 @@ vdev_queue_class_to_issue(vdev_queue_t *vq)
 
 	/*
 	 * If we haven't found a queue, look for one that hasn't reached its
-	 * maximum # outstanding i/os.
+	 * maximum # outstanding i/os, as lowered by the deadline scheduler.
 	 */
 	for (p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++) {
 		if ((cq & (1U << p)) != 0 && vq->vq_cactive[p] <
-		    vdev_queue_class_max_active(vq, p))
+		    vdev_queue_class_max_active(vq, p) &&
+		    (!deadline || vq->vq_cactive[p] < vq->vq_dl_max[p]))
 			break;
 	}
 
@@ -475,6 +567,8 @@ vdev_queue_init(vdev_t *vd)
 	    offsetof(struct zio, io_offset_node));
 
 	vq->vq_last_offset = 0;
+	for (p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++)
+		vq->vq_dl_max[p] = UINT32_MAX;
 	list_create(&vq->vq_active_list, sizeof (struct zio),
 	    offsetof(struct zio, io_queue_node.l));
 	mutex_init(&vq->vq_lock, NULL, MUTEX_DEFAULT, NULL);
@@ -539,6 +633,12 @@ vdev_queue_pending_add(vdev_queue_t *vq, zio_t *zio)
 {
 	ASSERT(MUTEX_HELD(&vq->vq_lock));
 	ASSERT3U(zio->io_priority, <, ZIO_PRIORITY_NUM_QUEUEABLE);
+	if (vdev_queue_deadline(vq)) {
+		hrtime_t wait = gethrtime() - zio->io_timestamp;
+		spa_iosched_stats_issue(vq->vq_vdev->vdev_spa,
+		    zio->io_priority, wait,
+		    wait > vdev_queue_class_target(zio->io_priority));
+	}
 	vq->vq_cactive[zio->io_priority]++;
 	vq->vq_active++;
 	if (vdev_queue_is_interactive(zio->io_priority)) {
@@ -569,6 +669,75 @@ vdev_queue_pending_remove(vdev_queue_t *vq, zio_t *zio)
 	zio->io_queue_state = ZIO_QS_NONE;
 }
 
+/*
+ * Is any class with a tighter target than the given one late and still
+ * busy?  Classes that went idle are forgotten, since their average is no
+ * longer being updated.
+ */
+static boolean_t
+vdev_queue_tighter_late(vdev_queue_t *vq, hrtime_t target)
+{
+	for (zio_priority_t c = 0; c < ZIO_PRIORITY_NUM_QUEUEABLE; c++) {
+		if (!(vq->vq_dl_late & (1U << c)) ||
+		    vdev_queue_class_target(c) >= target)
+			continue;
+		if ((vq->vq_cqueued & (1U << c)) || vq->vq_cactive[c] > 0)
+			return (B_TRUE);
+		vq->vq_dl_late &= ~(1U << c);
+	}
+	return (B_FALSE);
+}
+
+/*
+ * Fold the latency of a completed i/o into the moving average of its class.
+ * In deadline mode, if the class is over its target, halve the max_active
+ * of the classes with looser targets, at most once per target interval so
+ * that every step is judged on fresh samples.  A throttled class gets its
+ * limit raised by one for each of its completions while no tighter class
+ * is late, until it is back at its usual max_active.
+ */
+static void
+vdev_queue_latency_update(vdev_queue_t *vq, zio_priority_t p, hrtime_t lat,
+    hrtime_t now)
+{
+	hrtime_t target = vdev_queue_class_target(p);
+
+	ASSERT(MUTEX_HELD(&vq->vq_lock));
+	vq->vq_lat_ewma[p] += (lat - vq->vq_lat_ewma[p]) /
+	    (1 << VDQ_EWMA_SHIFT);
+
+	if (!vdev_queue_deadline(vq))
+		return;
+
+	if (vq->vq_lat_ewma[p] > target) {
+		vq->vq_dl_late |= 1U << p;
+		if (now - vq->vq_dl_backoff_ts >= target) {
+			vq->vq_dl_backoff_ts = now;
+			for (zio_priority_t c = 0;
+			    c < ZIO_PRIORITY_NUM_QUEUEABLE; c++) {
+				if (vdev_queue_class_target(c) <= target)
+					continue;
+				uint32_t max = MIN(vq->vq_dl_max[c],
+				    vdev_queue_class_max_active(vq, c));
+				uint32_t min = MAX(1,
+				    vdev_queue_class_min_active(vq, c));
+				if (max <= min)
+					continue;
+				vq->vq_dl_max[c] = MAX(max / 2, min);
+				spa_iosched_stats_throttle(
+				    vq->vq_vdev->vdev_spa, c);
+			}
+		}
+	} else {
+		vq->vq_dl_late &= ~(1U << p);
+	}
+
+	if (vq->vq_dl_max[p] != UINT32_MAX &&
+	    !vdev_queue_tighter_late(vq, target) &&
+	    ++vq->vq_dl_max[p] >= vdev_queue_class_max_active(vq, p))
+		vq->vq_dl_max[p] = UINT32_MAX;
+}
+
 static void
 vdev_queue_agg_io_done(zio_t *aio)
 {
@@ -833,11 +1002,14 @@ again:
 		 * For LBA-ordered queues (async / scrub / initializing),
 		 * issue the I/O which follows the most recently issued I/O
 		 * in LBA (offset) order, but to avoid starvation only within
-		 * the same 0.5 second interval as the first I/O.
+		 * the same 0.5 second interval as the first I/O.  In deadline
+		 * mode, the first I/O goes next once it is past its target.
 		 */
 		tree = &vq->vq_class[p].vqc_tree;
 		zio = aio = avl_first(tree);
-		if (zio->io_offset < vq->vq_last_offset) {
+		if (zio->io_offset < vq->vq_last_offset &&
+		    !(vdev_queue_deadline(vq) && gethrtime() -
+		    aio->io_timestamp > vdev_queue_class_target(p))) {
 			vq->vq_io_search.io_timestamp = zio->io_timestamp;
 			vq->vq_io_search.io_offset = vq->vq_last_offset;
 			zio = avl_find(tree, &vq->vq_io_search, &idx);
@@ -956,6 +1128,7 @@ vdev_queue_io_done(zio_t *zio)
 
 	mutex_enter(&vq->vq_lock);
 	vdev_queue_pending_remove(vq, zio);
+	vdev_queue_latency_update(vq, zio->io_priority, zio->io_delta, now);
 
 	while ((nio = vdev_queue_io_to_issue(vq)) != NULL) {
 		mutex_exit(&vq->vq_lock);
@@ -1138,6 +1311,33 @@ ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, rebuild_max_active, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, rebuild_min_active, UINT, ZMOD_RW,
 	"Min active rebuild I/Os per vdev");
 
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, sync_read_target_us, UINT, ZMOD_RW,
+	"Target sync read latency per vdev in deadline mode");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, sync_write_target_us, UINT, ZMOD_RW,
+	"Target sync write latency per vdev in deadline mode");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, async_read_target_us, UINT, ZMOD_RW,
+	"Target async read latency per vdev in deadline mode");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, async_write_target_us, UINT, ZMOD_RW,
+	"Target async write latency per vdev in deadline mode");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, scrub_target_us, UINT, ZMOD_RW,
+	"Target scrub latency per vdev in deadline mode");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, removal_target_us, UINT, ZMOD_RW,
+	"Target removal latency per vdev in deadline mode");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, initializing_target_us, UINT, ZMOD_RW,
+	"Target initializing latency per vdev in deadline mode");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, trim_target_us, UINT, ZMOD_RW,
+	"Target trim/discard latency per vdev in deadline mode");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, rebuild_target_us, UINT, ZMOD_RW,
+	"Target rebuild latency per vdev in deadline mode");
+
 ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, nia_credit, UINT, ZMOD_RW,
 	"Number of non-interactive I/Os to allow in sequence");
 
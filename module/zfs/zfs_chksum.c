@@ -43,6 +43,7 @@ typedef struct {
 	uint64_t bs1m;
 	uint64_t bs4m;
 	uint64_t bs16m;
+	uint32_t nbufs;
 	zio_cksum_salt_t salt;
 	zio_checksum_t *(func);
 	zio_checksum_tmpl_init_t *(init);
@@ -59,6 +60,9 @@ static int chksum_stat_limit = AT_STARTUP;
 static int chksum_stat_cnt = 0;
 static void chksum_benchmark(void);
 
+/* number of buffers hashed per call by the multi-buffer benchmarks */
+#define	CHKSUM_MULTI_BUFS	8
+
 /*
  * Sample output on i3-1005G1 System:
  *
@@ -181,11 +185,30 @@ chksum_run(chksum_stat_t *cs, abd_t *abd, void *ctx, int round,
 	} while (run_time_ns < MSEC2NSEC(1));
 	kpreempt_enable();
 
-	run_bw = size * run_count * NANOSEC;
+	run_bw = size * MAX(cs->nbufs, 1) * run_count * NANOSEC;
 	run_bw /= run_time_ns; /* B/s */
 	*result = run_bw/1024/1024; /* MiB/s */
 }
 
+/*
+ * Multi-buffer fletcher 4, the same block is passed for every buffer of the
+ * batch.  chksum_run() accounts for all of them via cs->nbufs.
+ */
+static void
+chksum_fletcher_4_multi(abd_t *abd, uint64_t size,
+    const void *ctx_template, zio_cksum_t *zcp)
+{
+	(void) ctx_template;
+	abd_t *abds[CHKSUM_MULTI_BUFS];
+	zio_cksum_t zcps[CHKSUM_MULTI_BUFS];
+
+	for (int i = 0; i < CHKSUM_MULTI_BUFS; i++)
+		abds[i] = abd;
+
+	abd_fletcher_4_native_multi(abds, size, zcps, CHKSUM_MULTI_BUFS);
+	*zcp = zcps[0];
+}
+
 static void
 chksum_benchit(chksum_stat_t *cs)
 {
@@ -253,6 +276,7 @@ chksum_benchmark(void)
 	/* count implementations */
 	chksum_stat_cnt = 1;  /* edonr */
 	chksum_stat_cnt += 1; /* skein */
+	chksum_stat_cnt += 2; /* fletcher4, single and multi-buffer */
 	chksum_stat_cnt += sha256->getcnt();
 	chksum_stat_cnt += sha512->getcnt();
 	chksum_stat_cnt += blake3->getcnt();
@@ -279,6 +303,24 @@ chksum_benchmark(void)
 	cs->impl = "generic";
 	chksum_benchit(cs);
 
+	/* fletcher4, with the implementation selected by fletcher_4_impl */
+	cs = &chksum_stat_data[cbid++];
+	cs->init = 0;
+	cs->func = abd_fletcher_4_native;
+	cs->free = 0;
+	cs->name = "fletcher4";
+	cs->impl = "x1";
+	chksum_benchit(cs);
+
+	cs = &chksum_stat_data[cbid++];
+	cs->init = 0;
+	cs->func = chksum_fletcher_4_multi;
+	cs->free = 0;
+	cs->nbufs = CHKSUM_MULTI_BUFS;
+	cs->name = "fletcher4";
+	cs->impl = "x8";
+	chksum_benchit(cs);
+
 	/* sha256 */
 	id_save = sha256->getid();
 	for (max = 0, id = 0; id < sha256->getcnt(); id++) {
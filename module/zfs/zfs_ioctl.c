@@ -192,6 +192,7 @@
 #include <sys/zfs_ctldir.h>
 #include <sys/zfs_dir.h>
 #include <sys/zfs_onexit.h>
+#include <sys/zfs_rlock.h>
 #include <sys/zvol.h>
 #include <sys/dsl_scan.h>
 #include <sys/fm/util.h>
@@ -8233,8 +8234,13 @@ zfs_kmod_init(void)
 {
 	int error;
 
-	if ((error = zvol_init()) != 0)
+	/* Range locks are taken by the ZPL and zvols */
+	zfs_rangelock_stat_init();
+
+	if ((error = zvol_init()) != 0) {
+		zfs_rangelock_stat_fini();
 		return (error);
+	}
 
 	spa_init(SPA_MODE_READ | SPA_MODE_WRITE);
 	zfs_init();
@@ -8255,6 +8261,7 @@ out:
 	zfs_fini();
 	spa_fini();
 	zvol_fini();
+	zfs_rangelock_stat_fini();
 
 	return (error);
 }
@@ -8282,6 +8289,7 @@ zfs_kmod_fini(void)
 	zfs_fini();
 	spa_fini();
 	zvol_fini();
+	zfs_rangelock_stat_fini();
 
 	tsd_destroy(&rrw_tsd_key);
 	tsd_destroy(&zfs_allow_log_key);
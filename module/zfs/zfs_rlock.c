@@ -109,10 +109,155 @@
  * So if the block size needs to be grown then the whole file is
  * exclusively locked, then later the caller will reduce the lock
  * range to just the range to be written using rangelock_reduce().
+ *
+ * Sharded fast path
+ * -----------------
+ * With many threads doing I/O to disjoint ranges of one file, rl_lock
+ * becomes the point of contention even though none of the ranges conflict.
+ * Once rl_lock has been found contended (and zfs_rangelock_shards is
+ * non-zero) the rangelock grows an array of shards, each with its own mutex
+ * and AVL tree.  The file is divided into buckets of
+ * 2^zfs_rangelock_shard_shift bytes which are assigned to the shards
+ * round-robin.  A reader, or a writer which the callback leaves unchanged,
+ * whose range lies within a single bucket is locked in that bucket's shard
+ * without touching rl_lock.  Overlapping ranges always share a bucket, so
+ * they meet in the same shard tree and the rules above apply there.
+ *
+ * Everything else (appends, growing the block size, truncation and ranges
+ * spanning buckets) takes the slow path through rl_tree.  While any slow
+ * path lock is held or wanted (rl_nslow) the shards are closed: new ranges
+ * fall back to the slow path, and a slow path lock additionally waits on
+ * rs_drain_cv for any conflicting range still held in a shard.  The shards
+ * reopen when the last slow path lock is dropped.  The lock order is
+ * rl_lock before rs_lock.
  */
 
 #include <sys/zfs_context.h>
 #include <sys/zfs_rlock.h>
+#include <sys/wmsum.h>
+
+/*
+ * Maximum number of shards a rangelock is split into once rl_lock is found
+ * contended, or 0 to always use the single tree.
+ */
+static uint_t zfs_rangelock_shards = 16;
+
+/*
+ * log2 of the size of the buckets which are assigned to the shards.
+ */
+static uint_t zfs_rangelock_shard_shift = 20;
+
+typedef struct rangelock_stats {
+	kstat_named_t rangelock_fast;
+	kstat_named_t rangelock_fast_wait;
+	kstat_named_t rangelock_fast_contended;
+	kstat_named_t rangelock_fast_fallback;
+	kstat_named_t rangelock_slow;
+	kstat_named_t rangelock_slow_wait;
+	kstat_named_t rangelock_slow_contended;
+	kstat_named_t rangelock_slow_close;
+} rangelock_stats_t;
+
+static rangelock_stats_t rangelock_stats = {
+	/* ranges locked in a shard */
+	{ "fast",			KSTAT_DATA_UINT64 },
+	/* waits for a conflicting range in a shard */
+	{ "fast_wait",			KSTAT_DATA_UINT64 },
+	/* shard mutex found held */
+	{ "fast_contended",		KSTAT_DATA_UINT64 },
+	/* shard attempts which had to take the slow path */
+	{ "fast_fallback",		KSTAT_DATA_UINT64 },
+	/* ranges locked in rl_tree */
+	{ "slow",			KSTAT_DATA_UINT64 },
+	/* waits for a conflicting range in rl_tree or a shard */
+	{ "slow_wait",			KSTAT_DATA_UINT64 },
+	/* rl_lock found held */
+	{ "slow_contended",		KSTAT_DATA_UINT64 },
+	/* shards closed for the slow path */
+	{ "slow_close",			KSTAT_DATA_UINT64 },
+};
+
+static struct {
+	wmsum_t rangelock_fast;
+	wmsum_t rangelock_fast_wait;
+	wmsum_t rangelock_fast_contended;
+	wmsum_t rangelock_fast_fallback;
+	wmsum_t rangelock_slow;
+	wmsum_t rangelock_slow_wait;
+	wmsum_t rangelock_slow_contended;
+	wmsum_t rangelock_slow_close;
+} rangelock_sums;
+
+#define	RANGELOCKSTAT_BUMP(stat)	wmsum_add(&rangelock_sums.stat, 1)
+
+static kstat_t *rangelock_ksp;
+
+static int
+rangelock_kstats_update(kstat_t *ksp, int rw)
+{
+	rangelock_stats_t *rs = ksp->ks_data;
+
+	if (rw == KSTAT_WRITE)
+		return (EACCES);
+	rs->rangelock_fast.value.ui64 =
+	    wmsum_value(&rangelock_sums.rangelock_fast);
+	rs->rangelock_fast_wait.value.ui64 =
+	    wmsum_value(&rangelock_sums.rangelock_fast_wait);
+	rs->rangelock_fast_contended.value.ui64 =
+	    wmsum_value(&rangelock_sums.rangelock_fast_contended);
+	rs->rangelock_fast_fallback.value.ui64 =
+	    wmsum_value(&rangelock_sums.rangelock_fast_fallback);
+	rs->rangelock_slow.value.ui64 =
+	    wmsum_value(&rangelock_sums.rangelock_slow);
+	rs->rangelock_slow_wait.value.ui64 =
+	    wmsum_value(&rangelock_sums.rangelock_slow_wait);
+	rs->rangelock_slow_contended.value.ui64 =
+	    wmsum_value(&rangelock_sums.rangelock_slow_contended);
+	rs->rangelock_slow_close.value.ui64 =
+	    wmsum_value(&rangelock_sums.rangelock_slow_close);
+	return (0);
+}
+
+void
+zfs_rangelock_stat_init(void)
+{
+	wmsum_init(&rangelock_sums.rangelock_fast, 0);
+	wmsum_init(&rangelock_sums.rangelock_fast_wait, 0);
+	wmsum_init(&rangelock_sums.rangelock_fast_contended, 0);
+	wmsum_init(&rangelock_sums.rangelock_fast_fallback, 0);
+	wmsum_init(&rangelock_sums.rangelock_slow, 0);
+	wmsum_init(&rangelock_sums.rangelock_slow_wait, 0);
+	wmsum_init(&rangelock_sums.rangelock_slow_contended, 0);
+	wmsum_init(&rangelock_sums.rangelock_slow_close, 0);
+
+	rangelock_ksp = kstat_create("zfs", 0, "rangelock", "misc",
+	    KSTAT_TYPE_NAMED, sizeof (rangelock_stats) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+
+	if (rangelock_ksp != NULL) {
+		rangelock_ksp->ks_data = &rangelock_stats;
+		rangelock_ksp->ks_update = rangelock_kstats_update;
+		kstat_install(rangelock_ksp);
+	}
+}
+
+void
+zfs_rangelock_stat_fini(void)
+{
+	if (rangelock_ksp != NULL) {
+		kstat_delete(rangelock_ksp);
+		rangelock_ksp = NULL;
+	}
+
+	wmsum_fini(&rangelock_sums.rangelock_fast);
+	wmsum_fini(&rangelock_sums.rangelock_fast_wait);
+	wmsum_fini(&rangelock_sums.rangelock_fast_contended);
+	wmsum_fini(&rangelock_sums.rangelock_fast_fallback);
+	wmsum_fini(&rangelock_sums.rangelock_slow);
+	wmsum_fini(&rangelock_sums.rangelock_slow_wait);
+	wmsum_fini(&rangelock_sums.rangelock_slow_contended);
+	wmsum_fini(&rangelock_sums.rangelock_slow_close);
+}
 
 
 /*
@@ -141,24 +286,203 @@ zfs_rangelock_init(zfs_rangelock_t *rl, zfs_rangelock_cb_t *cb, void *arg)
 	    sizeof (zfs_locked_range_t), offsetof(zfs_locked_range_t, lr_node));
 	rl->rl_cb = cb;
 	rl->rl_arg = arg;
+	rl->rl_shards = NULL;
+	rl->rl_nshards = 0;
+	rl->rl_shard_shift = 0;
+	rl->rl_nslow = 0;
 }
 
 void
 zfs_rangelock_fini(zfs_rangelock_t *rl)
 {
+	ASSERT0(rl->rl_nslow);
+	if (rl->rl_shards != NULL) {
+		for (uint_t i = 0; i < rl->rl_nshards; i++) {
+			zfs_rangelock_shard_t *rs = &rl->rl_shards[i];
+			mutex_destroy(&rs->rs_lock);
+			avl_destroy(&rs->rs_tree);
+			cv_destroy(&rs->rs_drain_cv);
+		}
+		kmem_free(rl->rl_shards,
+		    rl->rl_nshards * sizeof (zfs_rangelock_shard_t));
+		rl->rl_shards = NULL;
+	}
 	mutex_destroy(&rl->rl_lock);
 	avl_destroy(&rl->rl_tree);
 }
 
+/*
+ * Take the given mutex, counting it in "contended" if it was already held.
+ * Returns B_FALSE if we had to wait for it.
+ */
+static boolean_t
+zfs_rangelock_mutex_enter(kmutex_t *lock, wmsum_t *contended)
+{
+	if (mutex_tryenter(lock))
+		return (B_TRUE);
+	wmsum_add(contended, 1);
+	mutex_enter(lock);
+	return (B_FALSE);
+}
+
+/*
+ * Called with rl_lock held after it was found contended.  The shards are
+ * published only once fully set up, as the fast path looks at rl_shards
+ * without rl_lock.  This may be reached from page writeback, so don't
+ * sleep for memory; we'll just try again next time.
+ */
+static void
+zfs_rangelock_shards_alloc(zfs_rangelock_t *rl)
+{
+	uint_t nshards = MIN(zfs_rangelock_shards, 256);
+	zfs_rangelock_shard_t *shards;
+
+	ASSERT(MUTEX_HELD(&rl->rl_lock));
+	ASSERT0P(rl->rl_shards);
+
+	if (nshards < 2)
+		return;
+	shards = kmem_zalloc(nshards * sizeof (zfs_rangelock_shard_t),
+	    KM_NOSLEEP);
+	if (shards == NULL)
+		return;
+
+	for (uint_t i = 0; i < nshards; i++) {
+		zfs_rangelock_shard_t *rs = &shards[i];
+		mutex_init(&rs->rs_lock, NULL, MUTEX_DEFAULT, NULL);
+		avl_create(&rs->rs_tree, zfs_rangelock_compare,
+		    sizeof (zfs_locked_range_t),
+		    offsetof(zfs_locked_range_t, lr_node));
+		cv_init(&rs->rs_drain_cv, NULL, CV_DEFAULT, NULL);
+		rs->rs_closed = (rl->rl_nslow != 0);
+	}
+	rl->rl_nshards = nshards;
+	rl->rl_shard_shift = MIN(zfs_rangelock_shard_shift, 63);
+	membar_producer();
+	atomic_store_ptr(&rl->rl_shards, shards);
+}
+
+/*
+ * Return the shard which may hold the given range, or NULL if it must be
+ * locked via the slow path.
+ */
+static zfs_rangelock_shard_t *
+zfs_rangelock_shard(zfs_rangelock_t *rl, uint64_t off, uint64_t len)
+{
+	zfs_rangelock_shard_t *shards = atomic_load_ptr(&rl->rl_shards);
+	uint64_t bucket;
+
+	if (shards == NULL || len == 0)
+		return (NULL);
+	membar_consumer();
+
+	bucket = off >> rl->rl_shard_shift;
+	if (bucket != (off + len - 1) >> rl->rl_shard_shift)
+		return (NULL);
+	return (&shards[bucket % rl->rl_nshards]);
+}
+
+/*
+ * Close the shards to new ranges as the first slow path lock is wanted,
+ * or reopen them as the last one is dropped.
+ */
+static void
+zfs_rangelock_shards_close(zfs_rangelock_t *rl, boolean_t closed)
+{
+	ASSERT(MUTEX_HELD(&rl->rl_lock));
+
+	if (rl->rl_shards == NULL)
+		return;
+	if (closed)
+		RANGELOCKSTAT_BUMP(rangelock_slow_close);
+	for (uint_t i = 0; i < rl->rl_nshards; i++) {
+		zfs_rangelock_shard_t *rs = &rl->rl_shards[i];
+		mutex_enter(&rs->rs_lock);
+		rs->rs_closed = closed;
+		mutex_exit(&rs->rs_lock);
+	}
+}
+
+/*
+ * Look for a range still held in a (closed) shard which conflicts with the
+ * new slow path range.  If one is found it is returned with its shard's
+ * rs_lock held, so the caller can wait on rs_drain_cv.
+ */
+static zfs_locked_range_t *
+zfs_rangelock_shard_conflict(zfs_rangelock_t *rl, zfs_locked_range_t *new,
+    zfs_rangelock_shard_t **rsp)
+{
+	uint64_t off = new->lr_offset;
+	uint64_t end = off + new->lr_length;
+	uint64_t first, last;
+
+	if (rl->rl_shards == NULL || new->lr_length == 0)
+		return (NULL);
+
+	/* Only the shards owning the buckets in the range need checking */
+	first = off >> rl->rl_shard_shift;
+	last = (end - 1) >> rl->rl_shard_shift;
+	if (last - first >= rl->rl_nshards)
+		last = first + rl->rl_nshards - 1;
+
+	for (uint64_t b = first; b <= last; b++) {
+		zfs_rangelock_shard_t *rs = &rl->rl_shards[b % rl->rl_nshards];
+		zfs_locked_range_t search, *lr;
+		avl_index_t where;
+
+		mutex_enter(&rs->rs_lock);
+		ASSERT(rs->rs_closed);
+		search.lr_offset = off;
+		lr = avl_find(&rs->rs_tree, &search, &where);
+		if (lr == NULL) {
+			lr = avl_nearest(&rs->rs_tree, where, AVL_BEFORE);
+			if (lr == NULL || lr->lr_offset + lr->lr_length <= off)
+				lr = avl_nearest(&rs->rs_tree, where,
+				    AVL_AFTER);
+		}
+		for (; lr != NULL && lr->lr_offset < end;
+		    lr = AVL_NEXT(&rs->rs_tree, lr)) {
+			if (lr->lr_offset + lr->lr_length <= off)
+				continue;
+			if (new->lr_type == RL_WRITER ||
+			    lr->lr_type == RL_WRITER) {
+				*rsp = rs;
+				return (lr);
+			}
+		}
+		mutex_exit(&rs->rs_lock);
+	}
+	return (NULL);
+}
+
+/*
+ * Wait, dropping rl_lock, for a range held in a shard to be released.
+ */
+static void
+zfs_rangelock_shard_wait(zfs_rangelock_t *rl, zfs_rangelock_shard_t *rs)
+{
+	ASSERT(MUTEX_HELD(&rs->rs_lock));
+
+	RANGELOCKSTAT_BUMP(rangelock_slow_wait);
+	mutex_exit(&rl->rl_lock);
+	cv_wait(&rs->rs_drain_cv, &rs->rs_lock);
+	mutex_exit(&rs->rs_lock);
+	mutex_enter(&rl->rl_lock);
+}
+
 /*
  * Check if a write lock can be grabbed.  If not, fail immediately or sleep and
  * recheck until available, depending on the value of the "nonblock" parameter.
+ * The range is locked in the given shard, or in rl_tree if rs is NULL; from
+ * a shard EAGAIN is returned if the range must take the slow path instead.
  */
-static boolean_t
-zfs_rangelock_enter_writer(zfs_rangelock_t *rl, zfs_locked_range_t *new,
-    boolean_t nonblock)
+static int
+zfs_rangelock_enter_writer(zfs_rangelock_t *rl, zfs_rangelock_shard_t *rs,
+    zfs_locked_range_t *new, boolean_t nonblock)
 {
-	avl_tree_t *tree = &rl->rl_tree;
+	avl_tree_t *tree = (rs != NULL) ? &rs->rs_tree : &rl->rl_tree;
+	kmutex_t *lock = (rs != NULL) ? &rs->rs_lock : &rl->rl_lock;
+	zfs_rangelock_shard_t *crs;
 	zfs_locked_range_t *lr;
 	avl_index_t where;
 	uint64_t orig_off = new->lr_offset;
@@ -166,6 +490,9 @@ zfs_rangelock_enter_writer(zfs_rangelock_t *rl, zfs_locked_range_t *new,
 	zfs_rangelock_type_t orig_type = new->lr_type;
 
 	for (;;) {
+		if (rs != NULL && rs->rs_closed)
+			return (EAGAIN);
+
 		/*
 		 * Call callback which can modify new->r_off,len,type.
 		 * Note, the callback is used by the ZPL to handle appending
@@ -181,12 +508,34 @@ zfs_rangelock_enter_writer(zfs_rangelock_t *rl, zfs_locked_range_t *new,
 		 */
 		ASSERT3U(new->lr_type, ==, RL_WRITER);
 
+		if (rs != NULL) {
+			/*
+			 * A shard can only hold the range it was chosen for;
+			 * anything the callback widened takes the slow path.
+			 */
+			if (new->lr_offset != orig_off ||
+			    new->lr_length != orig_len) {
+				new->lr_offset = orig_off;
+				new->lr_length = orig_len;
+				new->lr_type = orig_type;
+				return (EAGAIN);
+			}
+		} else if ((lr = zfs_rangelock_shard_conflict(rl, new,
+		    &crs)) != NULL) {
+			if (nonblock) {
+				mutex_exit(&crs->rs_lock);
+				return (EBUSY);
+			}
+			zfs_rangelock_shard_wait(rl, crs);
+			goto reset;
+		}
+
 		/*
 		 * First check for the usual case of no locks
 		 */
 		if (avl_numnodes(tree) == 0) {
 			avl_add(tree, new);
-			return (B_TRUE);
+			return (0);
 		}
 
 		/*
@@ -207,16 +556,20 @@ zfs_rangelock_enter_writer(zfs_rangelock_t *rl, zfs_locked_range_t *new,
 			goto wait;
 
 		avl_insert(tree, new, where);
-		return (B_TRUE);
+		return (0);
 wait:
 		if (nonblock)
-			return (B_FALSE);
+			return (EBUSY);
 		if (!lr->lr_write_wanted) {
 			cv_init(&lr->lr_write_cv, NULL, CV_DEFAULT, NULL);
 			lr->lr_write_wanted = B_TRUE;
 		}
-		cv_wait(&lr->lr_write_cv, &rl->rl_lock);
-
+		if (rs != NULL)
+			RANGELOCKSTAT_BUMP(rangelock_fast_wait);
+		else
+			RANGELOCKSTAT_BUMP(rangelock_slow_wait);
+		cv_wait(&lr->lr_write_cv, lock);
+reset:
 		/* reset to original */
 		new->lr_offset = orig_off;
 		new->lr_length = orig_len;
@@ -398,21 +751,44 @@ zfs_rangelock_add_reader(avl_tree_t *tree, zfs_locked_range_t *new,
 /*
  * Check if a reader lock can be grabbed.  If not, fail immediately or sleep and
  * recheck until available, depending on the value of the "nonblock" parameter.
+ * As for writers, the range is locked in rs if given, or else in rl_tree.
  */
-static boolean_t
-zfs_rangelock_enter_reader(zfs_rangelock_t *rl, zfs_locked_range_t *new,
-    boolean_t nonblock)
+static int
+zfs_rangelock_enter_reader(zfs_rangelock_t *rl, zfs_rangelock_shard_t *rs,
+    zfs_locked_range_t *new, boolean_t nonblock)
 {
-	avl_tree_t *tree = &rl->rl_tree;
+	avl_tree_t *tree = (rs != NULL) ? &rs->rs_tree : &rl->rl_tree;
+	kmutex_t *lock = (rs != NULL) ? &rs->rs_lock : &rl->rl_lock;
+	zfs_rangelock_shard_t *crs;
 	zfs_locked_range_t *prev, *next;
 	avl_index_t where;
 	uint64_t off = new->lr_offset;
 	uint64_t len = new->lr_length;
 
+retry:
+	if (rs != NULL && rs->rs_closed)
+		return (EAGAIN);
+
+	if (rs == NULL && zfs_rangelock_shard_conflict(rl, new, &crs) != NULL) {
+		if (nonblock) {
+			mutex_exit(&crs->rs_lock);
+			return (EBUSY);
+		}
+		zfs_rangelock_shard_wait(rl, crs);
+		goto retry;
+	}
+
+	/*
+	 * First check for the usual case of no locks
+	 */
+	if (avl_numnodes(tree) == 0) {
+		avl_add(tree, new);
+		return (0);
+	}
+
 	/*
 	 * Look for any writer locks in the range.
 	 */
-retry:
 	prev = avl_find(tree, new, &where);
 	if (prev == NULL)
 		prev = avl_nearest(tree, where, AVL_BEFORE);
@@ -423,13 +799,17 @@ retry:
 	if (prev && (off < prev->lr_offset + prev->lr_length)) {
 		if ((prev->lr_type == RL_WRITER) || (prev->lr_write_wanted)) {
 			if (nonblock)
-				return (B_FALSE);
+				return (EBUSY);
 			if (!prev->lr_read_wanted) {
 				cv_init(&prev->lr_read_cv,
 				    NULL, CV_DEFAULT, NULL);
 				prev->lr_read_wanted = B_TRUE;
 			}
-			cv_wait(&prev->lr_read_cv, &rl->rl_lock);
+			if (rs != NULL)
+				RANGELOCKSTAT_BUMP(rangelock_fast_wait);
+			else
+				RANGELOCKSTAT_BUMP(rangelock_slow_wait);
+			cv_wait(&prev->lr_read_cv, lock);
 			goto retry;
 		}
 		if (off + len < prev->lr_offset + prev->lr_length)
@@ -449,13 +829,17 @@ retry:
 			goto got_lock;
 		if ((next->lr_type == RL_WRITER) || (next->lr_write_wanted)) {
 			if (nonblock)
-				return (B_FALSE);
+				return (EBUSY);
 			if (!next->lr_read_wanted) {
 				cv_init(&next->lr_read_cv,
 				    NULL, CV_DEFAULT, NULL);
 				next->lr_read_wanted = B_TRUE;
 			}
-			cv_wait(&next->lr_read_cv, &rl->rl_lock);
+			if (rs != NULL)
+				RANGELOCKSTAT_BUMP(rangelock_fast_wait);
+			else
+				RANGELOCKSTAT_BUMP(rangelock_slow_wait);
+			cv_wait(&next->lr_read_cv, lock);
 			goto retry;
 		}
 		if (off + len <= next->lr_offset + next->lr_length)
@@ -468,7 +852,7 @@ got_lock:
 	 * locks and bumping ref counts (r_count).
 	 */
 	zfs_rangelock_add_reader(tree, new, prev, where);
-	return (B_TRUE);
+	return (0);
 }
 
 /*
@@ -484,11 +868,13 @@ zfs_rangelock_enter_impl(zfs_rangelock_t *rl, uint64_t off, uint64_t len,
     zfs_rangelock_type_t type, boolean_t nonblock)
 {
 	zfs_locked_range_t *new;
+	int error;
 
 	ASSERT(type == RL_READER || type == RL_WRITER || type == RL_APPEND);
 
 	new = kmem_alloc(sizeof (zfs_locked_range_t), KM_SLEEP);
 	new->lr_rangelock = rl;
+	new->lr_shard = NULL;
 	new->lr_offset = off;
 	if (len + off < off)	/* overflow */
 		len = UINT64_MAX - off;
@@ -499,22 +885,55 @@ zfs_rangelock_enter_impl(zfs_rangelock_t *rl, uint64_t off, uint64_t len,
 	new->lr_write_wanted = B_FALSE;
 	new->lr_read_wanted = B_FALSE;
 
-	mutex_enter(&rl->rl_lock);
-	if (type == RL_READER) {
-		/*
-		 * First check for the usual case of no locks
-		 */
-		if (avl_numnodes(&rl->rl_tree) == 0) {
-			avl_add(&rl->rl_tree, new);
-		} else if (!zfs_rangelock_enter_reader(rl, new, nonblock)) {
+	/*
+	 * Try the range's shard first; appends need the end of the file and
+	 * so always take the slow path.
+	 */
+	zfs_rangelock_shard_t *rs = NULL;
+	if (type != RL_APPEND)
+		rs = zfs_rangelock_shard(rl, new->lr_offset, new->lr_length);
+	if (rs != NULL) {
+		(void) zfs_rangelock_mutex_enter(&rs->rs_lock,
+		    &rangelock_sums.rangelock_fast_contended);
+		if (type == RL_READER)
+			error = zfs_rangelock_enter_reader(rl, rs, new,
+			    nonblock);
+		else
+			error = zfs_rangelock_enter_writer(rl, rs, new,
+			    nonblock);
+		mutex_exit(&rs->rs_lock);
+
+		if (error == 0) {
+			new->lr_shard = rs;
+			RANGELOCKSTAT_BUMP(rangelock_fast);
+			return (new);
+		}
+		if (error != EAGAIN) {
 			kmem_free(new, sizeof (*new));
-			new = NULL;
+			return (NULL);
 		}
-	} else if (!zfs_rangelock_enter_writer(rl, new, nonblock)) {
-		kmem_free(new, sizeof (*new));
-		new = NULL;
+		RANGELOCKSTAT_BUMP(rangelock_fast_fallback);
 	}
+
+	if (!zfs_rangelock_mutex_enter(&rl->rl_lock,
+	    &rangelock_sums.rangelock_slow_contended) &&
+	    rl->rl_shards == NULL && zfs_rangelock_shards != 0)
+		zfs_rangelock_shards_alloc(rl);
+	if (rl->rl_nslow++ == 0)
+		zfs_rangelock_shards_close(rl, B_TRUE);
+	if (type == RL_READER)
+		error = zfs_rangelock_enter_reader(rl, NULL, new, nonblock);
+	else
+		error = zfs_rangelock_enter_writer(rl, NULL, new, nonblock);
+	if (error != 0 && --rl->rl_nslow == 0)
+		zfs_rangelock_shards_close(rl, B_FALSE);
 	mutex_exit(&rl->rl_lock);
+
+	if (error != 0) {
+		kmem_free(new, sizeof (*new));
+		return (NULL);
+	}
+	RANGELOCKSTAT_BUMP(rangelock_slow);
 	return (new);
 }
 
@@ -551,10 +970,9 @@ zfs_rangelock_free(zfs_locked_range_t *lr)
  * Unlock a reader lock
  */
 static void
-zfs_rangelock_exit_reader(zfs_rangelock_t *rl, zfs_locked_range_t *remove,
+zfs_rangelock_exit_reader(avl_tree_t *tree, zfs_locked_range_t *remove,
     list_t *free_list)
 {
-	avl_tree_t *tree = &rl->rl_tree;
 	uint64_t len;
 
 	/*
@@ -616,6 +1034,9 @@ void
 zfs_rangelock_exit(zfs_locked_range_t *lr)
 {
 	zfs_rangelock_t *rl = lr->lr_rangelock;
+	zfs_rangelock_shard_t *rs = lr->lr_shard;
+	avl_tree_t *tree = (rs != NULL) ? &rs->rs_tree : &rl->rl_tree;
+	kmutex_t *lock = (rs != NULL) ? &rs->rs_lock : &rl->rl_lock;
 	list_t free_list;
 	zfs_locked_range_t *free_lr;
 
@@ -630,10 +1051,10 @@ zfs_rangelock_exit(zfs_locked_range_t *lr)
 	list_create(&free_list, sizeof (zfs_locked_range_t),
 	    offsetof(zfs_locked_range_t, lr_node));
 
-	mutex_enter(&rl->rl_lock);
+	mutex_enter(lock);
 	if (lr->lr_type == RL_WRITER) {
 		/* writer locks can't be shared or split */
-		avl_remove(&rl->rl_tree, lr);
+		avl_remove(tree, lr);
 		if (lr->lr_write_wanted)
 			cv_broadcast(&lr->lr_write_cv);
 		if (lr->lr_read_wanted)
@@ -644,9 +1065,16 @@ zfs_rangelock_exit(zfs_locked_range_t *lr)
 		 * lock may be shared, let rangelock_exit_reader()
 		 * release the lock and free the zfs_locked_range_t.
 		 */
-		zfs_rangelock_exit_reader(rl, lr, &free_list);
+		zfs_rangelock_exit_reader(tree, lr, &free_list);
 	}
-	mutex_exit(&rl->rl_lock);
+	if (rs != NULL) {
+		/* the slow path may be waiting for this range */
+		if (rs->rs_closed)
+			cv_broadcast(&rs->rs_drain_cv);
+	} else if (--rl->rl_nslow == 0) {
+		zfs_rangelock_shards_close(rl, B_FALSE);
+	}
+	mutex_exit(lock);
 
 	while ((free_lr = list_remove_head(&free_list)) != NULL)
 		zfs_rangelock_free(free_lr);
@@ -669,6 +1097,7 @@ zfs_rangelock_reduce(zfs_locked_range_t *lr, uint64_t off, uint64_t len)
 	ASSERT0(lr->lr_offset);
 	ASSERT3U(lr->lr_type, ==, RL_WRITER);
 	ASSERT(!lr->lr_proxy);
+	ASSERT0P(lr->lr_shard);
 	ASSERT3U(lr->lr_length, ==, UINT64_MAX);
 	ASSERT3U(lr->lr_count, ==, 1);
 
@@ -690,3 +1119,9 @@ EXPORT_SYMBOL(zfs_rangelock_tryenter);
 EXPORT_SYMBOL(zfs_rangelock_exit);
 EXPORT_SYMBOL(zfs_rangelock_reduce);
 #endif
+
+ZFS_MODULE_PARAM(zfs, zfs_, rangelock_shards, UINT, ZMOD_RW,
+	"Max shards for the rangelock fast path once contended (0 disables)");
+
+ZFS_MODULE_PARAM(zfs, zfs_, rangelock_shard_shift, UINT, ZMOD_RW,
+	"log2 of the file range assigned to each rangelock shard");
@@ -47,6 +47,7 @@
 #include <sys/zfs_acl.h>
 #include <sys/zfs_ioctl.h>
 #include <sys/fs/zfs.h>
+#include <sys/abd.h>
 #include <sys/dmu.h>
 #include <sys/dmu_objset.h>
 #include <sys/dsl_crypt.h>
@@ -98,6 +99,14 @@ static int zfs_dio_enabled = 1;
  */
 static int zfs_dio_strict = 0;
 
+/*
+ * Allow Direct I/O reads and overwrites from asynchronous callers (e.g.
+ * io_uring or AIO on Linux) to return once issued and be completed from the
+ * zio done callback, rather than waiting for the I/O in the submitting
+ * thread.
+ */
+static int zfs_dio_async = 1;
+
 
 /*
  * Maximum bytes to read per chunk in zfs_read().
@@ -308,6 +317,98 @@ out:
 	return (error);
 }
 
+typedef struct zfs_read_async {
+	znode_t			*zra_zp;
+	zfs_uio_t		*zra_uio;
+	zfs_locked_range_t	*zra_lr;
+	ssize_t			zra_size;
+	int			zra_error;
+	taskq_ent_t		zra_tqent;
+} zfs_read_async_t;
+
+/*
+ * Release everything zfs_read() handed over with an asynchronous Direct I/O
+ * read and report the result to the uio's owner.
+ */
+static void
+zfs_read_async_finish(zfs_read_async_t *zra)
+{
+	znode_t *zp = zra->zra_zp;
+	zfs_uio_t *uio = zra->zra_uio;
+	ssize_t nread = 0;
+	int error = zra->zra_error;
+
+	/* convert checksum errors into IO errors */
+	if (error == ECKSUM)
+		error = SET_ERROR(EIO);
+	if (error == 0) {
+		nread = zra->zra_size;
+		dataset_kstats_update_read_kstats(&ZTOZSB(zp)->z_kstat, nread);
+	}
+
+	zfs_rangelock_exit(zra->zra_lr);
+	zfs_uio_free_dio_pages(uio, UIO_READ);
+	kmem_free(zra, sizeof (zfs_read_async_t));
+
+	zfs_uio_async_done(uio, nread, error);
+}
+
+/*
+ * As in zfs_read(), a checksum failure on a Direct I/O read must be treated
+ * as suspicious since the buffer could have been manipulated while the I/O
+ * was in flight, so the range is read again through the ARC.  The caller's
+ * iovec can't be used from here, so the data is copied into the mapped
+ * pages instead.
+ */
+static void
+zfs_read_async_retry(void *arg)
+{
+	zfs_read_async_t *zra = arg;
+	znode_t *zp = zra->zra_zp;
+	zfsvfs_t *zfsvfs = ZTOZSB(zp);
+	zfs_uio_t *uio = zra->zra_uio;
+	offset_t offset = zfs_uio_offset(uio);
+	offset_t page_index = (offset - zfs_uio_soffset(uio)) >> PAGESHIFT;
+	int error;
+
+	if ((error = zfs_enter_verify_zp(zfsvfs, zp, FTAG)) == 0) {
+		void *buf = vmem_alloc(zra->zra_size, KM_SLEEP);
+
+		error = dmu_read(zfsvfs->z_os, zp->z_id, offset,
+		    zra->zra_size, buf, DMU_READ_PREFETCH);
+		if (error == 0) {
+			abd_t *abd = abd_alloc_from_pages(
+			    &uio->uio_dio.pages[page_index],
+			    offset & (PAGESIZE - 1), zra->zra_size);
+			abd_copy_from_buf(abd, buf, zra->zra_size);
+			abd_free(abd);
+		}
+		vmem_free(buf, zra->zra_size);
+		zfs_exit(zfsvfs, FTAG);
+	}
+
+	zra->zra_error = error;
+	zfs_read_async_finish(zra);
+}
+
+/*
+ * Called from zio completion context; only a checksum failure needs to
+ * block, so that is passed off to a taskq.
+ */
+static void
+zfs_read_async_done(void *arg, int error)
+{
+	zfs_read_async_t *zra = arg;
+
+	zra->zra_error = error;
+	if (error == ECKSUM) {
+		taskq_dispatch_ent(system_taskq, zfs_read_async_retry, zra, 0,
+		    &zra->zra_tqent);
+		return;
+	}
+	zfs_read_async_finish(zra);
+}
+
 /*
  * Read bytes from specified file into supplied buffer.
  *
@@ -320,7 +421,10 @@ out:
  *
  *	OUT:	uio	- updated offset and range, buffer filled.
  *
- *	RETURN:	0 on success, error code on failure.
+ *	RETURN:	0 on success, error code on failure.  EINPROGRESS if the
+ *		uio has an async completion callback and the read was
+ *		queued; the result is then passed to the callback instead
+ *		and the uio is not updated.
  *
  * Side Effects:
  *	inode - atime updated if byte count > 0
@@ -448,6 +552,33 @@ zfs_read(struct znode *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 		    DMU_MAX_ACCESS / 2);
 	}
 
+	/*
+	 * A page aligned Direct I/O read from an asynchronous caller which
+	 * can be done in one chunk is queued, and the range lock and mapped
+	 * pages are released from its completion callback.
+	 */
+	if ((uio->uio_extflg & UIO_DIRECT) && zfs_uio_async(uio) &&
+	    zfs_dio_async && dio_remaining_resid == 0 &&
+	    n <= chunk_size - P2PHASE(zfs_uio_offset(uio), blksz) &&
+	    !zn_has_cached_data(zp, zfs_uio_offset(uio),
+	    zfs_uio_offset(uio) + n - 1)) {
+		zfs_read_async_t *zra = kmem_alloc(sizeof (zfs_read_async_t),
+		    KM_SLEEP);
+		zra->zra_zp = zp;
+		zra->zra_uio = uio;
+		zra->zra_lr = lr;
+		zra->zra_size = n;
+		zra->zra_error = 0;
+		taskq_init_ent(&zra->zra_tqent);
+
+		dmu_read_uio_direct_async(sa_get_db(zp->z_sa_hdl), uio, n,
+		    dflags, zfs_read_async_done, zra);
+
+		ZFS_ACCESSTIME_STAMP(zfsvfs, zp);
+		zfs_exit(zfsvfs, FTAG);
+		return (EINPROGRESS);
+	}
+
 	while (n > 0) {
 		ssize_t nbytes = MIN(n, chunk_size -
 		    P2PHASE(zfs_uio_offset(uio), blksz));
@@ -603,6 +734,126 @@ zfs_clear_setid_bits_if_necessary(zfsvfs_t *zfsvfs, znode_t *zp, cred_t *cr,
 	}
 }
 
+typedef struct zfs_write_async {
+	znode_t			*zwa_zp;
+	zfs_uio_t		*zwa_uio;
+	zfs_locked_range_t	*zwa_lr;
+	dmu_tx_t		*zwa_tx;
+	ssize_t			zwa_size;
+} zfs_write_async_t;
+
+/*
+ * Called from zio completion context once an asynchronous Direct I/O write
+ * has completed.  The znode and the intent log were already updated when
+ * the write was issued, so all that is left is to commit the tx and
+ * release the range lock and the mapped pages.
+ */
+static void
+zfs_write_async_done(void *arg, int error)
+{
+	zfs_write_async_t *zwa = arg;
+	znode_t *zp = zwa->zwa_zp;
+	zfs_uio_t *uio = zwa->zwa_uio;
+	ssize_t nwritten = 0;
+
+	dmu_tx_commit(zwa->zwa_tx);
+	zfs_rangelock_exit(zwa->zwa_lr);
+	zfs_uio_free_dio_pages(uio, UIO_WRITE);
+
+	if (error == 0) {
+		nwritten = zwa->zwa_size;
+		dataset_kstats_update_write_kstats(&ZTOZSB(zp)->z_kstat,
+		    nwritten);
+	}
+	kmem_free(zwa, sizeof (zfs_write_async_t));
+
+	zfs_uio_async_done(uio, nwritten, error);
+}
+
+/*
+ * Queue a block aligned Direct I/O write of n bytes, which lies within the
+ * file and fits in one tx, and return EINPROGRESS.  The tx stays assigned
+ * until the write completes, as it does while zfs_write() waits for it.
+ * Since nothing may block in the completion callback, the timestamps and
+ * the TX_WRITE record are written before the data is.  Should the write
+ * fail, dmu_write_direct() undirties the blocks again, and with no dirty
+ * record left for the txg zfs_get_data() skips the record; only the
+ * timestamp update remains.  If the write can't be issued, the error is
+ * returned before any data is written and the caller still owns the range
+ * lock.
+ */
+static int
+zfs_write_async(znode_t *zp, zfs_uio_t *uio, zfs_locked_range_t *lr,
+    ssize_t n, int ioflag, cred_t *cr)
+{
+	zfsvfs_t *zfsvfs = ZTOZSB(zp);
+	offset_t woff = zfs_uio_offset(uio);
+	uint64_t clear_setid_bits_txg = 0;
+	int error;
+
+	sa_bulk_attr_t bulk[3];
+	int count = 0;
+	uint64_t mtime[2], ctime[2];
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_MTIME(zfsvfs), NULL, &mtime, 16);
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_CTIME(zfsvfs), NULL, &ctime, 16);
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_FLAGS(zfsvfs), NULL,
+	    &zp->z_pflags, 8);
+
+	ASSERT(uio->uio_extflg & UIO_DIRECT);
+	ASSERT3U(woff + n, <=, zp->z_size);
+
+	if (zfs_id_overblockquota(zfsvfs, DMU_USERUSED_OBJECT,
+	    KUID_TO_SUID(ZTOUID(zp))) ||
+	    zfs_id_overblockquota(zfsvfs, DMU_GROUPUSED_OBJECT,
+	    KGID_TO_SGID(ZTOGID(zp))) ||
+	    (zp->z_projid != ZFS_DEFAULT_PROJID &&
+	    zfs_id_overblockquota(zfsvfs, DMU_PROJECTUSED_OBJECT,
+	    zp->z_projid)))
+		return (SET_ERROR(EDQUOT));
+
+	dmu_tx_t *tx = dmu_tx_create(zfsvfs->z_os);
+	dmu_tx_hold_sa(tx, zp->z_sa_hdl, B_FALSE);
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)sa_get_db(zp->z_sa_hdl);
+	DB_DNODE_ENTER(db);
+	dmu_tx_hold_write_by_dnode(tx, DB_DNODE(db), woff, n);
+	DB_DNODE_EXIT(db);
+	zfs_sa_upgrade_txholds(tx, zp);
+	error = dmu_tx_assign(tx, DMU_TX_WAIT);
+	if (error) {
+		dmu_tx_abort(tx);
+		return (error);
+	}
+
+	zfs_clear_setid_bits_if_necessary(zfsvfs, zp, cr,
+	    &clear_setid_bits_txg, tx);
+	zfs_tstamp_update_setup(zp, CONTENT_MODIFIED, mtime, ctime);
+	error = sa_bulk_update(zp->z_sa_hdl, bulk, count, tx);
+	if (error != 0) {
+		dmu_tx_commit(tx);
+		return (error);
+	}
+	zfs_log_write(zfsvfs->z_log, tx, TX_WRITE, zp, woff, n, B_FALSE,
+	    B_TRUE, NULL, NULL);
+	zfs_znode_update_vfs(zp);
+
+	zfs_write_async_t *zwa = kmem_alloc(sizeof (zfs_write_async_t),
+	    KM_SLEEP);
+	zwa->zwa_zp = zp;
+	zwa->zwa_uio = uio;
+	zwa->zwa_lr = lr;
+	zwa->zwa_tx = tx;
+	zwa->zwa_size = n;
+
+	dmu_flags_t dflags = DMU_READ_PREFETCH | DMU_DIRECTIO;
+	if (ioflag & O_DIRECT)
+		dflags |= DMU_UNCACHEDIO;
+
+	dmu_write_uio_direct_async(sa_get_db(zp->z_sa_hdl), uio, n, dflags,
+	    tx, zfs_write_async_done, zwa);
+
+	return (SET_ERROR(EINPROGRESS));
+}
+
 /*
  * Write the bytes to a file.
  *
@@ -617,6 +868,9 @@ zfs_clear_setid_bits_if_necessary(zfsvfs_t *zfsvfs, znode_t *zp, cred_t *cr,
  *
  *	RETURN:	0 if success
  *		error code if failure
+ *		EINPROGRESS if the uio has an async completion callback
+ *		and the write was queued; the result is then passed to
+ *		the callback instead and the uio is not updated.
  *
  * Timestamps:
  *	ip - ctime|mtime updated if byte count > 0
@@ -787,6 +1041,27 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 		o_direct_defer = B_TRUE;
 	}
 
+	/*
+	 * A block aligned Direct I/O write from an asynchronous caller which
+	 * overwrites part of the file in a single tx is queued, and the range
+	 * lock and mapped pages are released from its completion callback.
+	 * Writes which extend the file or must be committed to the intent
+	 * log before returning always wait.
+	 */
+	if ((uio->uio_extflg & UIO_DIRECT) && zfs_uio_async(uio) &&
+	    zfs_dio_async && !commit && !zfsvfs->z_replay &&
+	    lr->lr_length != UINT64_MAX && woff + n <= zp->z_size &&
+	    n <= DMU_MAX_ACCESS >> 1 &&
+	    zfs_dio_aligned(woff, n, zp->z_blksz) &&
+	    !zn_has_cached_data(zp, woff, woff + n - 1)) {
+		error = zfs_write_async(zp, uio, lr, n, ioflag, cr);
+		if (error == EINPROGRESS) {
+			zfs_exit(zfsvfs, FTAG);
+			return (error);
+		}
+		n = 0;
+	}
+
 	/*
 	 * Write the file in reasonable size chunks.  Each chunk is written
 	 * in a separate transaction; this keeps the intent log records small
@@ -1015,11 +1290,11 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 		}
 		/*
 		 * If we are replaying and eof is non zero then force
-		 * the file size to the specified eof. Note, there's no
-		 * concurrency during replay.
+		 * the file size to the specified eof. Note, replay of
+		 * records for one object is never concurrent.
 		 */
-		if (zfsvfs->z_replay && zfsvfs->z_replay_eof != 0)
-			zp->z_size = zfsvfs->z_replay_eof;
+		if (zfsvfs->z_replay && zp->z_replay_eof != 0)
+			zp->z_size = zp->z_replay_eof;
 
 		error1 = sa_bulk_update(zp->z_sa_hdl, bulk, count, tx);
 		if (error1 != 0)
@@ -2087,3 +2362,6 @@ ZFS_MODULE_PARAM(zfs, zfs_, dio_enabled, INT, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs, zfs_, dio_strict, INT, ZMOD_RW,
 	"Return errors on misaligned Direct I/O");
+
+ZFS_MODULE_PARAM(zfs, zfs_, dio_async, INT, ZMOD_RW,
+	"Complete Direct I/O from async callers without blocking");
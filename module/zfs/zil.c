@@ -120,6 +120,9 @@ static zil_kstat_values_t zil_stats = {
 	{ "zil_itx_metaslab_slog_bytes",	KSTAT_DATA_UINT64 },
 	{ "zil_itx_metaslab_slog_write",	KSTAT_DATA_UINT64 },
 	{ "zil_itx_metaslab_slog_alloc",	KSTAT_DATA_UINT64 },
+	{ "zil_replay_count",			KSTAT_DATA_UINT64 },
+	{ "zil_replay_bytes",			KSTAT_DATA_UINT64 },
+	{ "zil_replay_barrier_count",		KSTAT_DATA_UINT64 },
 };
 
 static zil_sums_t zil_sums_global;
@@ -144,6 +147,13 @@ static int zil_nocacheflush = 0;
  */
 static uint64_t zil_slog_bulk = 64 * 1024 * 1024;
 
+/*
+ * Place each lwb on the log vdev following the one of the previous lwb in
+ * the chain, so that the lwbs of a commit are written to all log vdevs in
+ * parallel even when other datasets share the allocator rotor.
+ */
+static int zil_slog_stripe = 1;
+
 static kmem_cache_t *zil_lwb_cache;
 static kmem_cache_t *zil_zcw_cache;
 
@@ -385,6 +395,13 @@ zil_sums_init(zil_sums_t *zs)
 	wmsum_init(&zs->zil_itx_metaslab_slog_bytes, 0);
 	wmsum_init(&zs->zil_itx_metaslab_slog_write, 0);
 	wmsum_init(&zs->zil_itx_metaslab_slog_alloc, 0);
+	wmsum_init(&zs->zil_replay_count, 0);
+	wmsum_init(&zs->zil_replay_bytes, 0);
+	wmsum_init(&zs->zil_replay_barrier_count, 0);
+	for (int p = 0; p < ZIL_PHASES; p++) {
+		for (int b = 0; b < ZIL_HIST_BUCKETS; b++)
+			wmsum_init(&zs->zil_hist[p][b], 0);
+	}
 }
 
 void
@@ -411,6 +428,49 @@ zil_sums_fini(zil_sums_t *zs)
 	wmsum_fini(&zs->zil_itx_metaslab_slog_bytes);
 	wmsum_fini(&zs->zil_itx_metaslab_slog_write);
 	wmsum_fini(&zs->zil_itx_metaslab_slog_alloc);
+	wmsum_fini(&zs->zil_replay_count);
+	wmsum_fini(&zs->zil_replay_bytes);
+	wmsum_fini(&zs->zil_replay_barrier_count);
+	for (int p = 0; p < ZIL_PHASES; p++) {
+		for (int b = 0; b < ZIL_HIST_BUCKETS; b++)
+			wmsum_fini(&zs->zil_hist[p][b]);
+	}
+}
+
+static const char *const zil_phase_names[ZIL_PHASES] = {
+	"assign",
+	"lwb",
+	"write",
+	"flush",
+	"commit",
+};
+
+/*
+ * Name the histogram entries of a copy of the zil kstat template.
+ */
+void
+zil_kstat_values_init(zil_kstat_values_t *zs)
+{
+	for (int p = 0; p < ZIL_PHASES; p++) {
+		for (int b = 0; b < ZIL_HIST_BUCKETS; b++) {
+			kstat_named_t *kn = &zs->zil_hist[p][b];
+
+			(void) snprintf(kn->name, sizeof (kn->name),
+			    "zil_hist_%s_%lluus", zil_phase_names[p],
+			    (u_longlong_t)1 << b);
+			kn->data_type = KSTAT_DATA_UINT64;
+			kn->value.ui64 = 0;
+		}
+	}
+}
+
+static void
+zil_hist_add(zilog_t *zilog, zil_commit_phase_t phase, hrtime_t ns)
+{
+	uint64_t us = NSEC2USEC(MAX(ns, 0));
+	uint_t b = MIN(us == 0 ? 0 : highbit64(us) - 1, ZIL_HIST_BUCKETS - 1);
+
+	ZIL_STAT_BUMP(zilog, zil_hist[phase][b]);
 }
 
 void
@@ -458,6 +518,18 @@ zil_kstat_values_update(zil_kstat_values_t *zs, zil_sums_t *zil_sums)
 	    wmsum_value(&zil_sums->zil_itx_metaslab_slog_write);
 	zs->zil_itx_metaslab_slog_alloc.value.ui64 =
 	    wmsum_value(&zil_sums->zil_itx_metaslab_slog_alloc);
+	zs->zil_replay_count.value.ui64 =
+	    wmsum_value(&zil_sums->zil_replay_count);
+	zs->zil_replay_bytes.value.ui64 =
+	    wmsum_value(&zil_sums->zil_replay_bytes);
+	zs->zil_replay_barrier_count.value.ui64 =
+	    wmsum_value(&zil_sums->zil_replay_barrier_count);
+	for (int p = 0; p < ZIL_PHASES; p++) {
+		for (int b = 0; b < ZIL_HIST_BUCKETS; b++) {
+			zs->zil_hist[p][b].value.ui64 =
+			    wmsum_value(&zil_sums->zil_hist[p][b]);
+		}
+	}
 }
 
 /*
@@ -854,6 +926,7 @@ zil_alloc_lwb(zilog_t *zilog, blkptr_t *bp, int min_sz, int sz,
 	lwb->lwb_write_zio = NULL;
 	lwb->lwb_root_zio = NULL;
 	lwb->lwb_issued_timestamp = 0;
+	lwb->lwb_written_timestamp = 0;
 	lwb->lwb_issued_txg = 0;
 	lwb->lwb_alloc_txg = txg;
 	lwb->lwb_max_txg = 0;
@@ -1020,7 +1093,7 @@ zil_create(zilog_t *zilog)
 		}
 
 		error = zio_alloc_zil(zilog->zl_spa, zilog->zl_os, txg, &blk,
-		    ZIL_MIN_BLKSZ, ZIL_MIN_BLKSZ, &slog, B_TRUE);
+		    ZIL_MIN_BLKSZ, ZIL_MIN_BLKSZ, NULL, &slog, B_TRUE);
 		if (error == 0)
 			zil_init_log_chain(zilog, &blk);
 	}
@@ -1467,9 +1540,20 @@ zil_lwb_flush_vdevs_done(zio_t *zio)
 	zil_commit_waiter_t *zcw;
 	itx_t *itx;
 
-	spa_config_exit(zilog->zl_spa, SCL_STATE, lwb);
+	hrtime_t now = gethrtime();
+	hrtime_t t = now - lwb->lwb_issued_timestamp;
 
-	hrtime_t t = gethrtime() - lwb->lwb_issued_timestamp;
+	if (zio->io_error == 0 && !(lwb->lwb_flags & LWB_FLAG_CRASHED)) {
+		zil_hist_add(zilog, ZIL_PHASE_FLUSH,
+		    now - lwb->lwb_written_timestamp);
+		if (lwb->lwb_flags & LWB_FLAG_SLOG) {
+			spa_zil_slog_stats_add(zilog->zl_spa,
+			    DVA_GET_VDEV(&lwb->lwb_blk.blk_dva[0]),
+			    lwb->lwb_nused, t);
+		}
+	}
+
+	spa_config_exit(zilog->zl_spa, SCL_STATE, lwb);
 
 	mutex_enter(&zilog->zl_lock);
 
@@ -1588,6 +1672,12 @@ zil_lwb_write_done(zio_t *zio)
 	zio_buf_free(lwb->lwb_buf, lwb->lwb_sz);
 	lwb->lwb_buf = NULL;
 
+	lwb->lwb_written_timestamp = gethrtime();
+	if (zio->io_error == 0) {
+		zil_hist_add(zilog, ZIL_PHASE_WRITE,
+		    lwb->lwb_written_timestamp - lwb->lwb_issued_timestamp);
+	}
+
 	mutex_enter(&zilog->zl_lock);
 	ASSERT3S(lwb->lwb_state, ==, LWB_STATE_ISSUED);
 	lwb->lwb_state = LWB_STATE_WRITE_DONE;
@@ -2059,7 +2149,8 @@ next_lwb:
 		}
 
 		error = zio_alloc_zil(spa, zilog->zl_os, txg, bp,
-		    min_size, max_size, &slog, flexible);
+		    min_size, max_size, zil_slog_stripe ? &lwb->lwb_blk : NULL,
+		    &slog, flexible);
 		if (error == 0) {
 			if (closed_slim)
 				ASSERT3U(BP_GET_LSIZE(bp), ==, max_size);
@@ -2100,6 +2191,15 @@ next_lwb:
 	zil_lwb_set_zio_dependency(zilog, lwb);
 	lwb->lwb_state = LWB_STATE_ISSUED;
 
+	hrtime_t now = gethrtime();
+	for (zil_commit_waiter_t *zcw = list_head(&lwb->lwb_waiters);
+	    zcw != NULL; zcw = list_next(&lwb->lwb_waiters, zcw)) {
+		if (zcw->zcw_assigned != 0) {
+			zil_hist_add(zilog, ZIL_PHASE_LWB,
+			    now - zcw->zcw_assigned);
+		}
+	}
+
 	if (nlwb) {
 		nlwb->lwb_blk = *bp;
 		nlwb->lwb_error = error;
@@ -3697,6 +3797,7 @@ zil_alloc_commit_waiter(void)
 	zcw->zcw_lwb = NULL;
 	zcw->zcw_done = B_FALSE;
 	zcw->zcw_error = 0;
+	zcw->zcw_assigned = 0;
 
 	return (zcw);
 }
@@ -3736,6 +3837,11 @@ zil_commit_itx_assign(zilog_t *zilog, zil_commit_waiter_t *zcw)
 	itx->itx_sync = B_TRUE;
 	itx->itx_private = zcw;
 
+	/*
+	 * Once assigned, the itx may be picked up by a concurrent commit
+	 * writer and issued in an lwb, so stamp the waiter before that.
+	 */
+	zcw->zcw_assigned = gethrtime();
 	zil_itx_assign(zilog, itx, tx);
 
 	dmu_tx_commit(tx);
@@ -4054,6 +4160,8 @@ out:
 static int
 zil_commit_impl(zilog_t *zilog, uint64_t foid)
 {
+	hrtime_t start = gethrtime();
+
 	ZIL_STAT_BUMP(zilog, zil_commit_count);
 
 	/*
@@ -4084,6 +4192,7 @@ zil_commit_impl(zilog_t *zilog, uint64_t foid)
 	 */
 	zil_commit_waiter_t *zcw = zil_alloc_commit_waiter();
 	zil_commit_itx_assign(zilog, zcw);
+	zil_hist_add(zilog, ZIL_PHASE_ASSIGN, zcw->zcw_assigned - start);
 
 	uint64_t wtxg = zil_commit_writer(zilog, zcw);
 	zil_commit_waiter(zilog, zcw);
@@ -4111,8 +4220,10 @@ zil_commit_impl(zilog_t *zilog, uint64_t foid)
 
 	zil_free_commit_waiter(zcw);
 
-	if (err == 0)
+	if (err == 0) {
+		zil_hist_add(zilog, ZIL_PHASE_COMMIT, gethrtime() - start);
 		return (0);
+	}
 
 	/*
 	 * ZIL write failed and pool failed in the fallback to
@@ -4152,8 +4263,12 @@ zil_sync(zilog_t *zilog, dmu_tx_t *tx)
 	ASSERT0(zilog->zl_stop_sync);
 
 	if (*replayed_seq != 0) {
-		ASSERT(zh->zh_replay_seq < *replayed_seq);
-		zh->zh_replay_seq = *replayed_seq;
+		/*
+		 * Parallel replay may record a sequence number for a txg
+		 * which ends up not dirtying the dataset; it is then picked
+		 * up by a later txg, possibly after a larger one.
+		 */
+		zh->zh_replay_seq = MAX(zh->zh_replay_seq, *replayed_seq);
 		*replayed_seq = 0;
 	}
 
@@ -4249,6 +4364,7 @@ zil_init(void)
 	    sizeof (zil_commit_waiter_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
 
 	zil_sums_init(&zil_sums_global);
+	zil_kstat_values_init(&zil_stats);
 	zil_kstats_global = kstat_create("zfs", 0, "zil", "misc",
 	    KSTAT_TYPE_NAMED, sizeof (zil_stats) / sizeof (kstat_named_t),
 	    KSTAT_FLAG_VIRTUAL);
@@ -4656,19 +4772,65 @@ zil_resume(void *cookie)
 	dsl_dataset_rele(dmu_objset_ds(os), suspend_tag);
 }
 
+/*
+ * Number of worker threads used to replay the object-local records of a log
+ * (writes, truncates and clones) in parallel.  Records for one object are
+ * always replayed by the same worker in log order; every other record acts
+ * as a barrier and is replayed alone once the workers have drained.  Zero
+ * replays the whole log serially.  Each replay uses at most one worker per
+ * CPU.
+ */
+static uint_t zil_replay_threads = 0;
+
+/*
+ * Limit in bytes of the records, including the log data of indirect writes,
+ * queued to the replay workers and not yet replayed.
+ */
+static uint64_t zil_replay_queue_max = 64 * 1024 * 1024;
+
 typedef struct zil_replay_arg {
+	zilog_t		*zr_zilog;
 	zil_replay_func_t *const *zr_replay;
 	void		*zr_arg;
 	boolean_t	zr_byteswap;
 	char		*zr_lr;
+
+	/* Parallel replay, see zil_replay_dispatch(). */
+	uint_t		zr_ntaskqs;
+	taskq_t		**zr_taskqs;
+	kmutex_t	zr_lock;
+	kcondvar_t	zr_cv;
+	list_t		zr_pending;	/* queued records in log order */
+	uint64_t	zr_pending_bytes; /* bytes of records not replayed */
+	uint64_t	zr_outstanding;	/* records not replayed */
+	uint64_t	zr_seen_seq;	/* last record queued or skipped */
+	int		zr_error;	/* first error of a worker */
+
+	/* Progress reporting. */
+	uint64_t	zr_records;
+	uint64_t	zr_bytes;
+	uint64_t	zr_barriers;
+	hrtime_t	zr_start;
+	hrtime_t	zr_reported;
 } zil_replay_arg_t;
 
+typedef struct zil_replay_rec {
+	list_node_t	zrr_node;
+	taskq_ent_t	zrr_tqent;
+	zil_replay_arg_t *zrr_zr;
+	uint64_t	zrr_seq;
+	uint64_t	zrr_size;	/* of zrr_lr */
+	boolean_t	zrr_done;
+	char		*zrr_lr;	/* copy of the record and its data */
+} zil_replay_rec_t;
+
 static int
 zil_replay_error(zilog_t *zilog, const lr_t *lr, int error)
 {
 	char name[ZFS_MAX_DATASET_NAME_LEN];
 
-	zilog->zl_replaying_seq--;	/* didn't actually replay this one */
+	if (!zilog->zl_replay_async)
+		zilog->zl_replaying_seq--; /* didn't actually replay this one */
 
 	dmu_objset_name(zilog->zl_os, name);
 
@@ -4681,30 +4843,18 @@ zil_replay_error(zilog_t *zilog, const lr_t *lr, int error)
 	return (error);
 }
 
+/*
+ * Replay one log record.  lr is the record as found in the log, buf a copy
+ * of it with room for the data of an indirect write.
+ */
 static int
-zil_replay_log_record(zilog_t *zilog, const lr_t *lr, void *zra,
-    uint64_t claim_txg)
+zil_replay_record(zilog_t *zilog, zil_replay_arg_t *zr, const lr_t *lr,
+    char *buf)
 {
-	zil_replay_arg_t *zr = zra;
-	const zil_header_t *zh = zilog->zl_header;
 	uint64_t reclen = lr->lrc_reclen;
-	uint64_t txtype = lr->lrc_txtype;
+	uint64_t txtype = lr->lrc_txtype & ~TX_CI;
 	int error = 0;
 
-	zilog->zl_replaying_seq = lr->lrc_seq;
-
-	if (lr->lrc_seq <= zh->zh_replay_seq)	/* already replayed */
-		return (0);
-
-	if (lr->lrc_txg < claim_txg)		/* already committed */
-		return (0);
-
-	/* Strip case-insensitive bit, still present in log record */
-	txtype &= ~TX_CI;
-
-	if (txtype == 0 || txtype >= TX_MAX_TYPE)
-		return (zil_replay_error(zilog, lr, EINVAL));
-
 	/*
 	 * If this record type can be logged out of order, the object
 	 * (lr_foid) may no longer exist.  That's legitimate, not an error.
@@ -4716,17 +4866,12 @@ zil_replay_log_record(zilog_t *zilog, const lr_t *lr, void *zra,
 			return (0);
 	}
 
-	/*
-	 * Make a copy of the data so we can revise and extend it.
-	 */
-	memcpy(zr->zr_lr, lr, reclen);
-
 	/*
 	 * If this is a TX_WRITE with a blkptr, suck in the data.
 	 */
 	if (txtype == TX_WRITE && reclen == sizeof (lr_write_t)) {
 		error = zil_read_log_data(zilog, (lr_write_t *)lr,
-		    zr->zr_lr + reclen);
+		    buf + reclen);
 		if (error != 0)
 			return (zil_replay_error(zilog, lr, error));
 	}
@@ -4739,7 +4884,7 @@ zil_replay_log_record(zilog_t *zilog, const lr_t *lr, void *zra,
 	 * the lr was byteswapped, undo it before invoking the replay vector.
 	 */
 	if (zr->zr_byteswap)
-		byteswap_uint64_array(zr->zr_lr, reclen);
+		byteswap_uint64_array(buf, reclen);
 
 	/*
 	 * We must now do two things atomically: replay this log record,
@@ -4747,7 +4892,7 @@ zil_replay_log_record(zilog_t *zilog, const lr_t *lr, void *zra,
 	 * we did so. At the end of each replay function the sequence number
 	 * is updated if we are in replay mode.
 	 */
-	error = zr->zr_replay[txtype](zr->zr_arg, zr->zr_lr, zr->zr_byteswap);
+	error = zr->zr_replay[txtype](zr->zr_arg, buf, zr->zr_byteswap);
 	if (error != 0) {
 		/*
 		 * The DMU's dnode layer doesn't see removes until the txg
@@ -4757,10 +4902,249 @@ zil_replay_log_record(zilog_t *zilog, const lr_t *lr, void *zra,
 		 * specify B_FALSE for byteswap now, so we don't do it twice.
 		 */
 		txg_wait_synced(spa_get_dsl(zilog->zl_spa), 0);
-		error = zr->zr_replay[txtype](zr->zr_arg, zr->zr_lr, B_FALSE);
+		error = zr->zr_replay[txtype](zr->zr_arg, buf, B_FALSE);
 		if (error != 0)
 			return (zil_replay_error(zilog, lr, error));
 	}
+
+	ZIL_STAT_BUMP(zilog, zil_replay_count);
+	ZIL_STAT_INCR(zilog, zil_replay_bytes, reclen);
+	return (0);
+}
+
+/*
+ * Records which only touch the object named by their lr_foid and whose
+ * replay vectors keep no state outside of that object, so that records
+ * for different objects may be replayed concurrently.  Everything else,
+ * in particular the records naming several objects (create, remove, link,
+ * rename) and those relying on the replay FUID state, is a barrier.
+ */
+static boolean_t
+zil_replay_parallel_ok(uint64_t txtype)
+{
+	switch (txtype) {
+	case TX_WRITE:
+	case TX_WRITE2:
+	case TX_TRUNCATE:
+	case TX_CLONE_RANGE:
+		return (B_TRUE);
+	default:
+		return (B_FALSE);
+	}
+}
+
+/*
+ * Records replayed by the workers complete out of log order, so the
+ * sequence number stored in the log header may only cover the records
+ * from the head of zr_pending that are all done.  Their transactions were
+ * committed in txgs no later than the open one, which is at most
+ * TXG_CONCURRENT_STATES past the last synced txg; the sequence number is
+ * recorded for that txg so it does not reach the header before they do.
+ * Called with zr_lock held.
+ */
+static void
+zil_replay_advance(zil_replay_arg_t *zr)
+{
+	zilog_t *zilog = zr->zr_zilog;
+	zil_replay_rec_t *rec;
+	uint64_t seq = 0;
+
+	ASSERT(MUTEX_HELD(&zr->zr_lock));
+
+	while ((rec = list_head(&zr->zr_pending)) != NULL && rec->zrr_done) {
+		seq = rec->zrr_seq;
+		list_remove(&zr->zr_pending, rec);
+		kmem_free(rec, sizeof (*rec));
+	}
+	if (seq == 0)
+		return;
+
+	seq = (rec != NULL) ? rec->zrr_seq - 1 : zr->zr_seen_seq;
+	uint64_t txg = spa_last_synced_txg(zilog->zl_spa) +
+	    TXG_CONCURRENT_STATES;
+
+	mutex_enter(&zilog->zl_lock);
+	zilog->zl_replayed_seq[txg & TXG_MASK] =
+	    MAX(zilog->zl_replayed_seq[txg & TXG_MASK], seq);
+	mutex_exit(&zilog->zl_lock);
+
+	if (list_is_empty(&zr->zr_pending))
+		zilog->zl_replay_async = B_FALSE;
+}
+
+static void
+zil_replay_rec_func(void *arg)
+{
+	zil_replay_rec_t *rec = arg;
+	zil_replay_arg_t *zr = rec->zrr_zr;
+	int error;
+
+	/* Once a record failed, the rest of the log is not replayed. */
+	error = zr->zr_error;
+	if (error == 0) {
+		error = zil_replay_record(zr->zr_zilog, zr,
+		    (lr_t *)rec->zrr_lr, rec->zrr_lr);
+	}
+	vmem_free(rec->zrr_lr, rec->zrr_size);
+	rec->zrr_lr = NULL;
+
+	mutex_enter(&zr->zr_lock);
+	zr->zr_pending_bytes -= rec->zrr_size;
+	zr->zr_outstanding--;
+	if (error == 0) {
+		rec->zrr_done = B_TRUE;
+		zil_replay_advance(zr);
+	} else if (zr->zr_error == 0) {
+		zr->zr_error = error;
+	}
+	cv_broadcast(&zr->zr_cv);
+	mutex_exit(&zr->zr_lock);
+}
+
+/*
+ * Queue a copy of an object-local record to the worker owning its object.
+ */
+static int
+zil_replay_dispatch(zil_replay_arg_t *zr, const lr_t *lr)
+{
+	uint64_t reclen = lr->lrc_reclen;
+	uint64_t size = reclen;
+	uint64_t obj = LR_FOID_GET_OBJ(((const lr_ooo_t *)lr)->lr_foid);
+	zil_replay_rec_t *rec;
+	int error;
+
+	if ((lr->lrc_txtype & ~TX_CI) == TX_WRITE &&
+	    reclen == sizeof (lr_write_t)) {
+		const lr_write_t *lrw = (const lr_write_t *)lr;
+		size += MAX(BP_GET_LSIZE(&lrw->lr_blkptr), lrw->lr_length);
+	}
+
+	mutex_enter(&zr->zr_lock);
+	while (zr->zr_error == 0 && zr->zr_pending_bytes != 0 &&
+	    zr->zr_pending_bytes + size > zil_replay_queue_max)
+		cv_wait(&zr->zr_cv, &zr->zr_lock);
+	if ((error = zr->zr_error) != 0) {
+		mutex_exit(&zr->zr_lock);
+		return (error);
+	}
+	mutex_exit(&zr->zr_lock);
+
+	rec = kmem_zalloc(sizeof (*rec), KM_SLEEP);
+	taskq_init_ent(&rec->zrr_tqent);
+	rec->zrr_zr = zr;
+	rec->zrr_seq = lr->lrc_seq;
+	rec->zrr_size = size;
+	rec->zrr_lr = vmem_alloc(size, KM_SLEEP);
+	memcpy(rec->zrr_lr, lr, reclen);
+
+	mutex_enter(&zr->zr_lock);
+	list_insert_tail(&zr->zr_pending, rec);
+	zr->zr_pending_bytes += size;
+	zr->zr_outstanding++;
+	zr->zr_seen_seq = rec->zrr_seq;
+	zr->zr_zilog->zl_replay_async = B_TRUE;
+	mutex_exit(&zr->zr_lock);
+
+	taskq_dispatch_ent(zr->zr_taskqs[obj % zr->zr_ntaskqs],
+	    zil_replay_rec_func, rec, 0, &rec->zrr_tqent);
+
+	return (0);
+}
+
+/*
+ * Wait for the workers to replay everything queued to them.
+ */
+static int
+zil_replay_drain(zil_replay_arg_t *zr)
+{
+	int error;
+
+	mutex_enter(&zr->zr_lock);
+	while (zr->zr_outstanding != 0)
+		cv_wait(&zr->zr_cv, &zr->zr_lock);
+	error = zr->zr_error;
+	mutex_exit(&zr->zr_lock);
+
+	return (error);
+}
+
+static void
+zil_replay_progress(zilog_t *zilog, zil_replay_arg_t *zr, const lr_t *lr,
+    boolean_t done)
+{
+	hrtime_t now = gethrtime();
+	char name[ZFS_MAX_DATASET_NAME_LEN];
+
+	if (!done && now - zr->zr_reported < SEC2NSEC(1))
+		return;
+	zr->zr_reported = now;
+
+	uint64_t ms = MAX(NSEC2MSEC(now - zr->zr_start), 1);
+	dmu_objset_name(zilog->zl_os, name);
+	zfs_dbgmsg("zil replay %s %s: seq %llu/%llu, %llu records, "
+	    "%llu barriers, %llu bytes in %llu ms (%llu records/s, "
+	    "%llu KiB/s)", name, done ? "done" : "progress",
+	    (u_longlong_t)(lr != NULL ? lr->lrc_seq : zr->zr_seen_seq),
+	    (u_longlong_t)zilog->zl_header->zh_claim_lr_seq,
+	    (u_longlong_t)zr->zr_records, (u_longlong_t)zr->zr_barriers,
+	    (u_longlong_t)zr->zr_bytes, (u_longlong_t)ms,
+	    (u_longlong_t)(zr->zr_records * 1000 / ms),
+	    (u_longlong_t)(zr->zr_bytes * 1000 / 1024 / ms));
+}
+
+static int
+zil_replay_log_record(zilog_t *zilog, const lr_t *lr, void *zra,
+    uint64_t claim_txg)
+{
+	zil_replay_arg_t *zr = zra;
+	const zil_header_t *zh = zilog->zl_header;
+	uint64_t reclen = lr->lrc_reclen;
+	uint64_t txtype = lr->lrc_txtype;
+	int error = 0;
+
+	zil_replay_progress(zilog, zr, lr, B_FALSE);
+
+	zilog->zl_replaying_seq = lr->lrc_seq;
+
+	if (lr->lrc_seq <= zh->zh_replay_seq)	/* already replayed */
+		goto skip;
+
+	if (lr->lrc_txg < claim_txg)		/* already committed */
+		goto skip;
+
+	/* Strip case-insensitive bit, still present in log record */
+	txtype &= ~TX_CI;
+
+	if (txtype == 0 || txtype >= TX_MAX_TYPE)
+		return (zil_replay_error(zilog, lr, EINVAL));
+
+	zr->zr_records++;
+	zr->zr_bytes += reclen;
+
+	if (zr->zr_ntaskqs != 0) {
+		if (zil_replay_parallel_ok(txtype))
+			return (zil_replay_dispatch(zr, lr));
+		if ((error = zil_replay_drain(zr)) != 0)
+			return (error);
+		zr->zr_barriers++;
+		ZIL_STAT_BUMP(zilog, zil_replay_barrier_count);
+	}
+
+	/*
+	 * Make a copy of the data so we can revise and extend it.
+	 */
+	memcpy(zr->zr_lr, lr, reclen);
+
+	error = zil_replay_record(zilog, zr, lr, zr->zr_lr);
+	if (error != 0)
+		return (error);
+
+skip:
+	if (zr->zr_ntaskqs != 0) {
+		mutex_enter(&zr->zr_lock);
+		zr->zr_seen_seq = lr->lrc_seq;
+		mutex_exit(&zr->zr_lock);
+	}
 	return (0);
 }
 
@@ -4790,10 +5174,27 @@ zil_replay(objset_t *os, void *arg,
 		return (zil_destroy(zilog, B_TRUE));
 	}
 
+	memset(&zr, 0, sizeof (zr));
+	zr.zr_zilog = zilog;
 	zr.zr_replay = replay_func;
 	zr.zr_arg = arg;
 	zr.zr_byteswap = BP_SHOULD_BYTESWAP(&zh->zh_log);
 	zr.zr_lr = vmem_alloc(2 * SPA_MAXBLOCKSIZE, KM_SLEEP);
+	zr.zr_start = zr.zr_reported = gethrtime();
+
+	zr.zr_ntaskqs = MIN(zil_replay_threads, boot_ncpus);
+	if (zr.zr_ntaskqs != 0) {
+		mutex_init(&zr.zr_lock, NULL, MUTEX_DEFAULT, NULL);
+		cv_init(&zr.zr_cv, NULL, CV_DEFAULT, NULL);
+		list_create(&zr.zr_pending, sizeof (zil_replay_rec_t),
+		    offsetof(zil_replay_rec_t, zrr_node));
+		zr.zr_taskqs = kmem_alloc(zr.zr_ntaskqs * sizeof (taskq_t *),
+		    KM_SLEEP);
+		for (uint_t i = 0; i < zr.zr_ntaskqs; i++) {
+			zr.zr_taskqs[i] = taskq_create("z_zil_replay", 1,
+			    defclsyspri, 1, INT_MAX, 0);
+		}
+	}
 
 	/*
 	 * Wait for in-progress removes to sync before starting replay.
@@ -4807,6 +5208,24 @@ zil_replay(objset_t *os, void *arg,
 	    zh->zh_claim_txg, B_TRUE);
 	vmem_free(zr.zr_lr, 2 * SPA_MAXBLOCKSIZE);
 
+	if (zr.zr_ntaskqs != 0) {
+		zil_replay_rec_t *rec;
+
+		(void) zil_replay_drain(&zr);
+		for (uint_t i = 0; i < zr.zr_ntaskqs; i++)
+			taskq_destroy(zr.zr_taskqs[i]);
+		kmem_free(zr.zr_taskqs, zr.zr_ntaskqs * sizeof (taskq_t *));
+
+		/* Only records left behind by an error remain. */
+		while ((rec = list_remove_head(&zr.zr_pending)) != NULL)
+			kmem_free(rec, sizeof (*rec));
+		zilog->zl_replay_async = B_FALSE;
+		list_destroy(&zr.zr_pending);
+		cv_destroy(&zr.zr_cv);
+		mutex_destroy(&zr.zr_lock);
+	}
+	zil_replay_progress(zilog, &zr, NULL, B_TRUE);
+
 	zil_destroy(zilog, B_FALSE);
 	txg_wait_synced(zilog->zl_dmu_pool, zilog->zl_destroy_txg);
 	zilog->zl_replay = B_FALSE;
@@ -4822,8 +5241,14 @@ zil_replaying(zilog_t *zilog, dmu_tx_t *tx)
 
 	if (zilog->zl_replay) {
 		dsl_dataset_dirty(dmu_objset_ds(zilog->zl_os), tx);
-		zilog->zl_replayed_seq[dmu_tx_get_txg(tx) & TXG_MASK] =
-		    zilog->zl_replaying_seq;
+		/*
+		 * Records replayed by the parallel replay workers advance
+		 * the replayed sequence number in zil_replay_advance().
+		 */
+		if (!zilog->zl_replay_async) {
+			zilog->zl_replayed_seq[dmu_tx_get_txg(tx) & TXG_MASK] =
+			    zilog->zl_replaying_seq;
+		}
 		return (B_TRUE);
 	}
 
@@ -4879,9 +5304,18 @@ ZFS_MODULE_PARAM(zfs_zil, zil_, replay_disable, INT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_zil, zil_, nocacheflush, INT, ZMOD_RW,
 	"Disable ZIL cache flushes");
 
+ZFS_MODULE_PARAM(zfs_zil, zil_, replay_threads, UINT, ZMOD_RW,
+	"Number of threads replaying object-local log records in parallel");
+
+ZFS_MODULE_PARAM(zfs_zil, zil_, replay_queue_max, U64, ZMOD_RW,
+	"Limit in bytes of log records queued to parallel replay threads");
+
 ZFS_MODULE_PARAM(zfs_zil, zil_, slog_bulk, U64, ZMOD_RW,
 	"Limit in bytes slog sync writes per commit");
 
+ZFS_MODULE_PARAM(zfs_zil, zil_, slog_stripe, INT, ZMOD_RW,
+	"Stripe consecutive log blocks across log vdevs");
+
 ZFS_MODULE_PARAM(zfs_zil, zil_, maxblocksize, UINT, ZMOD_RW,
 	"Limit in bytes of ZIL log block size");
 
@@ -140,17 +140,39 @@ static uint_t zfs_sync_pass_rewrite = 2;
 int zio_exclude_metadata = 0;
 static int zio_requeue_io_start_cut_in_line = 1;
 
+/*
+ * Small writes reaching the write issue taskqs are coalesced into batches of
+ * up to zio_write_batch_max zios which run from a single taskq entry, see
+ * zio_write_batch_execute().  Writes larger than zio_write_batch_maxsize are
+ * always dispatched individually so that their compression stays spread over
+ * all taskq threads; the limit is capped at SPA_OLD_MAXBLOCKSIZE so a batch
+ * never serializes the compression of many large blocks on one thread.
+ */
+static uint_t zio_write_batch_max = 16;
+static uint_t zio_write_batch_maxsize = 32 << 10;
+
 #ifdef ZFS_DEBUG
 static const int zio_buf_debug_limit = 16384;
 #else
 static const int zio_buf_debug_limit = 0;
 #endif
 
+/*
+ * Write batch size histograms have power-of-two buckets, bucket N counts
+ * batches of [2^N, 2^(N+1)) zios.  The last bucket holds batches of
+ * ZIO_CHECKSUM_MULTI_MAX zios, the largest allowed.
+ */
+#define	ZIO_BATCH_HIST_BUCKETS	5
+_Static_assert(ZIO_CHECKSUM_MULTI_MAX == 1 << (ZIO_BATCH_HIST_BUCKETS - 1),
+	"write batch histogram does not match ZIO_CHECKSUM_MULTI_MAX");
+
 typedef struct zio_stats {
 	kstat_named_t ziostat_total_allocations;
 	kstat_named_t ziostat_alloc_class_fallbacks;
 	kstat_named_t ziostat_gang_writes;
 	kstat_named_t ziostat_gang_multilevel;
+	kstat_named_t ziostat_compress_batch[ZIO_BATCH_HIST_BUCKETS];
+	kstat_named_t ziostat_checksum_batch[ZIO_BATCH_HIST_BUCKETS];
 } zio_stats_t;
 
 static zio_stats_t zio_stats = {
@@ -158,6 +180,20 @@ static zio_stats_t zio_stats = {
 	{ "alloc_class_fallbacks",	KSTAT_DATA_UINT64 },
 	{ "gang_writes",	KSTAT_DATA_UINT64 },
 	{ "gang_multilevel",	KSTAT_DATA_UINT64 },
+	{
+		{ "compress_batch_1",	KSTAT_DATA_UINT64 },
+		{ "compress_batch_2",	KSTAT_DATA_UINT64 },
+		{ "compress_batch_4",	KSTAT_DATA_UINT64 },
+		{ "compress_batch_8",	KSTAT_DATA_UINT64 },
+		{ "compress_batch_16",	KSTAT_DATA_UINT64 },
+	},
+	{
+		{ "checksum_batch_1",	KSTAT_DATA_UINT64 },
+		{ "checksum_batch_2",	KSTAT_DATA_UINT64 },
+		{ "checksum_batch_4",	KSTAT_DATA_UINT64 },
+		{ "checksum_batch_8",	KSTAT_DATA_UINT64 },
+		{ "checksum_batch_16",	KSTAT_DATA_UINT64 },
+	},
 };
 
 struct {
@@ -165,13 +201,44 @@ struct {
 	wmsum_t ziostat_alloc_class_fallbacks;
 	wmsum_t ziostat_gang_writes;
 	wmsum_t ziostat_gang_multilevel;
+	wmsum_t ziostat_compress_batch[ZIO_BATCH_HIST_BUCKETS];
+	wmsum_t ziostat_checksum_batch[ZIO_BATCH_HIST_BUCKETS];
 } ziostat_sums;
 
 #define	ZIOSTAT_BUMP(stat)	wmsum_add(&ziostat_sums.stat, 1);
+#define	ZIOSTAT_BATCH_BUMP(stat, n)	\
+	wmsum_add(&ziostat_sums.stat[highbit64(n) - 1], 1);
 
 static kstat_t *zio_ksp;
 
+/*
+ * Per-NUMA-node locality statistics, exported as node<N>_<stat> entries of
+ * the zfs/numa_stats kstat.  See zio_numa_stat_t.
+ *
+ * Node IDs need not be dense, so the nodes online at module load are
+ * numbered 0 to zio_numa_nnodes - 1, and the statistics as well as the
+ * NUMA-bound zio taskqs are indexed by that number.  zio_numa_node_id[]
+ * maps it to the node ID, zio_numa_node_idx[] maps node IDs back to it.
+ * Nodes brought online later have no index.
+ */
+static const char *const zio_numa_stat_names[ZIO_NUMA_NSTATS] = {
+	"zio_dispatch_local",
+	"zio_dispatch_remote",
+	"abd_pages_local",
+	"abd_pages_remote",
+};
+
+static uint_t zio_numa_nnodes;
+static int *zio_numa_node_id;
+static uint_t zio_numa_max_nodes;
+static uint_t *zio_numa_node_idx;
+static wmsum_t *zio_numa_sums;
+static kstat_named_t *zio_numa_stats;
+static kstat_t *zio_numa_ksp;
+
 static inline void __zio_execute(zio_t *zio);
+static inline zio_t *__zio_execute_until(zio_t *zio, enum zio_stage stop);
+static void zio_checksum_generate_batch(zio_t **zios, uint_t n);
 
 static void zio_taskq_dispatch(zio_t *, zio_taskq_type_t, boolean_t);
 
@@ -190,9 +257,133 @@ zio_kstats_update(kstat_t *ksp, int rw)
 	    wmsum_value(&ziostat_sums.ziostat_gang_writes);
 	zs->ziostat_gang_multilevel.value.ui64 =
 	    wmsum_value(&ziostat_sums.ziostat_gang_multilevel);
+	for (int i = 0; i < ZIO_BATCH_HIST_BUCKETS; i++) {
+		zs->ziostat_compress_batch[i].value.ui64 =
+		    wmsum_value(&ziostat_sums.ziostat_compress_batch[i]);
+		zs->ziostat_checksum_batch[i].value.ui64 =
+		    wmsum_value(&ziostat_sums.ziostat_checksum_batch[i]);
+	}
+	return (0);
+}
+
+uint_t
+zio_numa_node_count(void)
+{
+	return (zio_numa_nnodes);
+}
+
+/*
+ * Return the ID of the node numbered idx.
+ */
+int
+zio_numa_node(uint_t idx)
+{
+	ASSERT3U(idx, <, zio_numa_nnodes);
+	return (zio_numa_node_id[idx]);
+}
+
+/*
+ * Return the number of the node with the given ID, or UINT_MAX if it was
+ * not online at module load.
+ */
+uint_t
+zio_numa_node_index(int nid)
+{
+	if (nid < 0 || (uint_t)nid >= zio_numa_max_nodes)
+		return (UINT_MAX);
+	return (zio_numa_node_idx[nid]);
+}
+
+void
+zio_numa_stat_add(int nid, zio_numa_stat_t stat, uint64_t n)
+{
+	uint_t idx = zio_numa_node_index(nid);
+
+	ASSERT3U(stat, <, ZIO_NUMA_NSTATS);
+	if (idx < zio_numa_nnodes)
+		wmsum_add(&zio_numa_sums[idx * ZIO_NUMA_NSTATS + stat], n);
+}
+
+static int
+zio_numa_kstats_update(kstat_t *ksp, int rw)
+{
+	kstat_named_t *ks = ksp->ks_data;
+	if (rw == KSTAT_WRITE)
+		return (EACCES);
+
+	for (uint_t i = 0; i < zio_numa_nnodes * ZIO_NUMA_NSTATS; i++)
+		ks[i].value.ui64 = wmsum_value(&zio_numa_sums[i]);
 	return (0);
 }
 
+static void
+zio_numa_stats_init(void)
+{
+	uint_t n;
+
+	zio_numa_max_nodes = MAX(1, max_nnodes);
+	zio_numa_node_id = kmem_alloc(zio_numa_max_nodes * sizeof (int),
+	    KM_SLEEP);
+	zio_numa_node_idx = kmem_alloc(zio_numa_max_nodes * sizeof (uint_t),
+	    KM_SLEEP);
+	zio_numa_nnodes = 0;
+	for (uint_t nid = 0; nid < zio_numa_max_nodes; nid++) {
+		if (node_is_online(nid)) {
+			zio_numa_node_id[zio_numa_nnodes] = nid;
+			zio_numa_node_idx[nid] = zio_numa_nnodes++;
+		} else {
+			zio_numa_node_idx[nid] = UINT_MAX;
+		}
+	}
+	if (zio_numa_nnodes == 0) {
+		zio_numa_node_id[0] = 0;
+		zio_numa_node_idx[0] = 0;
+		zio_numa_nnodes = 1;
+	}
+
+	n = zio_numa_nnodes * ZIO_NUMA_NSTATS;
+	zio_numa_sums = kmem_alloc(n * sizeof (wmsum_t), KM_SLEEP);
+	zio_numa_stats = kmem_zalloc(n * sizeof (kstat_named_t), KM_SLEEP);
+	for (uint_t i = 0; i < n; i++) {
+		wmsum_init(&zio_numa_sums[i], 0);
+		(void) snprintf(zio_numa_stats[i].name, KSTAT_STRLEN,
+		    "node%d_%s", zio_numa_node_id[i / ZIO_NUMA_NSTATS],
+		    zio_numa_stat_names[i % ZIO_NUMA_NSTATS]);
+		zio_numa_stats[i].data_type = KSTAT_DATA_UINT64;
+	}
+
+	zio_numa_ksp = kstat_create("zfs", 0, "numa_stats", "misc",
+	    KSTAT_TYPE_NAMED, n, KSTAT_FLAG_VIRTUAL);
+	if (zio_numa_ksp != NULL) {
+		zio_numa_ksp->ks_data = zio_numa_stats;
+		zio_numa_ksp->ks_update = zio_numa_kstats_update;
+		kstat_install(zio_numa_ksp);
+	}
+}
+
+static void
+zio_numa_stats_fini(void)
+{
+	uint_t n = zio_numa_nnodes * ZIO_NUMA_NSTATS;
+
+	if (zio_numa_ksp != NULL) {
+		kstat_delete(zio_numa_ksp);
+		zio_numa_ksp = NULL;
+	}
+	for (uint_t i = 0; i < n; i++)
+		wmsum_fini(&zio_numa_sums[i]);
+	kmem_free(zio_numa_sums, n * sizeof (wmsum_t));
+	kmem_free(zio_numa_stats, n * sizeof (kstat_named_t));
+	kmem_free(zio_numa_node_id, zio_numa_max_nodes * sizeof (int));
+	kmem_free(zio_numa_node_idx, zio_numa_max_nodes * sizeof (uint_t));
+	zio_numa_sums = NULL;
+	zio_numa_stats = NULL;
+	zio_numa_node_id = NULL;
+	zio_numa_node_idx = NULL;
+	zio_numa_nnodes = 0;
+	zio_numa_max_nodes = 0;
+}
+
 void
 zio_init(void)
 {
@@ -207,6 +398,10 @@ zio_init(void)
 	wmsum_init(&ziostat_sums.ziostat_alloc_class_fallbacks, 0);
 	wmsum_init(&ziostat_sums.ziostat_gang_writes, 0);
 	wmsum_init(&ziostat_sums.ziostat_gang_multilevel, 0);
+	for (int i = 0; i < ZIO_BATCH_HIST_BUCKETS; i++) {
+		wmsum_init(&ziostat_sums.ziostat_compress_batch[i], 0);
+		wmsum_init(&ziostat_sums.ziostat_checksum_batch[i], 0);
+	}
 	zio_ksp = kstat_create("zfs", 0, "zio_stats",
 	    "misc", KSTAT_TYPE_NAMED, sizeof (zio_stats) /
 	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
@@ -215,6 +410,7 @@ zio_init(void)
 		zio_ksp->ks_update = zio_kstats_update;
 		kstat_install(zio_ksp);
 	}
+	zio_numa_stats_init();
 
 	for (c = 0; c < SPA_MAXBLOCKSIZE >> SPA_MINBLOCKSHIFT; c++) {
 		size_t size = (c + 1) << SPA_MINBLOCKSHIFT;
@@ -352,6 +548,11 @@ zio_fini(void)
 	wmsum_fini(&ziostat_sums.ziostat_alloc_class_fallbacks);
 	wmsum_fini(&ziostat_sums.ziostat_gang_writes);
 	wmsum_fini(&ziostat_sums.ziostat_gang_multilevel);
+	for (int i = 0; i < ZIO_BATCH_HIST_BUCKETS; i++) {
+		wmsum_fini(&ziostat_sums.ziostat_compress_batch[i]);
+		wmsum_fini(&ziostat_sums.ziostat_checksum_batch[i]);
+	}
+	zio_numa_stats_fini();
 
 	kmem_cache_destroy(zio_link_cache);
 	kmem_cache_destroy(zio_cache);
@@ -2204,10 +2405,137 @@ zio_taskq_member(zio_t *zio, zio_taskq_type_t q)
 	return (B_FALSE);
 }
 
+/*
+ * Pick the issue taskq a batch led by this zio is dispatched to.  Like
+ * zio_taskq_dispatch() does for single zios, high priority writes go to the
+ * high priority taskq if there is one and cut the line otherwise, so they
+ * are never left waiting behind normal writes.  Such writes only share a
+ * batch with other high priority writes.
+ */
+static zio_taskq_type_t
+zio_write_batch_queue(zio_t *zio, boolean_t *cutinline)
+{
+	spa_t *spa = zio->io_spa;
+	zio_taskq_type_t q = ZIO_TASKQ_ISSUE;
+
+	*cutinline = B_FALSE;
+	if (zio->io_priority == ZIO_PRIORITY_NOW) {
+		if (spa->spa_zio_taskq[ZIO_TYPE_WRITE][q + 1].stqs_count != 0)
+			q++;
+		else
+			*cutinline = B_TRUE;
+	}
+
+	return (q);
+}
+
+static spa_zio_batch_t *
+zio_write_batch(zio_t *zio)
+{
+	return (&zio->io_spa->spa_zio_batch[2 * zio->io_allocator +
+	    (zio->io_priority == ZIO_PRIORITY_NOW)]);
+}
+
+/*
+ * Run a batch of small writes collected by zio_issue_async().  Every zio is
+ * first executed up to its checksum stage, the checksums of the whole batch
+ * are then generated together, and finally each zio continues through the
+ * rest of its pipeline.  Compression has no batch kernel, but the batch
+ * still saves a taskq dispatch and wakeup per zio.
+ */
+static void
+zio_write_batch_execute(void *arg)
+{
+	zio_t *leader = arg;
+	spa_zio_batch_t *szb = zio_write_batch(leader);
+	zio_t *zios[ZIO_CHECKSUM_MULTI_MAX];
+	fstrans_cookie_t cookie;
+	uint_t i, n = 0, nready = 0;
+
+	/* Close the batch, no more zios can be added from here on. */
+	mutex_enter(&szb->szb_lock);
+	if (szb->szb_open == leader) {
+		szb->szb_open = NULL;
+		szb->szb_tail = NULL;
+		szb->szb_count = 0;
+	}
+	mutex_exit(&szb->szb_lock);
+
+	for (zio_t *zio = leader, *next; zio != NULL; zio = next) {
+		next = zio->io_batch_next;
+		zio->io_batch_next = NULL;
+		ASSERT3U(n, <, ZIO_CHECKSUM_MULTI_MAX);
+		zios[n++] = zio;
+	}
+	ZIOSTAT_BATCH_BUMP(ziostat_compress_batch, n);
+
+	cookie = spl_fstrans_mark();
+	for (i = 0; i < n; i++) {
+		zio_t *zio = __zio_execute_until(zios[i],
+		    ZIO_STAGE_CHECKSUM_GENERATE);
+		if (zio != NULL)
+			zios[nready++] = zio;
+	}
+	if (nready > 0) {
+		ZIOSTAT_BATCH_BUMP(ziostat_checksum_batch, nready);
+		zio_checksum_generate_batch(zios, nready);
+		for (i = 0; i < nready; i++)
+			__zio_execute(zios[i]);
+	}
+	spl_fstrans_unmark(cookie);
+}
+
+static boolean_t
+zio_write_batchable(zio_t *zio)
+{
+	return (zio->io_type == ZIO_TYPE_WRITE &&
+	    zio->io_vd == NULL &&
+	    zio->io_priority != ZIO_PRIORITY_SYNC_WRITE &&
+	    zio->io_size <=
+	    MIN(zio_write_batch_maxsize, SPA_OLD_MAXBLOCKSIZE) &&
+	    !(zio->io_flags & (ZIO_FLAG_CONFIG_WRITER | ZIO_FLAG_PROBE)));
+}
+
 static zio_t *
 zio_issue_async(zio_t *zio)
 {
 	ASSERT((zio->io_type != ZIO_TYPE_WRITE) || ZIO_HAS_ALLOCATOR(zio));
+
+	uint_t max = MIN(zio_write_batch_max, ZIO_CHECKSUM_MULTI_MAX);
+	if (max > 1 && zio_write_batchable(zio)) {
+		spa_zio_batch_t *szb = zio_write_batch(zio);
+		zio_taskq_type_t q;
+		boolean_t cutinline;
+
+		/*
+		 * Join the open batch of this allocator if there is one, it
+		 * is already waiting for a taskq thread.  Otherwise start a
+		 * new batch led by this zio.
+		 */
+		ASSERT0P(zio->io_batch_next);
+		mutex_enter(&szb->szb_lock);
+		if (szb->szb_open != NULL) {
+			szb->szb_tail->io_batch_next = zio;
+			szb->szb_tail = zio;
+			if (++szb->szb_count >= max) {
+				szb->szb_open = NULL;
+				szb->szb_tail = NULL;
+				szb->szb_count = 0;
+			}
+			mutex_exit(&szb->szb_lock);
+			return (NULL);
+		}
+		szb->szb_open = zio;
+		szb->szb_tail = zio;
+		szb->szb_count = 1;
+		mutex_exit(&szb->szb_lock);
+
+		q = zio_write_batch_queue(zio, &cutinline);
+		spa_taskq_dispatch(zio->io_spa, ZIO_TYPE_WRITE, q,
+		    zio_write_batch_execute, zio, cutinline);
+		return (NULL);
+	}
+
 	zio_taskq_dispatch(zio, ZIO_TASKQ_ISSUE, B_FALSE);
 	return (NULL);
 }
@@ -2422,9 +2750,14 @@ zio_execute_stack_check(zio_t *zio)
 	return (B_FALSE);
 }
 
+/*
+ * Execute the pipeline like __zio_execute(), but stop before entering the
+ * 'stop' stage.  The zio about to enter it is returned, or NULL if the
+ * pipeline stopped for any other reason.
+ */
 __attribute__((always_inline))
-static inline void
-__zio_execute(zio_t *zio)
+static inline zio_t *
+__zio_execute_until(zio_t *zio, enum zio_stage stop)
 {
 	ASSERT3U(zio->io_queued_timestamp, >, 0);
 
@@ -2444,6 +2777,9 @@ __zio_execute(zio_t *zio)
 
 		ASSERT(stage <= ZIO_STAGE_DONE);
 
+		if (stage == stop)
+			return (zio);
+
 		/*
 		 * If we are in interrupt context and this pipeline stage
 		 * will grab a config lock that is held across I/O,
@@ -2458,7 +2794,7 @@ __zio_execute(zio_t *zio)
 			boolean_t cut = (stage == ZIO_STAGE_VDEV_IO_START) ?
 			    zio_requeue_io_start_cut_in_line : B_FALSE;
 			zio_taskq_dispatch(zio, ZIO_TASKQ_ISSUE, cut);
-			return;
+			return (NULL);
 		}
 
 		/*
@@ -2469,7 +2805,7 @@ __zio_execute(zio_t *zio)
 			boolean_t cut = (stage == ZIO_STAGE_VDEV_IO_START) ?
 			    zio_requeue_io_start_cut_in_line : B_FALSE;
 			zio_taskq_dispatch(zio, ZIO_TASKQ_ISSUE, cut);
-			return;
+			return (NULL);
 		}
 
 		zio->io_stage = stage;
@@ -2483,8 +2819,17 @@ __zio_execute(zio_t *zio)
 		zio = zio_pipeline[highbit64(stage) - 1](zio);
 
 		if (zio == NULL)
-			return;
+			return (NULL);
 	}
+
+	return (NULL);
+}
+
+__attribute__((always_inline))
+static inline void
+__zio_execute(zio_t *zio)
+{
+	(void) __zio_execute_until(zio, 0);
 }
 
 
@@ -4431,11 +4776,13 @@ zio_dva_unallocate(zio_t *zio, zio_gang_node_t *gn, blkptr_t *bp)
 
 /*
  * Try to allocate an intent log block.  Return 0 on success, errno on failure.
+ * If prev_bp is given, it is the previous block of the same log chain and the
+ * new block is placed on the vdev following it within its allocation class.
  */
 int
 zio_alloc_zil(spa_t *spa, objset_t *os, uint64_t txg, blkptr_t *new_bp,
-    uint64_t min_size, uint64_t max_size, boolean_t *slog,
-    boolean_t allow_larger)
+    uint64_t min_size, uint64_t max_size, const blkptr_t *prev_bp,
+    boolean_t *slog, boolean_t allow_larger)
 {
 	int error;
 	zio_alloc_list_t io_alloc_list;
@@ -4463,11 +4810,15 @@ zio_alloc_zil(spa_t *spa, objset_t *os, uint64_t txg, blkptr_t *new_bp,
 	int flags = METASLAB_ZIL;
 	int allocator = (uint_t)cityhash1(os->os_dsl_dataset->ds_object)
 	    % spa->spa_alloc_count;
+	if (prev_bp != NULL && !BP_IS_HOLE(prev_bp))
+		flags |= METASLAB_ZIL_STRIPE;
+	else
+		prev_bp = NULL;
 	ZIOSTAT_BUMP(ziostat_total_allocations);
 
 	/* Try log class (dedicated slog devices) first */
 	error = metaslab_alloc_range(spa, spa_log_class(spa), min_size,
-	    max_size, new_bp, 1, txg, NULL, flags, &io_alloc_list, allocator,
+	    max_size, new_bp, 1, txg, prev_bp, flags, &io_alloc_list, allocator,
 	    NULL, &alloc_size);
 	*slog = (error == 0);
 
@@ -4475,21 +4826,21 @@ zio_alloc_zil(spa_t *spa, objset_t *os, uint64_t txg, blkptr_t *new_bp,
 	if (error != 0) {
 		error = metaslab_alloc_range(spa,
 		    spa_special_embedded_log_class(spa), min_size, max_size,
-		    new_bp, 1, txg, NULL, flags, &io_alloc_list, allocator,
+		    new_bp, 1, txg, prev_bp, flags, &io_alloc_list, allocator,
 		    NULL, &alloc_size);
 	}
 
 	/* Try special class (general special vdev allocation) */
 	if (error != 0) {
 		error = metaslab_alloc_range(spa, spa_special_class(spa),
-		    min_size, max_size, new_bp, 1, txg, NULL, flags,
+		    min_size, max_size, new_bp, 1, txg, prev_bp, flags,
 		    &io_alloc_list, allocator, NULL, &alloc_size);
 	}
 
 	/* Try embedded_log class (reserved on normal vdevs) */
 	if (error != 0) {
 		error = metaslab_alloc_range(spa, spa_embedded_log_class(spa),
-		    min_size, max_size, new_bp, 1, txg, NULL, flags,
+		    min_size, max_size, new_bp, 1, txg, prev_bp, flags,
 		    &io_alloc_list, allocator, NULL, &alloc_size);
 	}
 
@@ -4497,7 +4848,7 @@ zio_alloc_zil(spa_t *spa, objset_t *os, uint64_t txg, blkptr_t *new_bp,
 	if (error != 0) {
 		ZIOSTAT_BUMP(ziostat_alloc_class_fallbacks);
 		error = metaslab_alloc_range(spa, spa_normal_class(spa),
-		    min_size, max_size, new_bp, 1, txg, NULL, flags,
+		    min_size, max_size, new_bp, 1, txg, prev_bp, flags,
 		    &io_alloc_list, allocator, NULL, &alloc_size);
 	}
 	metaslab_trace_fini(&io_alloc_list);
@@ -5100,8 +5451,12 @@ zio_encrypt(zio_t *zio)
  * Generate and verify checksums
  * ==========================================================================
  */
-static zio_t *
-zio_checksum_generate(zio_t *zio)
+/*
+ * Returns B_FALSE if no checksum needs to be generated for this zio,
+ * otherwise the checksum function to use is returned in 'checksump'.
+ */
+static boolean_t
+zio_checksum_generate_type(zio_t *zio, enum zio_checksum *checksump)
 {
 	blkptr_t *bp = zio->io_bp;
 	enum zio_checksum checksum;
@@ -5114,7 +5469,7 @@ zio_checksum_generate(zio_t *zio)
 		checksum = zio->io_prop.zp_checksum;
 
 		if (checksum == ZIO_CHECKSUM_OFF)
-			return (zio);
+			return (B_FALSE);
 
 		ASSERT(checksum == ZIO_CHECKSUM_LABEL);
 	} else {
@@ -5126,11 +5481,53 @@ zio_checksum_generate(zio_t *zio)
 		}
 	}
 
-	zio_checksum_compute(zio, checksum, zio->io_abd, zio->io_size);
+	*checksump = checksum;
+	return (B_TRUE);
+}
+
+static zio_t *
+zio_checksum_generate(zio_t *zio)
+{
+	enum zio_checksum checksum;
+
+	if (zio_checksum_generate_type(zio, &checksum))
+		zio_checksum_compute(zio, checksum, zio->io_abd, zio->io_size);
 
 	return (zio);
 }
 
+/*
+ * Enter the checksum stage for a batch of zios stopped right before it by
+ * zio_write_batch_execute().  Fletcher 4 checksums are generated together,
+ * the other functions one zio at a time.
+ */
+static void
+zio_checksum_generate_batch(zio_t **zios, uint_t n)
+{
+	zio_t *fletcher4[ZIO_CHECKSUM_MULTI_MAX];
+	enum zio_checksum checksum;
+	uint_t nf = 0;
+
+	ASSERT3U(n, <=, ZIO_CHECKSUM_MULTI_MAX);
+
+	for (uint_t i = 0; i < n; i++) {
+		zio_t *zio = zios[i];
+
+		zio->io_stage = ZIO_STAGE_CHECKSUM_GENERATE;
+		zio->io_pipeline_trace |= zio->io_stage;
+
+		if (!zio_checksum_generate_type(zio, &checksum))
+			continue;
+		if (checksum == ZIO_CHECKSUM_FLETCHER_4)
+			fletcher4[nf++] = zio;
+		else
+			zio_checksum_compute(zio, checksum, zio->io_abd,
+			    zio->io_size);
+	}
+
+	zio_checksum_compute_multi(fletcher4, ZIO_CHECKSUM_FLETCHER_4, nf);
+}
+
 static zio_t *
 zio_checksum_verify(zio_t *zio)
 {
@@ -5983,6 +6380,12 @@ ZFS_MODULE_PARAM(zfs_zio, zio_, slow_io_ms, INT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_zio, zio_, requeue_io_start_cut_in_line, INT, ZMOD_RW,
 	"Prioritize requeued I/O");
 
+ZFS_MODULE_PARAM(zfs_zio, zio_, write_batch_max, UINT, ZMOD_RW,
+	"Max number of small writes issued together from one taskq entry");
+
+ZFS_MODULE_PARAM(zfs_zio, zio_, write_batch_maxsize, UINT, ZMOD_RW,
+	"Max size of writes which may be batched");
+
 ZFS_MODULE_PARAM(zfs, zfs_, sync_pass_deferred_free,  UINT, ZMOD_RW,
 	"Defer frees starting in this pass");
 
@@ -34,6 +34,67 @@
 #include <sys/abd.h>
 #include <zfs_fletcher.h>
 
+static void
+abd_fletcher_4_native_x2(abd_t *abd0, abd_t *abd1, uint64_t size,
+    zio_cksum_t *zcp0, zio_cksum_t *zcp1)
+{
+	fletcher_4_ctx_t ctx[2];
+
+	zio_abd_checksum_data_t acd[2] = {
+		{
+			.acd_byteorder	= ZIO_CHECKSUM_NATIVE,
+			.acd_zcp	= zcp0,
+			.acd_ctx	= &ctx[0]
+		},
+		{
+			.acd_byteorder	= ZIO_CHECKSUM_NATIVE,
+			.acd_zcp	= zcp1,
+			.acd_ctx	= &ctx[1]
+		}
+	};
+
+	fletcher_4_abd_x2_ops.acf_init(acd);
+	(void) abd_iterate_func2(abd0, abd1, 0, 0, size,
+	    fletcher_4_abd_x2_ops.acf_iter, acd);
+	fletcher_4_abd_x2_ops.acf_fini(acd);
+}
+
+/*
+ * Native Fletcher 4 checksums of up to ZIO_CHECKSUM_MULTI_MAX equally sized
+ * ABDs.  Linear buffers are handed to the multi-buffer kernel as a single
+ * batch, anything else is walked two ABDs at a time in lockstep.
+ */
+void
+abd_fletcher_4_native_multi(abd_t **abds, uint64_t size, zio_cksum_t *zcps,
+    uint_t n)
+{
+	const void *bufs[ZIO_CHECKSUM_MULTI_MAX];
+	boolean_t linear = B_TRUE;
+	uint_t i;
+
+	ASSERT3U(n, <=, ZIO_CHECKSUM_MULTI_MAX);
+
+	for (i = 0; i < n; i++) {
+		if (!abd_is_linear(abds[i])) {
+			linear = B_FALSE;
+			break;
+		}
+		bufs[i] = abd_to_buf(abds[i]);
+	}
+
+	if (linear) {
+		fletcher_4_native_multi(bufs, size, zcps, n);
+		return;
+	}
+
+	for (i = 0; i + 1 < n; i += 2) {
+		abd_fletcher_4_native_x2(abds[i], abds[i + 1], size,
+		    &zcps[i], &zcps[i + 1]);
+	}
+	if (i < n)
+		abd_fletcher_4_native(abds[i], size, NULL, &zcps[i]);
+}
+
 /*
  * Checksum vectors.
  *
@@ -340,6 +401,20 @@ zio_checksum_handle_crypt(zio_cksum_t *cksum, zio_cksum_t *saved, boolean_t xor)
 	cksum->zc_word[3] = saved->zc_word[3];
 }
 
+/*
+ * Store a freshly computed checksum in the block pointer, preserving the
+ * MAC words of encrypted blocks.
+ */
+static void
+zio_checksum_store(blkptr_t *bp, zio_cksum_t *cksum, boolean_t insecure)
+{
+	zio_cksum_t saved = bp->blk_cksum;
+
+	if (BP_USES_CRYPT(bp) && BP_GET_TYPE(bp) != DMU_OT_OBJSET)
+		zio_checksum_handle_crypt(cksum, &saved, insecure);
+	bp->blk_cksum = *cksum;
+}
+
 /*
  * Generate the checksum.
  */
@@ -409,12 +484,61 @@ zio_checksum_compute(zio_t *zio, enum zio_checksum checksum,
 		    eck_offset + offsetof(zio_eck_t, zec_cksum),
 		    sizeof (zio_cksum_t));
 	} else {
-		saved = bp->blk_cksum;
 		ci->ci_func[0](abd, size, spa->spa_cksum_tmpls[checksum],
 		    &cksum);
-		if (BP_USES_CRYPT(bp) && BP_GET_TYPE(bp) != DMU_OT_OBJSET)
-			zio_checksum_handle_crypt(&cksum, &saved, insecure);
-		bp->blk_cksum = cksum;
+		zio_checksum_store(bp, &cksum, insecure);
+	}
+}
+
+/*
+ * Generate the checksums of several write zios using the same checksum
+ * function in one pass.  Fletcher 4 checksums of equally sized blocks are
+ * computed with the multi-buffer implementation; everything else, as well
+ * as embedded checksums, falls back to zio_checksum_compute() per zio.
+ */
+void
+zio_checksum_compute_multi(zio_t **zios, enum zio_checksum checksum,
+    uint_t n)
+{
+	zio_checksum_info_t *ci = &zio_checksum_table[checksum];
+	abd_t *abds[ZIO_CHECKSUM_MULTI_MAX];
+	zio_cksum_t cksums[ZIO_CHECKSUM_MULTI_MAX];
+	boolean_t insecure = (ci->ci_flags & ZCHECKSUM_FLAG_DEDUP) == 0;
+	uint_t i, j, c;
+
+	ASSERT((uint_t)checksum < ZIO_CHECKSUM_FUNCTIONS);
+
+	if (checksum != ZIO_CHECKSUM_FLETCHER_4 || n < 2) {
+		for (i = 0; i < n; i++) {
+			zio_checksum_compute(zios[i], checksum,
+			    zios[i]->io_abd, zios[i]->io_size);
+		}
+		return;
+	}
+
+	for (i = 0; i < n; i = j) {
+		uint64_t size = zios[i]->io_size;
+
+		/* Gather a run of blocks of the same size */
+		for (j = i + 1; j < n && j - i < ZIO_CHECKSUM_MULTI_MAX &&
+		    zios[j]->io_size == size; j++)
+			;
+
+		if (j - i == 1) {
+			zio_checksum_compute(zios[i], checksum,
+			    zios[i]->io_abd, size);
+			continue;
+		}
+
+		for (c = 0; c < j - i; c++) {
+			ASSERT3P(zios[i + c]->io_bp, !=, NULL);
+			abds[c] = zios[i + c]->io_abd;
+		}
+		abd_fletcher_4_native_multi(abds, size, cksums, j - i);
+		for (c = 0; c < j - i; c++) {
+			zio_checksum_store(zios[i + c]->io_bp, &cksums[c],
+			    insecure);
+		}
 	}
 }
 
@@ -289,6 +289,100 @@ drain_tree(zfs_btree_t *bt, char *why)
 	return (0);
 }
 
+/*
+ * Bulk load a sorted array of random values, then verify the tree against an
+ * avl tree holding the same values while inserting and removing more.
+ */
+static int
+bulk_load(zfs_btree_t *bt, char *why)
+{
+	avl_tree_t avl;
+	int_node_t *node;
+	avl_index_t avl_idx = {0};
+	zfs_btree_index_t bt_idx = {0};
+	uint64_t *vals, nvals = 0;
+
+	avl_create(&avl, avl_compare, sizeof (int_node_t),
+	    offsetof(int_node_t, node));
+
+	for (int i = 0; i < 64 * 1024; i++) {
+		node = malloc(sizeof (int_node_t));
+		if (node == NULL) {
+			perror("malloc");
+			exit(EXIT_FAILURE);
+		}
+		node->data = random();
+		if (avl_find(&avl, node, &avl_idx) != NULL) {
+			free(node);
+			continue;
+		}
+		avl_insert(&avl, node, avl_idx);
+	}
+
+	vals = malloc(avl_numnodes(&avl) * sizeof (uint64_t));
+	if (vals == NULL) {
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	for (node = avl_first(&avl); node != NULL; node = AVL_NEXT(&avl, node))
+		vals[nvals++] = node->data;
+
+	zfs_btree_bulk_load(bt, vals, nvals);
+	free(vals);
+	zfs_btree_verify(bt);
+	verify_contents(&avl, bt);
+
+	for (node = avl_first(&avl); node != NULL; node = AVL_NEXT(&avl, node))
+		verify_node(&avl, bt, node);
+
+	/* The loaded tree must keep working under further modification. */
+	for (int i = 0; i < 16 * 1024; i++) {
+		uint64_t randval = random();
+
+		node = malloc(sizeof (int_node_t));
+		if (node == NULL) {
+			perror("malloc");
+			exit(EXIT_FAILURE);
+		}
+		node->data = randval;
+
+		int_node_t *found = avl_find(&avl, node, &avl_idx);
+		if (found == NULL) {
+			avl_insert(&avl, node, avl_idx);
+			ASSERT3P(zfs_btree_find(bt, &randval, &bt_idx), ==,
+			    NULL);
+			zfs_btree_add_idx(bt, &randval, &bt_idx);
+		} else {
+			zfs_btree_remove(bt, &randval);
+			avl_remove(&avl, found);
+			free(found);
+			free(node);
+		}
+
+		/* Also remove the smallest value to shrink the leftmost leaf */
+		if ((node = avl_first(&avl)) != NULL) {
+			zfs_btree_remove(bt, &node->data);
+			avl_remove(&avl, node);
+			free(node);
+		}
+	}
+	zfs_btree_verify(bt);
+	verify_contents(&avl, bt);
+
+	if (avl_numnodes(&avl) != zfs_btree_numnodes(bt)) {
+		(void) snprintf(why, BUFSIZE, "Tree has %lu nodes, not %lu\n",
+		    zfs_btree_numnodes(bt), avl_numnodes(&avl));
+		return (1);
+	}
+
+	void *avl_cookie = NULL;
+	while ((node = avl_destroy_nodes(&avl, &avl_cookie)) != NULL)
+		free(node);
+	avl_destroy(&avl);
+
+	return (0);
+}
+
 /*
  * This test uses an avl and btree, and continually processes new random
  * values. Each value is either removed or inserted, depending on whether
@@ -455,6 +549,7 @@ static btree_test_t test_table[] = {
 	{ "insert_find_remove",		insert_find_remove	},
 	{ "find_without_index",		find_without_index	},
 	{ "drain_tree",			drain_tree		},
+	{ "bulk_load",			bulk_load		},
 	{ "stress_tree",		stress_tree		},
 	{ NULL,				NULL			}
 };
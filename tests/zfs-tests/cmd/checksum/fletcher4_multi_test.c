@@ -0,0 +1,227 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Compare the multi-buffer Fletcher 4 entry points, fletcher_4_native_multi()
+ * and abd_fletcher_4_native_multi(), against the scalar implementation for
+ * every supported implementation, using random buffers, batch sizes and
+ * lengths.  The ABDs are alternately linear and gang ABDs split at random
+ * points, so both the batched kernel and the two-stream ABD walk are covered.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/abd.h>
+#include <sys/zio_checksum.h>
+#include <zfs_fletcher.h>
+
+#define	MAX_SIZE	(256 * 1024)
+
+/* Block size of the SIMD kernels, see zfs_fletcher.c */
+#define	SIMD_SIZE	64
+
+static const char *const impls[] = {
+	"scalar",
+	"superscalar",
+	"superscalar4",
+	"sse2",
+	"ssse3",
+	"avx2",
+	"avx512f",
+	"avx512bw",
+	"aarch64_neon",
+	"fastest",
+	"cycle",
+};
+
+static uint8_t *bufs[ZIO_CHECKSUM_MULTI_MAX];
+static zio_cksum_t expected[ZIO_CHECKSUM_MULTI_MAX];
+
+static void
+usage(const char *prog)
+{
+	(void) fprintf(stderr,
+	    "Usage: %s [-i iterations] [-s seed]\n", prog);
+	exit(2);
+}
+
+/* Pick a length, favouring the edges of the SIMD block size. */
+static uint64_t
+random_size(void)
+{
+	uint64_t size;
+
+	switch (random() % 4) {
+	case 0:
+		size = random() % (4 * SIMD_SIZE);
+		break;
+	case 1:
+		size = (1 + random() % 64) * SIMD_SIZE +
+		    random() % SIMD_SIZE;
+		break;
+	case 2:
+		size = (1 + random() % (MAX_SIZE / 512)) * 512;
+		break;
+	default:
+		size = random() % MAX_SIZE;
+		break;
+	}
+
+	return (P2ALIGN_TYPED(size, sizeof (uint32_t), uint64_t));
+}
+
+/* A gang ABD holding a copy of buf in up to four linear pieces. */
+static abd_t *
+random_gang(const uint8_t *buf, uint64_t size)
+{
+	abd_t *gang = abd_alloc_gang();
+	uint64_t off = 0;
+
+	for (int i = 0; i < 3 && off < size; i++) {
+		uint64_t len = random() % (size - off + 1);
+
+		if (len == 0)
+			continue;
+		abd_t *abd = abd_alloc_linear(len, B_FALSE);
+		abd_copy_from_buf(abd, buf + off, len);
+		abd_gang_add(gang, abd, B_TRUE);
+		off += len;
+	}
+	if (off < size) {
+		abd_t *abd = abd_alloc_linear(size - off, B_FALSE);
+		abd_copy_from_buf(abd, buf + off, size - off);
+		abd_gang_add(gang, abd, B_TRUE);
+	}
+
+	return (gang);
+}
+
+static int
+check(const char *impl, const char *what, const zio_cksum_t *zcps,
+    uint_t n, uint64_t size)
+{
+	for (uint_t i = 0; i < n; i++) {
+		if (!ZIO_CHECKSUM_EQUAL(zcps[i], expected[i])) {
+			(void) printf("%s: %s mismatch for buffer %u of %u, "
+			    "size %llu\n", impl, what, i, n,
+			    (unsigned long long)size);
+			return (1);
+		}
+	}
+
+	return (0);
+}
+
+static int
+run_one(const char *impl)
+{
+	zio_cksum_t zcps[ZIO_CHECKSUM_MULTI_MAX];
+	abd_t *abds[ZIO_CHECKSUM_MULTI_MAX];
+	uint_t n = 1 + random() % ZIO_CHECKSUM_MULTI_MAX;
+	uint64_t size = random_size();
+	boolean_t gang = random() % 2;
+	int err = 0;
+
+	for (uint_t i = 0; i < n; i++) {
+		for (uint64_t j = 0; j < size; j++)
+			bufs[i][j] = random();
+		fletcher_4_native_varsize(bufs[i], size, &expected[i]);
+	}
+
+	(void) memset(zcps, 0, sizeof (zcps));
+	fletcher_4_native_multi((const void *const *)bufs, size, zcps, n);
+	err |= check(impl, "fletcher_4_native_multi", zcps, n, size);
+
+	for (uint_t i = 0; i < n; i++) {
+		if (gang && size > 0) {
+			abds[i] = random_gang(bufs[i], size);
+		} else {
+			abds[i] = abd_alloc_linear(MAX(size, 1), B_FALSE);
+			abd_copy_from_buf(abds[i], bufs[i], size);
+		}
+	}
+
+	(void) memset(zcps, 0, sizeof (zcps));
+	abd_fletcher_4_native_multi(abds, size, zcps, n);
+	err |= check(impl, gang ? "abd_fletcher_4_native_multi (gang)" :
+	    "abd_fletcher_4_native_multi (linear)", zcps, n, size);
+
+	for (uint_t i = 0; i < n; i++)
+		abd_free(abds[i]);
+
+	return (err);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned long iterations = 1000;
+	unsigned int seed = time(NULL) ^ getpid();
+	int c, err = 0;
+
+	while ((c = getopt(argc, argv, "i:s:")) != -1) {
+		switch (c) {
+		case 'i':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	(void) printf("seed %u\n", seed);
+	srandom(seed);
+
+	abd_init();
+	fletcher_4_init();
+
+	for (int i = 0; i < ZIO_CHECKSUM_MULTI_MAX; i++)
+		bufs[i] = malloc(MAX_SIZE);
+
+	for (size_t i = 0; i < sizeof (impls) / sizeof (impls[0]); i++) {
+		int failed = 0;
+
+		if (fletcher_4_impl_set(impls[i]) != 0)
+			continue;
+
+		for (unsigned long j = 0; j < iterations && !failed; j++)
+			failed = run_one(impls[i]);
+
+		(void) printf("%-14s %s\n", impls[i],
+		    failed ? "FAILED" : "passed");
+		err |= failed;
+	}
+
+	for (int i = 0; i < ZIO_CHECKSUM_MULTI_MAX; i++)
+		free(bufs[i]);
+
+	fletcher_4_fini();
+	abd_fini();
+
+	return (err);
+}
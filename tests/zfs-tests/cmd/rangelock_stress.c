@@ -0,0 +1,365 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Concurrently read, write, append to and truncate a single file to
+ * exercise both the sharded fast path and the slow path of the range lock.
+ *
+ * Every write is a CHUNK sized buffer filled with one 64-bit stamp, so a
+ * read which is not torn by a concurrent write or truncate always finds
+ * each CHUNK it covers either holding a single stamp or all zeros.  The
+ * file is laid out as:
+ *
+ *   [0, DISJOINT_END)              Each writer owns its own REGION and
+ *                                  readers read 1-4 aligned chunks at a
+ *                                  time, some of them spanning a bucket.
+ *   [DISJOINT_END, STRADDLE_END)   Writers and readers both use a CHUNK
+ *                                  centred on a BUCKET boundary.
+ *   [STRADDLE_END, ...)            The tail, grown by O_APPEND writers and
+ *                                  cut back by ftruncate(2).
+ *
+ * The program exits non-zero if a torn read or an I/O error is seen.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define	CHUNK		(128 * 1024)
+#define	BUCKET		(1024 * 1024)
+#define	REGION		(4 * BUCKET)
+#define	MAX_WRITERS	16
+#define	DISJOINT_END	((off_t)MAX_WRITERS * REGION)
+#define	STRADDLE_END	(DISJOINT_END + 16 * BUCKET)
+#define	TAIL_MAX	(16 * BUCKET)
+
+static const char *filename;
+static int nthreads = 8;
+static int runtime = 30;
+static volatile int done;
+static volatile int failed;
+
+static void
+usage(const char *prog)
+{
+	(void) fprintf(stderr,
+	    "Usage: %s [-n threads] [-t seconds] <file>\n", prog);
+	exit(2);
+}
+
+static void
+fail(const char *fmt, ...)
+    __attribute__((format(printf, 1, 2)));
+
+static void
+fail(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	(void) vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	failed = 1;
+	done = 1;
+}
+
+static void
+fill(uint64_t *buf, uint64_t stamp)
+{
+	for (size_t i = 0; i < CHUNK / sizeof (uint64_t); i++)
+		buf[i] = stamp;
+}
+
+/*
+ * Verify that each CHUNK of a read holds a single stamp, allowing for the
+ * read to be cut short by a truncate.
+ */
+static void
+verify(const uint64_t *buf, ssize_t len, off_t off)
+{
+	size_t words = CHUNK / sizeof (uint64_t);
+
+	if (len % CHUNK != 0) {
+		fail("read at %lld returned %zd bytes, not a multiple of %d\n",
+		    (long long)off, len, CHUNK);
+		return;
+	}
+
+	for (ssize_t c = 0; c < len / CHUNK; c++) {
+		const uint64_t *p = buf + c * words;
+
+		for (size_t i = 1; i < words; i++) {
+			if (p[i] != p[0]) {
+				fail("torn read at %lld: %llx != %llx\n",
+				    (long long)(off + c * CHUNK + i * 8),
+				    (unsigned long long)p[i],
+				    (unsigned long long)p[0]);
+				return;
+			}
+		}
+	}
+}
+
+static void
+do_pwrite(int fd, const void *buf, off_t off)
+{
+	ssize_t n = pwrite(fd, buf, CHUNK, off);
+
+	if (n != CHUNK)
+		fail("pwrite at %lld: %zd (%s)\n", (long long)off, n,
+		    n < 0 ? strerror(errno) : "short write");
+}
+
+static void
+do_pread(int fd, void *buf, size_t len, off_t off)
+{
+	ssize_t n = pread(fd, buf, len, off);
+
+	if (n < 0)
+		fail("pread at %lld: %s\n", (long long)off, strerror(errno));
+	else
+		verify(buf, n, off);
+}
+
+static int
+open_file(int flags)
+{
+	int fd = open(filename, flags);
+
+	if (fd < 0)
+		fail("open %s: %s\n", filename, strerror(errno));
+	return (fd);
+}
+
+/* Writes to a REGION of the file no other writer touches. */
+static void *
+disjoint_writer(void *arg)
+{
+	int id = (int)(uintptr_t)arg;
+	unsigned int seed = id;
+	uint64_t *buf = malloc(CHUNK);
+	uint64_t seq = 0;
+	int fd = open_file(O_RDWR);
+
+	while (!done && fd >= 0) {
+		off_t off = (off_t)id * REGION +
+		    (rand_r(&seed) % (REGION / CHUNK)) * CHUNK;
+
+		fill(buf, ((uint64_t)(id + 1) << 48) | ++seq);
+		do_pwrite(fd, buf, off);
+	}
+
+	if (fd >= 0)
+		(void) close(fd);
+	free(buf);
+	return (NULL);
+}
+
+/*
+ * Reads 1-4 aligned chunks of the disjoint area.  Reads crossing a BUCKET
+ * boundary cannot use a single shard and so take the slow path.
+ */
+static void *
+disjoint_reader(void *arg)
+{
+	unsigned int seed = (unsigned int)(uintptr_t)arg + MAX_WRITERS;
+	uint64_t *buf = malloc(4 * CHUNK);
+	int fd = open_file(O_RDONLY);
+
+	while (!done && fd >= 0) {
+		size_t len = (1 + rand_r(&seed) % 4) * CHUNK;
+		off_t off = (rand_r(&seed) % (DISJOINT_END / CHUNK)) * CHUNK;
+
+		if (off + len > DISJOINT_END)
+			off = DISJOINT_END - len;
+		do_pread(fd, buf, len, off);
+	}
+
+	if (fd >= 0)
+		(void) close(fd);
+	free(buf);
+	return (NULL);
+}
+
+/* Reads and writes a CHUNK straddling a BUCKET boundary. */
+static void *
+straddler(void *arg)
+{
+	int id = (int)(uintptr_t)arg;
+	unsigned int seed = id + 2 * MAX_WRITERS;
+	uint64_t *buf = malloc(CHUNK);
+	uint64_t seq = 0;
+	int fd = open_file(O_RDWR);
+
+	while (!done && fd >= 0) {
+		off_t off = DISJOINT_END - CHUNK / 2 +
+		    (1 + rand_r(&seed) % 15) * (off_t)BUCKET;
+
+		if (rand_r(&seed) % 2) {
+			fill(buf, ((uint64_t)(id + 0x100) << 48) | ++seq);
+			do_pwrite(fd, buf, off);
+		} else {
+			do_pread(fd, buf, CHUNK, off);
+		}
+	}
+
+	if (fd >= 0)
+		(void) close(fd);
+	free(buf);
+	return (NULL);
+}
+
+/* Grows the tail of the file with O_APPEND writes and reads it back. */
+static void *
+appender(void *arg)
+{
+	int id = (int)(uintptr_t)arg;
+	unsigned int seed = id + 3 * MAX_WRITERS;
+	uint64_t *buf = malloc(CHUNK);
+	uint64_t seq = 0;
+	int fd = open_file(O_RDWR | O_APPEND);
+
+	while (!done && fd >= 0) {
+		struct stat st;
+
+		if (fstat(fd, &st) != 0) {
+			fail("fstat: %s\n", strerror(errno));
+			break;
+		}
+
+		if (st.st_size >= STRADDLE_END + TAIL_MAX) {
+			if (ftruncate(fd, STRADDLE_END) != 0)
+				fail("ftruncate: %s\n", strerror(errno));
+		} else if (rand_r(&seed) % 2) {
+			ssize_t n;
+
+			fill(buf, ((uint64_t)(id + 0x200) << 48) | ++seq);
+			n = write(fd, buf, CHUNK);
+			if (n != CHUNK) {
+				fail("append: %zd (%s)\n", n,
+				    n < 0 ? strerror(errno) : "short write");
+			}
+		} else if (st.st_size > STRADDLE_END) {
+			off_t off = STRADDLE_END + (rand_r(&seed) %
+			    ((st.st_size - STRADDLE_END) / CHUNK + 1)) * CHUNK;
+
+			do_pread(fd, buf, CHUNK, off);
+		}
+	}
+
+	if (fd >= 0)
+		(void) close(fd);
+	free(buf);
+	return (NULL);
+}
+
+/* Cuts the tail back to a random CHUNK aligned size. */
+static void *
+truncater(void *arg)
+{
+	unsigned int seed = (unsigned int)(uintptr_t)arg + 4 * MAX_WRITERS;
+	int fd = open_file(O_RDWR);
+
+	while (!done && fd >= 0) {
+		off_t size = STRADDLE_END +
+		    (rand_r(&seed) % (TAIL_MAX / CHUNK)) * CHUNK;
+
+		if (ftruncate(fd, size) != 0)
+			fail("ftruncate to %lld: %s\n", (long long)size,
+			    strerror(errno));
+		(void) usleep(10000);
+	}
+
+	if (fd >= 0)
+		(void) close(fd);
+	return (NULL);
+}
+
+int
+main(int argc, char **argv)
+{
+	pthread_t tids[4 * MAX_WRITERS + 1];
+	int c, fd, n = 0;
+
+	while ((c = getopt(argc, argv, "n:t:")) != -1) {
+		switch (c) {
+		case 'n':
+			nthreads = atoi(optarg);
+			break;
+		case 't':
+			runtime = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (optind != argc - 1 || nthreads < 1 || nthreads > MAX_WRITERS ||
+	    runtime < 1)
+		usage(argv[0]);
+	filename = argv[optind];
+
+	fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		perror("open");
+		return (1);
+	}
+	if (ftruncate(fd, STRADDLE_END) != 0) {
+		perror("ftruncate");
+		return (1);
+	}
+	(void) close(fd);
+
+	for (int i = 0; i < nthreads; i++) {
+		void *arg = (void *)(uintptr_t)i;
+
+		if (pthread_create(&tids[n++], NULL, disjoint_writer, arg) ||
+		    pthread_create(&tids[n++], NULL, disjoint_reader, arg) ||
+		    pthread_create(&tids[n++], NULL, straddler, arg) ||
+		    pthread_create(&tids[n++], NULL, appender, arg)) {
+			perror("pthread_create");
+			return (1);
+		}
+	}
+	if (pthread_create(&tids[n++], NULL, truncater, NULL)) {
+		perror("pthread_create");
+		return (1);
+	}
+
+	for (int i = 0; i < runtime && !done; i++)
+		(void) sleep(1);
+	done = 1;
+
+	for (int i = 0; i < n; i++)
+		(void) pthread_join(tids[i], NULL);
+
+	return (failed);
+}